@@ -0,0 +1,199 @@
+// Attestation benchmark: challenge every stick, then verify the batch.
+//
+//   attest_bench [devices] [rounds] [threads]
+//   attest_bench --tty /dev/ttyACM0 [--tty ...] [rounds] [threads]
+//
+// Each device answers `rounds` fresh challenges one after another, all
+// devices at once. Device side: round trip per ATTEST and the claims and
+// signing times the stick reports. Host side: the whole batch verified
+// with 1, 2, 4... up to `threads` workers (default: one per core), plus a
+// tampered copy that must be rejected. Without --tty the devices are
+// simulated sticks on ptys, which sign in software on a single thread, so
+// their round trip says nothing about hardware; the verify figures do.
+
+#include "cashstick/attestation.hpp"
+#include "cashstick/fleet.hpp"
+#include "sim_device.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace cashstick;
+
+namespace {
+
+using Challenge = std::array<uint8_t, ATTESTATION_CHALLENGE_SIZE>;
+
+struct BenchState {
+    Fleet *fleet;
+    std::mt19937_64 rng{std::random_device{}()};
+    std::vector<Challenge> challenges;      // Outstanding one per device
+    std::vector<uint32_t> remaining;
+    std::vector<Attestation> attestations;
+    std::vector<uint64_t> latencies;
+    std::vector<uint32_t> sign_us;
+    size_t failed = 0;
+};
+
+void on_reply(void *ctx, const Reply &reply);
+
+bool issue(BenchState &state, int device) {
+    if (state.remaining[(size_t)device] == 0) {
+        return false;
+    }
+
+    Challenge &challenge = state.challenges[(size_t)device];
+    for (size_t i = 0; i < challenge.size(); i += 8) {
+        uint64_t word = state.rng();
+        memcpy(challenge.data() + i, &word, 8);
+    }
+    if (!state.fleet->attest(device, challenge.data(), on_reply, &state)) {
+        return false;
+    }
+    state.remaining[(size_t)device]--;
+    return true;
+}
+
+void on_reply(void *ctx, const Reply &reply) {
+    BenchState &state = *static_cast<BenchState *>(ctx);
+
+    Attestation attestation;
+    if (!parse_attestation(reply.json, state.challenges[(size_t)reply.device].data(), &attestation)) {
+        state.failed++;
+        fprintf(stderr, "BENCH: device %d: %.*s\n", reply.device, (int)reply.line.size(), reply.line.data());
+    } else {
+        state.attestations.push_back(attestation);
+        state.latencies.push_back(reply.latency_ns);
+        state.sign_us.push_back(attestation.sign_us);
+    }
+
+    issue(state, reply.device);
+}
+
+template <typename T>
+double percentile(std::vector<T> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return (double)values[std::min(values.size() - 1, (size_t)(p * (double)values.size()))];
+}
+
+void raise_fd_limit() {
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<const char *> ttys;
+    std::vector<unsigned long> numbers;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tty") == 0 && i + 1 < argc) {
+            ttys.push_back(argv[++i]);
+        } else {
+            numbers.push_back(strtoul(argv[i], nullptr, 0));
+        }
+    }
+
+    // Positional: [devices] rounds threads, devices only when simulating
+    size_t arg = 0;
+    size_t devices = ttys.empty() ? (numbers.size() > arg ? numbers[arg++] : 256) : ttys.size();
+    uint32_t rounds = numbers.size() > arg ? (uint32_t)numbers[arg++] : 4;
+    unsigned max_threads = numbers.size() > arg ? (unsigned)numbers[arg++] : 0;
+    if (max_threads == 0) {
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    raise_fd_limit();
+
+    std::unique_ptr<SimDevices> sims;
+    std::vector<std::string> paths(ttys.begin(), ttys.end());
+    if (ttys.empty()) {
+        sims = std::make_unique<SimDevices>(devices);
+        if (!sims->ok()) {
+            fprintf(stderr, "BENCH: could not create %zu ptys\n", devices);
+            return 1;
+        }
+        paths = sims->slave_paths();
+    }
+
+    Fleet fleet(devices);
+    std::vector<int> ids;
+    for (const std::string &path : paths) {
+        int id = fleet.add(path.c_str());
+        if (id < 0) {
+            fprintf(stderr, "BENCH: %s: error %d\n", path.c_str(), -id);
+            return 1;
+        }
+        ids.push_back(id);
+    }
+    if (sims) {
+        sims->start();
+    }
+
+    BenchState state;
+    state.fleet = &fleet;
+    state.challenges.resize(devices);
+    state.remaining.assign(devices, rounds);
+    state.attestations.reserve(devices * rounds);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int id : ids) {
+        issue(state, id);
+    }
+    bool idle = fleet.drain(600000);
+    double collect_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (sims) {
+        sims->stop();
+    }
+
+    printf("BENCH: %zu %s devices, %u rounds: %zu attestations in %.3f s%s, %zu failed\n",
+           devices, sims ? "simulated" : "attached", rounds, state.attestations.size(), collect_s,
+           idle ? "" : " (timed out)", state.failed);
+    printf("BENCH: device round trip p50 %.1f ms, p99 %.1f ms; reported sign p50 %.1f ms\n",
+           percentile(state.latencies, 0.50) / 1e6, percentile(state.latencies, 0.99) / 1e6,
+           percentile(state.sign_us, 0.50) / 1e3);
+
+    // Host side: the same batch at each worker count
+    std::vector<uint8_t> results;
+    size_t batch = state.attestations.size();
+    bool all_verified = true;
+    for (unsigned threads = 1;; threads = std::min(threads * 2, max_threads)) {
+        auto verify_start = std::chrono::steady_clock::now();
+        size_t verified = verify_attestations(state.attestations, &results, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - verify_start).count();
+
+        printf("BENCH: verify %2u threads: %zu/%zu in %.3f s, %.0f/s\n",
+               threads, verified, batch, seconds, seconds > 0 ? (double)batch / seconds : 0.0);
+        all_verified &= verified == batch;
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    // A claim changed after signing must not verify
+    bool rejected = true;
+    if (batch > 0) {
+        std::vector<Attestation> tampered(1, state.attestations[0]);
+        tampered[0].claims.state_counter++;
+        rejected = verify_attestations(tampered, &results, 1) == 0;
+        printf("BENCH: altered claim %s\n", rejected ? "rejected" : "ACCEPTED");
+    }
+
+    return idle && state.failed == 0 && all_verified && rejected ? 0 : 1;
+}
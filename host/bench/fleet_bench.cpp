@@ -0,0 +1,146 @@
+// Scale benchmark: one Fleet driving many simulated sticks over ptys.
+//
+//   fleet_bench [devices] [requests per device] [pipeline depth]
+//
+// Requests cycle STATUS / ADDRESS / PUBKEY and every reply is parsed. Run
+// it once with depth 1 and once deeper to see what pipelining buys.
+
+#include "cashstick/fleet.hpp"
+#include "sim_device.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace cashstick;
+
+namespace {
+
+struct BenchState {
+    Fleet *fleet;
+    std::vector<uint32_t> remaining;    // Requests still to issue per device
+    std::vector<uint32_t> issued;
+    std::vector<uint64_t> latencies;    // Preallocated, one per request
+    size_t completed = 0;
+    size_t failed = 0;
+    size_t parsed_fields = 0;
+};
+
+void on_reply(void *ctx, const Reply &reply);
+
+bool issue(BenchState &state, int device) {
+    if (state.remaining[(size_t)device] == 0) {
+        return false;
+    }
+
+    bool queued;
+    switch (state.issued[(size_t)device] % 3) {
+        case 0:  queued = state.fleet->status(device, on_reply, &state); break;
+        case 1:  queued = state.fleet->address(device, "p2wpkh", on_reply, &state); break;
+        default: queued = state.fleet->pubkey(device, on_reply, &state); break;
+    }
+    if (queued) {
+        state.remaining[(size_t)device]--;
+        state.issued[(size_t)device]++;
+    }
+    return queued;
+}
+
+void on_reply(void *ctx, const Reply &reply) {
+    BenchState &state = *static_cast<BenchState *>(ctx);
+
+    if (!reply.ok()) {
+        state.failed++;
+    } else if (reply.command == "STATUS") {
+        state.parsed_fields += reply.json.str("device_id").has_value() +
+                               reply.json.u64("state").has_value() +
+                               reply.json.boolean("tamper_intact").has_value();
+    } else if (reply.command == "ADDRESS") {
+        state.parsed_fields += reply.json.str("address").has_value();
+    } else {
+        state.parsed_fields += reply.json.str("pubkey").has_value();
+    }
+
+    if (state.completed < state.latencies.size()) {
+        state.latencies[state.completed] = reply.latency_ns;
+    }
+    state.completed++;
+
+    // Keep this device's pipeline full
+    issue(state, reply.device);
+}
+
+void raise_fd_limit() {
+    rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    size_t devices = argc > 1 ? strtoul(argv[1], nullptr, 0) : 256;
+    uint32_t per_device = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 1000;
+    size_t depth = argc > 3 ? strtoul(argv[3], nullptr, 0) : 8;
+    depth = std::min(std::max<size_t>(depth, 1), Fleet::kMaxInFlight);
+
+    raise_fd_limit();
+
+    SimDevices sims(devices);
+    if (!sims.ok()) {
+        fprintf(stderr, "BENCH: could not create %zu ptys\n", devices);
+        return 1;
+    }
+
+    Fleet fleet(devices);
+    std::vector<int> ids;
+    for (const std::string &path : sims.slave_paths()) {
+        int id = fleet.add(path.c_str());
+        if (id < 0) {
+            fprintf(stderr, "BENCH: %s: error %d\n", path.c_str(), -id);
+            return 1;
+        }
+        ids.push_back(id);
+    }
+    sims.start();
+
+    BenchState state;
+    state.fleet = &fleet;
+    state.remaining.assign(devices, per_device);
+    state.issued.assign(devices, 0);
+    state.latencies.assign(devices * per_device, 0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int id : ids) {
+        for (size_t i = 0; i < depth; i++) {
+            issue(state, id);
+        }
+    }
+    bool idle = fleet.drain(60000);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sims.stop();
+
+    std::vector<uint64_t> &lat = state.latencies;
+    lat.resize(std::min(lat.size(), state.completed));
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&lat](double p) {
+        return lat.empty() ? 0.0 : lat[std::min(lat.size() - 1, (size_t)(p * (double)lat.size()))] / 1000.0;
+    };
+
+    printf("BENCH: %zu devices, depth %zu, %zu requests in %.3f s%s\n",
+           devices, depth, state.completed, seconds, idle ? "" : " (timed out)");
+    printf("BENCH: %.0f requests/s, %zu failed, %zu fields parsed\n",
+           (double)state.completed / seconds, state.failed, state.parsed_fields);
+    printf("BENCH: latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           pct(0.50), pct(0.99), lat.empty() ? 0.0 : lat.back() / 1000.0);
+
+    return idle && state.failed == 0 ? 0 : 1;
+}
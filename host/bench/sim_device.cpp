@@ -0,0 +1,269 @@
+#include "sim_device.hpp"
+
+#include "attestation.h"
+#include "secp256k1.h"
+#include "sha256.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace cashstick {
+
+namespace {
+
+// One firmware log line per this many commands, as printf() would emit
+constexpr uint32_t kLogEvery = 16;
+
+// What a simulated stick reports as its measured firmware
+constexpr char kSimFirmware[] = "cashstick sim firmware";
+
+bool parse_challenge(const std::string &hex, uint8_t out[ATTESTATION_CHALLENGE_SIZE]) {
+    if (hex.size() != ATTESTATION_CHALLENGE_SIZE * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < ATTESTATION_CHALLENGE_SIZE; i++) {
+        unsigned value;
+        if (sscanf(hex.c_str() + i * 2, "%2x", &value) != 1) {
+            return false;
+        }
+        out[i] = (uint8_t)value;
+    }
+    return true;
+}
+
+size_t append_hex(char *out, size_t len, size_t size, const uint8_t *data, size_t count) {
+    for (size_t i = 0; i < count && len < size; i++) {
+        len += (size_t)snprintf(out + len, size - len, "%02x", data[i]);
+    }
+    return len;
+}
+
+} // namespace
+
+SimDevices::SimDevices(size_t count) : sims_(count) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        return;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = UINT32_MAX;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    paths_.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+            fprintf(stderr, "SIM: pty %zu: %s\n", i, strerror(errno));
+            if (master >= 0) {
+                ::close(master);
+            }
+            return;
+        }
+
+        // Holding a slave fd open keeps the master from reporting a hangup
+        // while no host is attached; raw mode so nothing is echoed back
+        int slave = ::open(ptsname(master), O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (slave < 0) {
+            fprintf(stderr, "SIM: pty %zu: %s\n", i, strerror(errno));
+            ::close(master);
+            return;
+        }
+        termios tio;
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+
+        sims_[i].master = master;
+        sims_[i].slave = slave;
+        sims_[i].serial = 0xC5000000u + (uint32_t)i;
+        paths_.push_back(ptsname(master));
+
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, master, &ev);
+    }
+    ok_ = true;
+}
+
+SimDevices::~SimDevices() {
+    stop();
+    for (Sim &sim : sims_) {
+        if (sim.slave >= 0) {
+            ::close(sim.slave);
+        }
+        if (sim.master >= 0) {
+            ::close(sim.master);
+        }
+    }
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+}
+
+void SimDevices::start() {
+    if (!ok_ || running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread(&SimDevices::run, this);
+}
+
+void SimDevices::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    (void)n;
+    thread_.join();
+}
+
+void SimDevices::run() {
+    epoll_event events[64];
+    char chunk[4096];
+
+    while (running_.load()) {
+        int n = epoll_wait(epoll_fd_, events, 64, -1);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u32 == UINT32_MAX) {
+                continue;
+            }
+            Sim &sim = sims_[events[i].data.u32];
+
+            if (events[i].events & EPOLLOUT) {
+                flush(sim);
+            }
+            if (!(events[i].events & EPOLLIN)) {
+                continue;
+            }
+
+            ssize_t len;
+            while ((len = ::read(sim.master, chunk, sizeof(chunk))) > 0) {
+                sim.rx.append(chunk, (size_t)len);
+            }
+
+            size_t eol;
+            while ((eol = sim.rx.find_first_of("\r\n")) != std::string::npos) {
+                std::string line = sim.rx.substr(0, eol);
+                sim.rx.erase(0, eol + 1);
+                if (!line.empty()) {
+                    serve_line(sim, line);
+                }
+            }
+            flush(sim);
+        }
+    }
+}
+
+void SimDevices::serve_line(Sim &sim, const std::string &line) {
+    char reply[512];
+    std::string command = line.substr(0, line.find(' '));
+
+    if (++sim.commands % kLogEvery == 0) {
+        sim.tx += "USB: Simulated log line\r\n";
+    }
+
+    if (command == "PING") {
+        snprintf(reply, sizeof(reply), "{\"pong\":true}");
+    } else if (command == "STATUS") {
+        snprintf(reply, sizeof(reply),
+                 "{\"device_id\":\"%08x\",\"state\":2,\"tamper_intact\":true,\"keys_present\":true,"
+                 "\"wakeups\":%u,\"wakeups_per_hour\":12,\"key_pool_ready\":2,\"key_pool_depth\":2,"
+                 "\"state_commits\":1,\"firmware_version\":\"1.0.0\",\"signing_key\":\"vendor\",\"scp03_keys\":\"provisioned\"}",
+                 sim.serial, sim.commands);
+    } else if (command == "ADDRESS") {
+        snprintf(reply, sizeof(reply),
+                 "{\"format\":\"p2wpkh\",\"address\":\"bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4\"}");
+    } else if (command == "PUBKEY") {
+        snprintf(reply, sizeof(reply),
+                 "{\"pubkey\":\"0279be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798\"}");
+    } else if (command == "PROVISION") {
+        snprintf(reply, sizeof(reply),
+                 "{\"provisioned\":true,\"device_id\":\"%08x\",\"stage\":\"done\","
+                 "\"address\":\"bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4\",\"pool\":true,\"selftest\":true,"
+                 "\"keygen_us\":41200,\"seal_us\":30500,\"commit_us\":46100,\"selftest_us\":31800,"
+                 "\"total_us\":149600,\"commits\":1}",
+                 sim.serial);
+    } else if (command == "ATTEST") {
+        serve_attest(sim, line.size() > 7 ? line.substr(7) : std::string(), reply, sizeof(reply));
+    } else {
+        snprintf(reply, sizeof(reply), "{\"error\":\"unknown command\"}");
+    }
+
+    sim.tx += reply;
+    sim.tx += "\r\n";
+    served_++;
+}
+
+// Sign like wallet_attest(), in software: a throwaway key per serial and a
+// nonce hashed from key and message, both fine for a simulator only
+void SimDevices::serve_attest(Sim &sim, const std::string &args, char *reply, size_t size) {
+    attestation_claims_t claims = {};
+    if (!parse_challenge(args, claims.challenge)) {
+        snprintf(reply, size, "{\"error\":\"usage: ATTEST <32-byte hex challenge>\"}");
+        return;
+    }
+
+    if (!sim.keyed) {
+        uint8_t seed[8] = { 'c', 's', 'i', 'm', (uint8_t)sim.serial, (uint8_t)(sim.serial >> 8),
+                            (uint8_t)(sim.serial >> 16), (uint8_t)(sim.serial >> 24) };
+        secp256k1_point_t point;
+        sha256(seed, sizeof(seed), sim.key);
+        secp256k1_mul_base(sim.key, &point);
+        secp256k1_pubkey_serialize(&point, sim.pubkey);
+        sim.keyed = true;
+    }
+
+    claims.serial = sim.serial;
+    claims.tamper_intact = true;
+    claims.state_counter = 1;
+    sha256((const uint8_t *)kSimFirmware, sizeof(kSimFirmware) - 1, claims.firmware_root);
+
+    uint8_t digest[32], nonce[32], signature[ATTESTATION_SIGNATURE_SIZE];
+    attestation_digest(&claims, digest);
+    hmac_sha256(sim.key, sizeof(sim.key), digest, sizeof(digest), nonce);
+    if (!secp256k1_ecdsa_sign(sim.key, digest, nonce, signature)) {
+        snprintf(reply, size, "{\"error\":\"attestation failed\"}");
+        return;
+    }
+
+    size_t len = (size_t)snprintf(reply, size,
+                                  "{\"serial\":\"%08x\",\"tamper_intact\":true,\"tamper_count\":0,"
+                                  "\"counter\":1,\"firmware\":\"", sim.serial);
+    len = append_hex(reply, len, size, claims.firmware_root, sizeof(claims.firmware_root));
+    len += (size_t)snprintf(reply + len, size - len, "\",\"pubkey\":\"");
+    len = append_hex(reply, len, size, sim.pubkey, sizeof(sim.pubkey));
+    len += (size_t)snprintf(reply + len, size - len, "\",\"signature\":\"");
+    len = append_hex(reply, len, size, signature, sizeof(signature));
+    snprintf(reply + len, size - len, "\",\"claims_us\":820,\"sign_us\":41500}");
+}
+
+void SimDevices::flush(Sim &sim) {
+    while (!sim.tx.empty()) {
+        ssize_t n = ::write(sim.master, sim.tx.data(), sim.tx.size());
+        if (n <= 0) {
+            break;
+        }
+        sim.tx.erase(0, (size_t)n);
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | (sim.tx.empty() ? 0u : (uint32_t)EPOLLOUT);
+    ev.data.u32 = (uint32_t)(&sim - sims_.data());
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, sim.master, &ev);
+}
+
+} // namespace cashstick
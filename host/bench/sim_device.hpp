@@ -0,0 +1,64 @@
+#ifndef CASHSTICK_SIM_DEVICE_HPP
+#define CASHSTICK_SIM_DEVICE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cashstick {
+
+// Stand-ins for real sticks: each device is a pseudo-terminal whose master
+// side is served by one background thread that speaks the firmware's
+// line protocol (canned replies, CRLF line endings, and a log line mixed
+// in now and then). ATTEST is answered with a real signature from a key
+// derived from the serial, so verifiers can be run against the replies.
+// Point a Fleet at slave_paths().
+class SimDevices {
+public:
+    explicit SimDevices(size_t count);
+    ~SimDevices();
+
+    SimDevices(const SimDevices &) = delete;
+    SimDevices &operator=(const SimDevices &) = delete;
+
+    bool ok() const { return ok_; }
+    const std::vector<std::string> &slave_paths() const { return paths_; }
+
+    void start();
+    void stop();
+
+    uint64_t commands_served() const { return served_.load(); }
+
+private:
+    struct Sim {
+        int master = -1;
+        int slave = -1;
+        uint32_t serial = 0;
+        std::string rx;
+        std::string tx;
+        uint32_t commands = 0;
+        bool keyed = false;             // Attestation key derived yet
+        uint8_t key[32];
+        uint8_t pubkey[33];
+    };
+
+    void run();
+    void serve_line(Sim &sim, const std::string &line);
+    void serve_attest(Sim &sim, const std::string &args, char *reply, size_t size);
+    void flush(Sim &sim);
+
+    std::vector<Sim> sims_;
+    std::vector<std::string> paths_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> served_{0};
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    bool ok_ = false;
+};
+
+} // namespace cashstick
+
+#endif // CASHSTICK_SIM_DEVICE_HPP
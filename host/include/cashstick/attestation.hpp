@@ -0,0 +1,40 @@
+#ifndef CASHSTICK_ATTESTATION_HPP
+#define CASHSTICK_ATTESTATION_HPP
+
+#include "attestation.h"
+#include "cashstick/json_view.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cashstick {
+
+// One stick's answer to ATTEST, with the challenge it was sent
+struct Attestation {
+    attestation_claims_t claims = {};
+    uint8_t pubkey[33] = {};
+    uint8_t signature[ATTESTATION_SIGNATURE_SIZE] = {};
+    uint32_t claims_us = 0;             // Device side, as the stick timed it
+    uint32_t sign_us = 0;
+};
+
+// Decode an ATTEST reply. False if the reply is an error or a field is
+// missing or malformed; the signature is not checked here.
+bool parse_attestation(const JsonView &json, const uint8_t challenge[ATTESTATION_CHALLENGE_SIZE],
+                       Attestation *out);
+
+// Check the signatures of a batch on `threads` workers (0: one per core).
+// Each verification is independent and costs two scalar multiplications,
+// so workers take slices of the batch and share nothing; results[i] is 1
+// if attestations[i] verifies. Returns how many did.
+//
+// This proves the key signed these claims for this challenge. Whether the
+// claims are acceptable - the key registered for the serial, the expected
+// firmware root, an intact tamper loop - is the auditor's policy.
+size_t verify_attestations(const std::vector<Attestation> &attestations, std::vector<uint8_t> *results,
+                           unsigned threads = 0);
+
+} // namespace cashstick
+
+#endif // CASHSTICK_ATTESTATION_HPP
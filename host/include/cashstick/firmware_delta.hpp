@@ -0,0 +1,43 @@
+#ifndef CASHSTICK_FIRMWARE_DELTA_HPP
+#define CASHSTICK_FIRMWARE_DELTA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cashstick {
+
+// What went into a patch
+struct DeltaStats {
+    size_t copies = 0;
+    size_t copied_bytes = 0;
+    size_t inserts = 0;
+    size_t inserted_bytes = 0;
+};
+
+// Build a patch (format in include/delta_patch.h) that rebuilds target
+// from source, the image installed on the stick. Matches are found with a
+// hash chain over 8-byte windows of the source; the candidate that lines
+// up with the end of the previous copy is tried first, which keeps most
+// copy offsets to a one-byte delta when code has only shifted. The
+// header is signed with the vendor private key; the nonce is an HMAC of
+// the target digest under the key, as for make_signed_uf2().
+std::vector<uint8_t> make_delta_patch(const std::vector<uint8_t> &source,
+                                      const std::vector<uint8_t> &target,
+                                      const uint8_t private_key[32],
+                                      DeltaStats *stats = nullptr);
+
+// A patch that carries the whole target and needs no source: the
+// full-image baseline over the same transport
+std::vector<uint8_t> make_full_patch(const std::vector<uint8_t> &target, const uint8_t private_key[32]);
+
+// Apply a patch with the firmware's own decoder and check the target
+// hash and the signature against pubkey, as the stick would
+bool apply_delta_patch(const std::vector<uint8_t> &source, const std::vector<uint8_t> &patch,
+                       const uint8_t pubkey[33], std::vector<uint8_t> *target,
+                       std::string *error = nullptr);
+
+} // namespace cashstick
+
+#endif // CASHSTICK_FIRMWARE_DELTA_HPP
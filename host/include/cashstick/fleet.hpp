@@ -0,0 +1,149 @@
+#ifndef CASHSTICK_FLEET_HPP
+#define CASHSTICK_FLEET_HPP
+
+#include "cashstick/json_view.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace cashstick {
+
+// One reply, valid only for the duration of the callback: line and json
+// point into the device's receive buffer.
+struct Reply {
+    int device;
+    std::string_view command;   // First word of the request, e.g. "STATUS"
+    std::string_view line;
+    JsonView json;
+    uint64_t latency_ns;        // Request written to reply parsed
+
+    bool ok() const { return json.valid() && !json.error(); }
+};
+
+// Plain function pointers keep a request free of allocation; ctx is
+// handed back untouched
+using ReplyFn = void (*)(void *ctx, const Reply &reply);
+using LogFn = void (*)(void *ctx, int device, std::string_view line);
+
+// Drives many CashSticks over their CDC serial ports from one thread.
+//
+// Each device is a non-blocking tty on a single epoll set. Commands are
+// pipelined: up to kMaxInFlight requests may be outstanding per device, and
+// since the firmware answers commands strictly in order, replies are
+// matched to requests first-in first-out. Log lines the firmware prints on
+// the same port ("MODULE: ...") are told apart by not starting with '{'.
+//
+// All buffers are sized when the Fleet is created; adding devices,
+// submitting requests and handling replies do not allocate.
+//
+// A request that times out fails every request queued behind it; the
+// device is then re-synchronised by sending PING and discarding lines
+// until the pong arrives, so a late reply can never be matched to the
+// wrong request.
+class Fleet {
+public:
+    static constexpr size_t kMaxInFlight = 32;
+    static constexpr size_t kLineMax = 2048;
+    static constexpr size_t kTxBufferSize = 2048;
+    static constexpr uint32_t kDefaultTimeoutMs = 5000;
+
+    explicit Fleet(size_t max_devices = 1024);
+    ~Fleet();
+
+    Fleet(const Fleet &) = delete;
+    Fleet &operator=(const Fleet &) = delete;
+
+    // Open a CDC tty (e.g. /dev/ttyACM0) in raw mode. Returns the device
+    // id, or -errno.
+    int add(const char *tty_path);
+    void remove(int device);
+    size_t device_count() const { return open_count_; }
+
+    // Queue a command line (without the newline). False if the device is
+    // not open, is re-synchronising, or already has kMaxInFlight requests
+    // outstanding - poll() and try again.
+    bool request(int device, std::string_view command, ReplyFn fn, void *ctx);
+
+    bool status(int device, ReplyFn fn, void *ctx) { return request(device, "STATUS", fn, ctx); }
+    bool pubkey(int device, ReplyFn fn, void *ctx) { return request(device, "PUBKEY", fn, ctx); }
+    bool measure(int device, ReplyFn fn, void *ctx) { return request(device, "MEASURE", fn, ctx); }
+    // Per-operation "name":[count,errors,total_us,max_us,[log2 histogram]];
+    // read the arrays with JsonView::raw()
+    bool metrics(int device, ReplyFn fn, void *ctx) { return request(device, "METRICS", fn, ctx); }
+    // Keygen + seal + self-test in one round trip; can take several
+    // seconds if the stick's key pool is empty
+    bool provision(int device, ReplyFn fn, void *ctx) { return request(device, "PROVISION", fn, ctx); }
+    bool address(int device, std::string_view format, ReplyFn fn, void *ctx);
+    // SE050 bus transcript: "on", "off", "clear" or "read"; feed "read"
+    // replies to I2cTranscript::append_reply() until "more" is false
+    bool trace(int device, std::string_view args, ReplyFn fn, void *ctx);
+    // Signed proof of custody over a 32-byte challenge; decode the reply
+    // with parse_attestation() and batch-check with verify_attestations()
+    bool attest(int device, const uint8_t challenge[32], ReplyFn fn, void *ctx);
+
+    // Wait up to timeout_ms for I/O and dispatch replies. Returns the
+    // number of replies delivered (including failures), or -errno.
+    int poll(int timeout_ms);
+
+    // Poll until nothing is outstanding or timeout_ms passes. True if idle.
+    bool drain(int timeout_ms);
+
+    size_t in_flight() const { return in_flight_; }
+    size_t in_flight(int device) const;
+
+    void set_timeout_ms(uint32_t timeout_ms) { timeout_ms_ = timeout_ms; }
+    void set_log_handler(LogFn fn, void *ctx) { log_fn_ = fn; log_ctx_ = ctx; }
+
+private:
+    struct Pending {
+        ReplyFn fn;
+        void *ctx;
+        uint64_t sent_ns;
+        char command[16];
+    };
+
+    struct Device {
+        int fd = -1;
+        bool resyncing = false;
+        bool discarding = false;        // Rest of an over-long line
+        bool want_write = false;
+        uint64_t resync_ns = 0;         // Last resync PING
+
+        char rx[kLineMax];
+        size_t rx_len = 0;
+        char tx[kTxBufferSize];
+        size_t tx_len = 0;
+
+        Pending pending[kMaxInFlight];
+        size_t head = 0;                // Oldest outstanding request
+        size_t count = 0;
+    };
+
+    Device *get(int device);
+    const Device *get(int device) const;
+    bool queue_line(Device &dev, std::string_view a, std::string_view b);
+    void flush(int id, Device &dev);
+    void update_events(int id, Device &dev);
+    int read_ready(int id, Device &dev);
+    int handle_line(int id, Device &dev, std::string_view line);
+    int fail_all(int id, Device &dev, std::string_view error_line);
+    int check_timeouts(uint64_t now);
+    void close_device(int id, Device &dev);
+
+    std::vector<Device> devices_;
+    std::vector<int> free_ids_;
+    int epoll_fd_ = -1;
+    size_t open_count_ = 0;
+    size_t in_flight_ = 0;
+    size_t resyncing_ = 0;
+    uint64_t last_scan_ns_ = 0;
+    uint32_t timeout_ms_ = kDefaultTimeoutMs;
+    LogFn log_fn_ = nullptr;
+    void *log_ctx_ = nullptr;
+};
+
+} // namespace cashstick
+
+#endif // CASHSTICK_FLEET_HPP
@@ -0,0 +1,56 @@
+#ifndef CASHSTICK_I2C_TRANSCRIPT_HPP
+#define CASHSTICK_I2C_TRANSCRIPT_HPP
+
+#include "cashstick/json_view.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cashstick {
+
+// One SE050 bus transaction as recorded by the firmware (TRACE command)
+struct I2cRecord {
+    enum class Op : char { kWrite = 'w', kRead = 'r', kRecover = 'x' };
+
+    uint64_t start_us = 0;      // Device clock, unwrapped past 32 bits
+    uint32_t duration_us = 0;
+    uint32_t gap_us = 0;        // Since the previous transaction ended
+    Op op = Op::kWrite;
+    int result = 0;             // Bytes transferred or a PICO_ERROR_ code
+    uint16_t len = 0;           // Bytes requested
+    std::vector<uint8_t> data;  // Bytes on the bus, at most 255 kept
+};
+
+// A recorded SE050 bus transcript. Built from "TRACE read" replies as they
+// stream in, or loaded from the text form save() writes, one record per
+// line:
+//
+//   # cashstick i2c transcript v1
+//   <start_us> <duration_us> <gap_us> <w|r|x> <result> <len> <hex or ->
+class I2cTranscript {
+public:
+    // Append the records of one "TRACE read" reply. False if the reply is
+    // not a trace; *more is set while the device still has records queued.
+    bool append_reply(const JsonView &reply, bool *more = nullptr);
+
+    bool load(const char *path, std::string *error = nullptr);
+    bool save(const char *path) const;
+    void clear();
+
+    const std::vector<I2cRecord> &records() const { return records_; }
+    // Records the device overwrote before they were read
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    void push(I2cRecord record, uint32_t device_start_us);
+
+    std::vector<I2cRecord> records_;
+    uint64_t epoch_us_ = 0;         // Added to the 32-bit device clock
+    uint32_t last_start_us_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+} // namespace cashstick
+
+#endif // CASHSTICK_I2C_TRANSCRIPT_HPP
@@ -0,0 +1,42 @@
+#ifndef CASHSTICK_JSON_VIEW_HPP
+#define CASHSTICK_JSON_VIEW_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace cashstick {
+
+// Read-only view of one reply line from the device. Replies are flat JSON
+// objects ({"key":value,...}) with plain ASCII strings, so lookups scan
+// the line in place: nothing is copied or allocated, and every returned
+// string_view points into the original line.
+class JsonView {
+public:
+    JsonView() = default;
+    explicit JsonView(std::string_view line);
+
+    // True if the line is a (syntactically plausible) JSON object
+    bool valid() const { return valid_; }
+    std::string_view line() const { return line_; }
+
+    // Raw token for a top-level key: a quoted string without its quotes,
+    // or a number / literal / nested value as written
+    std::optional<std::string_view> raw(std::string_view key) const;
+
+    std::optional<std::string_view> str(std::string_view key) const;
+    std::optional<uint64_t> u64(std::string_view key) const;
+    std::optional<int64_t> i64(std::string_view key) const;
+    std::optional<bool> boolean(std::string_view key) const;
+
+    // The device reports every failure as {"error":"..."}
+    std::optional<std::string_view> error() const { return str("error"); }
+
+private:
+    std::string_view line_;
+    bool valid_ = false;
+};
+
+} // namespace cashstick
+
+#endif // CASHSTICK_JSON_VIEW_HPP
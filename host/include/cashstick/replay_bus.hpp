@@ -0,0 +1,69 @@
+#ifndef CASHSTICK_REPLAY_BUS_HPP
+#define CASHSTICK_REPLAY_BUS_HPP
+
+#include "cashstick/i2c_transcript.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cashstick {
+
+// Plays a recorded transcript back as the SE050 end of the bus, with the
+// original timing.
+//
+// Code under test calls write(), read() and recover() the way the firmware
+// calls se050_i2c_write(), se050_i2c_read() and se050_i2c_bus_recover().
+// Each call is matched against the next record:
+// - a write must carry the recorded bytes;
+// - a read gets the recorded response;
+// - every call takes as long as the recorded transfer did.
+// A transfer slower than the caller's timeout fails with kErrorTimeout
+// once the timeout has passed. Timeout and retry policies can therefore
+// be tried against real device behaviour. Calls that do not match the
+// recording are counted as divergences and still consume a record, so a
+// replay always runs to the end.
+//
+// Clock::kVirtual passes no real time: durations only advance now_us().
+// Runs are then deterministic and instant, which suits benchmarks.
+// Clock::kReal sleeps instead, for driving real-time code.
+class ReplayBus {
+public:
+    enum class Clock { kVirtual, kReal };
+
+    static constexpr int kErrorGeneric = -1;    // PICO_ERROR_GENERIC
+    static constexpr int kErrorTimeout = -2;    // PICO_ERROR_TIMEOUT
+    static constexpr uint32_t kNoTimeout = UINT32_MAX;
+
+    explicit ReplayBus(const I2cTranscript &transcript, Clock clock = Clock::kVirtual);
+
+    int write(const uint8_t *data, size_t len, uint32_t timeout_us = kNoTimeout);
+    int read(uint8_t *data, size_t len, uint32_t timeout_us = kNoTimeout);
+    void recover();
+
+    // Time spent on the caller's side: its own delays and processing
+    void wait_us(uint64_t us);
+
+    uint64_t now_us() const;
+    bool done() const { return next_ >= transcript_.records().size(); }
+    size_t position() const { return next_; }
+    size_t divergences() const { return divergences_; }
+    const std::string &last_divergence() const { return last_divergence_; }
+
+private:
+    const I2cRecord *take(I2cRecord::Op op, size_t len);
+    void diverge(std::string what);
+
+    const I2cTranscript &transcript_;
+    Clock clock_;
+    std::chrono::steady_clock::time_point real_start_;
+    uint64_t virtual_us_ = 0;
+    size_t next_ = 0;
+    size_t divergences_ = 0;
+    std::string last_divergence_;
+};
+
+} // namespace cashstick
+
+#endif // CASHSTICK_REPLAY_BUS_HPP
@@ -0,0 +1,43 @@
+#ifndef CASHSTICK_SIGNED_UF2_HPP
+#define CASHSTICK_SIGNED_UF2_HPP
+
+#include "sha256.h"
+#include "uf2_stream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cashstick {
+
+constexpr uint32_t kUf2FlashBase = 0x10000000;     // XIP_BASE
+
+// Wrap a firmware image in a UF2 the stick accepts in update mode
+// (format in include/uf2_stream.h): the image padded with zeros to whole
+// 256-byte blocks, then the signature block. The ECDSA nonce is an HMAC
+// of the image digest under the private key, so signing the same image
+// twice gives the same file.
+std::vector<uint8_t> make_signed_uf2(const std::vector<uint8_t> &image, const uint8_t private_key[32]);
+
+// What the stick made of a UF2
+struct Uf2Result {
+    std::vector<uint8_t> image;         // In address order, as it would be staged
+    uint8_t digest[SHA256_DIGEST_SIZE] = {};
+    bool signature_valid = false;
+    uint32_t reordered = 0;
+    uint32_t duplicates = 0;
+    uint32_t max_ahead = 0;
+    std::string error;
+};
+
+// Feed the blocks of a UF2, in the order given by `order` (block indices;
+// empty for file order), through the firmware's stream reader with a
+// reorder window of `window` blocks, hashing as they come out, and check
+// the signature against pubkey. True if the stick would stage the image.
+bool ingest_signed_uf2(const std::vector<uint8_t> &uf2, const std::vector<size_t> &order, uint32_t window,
+                       const uint8_t pubkey[33], Uf2Result *result);
+
+} // namespace cashstick
+
+#endif // CASHSTICK_SIGNED_UF2_HPP
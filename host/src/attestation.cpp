@@ -0,0 +1,121 @@
+#include "cashstick/attestation.hpp"
+
+#include "secp256k1.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <thread>
+
+namespace cashstick {
+
+namespace {
+
+// Slice of the batch a worker claims at a time: large enough to keep the
+// shared counter cold, small enough to even out the tail
+constexpr size_t kVerifyChunk = 64;
+
+int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Exactly len bytes of hex
+bool parse_hex(std::optional<std::string_view> hex, uint8_t *out, size_t len) {
+    if (!hex || hex->size() != len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        int hi = hex_nibble((*hex)[i * 2]);
+        int lo = hex_nibble((*hex)[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+} // namespace
+
+bool parse_attestation(const JsonView &json, const uint8_t challenge[ATTESTATION_CHALLENGE_SIZE],
+                       Attestation *out) {
+    if (!json.valid() || json.error()) {
+        return false;
+    }
+
+    auto serial = json.str("serial");
+    auto intact = json.boolean("tamper_intact");
+    auto tamper_count = json.u64("tamper_count");
+    auto counter = json.u64("counter");
+    if (!serial || serial->size() != 8 || !intact || !tamper_count || !counter) {
+        return false;
+    }
+    auto [end, ec] = std::from_chars(serial->data(), serial->data() + serial->size(), out->claims.serial, 16);
+    if (ec != std::errc() || end != serial->data() + serial->size()) {
+        return false;
+    }
+
+    attestation_claims_t &claims = out->claims;
+    memcpy(claims.challenge, challenge, ATTESTATION_CHALLENGE_SIZE);
+    claims.tamper_intact = *intact;
+    claims.tamper_count = (uint32_t)*tamper_count;
+    claims.state_counter = (uint32_t)*counter;
+    out->claims_us = (uint32_t)json.u64("claims_us").value_or(0);
+    out->sign_us = (uint32_t)json.u64("sign_us").value_or(0);
+
+    return parse_hex(json.str("firmware"), claims.firmware_root, sizeof(claims.firmware_root)) &&
+           parse_hex(json.str("pubkey"), out->pubkey, sizeof(out->pubkey)) &&
+           parse_hex(json.str("signature"), out->signature, sizeof(out->signature));
+}
+
+size_t verify_attestations(const std::vector<Attestation> &attestations, std::vector<uint8_t> *results,
+                           unsigned threads) {
+    results->assign(attestations.size(), 0);
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunks = (attestations.size() + kVerifyChunk - 1) / kVerifyChunk;
+    threads = (unsigned)std::min<size_t>(threads, std::max<size_t>(chunks, 1));
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> verified{0};
+    auto worker = [&]() {
+        size_t ok = 0;
+        for (;;) {
+            size_t begin = next.fetch_add(kVerifyChunk, std::memory_order_relaxed);
+            if (begin >= attestations.size()) {
+                break;
+            }
+            size_t end = std::min(begin + kVerifyChunk, attestations.size());
+            for (size_t i = begin; i < end; i++) {
+                const Attestation &a = attestations[i];
+                (*results)[i] = attestation_verify(&a.claims, a.pubkey, a.signature) ? 1 : 0;
+                ok += (*results)[i];
+            }
+        }
+        verified.fetch_add(ok, std::memory_order_relaxed);
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+    return verified.load();
+}
+
+} // namespace cashstick
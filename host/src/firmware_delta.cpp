@@ -0,0 +1,201 @@
+#include "cashstick/firmware_delta.hpp"
+
+#include "delta_patch.h"
+#include "secp256k1.h"
+#include "sha256.h"
+
+#include <cstring>
+
+namespace cashstick {
+
+namespace {
+
+constexpr size_t kMinMatch = 8;
+constexpr size_t kHashBits = 16;
+constexpr int kMaxChain = 64;
+
+uint32_t window_hash(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - kHashBits));
+}
+
+size_t match_length(const std::vector<uint8_t> &source, size_t s,
+                    const std::vector<uint8_t> &target, size_t t) {
+    size_t n = 0;
+    while (s + n < source.size() && t + n < target.size() && source[s + n] == target[t + n]) {
+        n++;
+    }
+    return n;
+}
+
+bool hash_matches(const uint8_t *data, size_t len, const uint8_t expected[SHA256_DIGEST_SIZE]) {
+    uint8_t hash[SHA256_DIGEST_SIZE];
+    sha256(data, len, hash);
+    return memcmp(hash, expected, sizeof(hash)) == 0;
+}
+
+void put_u16(std::vector<uint8_t> &out, uint16_t v) {
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+void put_u32(std::vector<uint8_t> &out, uint32_t v) {
+    put_u16(out, (uint16_t)v);
+    put_u16(out, (uint16_t)(v >> 16));
+}
+
+void put_varint(std::vector<uint8_t> &out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+void put_header(std::vector<uint8_t> &out, const std::vector<uint8_t> &source,
+                const std::vector<uint8_t> &target, const uint8_t private_key[32]) {
+    uint8_t hash[SHA256_DIGEST_SIZE] = {};
+    uint8_t nonce[SHA256_DIGEST_SIZE];
+    uint8_t signature[DELTA_PATCH_SIGNATURE_SIZE] = {};
+
+    put_u32(out, DELTA_PATCH_MAGIC);
+    put_u16(out, DELTA_PATCH_VERSION);
+    put_u16(out, 0);
+    put_u32(out, (uint32_t)source.size());
+    put_u32(out, (uint32_t)target.size());
+    if (!source.empty()) {
+        sha256(source.data(), source.size(), hash);
+    }
+    out.insert(out.end(), hash, hash + sizeof(hash));
+    sha256(target.data(), target.size(), hash);
+    out.insert(out.end(), hash, hash + sizeof(hash));
+
+    // A zero signature never verifies, should the key be out of range
+    hmac_sha256(private_key, 32, hash, sizeof(hash), nonce);
+    secp256k1_ecdsa_sign(private_key, hash, nonce, signature);
+    out.insert(out.end(), signature, signature + sizeof(signature));
+}
+
+void put_insert(std::vector<uint8_t> &out, const uint8_t *data, size_t len, DeltaStats &stats) {
+    if (len == 0) {
+        return;
+    }
+    out.push_back(DELTA_PATCH_OP_INSERT);
+    put_varint(out, (uint32_t)len);
+    out.insert(out.end(), data, data + len);
+    stats.inserts++;
+    stats.inserted_bytes += len;
+}
+
+} // namespace
+
+std::vector<uint8_t> make_delta_patch(const std::vector<uint8_t> &source,
+                                      const std::vector<uint8_t> &target,
+                                      const uint8_t private_key[32],
+                                      DeltaStats *stats) {
+    DeltaStats local;
+    DeltaStats &s = stats ? *stats : local;
+    s = DeltaStats();
+
+    std::vector<uint8_t> out;
+    put_header(out, source, target, private_key);
+
+    // Hash chains over every source window, most recent first
+    std::vector<int32_t> head(size_t(1) << kHashBits, -1);
+    std::vector<int32_t> prev(source.size(), -1);
+    for (size_t i = 0; i + kMinMatch <= source.size(); i++) {
+        uint32_t h = window_hash(&source[i]);
+        prev[i] = head[h];
+        head[h] = (int32_t)i;
+    }
+
+    size_t copy_end = 0;
+    size_t literal_start = 0;
+    size_t t = 0;
+
+    while (t < target.size()) {
+        // Where the previous copy would carry on if the bytes since were
+        // only patched in place
+        size_t best_pos = copy_end + (t - literal_start);
+        size_t best_len = best_pos < source.size() ? match_length(source, best_pos, target, t) : 0;
+
+        if (best_len < kMinMatch && t + kMinMatch <= target.size()) {
+            int chain = 0;
+            for (int32_t c = head[window_hash(&target[t])]; c >= 0 && chain < kMaxChain; c = prev[c], chain++) {
+                size_t len = match_length(source, (size_t)c, target, t);
+                if (len > best_len) {
+                    best_len = len;
+                    best_pos = (size_t)c;
+                }
+            }
+        }
+
+        if (best_len < kMinMatch) {
+            t++;
+            continue;
+        }
+
+        put_insert(out, &target[literal_start], t - literal_start, s);
+
+        int32_t delta = (int32_t)best_pos - (int32_t)copy_end;
+        out.push_back(DELTA_PATCH_OP_COPY);
+        put_varint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+        put_varint(out, (uint32_t)best_len);
+        s.copies++;
+        s.copied_bytes += best_len;
+
+        copy_end = best_pos + best_len;
+        t += best_len;
+        literal_start = t;
+    }
+
+    put_insert(out, &target[literal_start], t - literal_start, s);
+    return out;
+}
+
+std::vector<uint8_t> make_full_patch(const std::vector<uint8_t> &target, const uint8_t private_key[32]) {
+    DeltaStats stats;
+    std::vector<uint8_t> out;
+    put_header(out, {}, target, private_key);
+    put_insert(out, target.data(), target.size(), stats);
+    return out;
+}
+
+bool apply_delta_patch(const std::vector<uint8_t> &source, const std::vector<uint8_t> &patch,
+                       const uint8_t pubkey[33], std::vector<uint8_t> *target, std::string *error) {
+    target->clear();
+
+    delta_patch_t decoder;
+    decoder.source = source.data();
+    decoder.source_len = (uint32_t)source.size();
+    decoder.header = nullptr;
+    decoder.output = [](void *user, const uint8_t *data, size_t len) {
+        auto *out = static_cast<std::vector<uint8_t> *>(user);
+        out->insert(out->end(), data, data + len);
+        return true;
+    };
+    decoder.user = target;
+    delta_patch_init(&decoder);
+
+    const char *failure = nullptr;
+    if (!delta_patch_feed(&decoder, patch.data(), patch.size())) {
+        failure = decoder.error;
+    } else if (!delta_patch_done(&decoder)) {
+        failure = "patch incomplete";
+    } else if (decoder.info.source_len > 0 &&
+               !hash_matches(source.data(), decoder.info.source_len, decoder.info.source_hash)) {
+        failure = "patch is for a different image";
+    } else if (!hash_matches(target->data(), target->size(), decoder.info.target_hash)) {
+        failure = "image hash mismatch";
+    } else if (!secp256k1_ecdsa_verify(pubkey, decoder.info.target_hash, decoder.info.signature)) {
+        failure = "bad signature";
+    }
+
+    if (failure && error) {
+        *error = failure;
+    }
+    return failure == nullptr;
+}
+
+} // namespace cashstick
@@ -0,0 +1,455 @@
+#include "cashstick/fleet.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace cashstick {
+
+namespace {
+
+constexpr std::string_view kTimeoutLine = "{\"error\":\"timeout\"}";
+constexpr std::string_view kDisconnectedLine = "{\"error\":\"disconnected\"}";
+constexpr int kMaxEvents = 64;
+constexpr int kTimeoutScanMs = 20;
+
+uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+} // namespace
+
+Fleet::Fleet(size_t max_devices) : devices_(max_devices) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+
+    // Hand out low ids first
+    free_ids_.reserve(max_devices);
+    for (size_t i = max_devices; i > 0; i--) {
+        free_ids_.push_back((int)(i - 1));
+    }
+}
+
+Fleet::~Fleet() {
+    for (size_t i = 0; i < devices_.size(); i++) {
+        if (devices_[i].fd >= 0) {
+            ::close(devices_[i].fd);
+        }
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+}
+
+int Fleet::add(const char *tty_path) {
+    if (epoll_fd_ < 0) {
+        return -EBADF;
+    }
+    if (free_ids_.empty()) {
+        return -ENOSPC;
+    }
+
+    int fd = ::open(tty_path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    // Raw 8-bit, no echo, no line discipline; the CDC ignores the baud rate
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIOFLUSH);
+    }
+
+    int id = free_ids_.back();
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u32 = (uint32_t)id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        int err = errno;
+        ::close(fd);
+        return -err;
+    }
+    free_ids_.pop_back();
+
+    Device &dev = devices_[(size_t)id];
+    dev.fd = fd;
+    dev.resyncing = false;
+    dev.discarding = false;
+    dev.want_write = false;
+    dev.rx_len = 0;
+    dev.tx_len = 0;
+    dev.head = 0;
+    dev.count = 0;
+    dev.resync_ns = 0;
+    open_count_++;
+    return id;
+}
+
+void Fleet::remove(int device) {
+    Device *dev = get(device);
+    if (!dev) {
+        return;
+    }
+    fail_all(device, *dev, kDisconnectedLine);
+    close_device(device, *dev);
+}
+
+size_t Fleet::in_flight(int device) const {
+    const Device *dev = get(device);
+    return dev ? dev->count : 0;
+}
+
+bool Fleet::request(int device, std::string_view command, ReplyFn fn, void *ctx) {
+    Device *dev = get(device);
+    if (!dev || dev->resyncing || dev->count >= kMaxInFlight) {
+        return false;
+    }
+    if (!queue_line(*dev, command, {})) {
+        return false;
+    }
+
+    Pending &p = dev->pending[(dev->head + dev->count) % kMaxInFlight];
+    p.fn = fn;
+    p.ctx = ctx;
+    p.sent_ns = now_ns();
+    size_t word = std::min(command.find(' '), command.size());
+    size_t len = std::min(word, sizeof(p.command) - 1);
+    memcpy(p.command, command.data(), len);
+    p.command[len] = '\0';
+
+    dev->count++;
+    in_flight_++;
+
+    flush(device, *dev);
+    return true;
+}
+
+bool Fleet::address(int device, std::string_view format, ReplyFn fn, void *ctx) {
+    if (format.empty()) {
+        return request(device, "ADDRESS", fn, ctx);
+    }
+
+    char line[48];
+    if (format.size() > sizeof(line) - 9) {
+        return false;
+    }
+    memcpy(line, "ADDRESS ", 8);
+    memcpy(line + 8, format.data(), format.size());
+    return request(device, std::string_view(line, 8 + format.size()), fn, ctx);
+}
+
+bool Fleet::trace(int device, std::string_view args, ReplyFn fn, void *ctx) {
+    if (args.empty()) {
+        return request(device, "TRACE", fn, ctx);
+    }
+
+    char line[16];
+    if (args.size() > sizeof(line) - 7) {
+        return false;
+    }
+    memcpy(line, "TRACE ", 6);
+    memcpy(line + 6, args.data(), args.size());
+    return request(device, std::string_view(line, 6 + args.size()), fn, ctx);
+}
+
+bool Fleet::attest(int device, const uint8_t challenge[32], ReplyFn fn, void *ctx) {
+    static const char digits[] = "0123456789abcdef";
+    char line[7 + 64];
+    memcpy(line, "ATTEST ", 7);
+    for (size_t i = 0; i < 32; i++) {
+        line[7 + i * 2] = digits[challenge[i] >> 4];
+        line[8 + i * 2] = digits[challenge[i] & 0x0F];
+    }
+    return request(device, std::string_view(line, sizeof(line)), fn, ctx);
+}
+
+int Fleet::poll(int timeout_ms) {
+    if (epoll_fd_ < 0) {
+        return -EBADF;
+    }
+
+    // Wake up often enough to notice timeouts while requests are outstanding
+    if ((in_flight_ > 0 || resyncing_ > 0) && (timeout_ms < 0 || timeout_ms > kTimeoutScanMs)) {
+        timeout_ms = kTimeoutScanMs;
+    }
+
+    epoll_event events[kMaxEvents];
+    int n = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -errno;
+    }
+
+    int delivered = 0;
+    for (int i = 0; i < n; i++) {
+        int id = (int)events[i].data.u32;
+        Device *dev = get(id);
+        if (!dev) {
+            continue;
+        }
+
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
+            delivered += read_ready(id, *dev);
+        }
+        if (dev->fd >= 0 && (events[i].events & EPOLLOUT)) {
+            flush(id, *dev);
+        }
+    }
+
+    // Timeouts are coarse; scanning every device on every wakeup is not
+    uint64_t now = now_ns();
+    if ((in_flight_ > 0 || resyncing_ > 0) && now - last_scan_ns_ >= (uint64_t)kTimeoutScanMs * 1000000ull) {
+        last_scan_ns_ = now;
+        delivered += check_timeouts(now);
+    }
+    return delivered;
+}
+
+bool Fleet::drain(int timeout_ms) {
+    uint64_t deadline = now_ns() + (uint64_t)timeout_ms * 1000000ull;
+    while (in_flight_ > 0) {
+        uint64_t now = now_ns();
+        if (now >= deadline) {
+            return false;
+        }
+        if (poll((int)((deadline - now) / 1000000ull) + 1) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Internal helper functions
+
+Fleet::Device *Fleet::get(int device) {
+    if (device < 0 || (size_t)device >= devices_.size() || devices_[(size_t)device].fd < 0) {
+        return nullptr;
+    }
+    return &devices_[(size_t)device];
+}
+
+const Fleet::Device *Fleet::get(int device) const {
+    if (device < 0 || (size_t)device >= devices_.size() || devices_[(size_t)device].fd < 0) {
+        return nullptr;
+    }
+    return &devices_[(size_t)device];
+}
+
+bool Fleet::queue_line(Device &dev, std::string_view a, std::string_view b) {
+    if (dev.tx_len + a.size() + b.size() + 1 > sizeof(dev.tx)) {
+        return false;
+    }
+    memcpy(dev.tx + dev.tx_len, a.data(), a.size());
+    dev.tx_len += a.size();
+    memcpy(dev.tx + dev.tx_len, b.data(), b.size());
+    dev.tx_len += b.size();
+    dev.tx[dev.tx_len++] = '\n';
+    return true;
+}
+
+void Fleet::flush(int id, Device &dev) {
+    size_t written = 0;
+    while (written < dev.tx_len) {
+        ssize_t n = ::write(dev.fd, dev.tx + written, dev.tx_len - written);
+        if (n > 0) {
+            written += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // EAGAIN: finish on EPOLLOUT. Hard errors surface as EPOLLHUP/ERR.
+            break;
+        }
+    }
+
+    if (written > 0) {
+        memmove(dev.tx, dev.tx + written, dev.tx_len - written);
+        dev.tx_len -= written;
+    }
+
+    bool want_write = dev.tx_len > 0;
+    if (want_write != dev.want_write) {
+        dev.want_write = want_write;
+        update_events(id, dev);
+    }
+}
+
+void Fleet::update_events(int id, Device &dev) {
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP | (dev.want_write ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.u32 = (uint32_t)id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, dev.fd, &ev);
+}
+
+int Fleet::read_ready(int id, Device &dev) {
+    int delivered = 0;
+    char chunk[4096];
+
+    while (dev.fd >= 0) {
+        ssize_t n = ::read(dev.fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            break;
+        }
+        if (n <= 0) {
+            // EOF, or EIO once the device has gone away
+            delivered += fail_all(id, dev, kDisconnectedLine);
+            close_device(id, dev);
+            break;
+        }
+
+        for (ssize_t i = 0; i < n && dev.fd >= 0; i++) {
+            char c = chunk[i];
+            if (c == '\n') {
+                if (!dev.discarding) {
+                    size_t len = dev.rx_len;
+                    if (len > 0 && dev.rx[len - 1] == '\r') {
+                        len--;
+                    }
+                    delivered += handle_line(id, dev, std::string_view(dev.rx, len));
+                }
+                dev.rx_len = 0;
+                dev.discarding = false;
+            } else if (dev.discarding) {
+                continue;
+            } else if (dev.rx_len < sizeof(dev.rx)) {
+                dev.rx[dev.rx_len++] = c;
+            } else {
+                // Longer than any reply; drop it rather than split it
+                dev.discarding = true;
+            }
+        }
+    }
+    return delivered;
+}
+
+int Fleet::handle_line(int id, Device &dev, std::string_view line) {
+    if (line.empty()) {
+        return 0;
+    }
+
+    // Firmware log output shares the port; replies are JSON objects
+    if (line.front() != '{') {
+        if (log_fn_) {
+            log_fn_(log_ctx_, id, line);
+        }
+        return 0;
+    }
+
+    JsonView json(line);
+
+    if (dev.resyncing) {
+        if (json.boolean("pong") == true) {
+            dev.resyncing = false;
+            resyncing_--;
+        }
+        return 0;
+    }
+
+    if (dev.count == 0) {
+        // Unsolicited; nothing is waiting for it
+        if (log_fn_) {
+            log_fn_(log_ctx_, id, line);
+        }
+        return 0;
+    }
+
+    // Pop before the callback so it can queue the next request
+    Pending p = dev.pending[dev.head];
+    dev.head = (dev.head + 1) % kMaxInFlight;
+    dev.count--;
+    in_flight_--;
+
+    Reply reply = { id, p.command, line, json, now_ns() - p.sent_ns };
+    if (p.fn) {
+        p.fn(p.ctx, reply);
+    }
+    return 1;
+}
+
+int Fleet::fail_all(int id, Device &dev, std::string_view error_line) {
+    int failed = 0;
+    uint64_t now = now_ns();
+
+    while (dev.count > 0) {
+        Pending p = dev.pending[dev.head];
+        dev.head = (dev.head + 1) % kMaxInFlight;
+        dev.count--;
+        in_flight_--;
+
+        Reply reply = { id, p.command, error_line, JsonView(error_line), now - p.sent_ns };
+        if (p.fn) {
+            p.fn(p.ctx, reply);
+        }
+        failed++;
+    }
+    return failed;
+}
+
+int Fleet::check_timeouts(uint64_t now) {
+    uint64_t timeout_ns = (uint64_t)timeout_ms_ * 1000000ull;
+    int failed = 0;
+
+    for (size_t i = 0; i < devices_.size(); i++) {
+        Device &dev = devices_[i];
+        if (dev.fd < 0) {
+            continue;
+        }
+
+        // The PING (or its pong) was lost too - ask again
+        if (dev.resyncing && now - dev.resync_ns >= timeout_ns) {
+            dev.resync_ns = now;
+            queue_line(dev, "PING", {});
+            flush((int)i, dev);
+            continue;
+        }
+        if (dev.count == 0) {
+            continue;
+        }
+        if (now - dev.pending[dev.head].sent_ns < timeout_ns) {
+            continue;
+        }
+
+        failed += fail_all((int)i, dev, kTimeoutLine);
+        if (dev.fd < 0) {
+            continue;
+        }
+
+        // Replies still in the pipe would land on the wrong requests; skip
+        // everything up to the answer to a fresh PING
+        dev.resyncing = true;
+        dev.resync_ns = now;
+        resyncing_++;
+        dev.tx_len = 0;
+        queue_line(dev, "PING", {});
+        flush((int)i, dev);
+    }
+    return failed;
+}
+
+void Fleet::close_device(int id, Device &dev) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, dev.fd, nullptr);
+    ::close(dev.fd);
+    dev.fd = -1;
+    if (dev.resyncing) {
+        dev.resyncing = false;
+        resyncing_--;
+    }
+    dev.count = 0;
+    dev.rx_len = 0;
+    dev.tx_len = 0;
+    open_count_--;
+    free_ids_.push_back(id);
+}
+
+} // namespace cashstick
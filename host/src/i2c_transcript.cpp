@@ -0,0 +1,219 @@
+#include "cashstick/i2c_transcript.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace cashstick {
+
+namespace {
+
+constexpr const char *kFileHeader = "# cashstick i2c transcript v1";
+
+// Minimal cursor over the nested arrays of a TRACE reply
+struct Cursor {
+    std::string_view s;
+    size_t i = 0;
+
+    bool eat(char c) {
+        while (i < s.size() && s[i] == ' ') {
+            i++;
+        }
+        if (i < s.size() && s[i] == c) {
+            i++;
+            return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool number(T *out) {
+        eat(' ');
+        auto [end, ec] = std::from_chars(s.data() + i, s.data() + s.size(), *out);
+        if (ec != std::errc()) {
+            return false;
+        }
+        i = (size_t)(end - s.data());
+        return true;
+    }
+
+    bool string(std::string_view *out) {
+        if (!eat('"')) {
+            return false;
+        }
+        size_t close = s.find('"', i);
+        if (close == std::string_view::npos) {
+            return false;
+        }
+        *out = s.substr(i, close - i);
+        i = close + 1;
+        return true;
+    }
+};
+
+int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool parse_hex(std::string_view hex, std::vector<uint8_t> *out) {
+    out->clear();
+    if (hex == "-") {
+        return true;
+    }
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int hi = hex_nibble(hex[i]);
+        int lo = hex_nibble(hex[i + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        out->push_back((uint8_t)(hi << 4 | lo));
+    }
+    return true;
+}
+
+bool parse_op(std::string_view name, I2cRecord::Op *op) {
+    if (name.size() != 1 || (name[0] != 'w' && name[0] != 'r' && name[0] != 'x')) {
+        return false;
+    }
+    *op = static_cast<I2cRecord::Op>(name[0]);
+    return true;
+}
+
+} // namespace
+
+bool I2cTranscript::append_reply(const JsonView &reply, bool *more) {
+    std::optional<std::string_view> trace = reply.raw("trace");
+    if (!trace) {
+        return false;
+    }
+
+    Cursor c{*trace};
+    if (!c.eat('[')) {
+        return false;
+    }
+    bool first = true;
+    while (!c.eat(']')) {
+        if (!first && !c.eat(',')) {
+            return false;
+        }
+        first = false;
+
+        I2cRecord record;
+        uint32_t start_us = 0;
+        std::string_view op, hex;
+        if (!c.eat('[') || !c.number(&start_us) || !c.eat(',') ||
+            !c.number(&record.duration_us) || !c.eat(',') || !c.number(&record.gap_us) || !c.eat(',') ||
+            !c.string(&op) || !parse_op(op, &record.op) || !c.eat(',') ||
+            !c.number(&record.result) || !c.eat(',') || !c.number(&record.len) || !c.eat(',') ||
+            !c.string(&hex) || !parse_hex(hex, &record.data) || !c.eat(']')) {
+            return false;
+        }
+        push(std::move(record), start_us);
+    }
+
+    if (more) {
+        *more = reply.boolean("more").value_or(false);
+    }
+    dropped_ = std::max<uint64_t>(dropped_, reply.u64("dropped").value_or(0));
+    return true;
+}
+
+bool I2cTranscript::load(const char *path, std::string *error) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        if (error) {
+            *error = strerror(errno);
+        }
+        return false;
+    }
+
+    clear();
+    char line[1024];
+    int line_no = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        unsigned long long start_us;
+        unsigned duration_us, gap_us, len;
+        int result;
+        char op[4], hex[600];
+        I2cRecord record;
+        if (sscanf(line, "%llu %u %u %3s %d %u %599s", &start_us, &duration_us, &gap_us,
+                   op, &result, &len, hex) != 7 ||
+            !parse_op(op, &record.op) || !parse_hex(hex, &record.data)) {
+            if (error) {
+                *error = "line " + std::to_string(line_no) + ": malformed record";
+            }
+            ok = false;
+            break;
+        }
+        record.start_us = start_us;
+        record.duration_us = duration_us;
+        record.gap_us = gap_us;
+        record.result = result;
+        record.len = (uint16_t)len;
+        records_.push_back(std::move(record));
+    }
+
+    fclose(f);
+    return ok;
+}
+
+bool I2cTranscript::save(const char *path) const {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+
+    fprintf(f, "%s\n", kFileHeader);
+    for (const I2cRecord &r : records_) {
+        fprintf(f, "%llu %u %u %c %d %u ", (unsigned long long)r.start_us, r.duration_us,
+                r.gap_us, static_cast<char>(r.op), r.result, r.len);
+        if (r.data.empty()) {
+            fputc('-', f);
+        }
+        for (uint8_t b : r.data) {
+            fprintf(f, "%02x", b);
+        }
+        fputc('\n', f);
+    }
+
+    return fclose(f) == 0;
+}
+
+void I2cTranscript::clear() {
+    records_.clear();
+    epoch_us_ = 0;
+    last_start_us_ = 0;
+    dropped_ = 0;
+}
+
+void I2cTranscript::push(I2cRecord record, uint32_t device_start_us) {
+    // The device clock wraps every ~71 minutes
+    if (!records_.empty() && device_start_us < last_start_us_) {
+        epoch_us_ += 1ull << 32;
+    }
+    last_start_us_ = device_start_us;
+    record.start_us = epoch_us_ + device_start_us;
+    records_.push_back(std::move(record));
+}
+
+} // namespace cashstick
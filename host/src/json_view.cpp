@@ -0,0 +1,160 @@
+#include "cashstick/json_view.hpp"
+
+#include <charconv>
+
+namespace cashstick {
+
+namespace {
+
+size_t skip_space(std::string_view s, size_t i) {
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) {
+        i++;
+    }
+    return i;
+}
+
+// Index just past the string starting at the opening quote s[i]
+size_t skip_string(std::string_view s, size_t i) {
+    for (i++; i < s.size(); i++) {
+        if (s[i] == '\\') {
+            i++;
+        } else if (s[i] == '"') {
+            return i + 1;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Index just past the value starting at s[i]
+size_t skip_value(std::string_view s, size_t i) {
+    if (i >= s.size()) {
+        return std::string_view::npos;
+    }
+    if (s[i] == '"') {
+        return skip_string(s, i);
+    }
+    if (s[i] == '{' || s[i] == '[') {
+        int depth = 0;
+        while (i < s.size()) {
+            char c = s[i];
+            if (c == '"') {
+                i = skip_string(s, i);
+                if (i == std::string_view::npos) {
+                    return i;
+                }
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return i + 1;
+            }
+            i++;
+        }
+        return std::string_view::npos;
+    }
+    while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ' ') {
+        i++;
+    }
+    return i;
+}
+
+template <typename T>
+std::optional<T> parse_number(std::optional<std::string_view> value) {
+    T out = 0;
+    if (!value || value->empty()) {
+        return std::nullopt;
+    }
+    const char *end = value->data() + value->size();
+    auto result = std::from_chars(value->data(), end, out);
+    if (result.ec != std::errc() || result.ptr != end) {
+        return std::nullopt;
+    }
+    return out;
+}
+
+} // namespace
+
+JsonView::JsonView(std::string_view line) : line_(line) {
+    while (!line_.empty() && (line_.back() == '\r' || line_.back() == '\n' || line_.back() == ' ')) {
+        line_.remove_suffix(1);
+    }
+    valid_ = line_.size() >= 2 && line_.front() == '{' && line_.back() == '}';
+}
+
+std::optional<std::string_view> JsonView::raw(std::string_view key) const {
+    if (!valid_) {
+        return std::nullopt;
+    }
+
+    size_t i = 1;
+    while (true) {
+        i = skip_space(line_, i);
+        if (i >= line_.size() || line_[i] != '"') {
+            return std::nullopt;
+        }
+        size_t key_end = skip_string(line_, i);
+        if (key_end == std::string_view::npos) {
+            return std::nullopt;
+        }
+        std::string_view name = line_.substr(i + 1, key_end - i - 2);
+
+        i = skip_space(line_, key_end);
+        if (i >= line_.size() || line_[i] != ':') {
+            return std::nullopt;
+        }
+        i = skip_space(line_, i + 1);
+        size_t value_end = skip_value(line_, i);
+        if (value_end == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        if (name == key) {
+            std::string_view value = line_.substr(i, value_end - i);
+            if (value.size() >= 2 && value.front() == '"') {
+                value = value.substr(1, value.size() - 2);
+            }
+            return value;
+        }
+
+        i = skip_space(line_, value_end);
+        if (i >= line_.size() || line_[i] != ',') {
+            return std::nullopt;
+        }
+        i++;
+    }
+}
+
+std::optional<std::string_view> JsonView::str(std::string_view key) const {
+    // raw() strips the quotes; reject values that were not strings
+    auto value = raw(key);
+    if (!value) {
+        return std::nullopt;
+    }
+    const char *quote = value->data() - 1;
+    if (quote < line_.data() || *quote != '"') {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::optional<uint64_t> JsonView::u64(std::string_view key) const {
+    return parse_number<uint64_t>(raw(key));
+}
+
+std::optional<int64_t> JsonView::i64(std::string_view key) const {
+    return parse_number<int64_t>(raw(key));
+}
+
+std::optional<bool> JsonView::boolean(std::string_view key) const {
+    auto value = raw(key);
+    if (value == "true") {
+        return true;
+    }
+    if (value == "false") {
+        return false;
+    }
+    return std::nullopt;
+}
+
+} // namespace cashstick
@@ -0,0 +1,99 @@
+#include "cashstick/replay_bus.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace cashstick {
+
+ReplayBus::ReplayBus(const I2cTranscript &transcript, Clock clock)
+    : transcript_(transcript), clock_(clock), real_start_(std::chrono::steady_clock::now()) {}
+
+int ReplayBus::write(const uint8_t *data, size_t len, uint32_t timeout_us) {
+    const I2cRecord *r = take(I2cRecord::Op::kWrite, len);
+    if (!r) {
+        return kErrorGeneric;
+    }
+
+    size_t compare = std::min(len, r->data.size());
+    if (len != r->len || memcmp(data, r->data.data(), compare) != 0) {
+        diverge("record " + std::to_string(next_ - 1) + ": write differs from the recording");
+    }
+
+    if (r->duration_us > timeout_us) {
+        wait_us(timeout_us);
+        return kErrorTimeout;
+    }
+    wait_us(r->duration_us);
+    return r->result;
+}
+
+int ReplayBus::read(uint8_t *data, size_t len, uint32_t timeout_us) {
+    const I2cRecord *r = take(I2cRecord::Op::kRead, len);
+    if (!r) {
+        return kErrorGeneric;
+    }
+
+    if (r->duration_us > timeout_us) {
+        wait_us(timeout_us);
+        return kErrorTimeout;
+    }
+    wait_us(r->duration_us);
+
+    // Bytes past what the device recorded read as an idle bus
+    size_t copy = std::min(len, r->data.size());
+    memcpy(data, r->data.data(), copy);
+    memset(data + copy, 0xFF, len - copy);
+    return r->result;
+}
+
+void ReplayBus::recover() {
+    const I2cRecord *r = take(I2cRecord::Op::kRecover, 0);
+    if (r) {
+        wait_us(r->duration_us);
+    }
+}
+
+void ReplayBus::wait_us(uint64_t us) {
+    virtual_us_ += us;
+    if (clock_ == Clock::kReal) {
+        std::this_thread::sleep_until(real_start_ + std::chrono::microseconds(virtual_us_));
+    }
+}
+
+uint64_t ReplayBus::now_us() const {
+    return virtual_us_;
+}
+
+// Next record, which should be an op of this kind
+const I2cRecord *ReplayBus::take(I2cRecord::Op op, size_t len) {
+    const std::vector<I2cRecord> &records = transcript_.records();
+
+    // The recording recovered the bus here and the caller did not
+    while (op != I2cRecord::Op::kRecover && next_ < records.size() &&
+           records[next_].op == I2cRecord::Op::kRecover) {
+        diverge("record " + std::to_string(next_) + ": recorded bus recovery skipped");
+        next_++;
+    }
+
+    if (next_ >= records.size()) {
+        diverge("call past the end of the transcript");
+        return nullptr;
+    }
+
+    const I2cRecord *r = &records[next_++];
+    if (r->op != op) {
+        diverge("record " + std::to_string(next_ - 1) + ": expected '" +
+                static_cast<char>(r->op) + "', got '" + static_cast<char>(op) + "'");
+    } else if (op == I2cRecord::Op::kRead && len != r->len) {
+        diverge("record " + std::to_string(next_ - 1) + ": read length differs from the recording");
+    }
+    return r;
+}
+
+void ReplayBus::diverge(std::string what) {
+    divergences_++;
+    last_divergence_ = std::move(what);
+}
+
+} // namespace cashstick
@@ -0,0 +1,104 @@
+#include "cashstick/signed_uf2.hpp"
+
+#include "secp256k1.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cashstick {
+
+namespace {
+
+struct IngestState {
+    sha256_ctx_t hash;
+    std::vector<uint8_t> *image;
+};
+
+bool on_output(void *user, const uint8_t *data, size_t len) {
+    IngestState *state = static_cast<IngestState *>(user);
+    sha256_update(&state->hash, data, len);
+    state->image->insert(state->image->end(), data, data + len);
+    return true;
+}
+
+} // namespace
+
+std::vector<uint8_t> make_signed_uf2(const std::vector<uint8_t> &image, const uint8_t private_key[32]) {
+    std::vector<uint8_t> padded(image);
+    padded.resize((image.size() + UF2_PAYLOAD_SIZE - 1) / UF2_PAYLOAD_SIZE * UF2_PAYLOAD_SIZE, 0);
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    uint8_t nonce[SHA256_DIGEST_SIZE];
+    uint8_t signature[UF2_SIGNATURE_SIZE];
+    sha256(padded.data(), padded.size(), digest);
+    hmac_sha256(private_key, 32, digest, sizeof(digest), nonce);
+    if (!secp256k1_ecdsa_sign(private_key, digest, nonce, signature)) {
+        return {};
+    }
+
+    uint32_t image_blocks = (uint32_t)(padded.size() / UF2_PAYLOAD_SIZE);
+    uint32_t num_blocks = image_blocks + 1;
+    std::vector<uint8_t> uf2((size_t)num_blocks * UF2_BLOCK_SIZE);
+    for (uint32_t i = 0; i < image_blocks; i++) {
+        uf2_encode_block(kUf2FlashBase + i * UF2_PAYLOAD_SIZE, 0, i, num_blocks,
+                         &padded[(size_t)i * UF2_PAYLOAD_SIZE], &uf2[(size_t)i * UF2_BLOCK_SIZE]);
+    }
+
+    uint8_t payload[UF2_PAYLOAD_SIZE] = {};
+    uint32_t fields[2] = { UF2_SIGNATURE_MAGIC, (uint32_t)padded.size() };
+    for (size_t f = 0; f < 2; f++) {
+        for (size_t b = 0; b < 4; b++) {
+            payload[f * 4 + b] = (uint8_t)(fields[f] >> (8 * b));
+        }
+    }
+    memcpy(payload + 8, signature, sizeof(signature));
+    uf2_encode_block(0, UF2_FLAG_NOT_MAIN_FLASH, image_blocks, num_blocks, payload,
+                     &uf2[(size_t)image_blocks * UF2_BLOCK_SIZE]);
+    return uf2;
+}
+
+bool ingest_signed_uf2(const std::vector<uint8_t> &uf2, const std::vector<size_t> &order, uint32_t window,
+                       const uint8_t pubkey[33], Uf2Result *result) {
+    size_t blocks = uf2.size() / UF2_BLOCK_SIZE;
+    std::vector<uint8_t> slots((size_t)std::max(window, 1u) * UF2_PAYLOAD_SIZE);
+    IngestState state;
+    sha256_init(&state.hash);
+    result->image.clear();
+    state.image = &result->image;
+
+    uf2_stream_t stream;
+    stream.base = kUf2FlashBase;
+    stream.max_len = 256 * 1024;        // UPDATE_SLOT_SIZE
+    stream.window = reinterpret_cast<uint8_t (*)[UF2_PAYLOAD_SIZE]>(slots.data());
+    stream.window_size = window;
+    stream.output = on_output;
+    stream.user = &state;
+    uf2_stream_init(&stream);
+
+    uf2_stream_result_t last = UF2_STREAM_ACCEPTED;
+    for (size_t n = 0; n < blocks && last == UF2_STREAM_ACCEPTED; n++) {
+        size_t index = order.empty() ? n : order[n];
+        last = uf2_stream_feed(&stream, &uf2[index * UF2_BLOCK_SIZE]);
+        if (last == UF2_STREAM_NOT_UF2) {
+            last = UF2_STREAM_ACCEPTED;     // An ordinary sector; the stick keeps it in RAM
+        }
+    }
+
+    result->reordered = stream.reordered;
+    result->duplicates = stream.duplicates;
+    result->max_ahead = stream.max_ahead;
+    if (last != UF2_STREAM_COMPLETE) {
+        result->error = last == UF2_STREAM_ERROR ? stream.error : "image incomplete";
+        return false;
+    }
+
+    sha256_final(&state.hash, result->digest);
+    result->signature_valid = secp256k1_ecdsa_verify(pubkey, result->digest, stream.signature);
+    if (!result->signature_valid) {
+        result->error = "bad signature";
+    }
+    return result->signature_valid;
+}
+
+} // namespace cashstick
@@ -0,0 +1,119 @@
+// Run the firmware's board profiles against the simulated HAL backend.
+//
+//   board_sim [--stuck-clocks N]
+//
+// For each profile in hal/boards.hpp: print the pin map, drive the LED and
+// button, and check that SE050 bus recovery frees a target holding SDA low
+// for N clocks (default 5) and that transfers reach the bus afterwards.
+// The parts are the same templates the firmware instantiates over
+// PicoBackend, so a profile that passes here differs on the stick only in
+// the backend. Exits non-zero if a check fails.
+
+#include "hal/boards.hpp"
+#include "hal/sim_backend.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using hal::SimBackend;
+
+namespace {
+
+constexpr uint32_t kHalfClockUs = 5;
+constexpr uint8_t kSe050Addr = 0x48;
+
+struct Result {
+    size_t checks = 0;
+    size_t failed = 0;
+};
+
+void check(Result &result, const char *board, bool ok, const char *what) {
+    result.checks++;
+    if (!ok) {
+        result.failed++;
+        fprintf(stderr, "%s: FAIL %s\n", board, what);
+    }
+}
+
+template <class Part>
+void print_pins(const char *role) {
+    printf("  %-14s", role);
+    for (uint8_t pin : Part::pins) {
+        printf(" GP%u", pin);
+    }
+    printf("\n");
+}
+
+template <template <class> class Profile>
+void run(Result &result, unsigned stuck_clocks) {
+    using Board = Profile<SimBackend>;
+    using Bus = typename Board::Se050Bus;
+    const char *name = Board::name;
+
+    SimBackend::reset();
+    printf("%s: SE050 on I2C%u at %u Hz\n", name, Bus::instance, (unsigned)Bus::baudrate);
+    print_pins<typename Board::Led>("led");
+    print_pins<typename Board::TestButton>("button");
+    print_pins<typename Board::TamperLoop>("tamper");
+    print_pins<Bus>("se050 sda/scl");
+
+    Board::Led::init();
+    Board::Led::set(0xFF, 0xFF, 0x00);
+    check(result, name, SimBackend::gpio_get(Board::Led::pins[0]), "LED lights");
+    Board::Led::set(0, 0, 0);
+    check(result, name, !SimBackend::gpio_get(Board::Led::pins[0]), "LED goes dark");
+
+    Board::TestButton::init();
+    check(result, name, !Board::TestButton::pressed(), "button idle with pull");
+    SimBackend::hold_low(Board::TestButton::gpio, true);
+    check(result, name, Board::TestButton::pressed(), "button reads pressed");
+
+    Board::TamperLoop::init();
+    check(result, name, Board::TamperLoop::read(), "tamper loop pulled up");
+
+    Bus::init();
+    SimBackend::target = [](unsigned, uint8_t addr, bool, uint8_t *, size_t len, uint32_t) {
+        return addr == kSe050Addr ? (int)len : -1;
+    };
+    uint8_t frame[4] = {0x5A, 0x01, 0x02, 0x03};
+    check(result, name, Bus::write(kSe050Addr, frame, sizeof(frame), 1000) == (int)sizeof(frame),
+          "write reaches the SE050");
+
+    // Target stuck mid-byte: SDA low until SCL has clocked it out
+    uint8_t sda = Bus::pins[0];
+    uint8_t scl = Bus::pins[1];
+    SimBackend::hold_low_for_clocks(sda, scl, stuck_clocks);
+    unsigned before = SimBackend::pins[scl].rising_edges;
+    uint64_t start = SimBackend::now_us;
+    unsigned clocks = Bus::recover(kHalfClockUs);
+    unsigned edges = SimBackend::pins[scl].rising_edges - before;
+
+    printf("  recovery: %u clocks, %u SCL edges, %llu us\n", clocks, edges,
+           (unsigned long long)(SimBackend::now_us - start));
+    check(result, name, clocks == (stuck_clocks < 9 ? stuck_clocks : 9), "recovery clocks out the stuck byte");
+    check(result, name, stuck_clocks > 9 || SimBackend::gpio_get(sda), "SDA released");
+    check(result, name, SimBackend::pins[sda].i2c && SimBackend::pins[scl].i2c, "pins back on the I2C block");
+    check(result, name, Bus::read(kSe050Addr, frame, 2, 1000) == 2, "read after recovery");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    unsigned stuck_clocks = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stuck-clocks") == 0 && i + 1 < argc) {
+            stuck_clocks = (unsigned)strtoul(argv[++i], nullptr, 0);
+        } else {
+            fprintf(stderr, "usage: %s [--stuck-clocks N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Result result;
+    run<hal::CashStickRev1>(result, stuck_clocks);
+    run<hal::PicoDevBoard>(result, stuck_clocks);
+
+    fprintf(stderr, "BOARD_SIM: %zu checks, %zu failed\n", result.checks, result.failed);
+    return result.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+// Delta firmware updates: build patches, check them, send them to a stick.
+//
+//   fw_delta make OLD.bin NEW.bin KEYHEX OUT.patch
+//   fw_delta full NEW.bin KEYHEX OUT.patch
+//   fw_delta apply OLD.bin PATCH PUBKEYHEX OUT.bin
+//   fw_delta send TTY PATCH [--install]
+//   fw_delta compare OLD.bin NEW.bin KEYHEX [TTY]
+//
+// OLD.bin is the image installed on the stick (the .bin the build writes
+// next to the .uf2), NEW.bin the one to install. "full" wraps a whole
+// image in a patch that needs no source. That is the full-image baseline
+// over the same UPDATE transport. KEYHEX is the 32-byte vendor private
+// key the patch is signed with; the stick takes only patches signed for
+// its CASHSTICK_VENDOR_PUBKEY, and only in update mode.
+//
+// compare is the update harness. It sets the delta patch against the full
+// image on bytes transferred and flash sectors erased, for both the
+// UPDATE transport and a drag-and-drop UF2. Given a TTY, it also stages
+// both patches on the stick, aborting each once staged, and times them.
+
+#include "cashstick/firmware_delta.hpp"
+#include "cashstick/fleet.hpp"
+
+#include "secp256k1.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace cashstick;
+
+namespace {
+
+constexpr size_t kChunk = 256;             // Patch bytes per UPDATE data line
+constexpr size_t kUf2Payload = 256;        // Image bytes per 512-byte UF2 block
+constexpr size_t kSectorSize = 4096;
+constexpr uint32_t kUpdateTimeoutMs = 30000;
+
+bool read_file(const char *path, std::vector<uint8_t> *data) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    data->clear();
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data->insert(data->end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+}
+
+bool write_file(const char *path, const std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(data.data(), 1, data.size(), f) != data.size() || fclose(f) != 0) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+bool parse_hex(const char *hex, uint8_t *out, size_t len) {
+    if (strlen(hex) != len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned value;
+        if (sscanf(hex + i * 2, "%2x", &value) != 1) {
+            return false;
+        }
+        out[i] = (uint8_t)value;
+    }
+    return true;
+}
+
+bool parse_private_key(const char *hex, uint8_t private_key[32]) {
+    if (!parse_hex(hex, private_key, 32) || !secp256k1_scalar_is_valid(private_key)) {
+        fprintf(stderr, "bad private key\n");
+        return false;
+    }
+    return true;
+}
+
+size_t sectors(size_t bytes) {
+    return (bytes + kSectorSize - 1) / kSectorSize;
+}
+
+// Image sectors that differ between two images, i.e. what the stick stages
+// and rewrites (sector 0 always is)
+size_t changed_sectors(const std::vector<uint8_t> &old_image, const std::vector<uint8_t> &new_image) {
+    size_t changed = 0;
+    for (size_t s = 0; s < sectors(new_image.size()); s++) {
+        size_t start = s * kSectorSize;
+        size_t end = std::min(start + kSectorSize, new_image.size());
+        bool same = s != 0 && end <= old_image.size() &&
+                    memcmp(&old_image[start], &new_image[start], end - start) == 0;
+        changed += same ? 0 : 1;
+    }
+    return changed;
+}
+
+struct Send {
+    size_t failed = 0;
+    std::string error;
+    bool installing = false;
+};
+
+void on_reply(void *ctx, const Reply &reply) {
+    Send &send = *static_cast<Send *>(ctx);
+    if (!reply.ok()) {
+        if (send.failed++ == 0) {
+            send.error = std::string(reply.json.error().value_or("no reply"));
+        }
+    } else if (reply.json.boolean("installing").value_or(false)) {
+        send.installing = true;
+    }
+}
+
+// Stream a patch to the stick and stage it. Seconds taken, or < 0.
+double send_patch(Fleet &fleet, int id, const std::vector<uint8_t> &patch, bool install) {
+    static const char kHex[] = "0123456789abcdef";
+    Send send;
+    std::string line;
+
+    auto start = std::chrono::steady_clock::now();
+    auto submit = [&](const std::string &command) {
+        while (!fleet.request(id, command, on_reply, &send)) {
+            fleet.poll(100);
+        }
+    };
+
+    submit("UPDATE begin");
+    for (size_t offset = 0; offset < patch.size() && send.failed == 0; offset += kChunk) {
+        size_t len = std::min(kChunk, patch.size() - offset);
+        line = "UPDATE data ";
+        for (size_t i = 0; i < len; i++) {
+            line += kHex[patch[offset + i] >> 4];
+            line += kHex[patch[offset + i] & 0xF];
+        }
+        submit(line);
+    }
+    submit("UPDATE end");
+    fleet.drain((int)kUpdateTimeoutMs);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (send.failed > 0) {
+        fprintf(stderr, "UPDATE: %s\n", send.error.c_str());
+        fleet.request(id, "UPDATE abort", on_reply, &send);
+        fleet.drain((int)kUpdateTimeoutMs);
+        return -1;
+    }
+
+    if (install) {
+        submit("UPDATE install");
+        fleet.drain((int)kUpdateTimeoutMs);
+        if (!send.installing) {
+            fprintf(stderr, "UPDATE: %s\n", send.error.c_str());
+            return -1;
+        }
+    }
+    return seconds;
+}
+
+int make(const char *old_path, const char *new_path, const char *key_hex, const char *out_path) {
+    std::vector<uint8_t> old_image, new_image;
+    uint8_t private_key[32];
+    if (!parse_private_key(key_hex, private_key)) {
+        return 2;
+    }
+    if (!read_file(old_path, &old_image) || !read_file(new_path, &new_image)) {
+        return 1;
+    }
+
+    DeltaStats stats;
+    std::vector<uint8_t> patch = make_delta_patch(old_image, new_image, private_key, &stats);
+    if (!write_file(out_path, patch)) {
+        return 1;
+    }
+    printf("%s: %zu bytes for a %zu byte image (%zu copies of %zu bytes, %zu inserts of %zu bytes)\n",
+           out_path, patch.size(), new_image.size(), stats.copies, stats.copied_bytes,
+           stats.inserts, stats.inserted_bytes);
+    return 0;
+}
+
+int full(const char *new_path, const char *key_hex, const char *out_path) {
+    std::vector<uint8_t> new_image;
+    uint8_t private_key[32];
+    if (!parse_private_key(key_hex, private_key)) {
+        return 2;
+    }
+    if (!read_file(new_path, &new_image)) {
+        return 1;
+    }
+    return write_file(out_path, make_full_patch(new_image, private_key)) ? 0 : 1;
+}
+
+int apply(const char *old_path, const char *patch_path, const char *pubkey_hex, const char *out_path) {
+    std::vector<uint8_t> old_image, patch, new_image;
+    uint8_t pubkey[33];
+    if (!parse_hex(pubkey_hex, pubkey, sizeof(pubkey))) {
+        fprintf(stderr, "bad public key\n");
+        return 2;
+    }
+    if (!read_file(old_path, &old_image) || !read_file(patch_path, &patch)) {
+        return 1;
+    }
+
+    std::string error;
+    if (!apply_delta_patch(old_image, patch, pubkey, &new_image, &error)) {
+        fprintf(stderr, "%s: %s\n", patch_path, error.c_str());
+        return 1;
+    }
+    return write_file(out_path, new_image) ? 0 : 1;
+}
+
+int send(const char *tty, const char *patch_path, bool install) {
+    std::vector<uint8_t> patch;
+    if (!read_file(patch_path, &patch)) {
+        return 1;
+    }
+
+    Fleet fleet(1);
+    fleet.set_timeout_ms(kUpdateTimeoutMs);
+    int id = fleet.add(tty);
+    if (id < 0) {
+        fprintf(stderr, "%s: %s\n", tty, strerror(-id));
+        return 1;
+    }
+
+    double seconds = send_patch(fleet, id, patch, install);
+    if (seconds < 0) {
+        return 1;
+    }
+    printf("%s: %zu patch bytes staged in %.2f s%s\n", tty, patch.size(), seconds,
+           install ? ", installing" : "");
+    return 0;
+}
+
+int compare(const char *old_path, const char *new_path, const char *key_hex, const char *tty) {
+    std::vector<uint8_t> old_image, new_image;
+    uint8_t private_key[32];
+    uint8_t pubkey[33];
+    if (!parse_private_key(key_hex, private_key)) {
+        return 2;
+    }
+    if (!read_file(old_path, &old_image) || !read_file(new_path, &new_image)) {
+        return 1;
+    }
+    secp256k1_point_t point;
+    secp256k1_mul_base(private_key, &point);
+    secp256k1_pubkey_serialize(&point, pubkey);
+
+    std::vector<uint8_t> delta = make_delta_patch(old_image, new_image, private_key);
+    std::vector<uint8_t> whole = make_full_patch(new_image, private_key);
+    std::vector<uint8_t> check;
+    std::string error;
+    if (!apply_delta_patch(old_image, delta, pubkey, &check, &error)) {
+        fprintf(stderr, "delta patch does not apply: %s\n", error.c_str());
+        return 1;
+    }
+
+    // UPDATE data sends each patch byte as two hex digits; a UF2 block is
+    // 512 bytes for 256 of image, and BOOTSEL rewrites every sector
+    size_t uf2_bytes = (new_image.size() + kUf2Payload - 1) / kUf2Payload * 512;
+    size_t slot = sectors(new_image.size());
+    size_t changed = changed_sectors(old_image, new_image);
+
+    double delta_s = -1, whole_s = -1;
+    if (tty) {
+        Fleet fleet(1);
+        fleet.set_timeout_ms(kUpdateTimeoutMs);
+        int id = fleet.add(tty);
+        if (id < 0) {
+            fprintf(stderr, "%s: %s\n", tty, strerror(-id));
+            return 1;
+        }
+        delta_s = send_patch(fleet, id, delta, false);
+        whole_s = send_patch(fleet, id, whole, false);
+        Send ignore;
+        fleet.request(id, "UPDATE abort", on_reply, &ignore);
+        fleet.drain(1000);
+    }
+
+    auto row = [](const char *name, size_t payload, size_t wire, size_t erased, double seconds) {
+        printf("%-12s %10zu %10zu %8zu", name, payload, wire, erased);
+        if (seconds >= 0) {
+            printf(" %9.2f\n", seconds);
+        } else {
+            printf(" %9s\n", "-");
+        }
+    };
+    printf("%-12s %10s %10s %8s %9s\n", "update", "payload", "wire", "erases", "stage_s");
+    // Changed sectors are erased once in the staging slot, once at install
+    row("delta", delta.size(), delta.size() * 2, 2 * changed, delta_s);
+    row("full", whole.size(), whole.size() * 2, 2 * changed, whole_s);
+    row("uf2", new_image.size(), uf2_bytes, slot, -1);
+    printf("%zu of %zu image sectors change\n", changed, slot);
+    return 0;
+}
+
+int usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s make OLD.bin NEW.bin KEYHEX OUT.patch\n"
+            "       %s full NEW.bin KEYHEX OUT.patch\n"
+            "       %s apply OLD.bin PATCH PUBKEYHEX OUT.bin\n"
+            "       %s send TTY PATCH [--install]\n"
+            "       %s compare OLD.bin NEW.bin KEYHEX [TTY]\n",
+            argv0, argv0, argv0, argv0, argv0);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+
+    bool install = false;
+    std::vector<const char *> args;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--install") == 0) {
+            install = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    const char *command = argv[1];
+    if (strcmp(command, "make") == 0 && args.size() == 4) {
+        return make(args[0], args[1], args[2], args[3]);
+    }
+    if (strcmp(command, "full") == 0 && args.size() == 3) {
+        return full(args[0], args[1], args[2]);
+    }
+    if (strcmp(command, "apply") == 0 && args.size() == 4) {
+        return apply(args[0], args[1], args[2], args[3]);
+    }
+    if (strcmp(command, "send") == 0 && args.size() == 2) {
+        return send(args[0], args[1], install);
+    }
+    if (strcmp(command, "compare") == 0 && (args.size() == 3 || args.size() == 4)) {
+        return compare(args[0], args[1], args[2], args.size() == 4 ? args[3] : nullptr);
+    }
+    return usage(argv[0]);
+}
@@ -0,0 +1,224 @@
+// Capture an SE050 bus transcript from a stick, or replay one.
+//
+//   i2c_trace capture TTY OUT [--seconds N]
+//   i2c_trace replay FILE [--real] [--timeout-us N]
+//
+// capture records for N seconds (default 10) while the stick is used
+// normally, draining the device's ring as it goes, and saves the
+// transcript to OUT.
+//
+// replay drives the recorded traffic back through a ReplayBus. With
+// --timeout-us it shows how a per-transfer timeout would have fared
+// against the recorded device: how many transfers it would cut short, and
+// the bus time it would save or cost. --real replays at recorded speed
+// instead of on a virtual clock.
+
+#include "cashstick/fleet.hpp"
+#include "cashstick/i2c_transcript.hpp"
+#include "cashstick/replay_bus.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace cashstick;
+
+namespace {
+
+constexpr int kReplyWaitMs = 2000;
+
+struct Capture {
+    I2cTranscript transcript;
+    bool more = false;
+    bool failed = false;
+};
+
+void on_command(void *ctx, const Reply &reply) {
+    Capture &capture = *static_cast<Capture *>(ctx);
+    if (!reply.ok()) {
+        std::string_view error = reply.json.error().value_or("no reply");
+        fprintf(stderr, "TRACE: %.*s\n", (int)error.size(), error.data());
+        capture.failed = true;
+    }
+}
+
+void on_read(void *ctx, const Reply &reply) {
+    Capture &capture = *static_cast<Capture *>(ctx);
+    if (!reply.ok() || !capture.transcript.append_reply(reply.json, &capture.more)) {
+        on_command(ctx, reply);
+        capture.failed = true;
+        capture.more = false;
+    }
+}
+
+bool trace(Fleet &fleet, int id, const char *args, Capture &capture) {
+    ReplyFn fn = strcmp(args, "read") == 0 ? on_read : on_command;
+    return fleet.trace(id, args, fn, &capture) && fleet.drain(kReplyWaitMs) && !capture.failed;
+}
+
+int capture(const char *tty, const char *out, double seconds) {
+    Fleet fleet(1);
+    int id = fleet.add(tty);
+    if (id < 0) {
+        fprintf(stderr, "%s: %s\n", tty, strerror(-id));
+        return 1;
+    }
+
+    Capture capture;
+    if (!trace(fleet, id, "clear", capture) || !trace(fleet, id, "on", capture)) {
+        return 1;
+    }
+    fprintf(stderr, "TRACE: recording %s for %.0f s\n", tty, seconds);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        do {
+            if (!trace(fleet, id, "read", capture)) {
+                return 1;
+            }
+        } while (capture.more);
+        fleet.poll(100);
+    }
+
+    if (!trace(fleet, id, "off", capture)) {
+        return 1;
+    }
+    do {
+        if (!trace(fleet, id, "read", capture)) {
+            return 1;
+        }
+    } while (capture.more);
+
+    if (!capture.transcript.save(out)) {
+        perror(out);
+        return 1;
+    }
+    fprintf(stderr, "TRACE: %zu records to %s, %llu dropped on the device\n",
+            capture.transcript.records().size(), out,
+            (unsigned long long)capture.transcript.dropped());
+    return 0;
+}
+
+uint32_t percentile(std::vector<uint32_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * (double)sorted.size()))];
+}
+
+int replay(const char *path, bool real, uint32_t timeout_us) {
+    I2cTranscript transcript;
+    std::string error;
+    if (!transcript.load(path, &error)) {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return 1;
+    }
+
+    const std::vector<I2cRecord> &records = transcript.records();
+    ReplayBus bus(transcript, real ? ReplayBus::Clock::kReal : ReplayBus::Clock::kVirtual);
+
+    std::vector<uint32_t> writes, reads;
+    uint64_t bus_us = 0, recorded_bus_us = 0;
+    size_t failures = 0, timeouts = 0, recoveries = 0;
+    std::vector<uint8_t> buffer;
+
+    for (const I2cRecord &r : records) {
+        bus.wait_us(r.gap_us);
+        uint64_t start = bus.now_us();
+        int result = 0;
+
+        switch (r.op) {
+        case I2cRecord::Op::kWrite:
+            buffer.assign(r.data.begin(), r.data.end());
+            buffer.resize(r.len);
+            result = bus.write(buffer.data(), buffer.size(), timeout_us);
+            writes.push_back(r.duration_us);
+            break;
+        case I2cRecord::Op::kRead:
+            buffer.resize(r.len);
+            result = bus.read(buffer.data(), buffer.size(), timeout_us);
+            reads.push_back(r.duration_us);
+            break;
+        case I2cRecord::Op::kRecover:
+            bus.recover();
+            recoveries++;
+            break;
+        }
+
+        if (result == ReplayBus::kErrorTimeout && r.result != ReplayBus::kErrorTimeout) {
+            timeouts++;
+        } else if (result < 0) {
+            failures++;
+        }
+        bus_us += bus.now_us() - start;
+        recorded_bus_us += r.duration_us;
+    }
+
+    std::sort(writes.begin(), writes.end());
+    std::sort(reads.begin(), reads.end());
+    uint64_t span_us = bus.now_us();
+
+    printf("records      %zu (%zu writes, %zu reads, %zu recoveries), %llu dropped while recording\n",
+           records.size(), writes.size(), reads.size(), recoveries,
+           (unsigned long long)transcript.dropped());
+    printf("span         %.3f s, bus busy %.1f%%\n",
+           (double)span_us / 1e6, span_us ? 100.0 * (double)bus_us / (double)span_us : 0.0);
+    printf("write us     p50 %u  p99 %u  max %u\n",
+           percentile(writes, 0.50), percentile(writes, 0.99), writes.empty() ? 0 : writes.back());
+    printf("read us      p50 %u  p99 %u  max %u\n",
+           percentile(reads, 0.50), percentile(reads, 0.99), reads.empty() ? 0 : reads.back());
+    printf("failures     %zu recorded\n", failures);
+    if (timeout_us != ReplayBus::kNoTimeout) {
+        printf("timeout      %u us: %zu transfers cut short, bus time %+lld us\n",
+               timeout_us, timeouts, (long long)bus_us - (long long)recorded_bus_us);
+    }
+    if (bus.divergences() > 0) {
+        printf("divergences  %zu, last: %s\n", bus.divergences(), bus.last_divergence().c_str());
+    }
+    return bus.divergences() == 0 ? 0 : 1;
+}
+
+int usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s capture TTY OUT [--seconds N]\n"
+            "       %s replay FILE [--real] [--timeout-us N]\n",
+            argv0, argv0);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        return usage(argv[0]);
+    }
+
+    double seconds = 10;
+    bool real = false;
+    uint32_t timeout_us = ReplayBus::kNoTimeout;
+    std::vector<const char *> args;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--timeout-us") == 0 && i + 1 < argc) {
+            timeout_us = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--real") == 0) {
+            real = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (strcmp(argv[1], "capture") == 0 && args.size() == 2) {
+        return capture(args[0], args[1], seconds);
+    }
+    if (strcmp(argv[1], "replay") == 0 && args.size() == 1) {
+        return replay(args[0], real, timeout_us);
+    }
+    return usage(argv[0]);
+}
@@ -0,0 +1,452 @@
+// Replay host mount write traces against the mass-storage write overlay.
+//
+//   msc_replay [--sectors N] [TRACE...]
+//
+// Traces are text, one operation per line: "R LBA COUNT" reads and
+// "W LBA COUNT" writes sectors, "E" ejects, '#' starts a comment. Without
+// files, the built-in traces model what Windows, macOS and Linux write
+// when they mount this stick's 8 MB FAT12 volume: folders and index files
+// in the free clusters, FAT and directory updates, dirty flags and access
+// dates. Each trace runs through the firmware's msc_overlay.c with the
+// same per-transfer split as usb_msc_disk.c, once in whole 4 KB transfers
+// and once in 192-byte pieces so partial sectors are patched too.
+//
+// Checks that every write is accepted, that each read returns the last
+// write or (for an evicted data sector) the generated sector, that no
+// FAT or directory write is lost in an overlay of N sectors (default 16,
+// CASHSTICK_MSC_OVERLAY_SECTORS), and that the volume reads back as
+// generated after eject. Reports per-sector latency and the smallest
+// overlay that keeps every metadata write. Exits non-zero on failure.
+
+#include "msc_overlay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Volume geometry from usb_msc_disk.c
+constexpr uint32_t kBlockSize = MSC_OVERLAY_SECTOR_SIZE;
+constexpr uint32_t kBlockCount = 16384;
+constexpr uint32_t kDataLba = 11;       // After boot sector, 6 FAT and 4 root sectors
+constexpr uint32_t kDefaultSectors = 16;
+
+using Sector = std::vector<uint8_t>;
+
+const char kWindowsTrace[] =
+    "# Windows 10/11: mount, then System Volume Information and the indexer GUID\n"
+    "R 0 1\n"
+    "R 1 6\n"
+    "R 7 4\n"
+    "W 1 1\n"
+    "W 7 1\n"
+    "W 43 8\n"         // Cluster 6: System Volume Information
+    "W 51 1\n"         // Cluster 7: IndexerVolumeGuid
+    "W 43 1\n"
+    "W 1 1\n"
+    "R 7 4\n"
+    "R 43 8\n"
+    "R 51 1\n"
+    "# Explorer opens README.TXT and ADDRESS.TXT: last access dates\n"
+    "R 11 2\n"
+    "W 7 1\n"
+    "R 19 1\n"
+    "W 7 1\n"
+    "R 7 4\n"
+    "E\n"
+    "R 0 1\n"
+    "R 1 6\n"
+    "R 7 4\n"
+    "R 43 8\n";
+
+const char kMacTrace[] =
+    "# macOS: mount, then .fseventsd, .Spotlight-V100, .Trashes and AppleDouble files\n"
+    "R 0 1\n"
+    "R 1 6\n"
+    "R 7 4\n"
+    "W 1 1\n"
+    "W 7 1\n"
+    "W 43 8\n"         // Cluster 6: .fseventsd
+    "W 51 1\n"         // Cluster 7: fseventsd-uuid
+    "W 1 1\n"
+    "W 7 2\n"
+    "W 59 8\n"         // Clusters 8-10: .Spotlight-V100/Store-V2/<uuid>
+    "W 67 8\n"
+    "W 75 8\n"
+    "W 83 8\n"         // Cluster 11: store files, written in pieces
+    "W 83 2\n"
+    "W 85 3\n"
+    "W 1 1\n"
+    "W 7 2\n"
+    "W 91 8\n"         // Cluster 12: .Trashes
+    "W 99 8\n"         // Cluster 13: ._.Trashes
+    "W 1 1\n"
+    "W 7 2\n"
+    "R 7 4\n"
+    "R 1 6\n"
+    "R 91 8\n"
+    "R 99 8\n"
+    "# Finder preview of ADDRESS.TXT, then the fseventsd journal on eject\n"
+    "R 19 1\n"
+    "W 107 1\n"        // Cluster 14: fseventsd log
+    "W 1 1\n"
+    "W 7 2\n"
+    "R 7 4\n"
+    "R 43 8\n"
+    "R 59 8\n"
+    "E\n"
+    "R 0 1\n"
+    "R 1 6\n"
+    "R 7 4\n"
+    "R 59 8\n";
+
+const char kLinuxTrace[] =
+    "# Linux vfat: dirty flag on mount, relatime access dates, clean flag on unmount\n"
+    "R 0 1\n"
+    "R 1 6\n"
+    "R 7 4\n"
+    "W 0 1\n"
+    "R 11 1\n"
+    "W 7 1\n"
+    "R 19 1\n"
+    "W 7 1\n"
+    "R 27 1\n"
+    "W 7 1\n"
+    "R 7 1\n"
+    "W 0 1\n"
+    "R 0 1\n"
+    "R 7 4\n"
+    "E\n"
+    "R 0 1\n"
+    "R 7 4\n";
+
+struct Op {
+    char kind;          // 'R', 'W' or 'E'
+    uint32_t lba;
+    uint32_t count;
+};
+
+struct Trace {
+    std::string name;
+    std::vector<Op> ops;
+};
+
+struct Outcome {
+    size_t sectors_written = 0;
+    size_t sectors_read = 0;
+    size_t write_errors = 0;
+    size_t corrupt = 0;             // Neither the last write nor the generated sector
+    size_t lost_metadata = 0;       // FAT or directory write read back as generated
+    size_t lost_data = 0;
+    size_t stale_after_eject = 0;
+    msc_overlay_stats_t stats{};
+    std::vector<double> write_ns;   // Per sector
+    std::vector<double> read_ns;
+};
+
+bool parse_trace(const std::string &name, std::istream &in, Trace *trace) {
+    trace->name = name;
+    std::string line;
+    for (unsigned number = 1; std::getline(in, line); number++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind)) {
+            continue;
+        }
+
+        Op op{kind[0], 0, 0};
+        if (kind == "E") {
+            trace->ops.push_back(op);
+            continue;
+        }
+        if ((kind != "R" && kind != "W") || !(fields >> op.lba >> op.count) || op.count == 0 ||
+            op.lba >= kBlockCount || op.count > kBlockCount - op.lba) {
+            fprintf(stderr, "MSC_REPLAY: %s:%u: bad operation '%s'\n", name.c_str(), number, line.c_str());
+            return false;
+        }
+        trace->ops.push_back(op);
+    }
+    return true;
+}
+
+// Stands in for the generated volume: fixed content per LBA
+Sector generated(uint32_t lba) {
+    Sector sector(kBlockSize);
+    for (uint32_t i = 0; i < kBlockSize; i++) {
+        sector[i] = (uint8_t)((lba * 2654435761u) >> (i % 4 * 8)) ^ (uint8_t)i;
+    }
+    return sector;
+}
+
+// What the host writes: distinct for every write of every sector
+Sector host_data(uint32_t lba, uint32_t sequence) {
+    Sector sector(kBlockSize);
+    for (uint32_t i = 0; i < kBlockSize; i++) {
+        sector[i] = (uint8_t)(lba ^ (sequence * 31u) ^ (i * 7u) ^ 0xA5u);
+    }
+    return sector;
+}
+
+// The overlay behind usb_msc_disk.c's read10/write10 callbacks
+class Disk {
+public:
+    explicit Disk(uint32_t capacity)
+        : sectors_((size_t)std::max(capacity, 1u) * kBlockSize), lba_(std::max(capacity, 1u)),
+          last_use_(lba_.size()) {
+        msc_overlay_init(&overlay_, reinterpret_cast<uint8_t (*)[kBlockSize]>(sectors_.data()), lba_.data(),
+                         last_use_.data(), capacity, kDataLba);
+    }
+
+    // TinyUSB's split of one transfer: lba advances, offset into the first sector
+    int32_t write(uint32_t lba, uint32_t offset, const uint8_t *buffer, uint32_t size) {
+        uint32_t done = 0;
+        while (done < size) {
+            if (lba >= kBlockCount) {
+                return -1;
+            }
+            uint32_t chunk = std::min(kBlockSize - offset, size - done);
+            if (chunk == kBlockSize) {
+                msc_overlay_write(&overlay_, lba, buffer + done);
+            } else {
+                uint8_t sector[kBlockSize];
+                uint8_t *current = msc_overlay_find(&overlay_, lba);
+                if (!current) {
+                    read_sector(lba, sector);
+                    current = sector;
+                }
+                memcpy(current + offset, buffer + done, chunk);
+                msc_overlay_write(&overlay_, lba, current);
+            }
+            done += chunk;
+            offset = 0;
+            lba++;
+        }
+        return (int32_t)done;
+    }
+
+    int32_t read(uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t size) {
+        uint32_t done = 0;
+        while (done < size) {
+            if (lba >= kBlockCount) {
+                return -1;
+            }
+            uint8_t sector[kBlockSize];
+            read_sector(lba, sector);
+            uint32_t chunk = std::min(kBlockSize - offset, size - done);
+            memcpy(buffer + done, sector + offset, chunk);
+            done += chunk;
+            offset = 0;
+            lba++;
+        }
+        return (int32_t)done;
+    }
+
+    void eject() { msc_overlay_discard(&overlay_); }
+
+    const msc_overlay_stats_t &stats() const { return overlay_.stats; }
+
+private:
+    void read_sector(uint32_t lba, uint8_t *sector) {
+        if (!msc_overlay_read(&overlay_, lba, sector)) {
+            Sector base = generated(lba);
+            memcpy(sector, base.data(), kBlockSize);
+        }
+    }
+
+    std::vector<uint8_t> sectors_;
+    std::vector<uint32_t> lba_;
+    std::vector<uint32_t> last_use_;
+    msc_overlay_t overlay_;
+};
+
+Outcome replay(const Trace &trace, uint32_t capacity, uint32_t transfer_size) {
+    using Clock = std::chrono::steady_clock;
+    Outcome outcome;
+    Disk disk(capacity);
+    std::map<uint32_t, Sector> written;     // Last write per LBA since the last eject
+    std::map<uint32_t, bool> ejected_lbas;  // Written before an eject, not since
+    uint32_t sequence = 0;
+
+    for (const Op &op : trace.ops) {
+        if (op.kind == 'E') {
+            disk.eject();
+            for (const auto &entry : written) {
+                ejected_lbas[entry.first] = true;
+            }
+            written.clear();
+            continue;
+        }
+
+        std::vector<uint8_t> buffer((size_t)op.count * kBlockSize);
+        if (op.kind == 'W') {
+            for (uint32_t i = 0; i < op.count; i++) {
+                Sector data = host_data(op.lba + i, ++sequence);
+                memcpy(&buffer[(size_t)i * kBlockSize], data.data(), kBlockSize);
+                written[op.lba + i] = data;
+                ejected_lbas.erase(op.lba + i);
+            }
+        }
+
+        auto start = Clock::now();
+        for (uint32_t done = 0; done < buffer.size();) {
+            uint32_t size = std::min<uint32_t>(transfer_size, (uint32_t)buffer.size() - done);
+            uint32_t lba = op.lba + done / kBlockSize;
+            uint32_t offset = done % kBlockSize;
+            int32_t result = op.kind == 'W' ? disk.write(lba, offset, &buffer[done], size)
+                                            : disk.read(lba, offset, &buffer[done], size);
+            if (result != (int32_t)size) {
+                outcome.write_errors += op.kind == 'W';
+                break;
+            }
+            done += size;
+        }
+        double per_sector = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / op.count;
+
+        if (op.kind == 'W') {
+            outcome.sectors_written += op.count;
+            outcome.write_ns.insert(outcome.write_ns.end(), op.count, per_sector);
+            continue;
+        }
+
+        outcome.sectors_read += op.count;
+        outcome.read_ns.insert(outcome.read_ns.end(), op.count, per_sector);
+        for (uint32_t i = 0; i < op.count; i++) {
+            uint32_t lba = op.lba + i;
+            const uint8_t *got = &buffer[(size_t)i * kBlockSize];
+            Sector base = generated(lba);
+            bool is_base = memcmp(got, base.data(), kBlockSize) == 0;
+            auto last = written.find(lba);
+
+            if (last == written.end()) {
+                if (!is_base) {
+                    outcome.corrupt++;
+                    outcome.stale_after_eject += ejected_lbas.count(lba);
+                }
+            } else if (memcmp(got, last->second.data(), kBlockSize) != 0) {
+                if (!is_base) {
+                    outcome.corrupt++;
+                } else if (lba < kDataLba) {
+                    outcome.lost_metadata++;
+                } else {
+                    outcome.lost_data++;
+                }
+            }
+        }
+    }
+
+    // Whatever the trace ended with, an eject leaves the generated volume
+    disk.eject();
+    for (const auto &entry : written) {
+        uint8_t sector[kBlockSize];
+        disk.read(entry.first, 0, sector, kBlockSize);
+        if (memcmp(sector, generated(entry.first).data(), kBlockSize) != 0) {
+            outcome.stale_after_eject++;
+        }
+    }
+
+    outcome.stats = disk.stats();
+    return outcome;
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * (double)values.size()))];
+}
+
+// Smallest overlay in which no FAT or directory write is lost
+uint32_t smallest_capacity(const Trace &trace) {
+    for (uint32_t capacity = 1; capacity <= 256; capacity++) {
+        Outcome outcome = replay(trace, capacity, 4096);
+        if (outcome.lost_metadata == 0 && outcome.stats.pinned_evictions == 0) {
+            return capacity;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    uint32_t capacity = kDefaultSectors;
+    std::vector<Trace> traces;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sectors") == 0 && i + 1 < argc) {
+            capacity = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [--sectors N] [TRACE...]\n", argv[0]);
+            return 2;
+        } else {
+            std::ifstream file(argv[i]);
+            Trace trace;
+            if (!file || !parse_trace(argv[i], file, &trace)) {
+                fprintf(stderr, "MSC_REPLAY: cannot read trace %s\n", argv[i]);
+                return 2;
+            }
+            traces.push_back(trace);
+        }
+    }
+
+    if (traces.empty()) {
+        const std::pair<const char *, const char *> builtin[] = {
+            { "windows", kWindowsTrace },
+            { "macos", kMacTrace },
+            { "linux", kLinuxTrace },
+        };
+        for (const auto &entry : builtin) {
+            std::istringstream text(entry.second);
+            Trace trace;
+            parse_trace(entry.first, text, &trace);
+            traces.push_back(trace);
+        }
+    }
+
+    printf("MSC_REPLAY: overlay of %u sectors (%u bytes)\n", capacity, capacity * kBlockSize);
+
+    size_t checks = 0;
+    size_t failed = 0;
+    for (const Trace &trace : traces) {
+        for (uint32_t transfer_size : { 4096u, 192u }) {
+            Outcome o = replay(trace, capacity, transfer_size);
+            printf("MSC_REPLAY: %-8s %4u-byte transfers: %3zu written, %3zu read, %3lu hits, %2lu evicted "
+                   "(%lu metadata), %zu data sectors read back as generated\n",
+                   trace.name.c_str(), transfer_size, o.sectors_written, o.sectors_read,
+                   (unsigned long)o.stats.read_hits, (unsigned long)o.stats.evictions,
+                   (unsigned long)o.stats.pinned_evictions, o.lost_data);
+            printf("MSC_REPLAY: %-8s %4u-byte transfers: write p50 %.0f ns max %.0f ns, "
+                   "read p50 %.0f ns max %.0f ns per sector\n",
+                   trace.name.c_str(), transfer_size, percentile(o.write_ns, 0.5), percentile(o.write_ns, 1.0),
+                   percentile(o.read_ns, 0.5), percentile(o.read_ns, 1.0));
+
+            const std::pair<bool, const char *> results[] = {
+                { o.write_errors == 0, "write refused" },
+                { o.corrupt == 0, "sector read back neither written nor generated" },
+                { o.lost_metadata == 0, "FAT or directory write lost" },
+                { o.stale_after_eject == 0, "host write survived eject" },
+            };
+            for (const auto &result : results) {
+                checks++;
+                if (!result.first) {
+                    failed++;
+                    fprintf(stderr, "MSC_REPLAY: %s: FAIL %s\n", trace.name.c_str(), result.second);
+                }
+            }
+        }
+        printf("MSC_REPLAY: %-8s keeps every metadata write from %u sectors\n", trace.name.c_str(),
+               smallest_capacity(trace));
+    }
+
+    fprintf(stderr, "MSC_REPLAY: %zu checks, %zu failed\n", checks, failed);
+    return failed == 0 ? 0 : 1;
+}
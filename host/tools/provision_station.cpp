@@ -0,0 +1,111 @@
+// Production-line fixture: provision every attached stick in parallel.
+//
+//   provision_station [--log FILE] TTY...
+//
+// Sends PROVISION to all units at once and writes one CSV row per unit
+// (stdout, and appended to FILE if given) with the device's own stage
+// timings and the cycle time seen by the host. Exits non-zero if any unit
+// failed.
+
+#include "cashstick/fleet.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace cashstick;
+
+namespace {
+
+constexpr uint32_t kProvisionTimeoutMs = 30000;
+
+struct Station {
+    std::vector<std::string> paths;     // By device id
+    FILE *log = nullptr;
+    size_t failed = 0;
+};
+
+void write_row(FILE *out, const std::string &path, const Reply &reply) {
+    const JsonView &j = reply.json;
+    auto text = [&j](const char *key) { return j.str(key).value_or(std::string_view()); };
+    auto number = [&j](const char *key) { return (unsigned long long)j.u64(key).value_or(0); };
+
+    std::string_view stage = reply.ok() ? text("stage") : j.error().value_or("no reply");
+    fprintf(out, "%s,%.*s,%s,%.*s,%.*s,%s,%llu,%llu,%llu,%llu,%llu,%.1f\n",
+            path.c_str(),
+            (int)text("device_id").size(), text("device_id").data(),
+            j.boolean("provisioned").value_or(false) ? "ok" : "FAIL",
+            (int)stage.size(), stage.data(),
+            (int)text("address").size(), text("address").data(),
+            j.boolean("pool").value_or(false) ? "pool" : "foreground",
+            number("keygen_us"), number("seal_us"), number("commit_us"),
+            number("selftest_us"), number("total_us"),
+            (double)reply.latency_ns / 1e6);
+}
+
+void on_provisioned(void *ctx, const Reply &reply) {
+    Station &station = *static_cast<Station *>(ctx);
+    const std::string &path = station.paths[(size_t)reply.device];
+
+    if (!reply.ok() || !reply.json.boolean("provisioned").value_or(false)) {
+        station.failed++;
+    }
+
+    write_row(stdout, path, reply);
+    if (station.log) {
+        write_row(station.log, path, reply);
+        fflush(station.log);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Station station;
+    std::vector<const char *> ttys;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            station.log = fopen(argv[++i], "a");
+            if (!station.log) {
+                perror(argv[i]);
+                return 2;
+            }
+        } else {
+            ttys.push_back(argv[i]);
+        }
+    }
+    if (ttys.empty()) {
+        fprintf(stderr, "usage: %s [--log FILE] TTY...\n", argv[0]);
+        return 2;
+    }
+
+    Fleet fleet(ttys.size());
+    fleet.set_timeout_ms(kProvisionTimeoutMs);
+    station.paths.resize(ttys.size());
+
+    printf("tty,device_id,result,stage,address,key,keygen_us,seal_us,commit_us,selftest_us,device_us,host_ms\n");
+
+    auto start = std::chrono::steady_clock::now();
+    for (const char *tty : ttys) {
+        int id = fleet.add(tty);
+        if (id < 0) {
+            fprintf(stderr, "%s: %s\n", tty, strerror(-id));
+            station.failed++;
+            continue;
+        }
+        station.paths[(size_t)id] = tty;
+        fleet.provision(id, on_provisioned, &station);
+    }
+    fleet.drain((int)kProvisionTimeoutMs + 1000);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "STATION: %zu units, %zu failed, %.2f s\n", ttys.size(), station.failed, seconds);
+
+    if (station.log) {
+        fclose(station.log);
+    }
+    return station.failed == 0 ? 0 : 1;
+}
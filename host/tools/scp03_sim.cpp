@@ -0,0 +1,337 @@
+// SE050 secure channel (SCP03) against a simulated card.
+//
+//   scp03_sim [--iterations N] [--commands N] [--faults PERMILLE] [--budget-blocks N]
+//
+// Cost: the handshake, then wrap and unwrap of each command the firmware
+// sends, timed over N iterations (default 2000) with the AES blocks each
+// one takes. Host time says little about the stick; the block count is
+// what carries over (times the per-block cost on the RP2040). With
+// --budget-blocks a command above the budget fails the run.
+//
+// Resumption: N commands (default 10000) over a link that loses the write
+// or the reply at the given rate (default 50 per mille), handled the way
+// se050_interface.c does: rewind when the frame never arrived, carry on
+// when only the reply was lost. Every command after a fault must go
+// through without a new handshake. Exits non-zero if a check fails.
+
+#include "scp03.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr uint16_t kSwSecurity = SCP03_SW_SECURITY;
+
+// Commands as se050_interface.c sends them: data out, plaintext back
+struct Command {
+    const char *name;
+    uint8_t ins;
+    size_t data_len;
+    size_t reply_len;
+};
+
+constexpr Command kCommands[] = {
+    { "delete",  0x07, 0,   0 },
+    { "random",  0x08, 1,   64 },
+    { "seal",    0x09, 32,  32 },
+    { "sign",    0x03, 32,  64 },
+    { "keygen",  0x02, 2,   33 },
+    { "max",     0x7E, SCP03_MAX_DATA, SCP03_MAX_DATA },
+};
+
+const Command *find_command(uint8_t ins) {
+    for (const Command &command : kCommands) {
+        if (command.ins == ins) {
+            return &command;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<uint8_t> status_only(uint16_t sw) {
+    return { (uint8_t)(sw >> 8), (uint8_t)sw };
+}
+
+// The SE050 end: answers every known command with reply_len bytes
+struct SimCard {
+    scp03_static_keys_t keys;
+    scp03_session_t session{};
+    std::mt19937_64 rng{0x5E050};
+
+    std::vector<uint8_t> handle(const uint8_t *frame, size_t len) {
+        if (len == SCP03_INIT_UPDATE_SIZE && frame[1] == 0x50) {
+            uint8_t challenge[SCP03_CHALLENGE_SIZE];
+            fill(challenge, sizeof(challenge));
+            std::vector<uint8_t> reply(SCP03_INIT_RESPONSE_SIZE);
+            scp03_card_initialize(&session, &keys, frame, challenge, reply.data());
+            return reply;
+        }
+        if (len == SCP03_EXT_AUTH_SIZE && frame[1] == 0x82) {
+            return status_only(scp03_card_authenticate(&session, frame) ? SCP03_SW_OK : kSwSecurity);
+        }
+
+        uint8_t header[4];
+        uint8_t data[SCP03_MAX_DATA];
+        size_t data_len = sizeof(data);
+        if (!scp03_card_unwrap(&session, frame, len, header, data, &data_len)) {
+            return status_only(kSwSecurity);
+        }
+        const Command *command = find_command(header[1]);
+        if (!command) {
+            return status_only(0x6D00);         // INS not supported
+        }
+
+        uint8_t out[SCP03_MAX_DATA];
+        fill(out, command->reply_len);
+        std::vector<uint8_t> reply(scp03_response_size(command->reply_len));
+        reply.resize(scp03_card_wrap(&session, out, command->reply_len, SCP03_SW_OK, reply.data(), reply.size()));
+        return reply;
+    }
+
+    void fill(uint8_t *out, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            out[i] = (uint8_t)rng();
+        }
+    }
+};
+
+enum class Fault { kNone, kWrite, kReply };
+
+// The firmware end, following se050_open_session and se050_command
+struct SimHost {
+    scp03_static_keys_t keys;
+    scp03_session_t session{};
+    SimCard *card;
+    std::mt19937_64 rng{0xC0FFEE};
+    uint32_t handshakes = 0;
+    uint32_t rewinds = 0;
+    uint32_t lost_replies = 0;
+    uint32_t rejected = 0;
+
+    bool handshake() {
+        uint8_t challenge[SCP03_CHALLENGE_SIZE];
+        uint64_t nonce = rng();
+        memcpy(challenge, &nonce, sizeof(challenge));
+
+        uint8_t init[SCP03_INIT_UPDATE_SIZE];
+        scp03_initialize_update(challenge, init);
+        std::vector<uint8_t> reply = card->handle(init, sizeof(init));
+        if (reply.size() != SCP03_INIT_RESPONSE_SIZE || !scp03_begin(&session, &keys, challenge, reply.data())) {
+            return false;
+        }
+
+        uint8_t auth[SCP03_EXT_AUTH_SIZE];
+        scp03_external_authenticate(&session, auth);
+        reply = card->handle(auth, sizeof(auth));
+        handshakes++;
+        return reply == status_only(SCP03_SW_OK);
+    }
+
+    // False on a lost transfer; a rejected session gets one new handshake
+    bool command(const Command &command, Fault fault) {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            scp03_mark_t mark;
+            scp03_mark(&session, &mark);
+
+            uint8_t header[4] = { 0x80, command.ins, 0x00, 0x00 };
+            uint8_t data[SCP03_MAX_DATA] = {0};
+            uint8_t frame[256];
+            size_t frame_len = scp03_wrap(&session, header, data, command.data_len, frame, sizeof(frame));
+            if (fault == Fault::kWrite) {
+                scp03_rewind(&session, &mark);
+                rewinds++;
+                return false;
+            }
+
+            std::vector<uint8_t> reply = card->handle(frame, frame_len);
+            if (fault == Fault::kReply) {
+                lost_replies++;
+                return false;
+            }
+
+            uint8_t out[SCP03_MAX_DATA];
+            size_t out_len = sizeof(out);
+            uint16_t sw = 0;
+            bool authentic = scp03_unwrap(&session, reply.data(), reply.size(), out, &out_len, &sw);
+            if (authentic && sw == SCP03_SW_OK) {
+                return out_len == command.reply_len;
+            }
+            if (authentic && sw != kSwSecurity) {
+                return false;
+            }
+            rejected++;
+            if (attempt > 0 || !handshake()) {
+                return false;
+            }
+        }
+        return false;
+    }
+};
+
+struct Result {
+    size_t checks = 0;
+    size_t failed = 0;
+};
+
+void check(Result &result, bool ok, const char *what) {
+    result.checks++;
+    if (!ok) {
+        result.failed++;
+        fprintf(stderr, "SCP03_SIM: FAIL %s\n", what);
+    }
+}
+
+void fill_keys(scp03_static_keys_t *keys) {
+    for (uint8_t i = 0; i < AES128_KEY_SIZE; i++) {
+        keys->enc[i] = keys->mac[i] = keys->dek[i] = (uint8_t)(0x40 + i);   // GlobalPlatform test keys
+    }
+}
+
+double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void measure_cost(Result &result, unsigned iterations, unsigned budget_blocks) {
+    SimCard card;
+    SimHost host;
+    fill_keys(&card.keys);
+    fill_keys(&host.keys);
+    host.card = &card;
+
+    uint32_t blocks = aes128_block_count();
+    auto start = std::chrono::steady_clock::now();
+    bool opened = host.handshake();
+    double handshake_us = elapsed_us(start);
+    check(result, opened, "handshake");
+    printf("SCP03_SIM: handshake %.1f us, %u AES blocks (both ends)\n",
+           handshake_us, aes128_block_count() - blocks);
+
+    printf("  %-8s %5s %5s %6s %6s %10s %10s %7s\n",
+           "command", "data", "reply", "frame", "resp", "wrap us", "unwrap us", "blocks");
+    for (const Command &command : kCommands) {
+        uint8_t header[4] = { 0x80, command.ins, 0x00, 0x00 };
+        uint8_t data[SCP03_MAX_DATA] = {0};
+        uint8_t frame[256];
+        uint8_t out[SCP03_MAX_DATA];
+        double wrap_us = 0;
+        double unwrap_us = 0;
+        uint32_t host_blocks = 0;
+        size_t frame_len = 0;
+        size_t reply_len = 0;
+        bool ok = true;
+
+        for (unsigned i = 0; i < iterations; i++) {
+            uint32_t before = aes128_block_count();
+            auto wrap_start = std::chrono::steady_clock::now();
+            frame_len = scp03_wrap(&host.session, header, data, command.data_len, frame, sizeof(frame));
+            wrap_us += elapsed_us(wrap_start);
+            uint32_t wrap_blocks = aes128_block_count() - before;
+
+            std::vector<uint8_t> reply = card.handle(frame, frame_len);
+            reply_len = reply.size();
+
+            size_t out_len = sizeof(out);
+            uint16_t sw = 0;
+            before = aes128_block_count();
+            auto unwrap_start = std::chrono::steady_clock::now();
+            ok &= scp03_unwrap(&host.session, reply.data(), reply.size(), out, &out_len, &sw) &&
+                  sw == SCP03_SW_OK && out_len == command.reply_len;
+            unwrap_us += elapsed_us(unwrap_start);
+            host_blocks = wrap_blocks + (aes128_block_count() - before);
+        }
+
+        printf("  %-8s %5zu %5zu %6zu %6zu %10.2f %10.2f %7u\n", command.name, command.data_len,
+               command.reply_len, frame_len, reply_len, wrap_us / iterations, unwrap_us / iterations, host_blocks);
+        check(result, ok, command.name);
+        if (budget_blocks > 0 && host_blocks > budget_blocks) {
+            fprintf(stderr, "SCP03_SIM: %s takes %u blocks, budget %u\n", command.name, host_blocks, budget_blocks);
+            check(result, false, "per-command budget");
+        }
+    }
+}
+
+void measure_resumption(Result &result, unsigned commands, unsigned fault_permille) {
+    SimCard card;
+    SimHost host;
+    fill_keys(&card.keys);
+    fill_keys(&host.keys);
+    host.card = &card;
+    check(result, host.handshake(), "handshake");
+
+    std::mt19937 rng(0x12C);
+    unsigned failed_after_fault = 0;
+    unsigned unexpected = 0;
+    unsigned lost = 0;
+    bool last_faulted = false;
+    for (unsigned i = 0; i < commands; i++) {
+        const Command &command = kCommands[i % (sizeof(kCommands) / sizeof(kCommands[0]))];
+        Fault fault = Fault::kNone;
+        if (rng() % 1000 < fault_permille) {
+            fault = rng() % 2 ? Fault::kWrite : Fault::kReply;
+        }
+
+        bool ok = host.command(command, fault);
+        if (fault != Fault::kNone) {
+            lost++;
+        } else if (!ok && last_faulted) {
+            failed_after_fault++;
+        }
+        unexpected += ok != (fault == Fault::kNone);
+        last_faulted = fault != Fault::kNone;
+    }
+
+    printf("SCP03_SIM: %u commands, %u lost (%u writes rewound, %u replies), %u handshakes, %u rejected\n",
+           commands, lost, host.rewinds, host.lost_replies, host.handshakes, host.rejected);
+    check(result, host.handshakes == 1 && host.rejected == 0, "no handshake after I2C faults");
+    check(result, failed_after_fault == 0, "commands after a fault");
+    check(result, unexpected == 0, "fault-free commands go through");
+
+    // A broken MAC is the one case that needs a new session
+    uint8_t frame[256];
+    uint8_t header[4] = { 0x80, 0x08, 0x00, 0x00 };
+    uint8_t chunk = 8;
+    size_t frame_len = scp03_wrap(&host.session, header, &chunk, 1, frame, sizeof(frame));
+    frame[frame_len - 1] ^= 0x01;
+    check(result, card.handle(frame, frame_len) == status_only(kSwSecurity), "card rejects a bad MAC");
+    check(result, host.command(kCommands[1], Fault::kNone) && host.handshakes == 2,
+          "bad MAC recovered with one handshake");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    unsigned iterations = 2000;
+    unsigned commands = 10000;
+    unsigned fault_permille = 50;
+    unsigned budget_blocks = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (unsigned)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--commands") == 0 && i + 1 < argc) {
+            commands = (unsigned)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--faults") == 0 && i + 1 < argc) {
+            fault_permille = (unsigned)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--budget-blocks") == 0 && i + 1 < argc) {
+            budget_blocks = (unsigned)strtoul(argv[++i], nullptr, 0);
+        } else {
+            fprintf(stderr, "usage: %s [--iterations N] [--commands N] [--faults PERMILLE] [--budget-blocks N]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    Result result;
+    measure_cost(result, iterations, budget_blocks);
+    measure_resumption(result, commands, fault_permille);
+
+    fprintf(stderr, "SCP03_SIM: %zu checks, %zu failed\n", result.checks, result.failed);
+    return result.failed == 0 ? 0 : 1;
+}
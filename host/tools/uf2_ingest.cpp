@@ -0,0 +1,307 @@
+// Signed UF2 firmware images: sign them, check them, and time the stick's
+// single-pass ingest against verifying in a second pass.
+//
+//   uf2_ingest sign IMAGE.bin KEYHEX OUT.uf2
+//   uf2_ingest check FILE.uf2 PUBKEYHEX [--window N]
+//   uf2_ingest bench [kilobytes] [--window N]
+//
+// sign wraps a .bin for drag-and-drop in update mode; KEYHEX is the
+// 32-byte vendor private key. check runs a .uf2 through the firmware's
+// stream reader as the stick would, with a reorder window of N blocks
+// (default 8, CASHSTICK_UF2_REORDER_WINDOW).
+//
+// bench signs a random image (default 200 KB) with the development key
+// and feeds it in file order, with every run of N blocks reversed, and
+// with the signature block first. It times the single pass - hash each
+// block as it is programmed, check the signature on the final digest -
+// against programming first and hashing the whole image back from flash.
+// It also checks that a changed byte, another key, a missing signature
+// and a block beyond the window are all refused, and that a rewritten
+// block is ignored. Exits non-zero on a failed check.
+
+#include "cashstick/signed_uf2.hpp"
+
+#include "secp256k1.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cashstick;
+
+namespace {
+
+constexpr uint32_t kDefaultWindow = 8;
+constexpr int kBenchRounds = 20;
+
+bool read_file(const char *path, std::vector<uint8_t> *data) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    data->clear();
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data->insert(data->end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+}
+
+bool write_file(const char *path, const std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(data.data(), 1, data.size(), f) != data.size() || fclose(f) != 0) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+bool parse_hex(const char *hex, uint8_t *out, size_t len) {
+    if (strlen(hex) != len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned value;
+        if (sscanf(hex + i * 2, "%2x", &value) != 1) {
+            return false;
+        }
+        out[i] = (uint8_t)value;
+    }
+    return true;
+}
+
+// Private key 1, the key CASHSTICK_DEV_SIGNING_KEY builds accept
+void development_key(uint8_t private_key[32], uint8_t pubkey[33]) {
+    memset(private_key, 0, 32);
+    private_key[31] = 1;
+    secp256k1_point_t point;
+    secp256k1_mul_base(private_key, &point);
+    secp256k1_pubkey_serialize(&point, pubkey);
+}
+
+// File order with every run of `run` blocks reversed: each block arrives
+// up to run - 1 places early
+std::vector<size_t> reversed_runs(size_t blocks, size_t run) {
+    std::vector<size_t> order(blocks);
+    std::iota(order.begin(), order.end(), 0);
+    for (size_t start = 0; start < blocks; start += run) {
+        std::reverse(order.begin() + (long)start, order.begin() + (long)std::min(start + run, blocks));
+    }
+    return order;
+}
+
+struct Result {
+    size_t checks = 0;
+    size_t failed = 0;
+};
+
+void check(Result &result, bool ok, const char *what) {
+    result.checks++;
+    if (!ok) {
+        result.failed++;
+        fprintf(stderr, "UF2: FAIL %s\n", what);
+    }
+}
+
+// The stick's two ways of getting from UF2 blocks to a checked image. The
+// flash is a buffer here; the second pass reads the whole of it back.
+double time_ingest(const std::vector<uint8_t> &uf2, const uint8_t pubkey[33], bool two_pass, bool *valid) {
+    size_t blocks = uf2.size() / UF2_BLOCK_SIZE;
+    std::vector<uint8_t> flash(blocks * UF2_PAYLOAD_SIZE);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int round = 0; round < kBenchRounds; round++) {
+        sha256_ctx_t ctx;
+        sha256_init(&ctx);
+        const uint8_t *signature = nullptr;
+        size_t length = 0;
+
+        for (size_t i = 0; i < blocks; i++) {
+            const uint8_t *block = &uf2[i * UF2_BLOCK_SIZE];
+            if (block[8] & UF2_FLAG_NOT_MAIN_FLASH) {
+                signature = block + 32 + 8;
+                continue;
+            }
+            memcpy(&flash[i * UF2_PAYLOAD_SIZE], block + 32, UF2_PAYLOAD_SIZE);
+            length += UF2_PAYLOAD_SIZE;
+            if (!two_pass) {
+                sha256_update(&ctx, block + 32, UF2_PAYLOAD_SIZE);
+            }
+        }
+        if (two_pass) {
+            sha256_update(&ctx, flash.data(), length);
+        }
+
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        sha256_final(&ctx, digest);
+        *valid = signature && secp256k1_ecdsa_verify(pubkey, digest, signature);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / kBenchRounds;
+}
+
+int bench(size_t kilobytes, uint32_t window) {
+    Result result;
+    uint8_t private_key[32];
+    uint8_t pubkey[33];
+    development_key(private_key, pubkey);
+
+    std::vector<uint8_t> image(kilobytes * 1024);
+    std::mt19937_64 rng(0x0F2);
+    for (uint8_t &byte : image) {
+        byte = (uint8_t)rng();
+    }
+    std::vector<uint8_t> uf2 = make_signed_uf2(image, private_key);
+    size_t blocks = uf2.size() / UF2_BLOCK_SIZE;
+    printf("UF2: %zu byte image, %zu blocks, reorder window %u\n", image.size(), blocks, window);
+
+    // Signature block is the last one in the file
+    std::vector<size_t> signature_first(blocks);
+    std::iota(signature_first.begin() + 1, signature_first.end(), 0);
+    signature_first[0] = blocks - 1;
+
+    const struct {
+        const char *name;
+        std::vector<size_t> order;
+    } orders[] = {
+        { "file order", {} },
+        { "reversed runs", reversed_runs(blocks, window + 1) },
+        { "signature first", signature_first },
+    };
+    for (const auto &entry : orders) {
+        Uf2Result out;
+        bool ok = ingest_signed_uf2(uf2, entry.order, window, pubkey, &out);
+        printf("UF2: %-16s %s, %u reordered, furthest %u ahead\n", entry.name,
+               ok ? "staged" : out.error.c_str(), out.reordered, out.max_ahead);
+        check(result, ok && out.image == image, entry.name);
+    }
+
+    // Refusals
+    Uf2Result out;
+    std::vector<uint8_t> tampered = uf2;
+    tampered[(blocks / 2) * UF2_BLOCK_SIZE + 100] ^= 1;
+    check(result, !ingest_signed_uf2(tampered, {}, window, pubkey, &out) && out.error == "bad signature",
+          "changed byte refused");
+
+    uint8_t other_private[32];
+    uint8_t other_pubkey[33];
+    development_key(other_private, other_pubkey);
+    other_private[31] = 2;
+    check(result, !ingest_signed_uf2(make_signed_uf2(image, other_private), {}, window, pubkey, &out),
+          "other key refused");
+
+    std::vector<size_t> unsigned_order(blocks - 1);
+    std::iota(unsigned_order.begin(), unsigned_order.end(), 0);
+    std::vector<uint8_t> unsigned_uf2(uf2.begin(), uf2.end() - UF2_BLOCK_SIZE);
+    for (size_t i = 0; i < blocks - 1; i++) {
+        uint32_t count = (uint32_t)(blocks - 1);
+        memcpy(&unsigned_uf2[i * UF2_BLOCK_SIZE + 24], &count, 4);
+    }
+    check(result, !ingest_signed_uf2(unsigned_uf2, unsigned_order, window, pubkey, &out),
+          "unsigned image refused");
+
+    check(result, !ingest_signed_uf2(uf2, reversed_runs(blocks, window + 2), window, pubkey, &out) &&
+                  out.error == "block too far out of order",
+          "block beyond the window refused");
+
+    // Host writes block 3 again, after block 5; the image is unchanged
+    std::vector<uint8_t> rewritten(uf2.begin(), uf2.begin() + 6 * UF2_BLOCK_SIZE);
+    rewritten.insert(rewritten.end(), uf2.begin() + 3 * UF2_BLOCK_SIZE, uf2.begin() + 4 * UF2_BLOCK_SIZE);
+    rewritten.insert(rewritten.end(), uf2.begin() + 6 * UF2_BLOCK_SIZE, uf2.end());
+    bool ok = ingest_signed_uf2(rewritten, {}, window, pubkey, &out);
+    check(result, ok && out.duplicates == 1 && out.image == image, "rewritten block ignored");
+
+    // Single pass against two
+    bool one_valid = false;
+    bool two_valid = false;
+    double one_pass = time_ingest(uf2, pubkey, false, &one_valid);
+    double two_pass = time_ingest(uf2, pubkey, true, &two_valid);
+    printf("UF2: single pass %.2f ms, two-pass %.2f ms (%zu bytes read back) on this host\n",
+           one_pass * 1e3, two_pass * 1e3, image.size());
+    check(result, one_valid && two_valid, "both passes verify");
+
+    fprintf(stderr, "UF2: %zu checks, %zu failed\n", result.checks, result.failed);
+    return result.failed == 0 ? 0 : 1;
+}
+
+void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s sign IMAGE.bin KEYHEX OUT.uf2\n"
+            "       %s check FILE.uf2 PUBKEYHEX [--window N]\n"
+            "       %s bench [kilobytes] [--window N]\n",
+            argv0, argv0, argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<const char *> args;
+    uint32_t window = kDefaultWindow;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.empty() || window > UF2_STREAM_MAX_WINDOW) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string command = args[0];
+    if (command == "sign" && args.size() == 4) {
+        std::vector<uint8_t> image;
+        uint8_t private_key[32];
+        if (!read_file(args[1], &image)) {
+            return 1;
+        }
+        if (!parse_hex(args[2], private_key, sizeof(private_key)) || !secp256k1_scalar_is_valid(private_key)) {
+            fprintf(stderr, "UF2: bad private key\n");
+            return 2;
+        }
+        std::vector<uint8_t> uf2 = make_signed_uf2(image, private_key);
+        if (uf2.empty() || !write_file(args[3], uf2)) {
+            return 1;
+        }
+        printf("UF2: %s: %zu blocks, signed\n", args[3], uf2.size() / UF2_BLOCK_SIZE);
+        return 0;
+    }
+
+    if (command == "check" && args.size() == 3) {
+        std::vector<uint8_t> uf2;
+        uint8_t pubkey[33];
+        if (!read_file(args[1], &uf2)) {
+            return 1;
+        }
+        if (!parse_hex(args[2], pubkey, sizeof(pubkey))) {
+            fprintf(stderr, "UF2: bad public key\n");
+            return 2;
+        }
+        Uf2Result out;
+        bool ok = ingest_signed_uf2(uf2, {}, window, pubkey, &out);
+        printf("UF2: %s: %s, %zu image bytes\n", args[1], ok ? "valid" : out.error.c_str(), out.image.size());
+        return ok ? 0 : 1;
+    }
+
+    if (command == "bench" && args.size() <= 2) {
+        size_t kilobytes = args.size() > 1 ? strtoul(args[1], nullptr, 0) : 200;
+        if (kilobytes == 0 || kilobytes > 256) {
+            fprintf(stderr, "UF2: image must be 1 to 256 KB, the staging slot\n");
+            return 2;
+        }
+        return bench(kilobytes, window);
+    }
+
+    usage(argv[0]);
+    return 2;
+}
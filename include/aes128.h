@@ -0,0 +1,59 @@
+#ifndef AES128_H
+#define AES128_H
+
+// Portable AES-128 (FIPS 197) with CBC and CMAC (SP 800-38B), as the SE050
+// secure channel needs them. Kept free of SDK dependencies so the same
+// code builds for the firmware and for host-side tools. Byte-oriented
+// and table-light rather than fast: an SCP03 command costs a handful of
+// blocks.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AES128_KEY_SIZE 16
+#define AES128_BLOCK_SIZE 16
+
+typedef struct {
+    uint8_t round_keys[11][AES128_BLOCK_SIZE];
+    uint8_t cmac_k1[AES128_BLOCK_SIZE];     // CMAC subkey, derived once per key
+} aes128_ctx_t;
+
+void aes128_init(aes128_ctx_t *ctx, const uint8_t key[AES128_KEY_SIZE]);
+void aes128_encrypt_block(const aes128_ctx_t *ctx, const uint8_t in[AES128_BLOCK_SIZE],
+                          uint8_t out[AES128_BLOCK_SIZE]);
+void aes128_decrypt_block(const aes128_ctx_t *ctx, const uint8_t in[AES128_BLOCK_SIZE],
+                          uint8_t out[AES128_BLOCK_SIZE]);
+
+// CBC over whole blocks (len a multiple of 16); in and out may alias
+void aes128_cbc_encrypt(const aes128_ctx_t *ctx, const uint8_t iv[AES128_BLOCK_SIZE],
+                        const uint8_t *in, uint8_t *out, size_t len);
+void aes128_cbc_decrypt(const aes128_ctx_t *ctx, const uint8_t iv[AES128_BLOCK_SIZE],
+                        const uint8_t *in, uint8_t *out, size_t len);
+
+// CMAC over data fed in pieces
+typedef struct {
+    const aes128_ctx_t *cipher;
+    uint8_t state[AES128_BLOCK_SIZE];
+    uint8_t buffer[AES128_BLOCK_SIZE];
+    size_t buffer_len;
+} aes128_cmac_ctx_t;
+
+void aes128_cmac_init(aes128_cmac_ctx_t *ctx, const aes128_ctx_t *cipher);
+void aes128_cmac_update(aes128_cmac_ctx_t *ctx, const uint8_t *data, size_t len);
+void aes128_cmac_final(aes128_cmac_ctx_t *ctx, uint8_t mac[AES128_BLOCK_SIZE]);
+
+// One-shot helper
+void aes128_cmac(const aes128_ctx_t *cipher, const uint8_t *data, size_t len, uint8_t mac[AES128_BLOCK_SIZE]);
+
+// Blocks run through the cipher since boot, for cost accounting
+uint32_t aes128_block_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AES128_H
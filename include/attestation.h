@@ -0,0 +1,64 @@
+#ifndef ATTESTATION_H
+#define ATTESTATION_H
+
+// Challenge-response attestation: the stick signs a host challenge together
+// with what it claims about itself, so an auditor learns in one round trip
+// that it still holds the key behind its address and what state it is in.
+// Kept free of SDK dependencies so the same code builds for the firmware
+// and for host-side verifiers.
+//
+// The signed hash is SHA-256 over this 84-byte message, little-endian:
+//
+//   0   u32  magic "CSAT"
+//   4   u16  version (1)
+//   6   u8   tamper loop intact (0 or 1)
+//   7   u8   reserved (0)
+//   8   [32] host challenge
+//   40  u32  device serial
+//   44  u32  tamper events seen
+//   48  u32  device record commits (the state counter)
+//   52  [32] measured firmware image root
+//
+// The stick signs it with the wallet key. A sighash is a double SHA-256
+// over a transaction serialization, so a single SHA-256 over a message
+// starting "CSAT" cannot be replayed as a spend.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ATTESTATION_MAGIC 0x54415343    // "CSAT" read little-endian
+#define ATTESTATION_VERSION 1
+#define ATTESTATION_MESSAGE_SIZE 84
+#define ATTESTATION_CHALLENGE_SIZE 32
+#define ATTESTATION_SIGNATURE_SIZE 64
+
+typedef struct {
+    uint8_t challenge[ATTESTATION_CHALLENGE_SIZE];
+    uint32_t serial;
+    bool tamper_intact;
+    uint32_t tamper_count;
+    uint32_t state_counter;
+    uint8_t firmware_root[32];
+} attestation_claims_t;
+
+void attestation_encode(const attestation_claims_t *claims, uint8_t message[ATTESTATION_MESSAGE_SIZE]);
+
+// The hash the stick signs
+void attestation_digest(const attestation_claims_t *claims, uint8_t digest[32]);
+
+// True if signature is the key's signature over the claims. The caller
+// still has to check the claims (challenge, serial, firmware root) and
+// that pubkey is the one on record for the serial.
+bool attestation_verify(const attestation_claims_t *claims, const uint8_t pubkey[33],
+                        const uint8_t signature[ATTESTATION_SIGNATURE_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ATTESTATION_H
@@ -0,0 +1,60 @@
+#ifndef BITCOIN_ADDRESS_H
+#define BITCOIN_ADDRESS_H
+
+// Bitcoin address encodings (Base58Check, bech32/bech32m) and the
+// per-key address table. Portable, no SDK dependencies.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ADDRESS_FORMAT_P2WPKH = 0,      // Native segwit v0, bc1q...
+    ADDRESS_FORMAT_P2TR = 1,        // Taproot key path, bc1p...
+    ADDRESS_FORMAT_P2PKH = 2,       // Legacy, 1...
+    ADDRESS_FORMAT_COUNT
+} address_format_t;
+
+#define ADDRESS_FORMAT_DEFAULT ADDRESS_FORMAT_P2WPKH
+
+// Bump when the table layout or derivation changes; stale tables are
+// rebuilt from the public key
+#define ADDRESS_TABLE_VERSION 1
+
+// Mainnet lengths including the terminator
+#define ADDRESS_P2WPKH_LEN 43
+#define ADDRESS_P2TR_LEN 63
+#define ADDRESS_P2PKH_LEN 35
+
+// Every supported encoding of one key, derived once when the key is created
+typedef struct {
+    uint8_t version;
+    uint8_t format_mask;                // Bit per address_format_t that is present
+    char p2wpkh[ADDRESS_P2WPKH_LEN];
+    char p2tr[ADDRESS_P2TR_LEN];
+    char p2pkh[ADDRESS_P2PKH_LEN];
+} address_table_t;
+
+bool address_table_build(const uint8_t pubkey[33], address_table_t *table);
+const char *address_table_get(const address_table_t *table, address_format_t format);
+bool address_table_is_current(const address_table_t *table);
+
+const char *address_format_name(address_format_t format);
+bool address_format_parse(const char *name, address_format_t *format);
+
+// Encoders
+bool base58check_encode(uint8_t version, const uint8_t *payload, size_t payload_len,
+                        char *out, size_t out_len);
+bool segwit_address_encode(const char *hrp, uint8_t witness_version,
+                           const uint8_t *program, size_t program_len,
+                           char *out, size_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BITCOIN_ADDRESS_H
@@ -0,0 +1,42 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+// C entry points to the board profile chosen at build time (CASHSTICK_BOARD,
+// see hal/boards.hpp). Each is a single call into the profile's HAL parts,
+// which resolve to the SDK calls for that board's pins at compile time.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *board_name(void);
+
+// Status LED
+void board_led_init(void);
+void board_led_set(uint8_t r, uint8_t g, uint8_t b);
+
+// BOOT/TEST button (GPIO for wake interrupts)
+void board_button_init(void);
+bool board_button_pressed(void);
+unsigned board_button_gpio(void);
+
+// Tamper loop
+void board_tamper_init(void);
+bool board_tamper_loop_high(void);
+
+// SE050 bus; transfers return the byte count or a PICO_ERROR_ code
+void board_se050_bus_init(void);
+void board_se050_bus_restore_baudrate(void);
+unsigned board_se050_bus_recover(uint32_t half_clock_us);
+int board_se050_write(uint8_t addr, const uint8_t *data, size_t len, uint32_t timeout_us);
+int board_se050_read(uint8_t addr, uint8_t *data, size_t len, uint32_t timeout_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOARD_H
@@ -12,17 +12,150 @@
 #include "hardware/uart.h"
 #include "hardware/flash.h"
 #include "hardware/watchdog.h"
+#include "sha256.h"
+#include "hmac_drbg.h"
+#include "bitcoin_address.h"
+#include "attestation.h"
+#include "ram_functions.h"
+#include "board.h"
 
-// Hardware pin definitions from schematic
-#define LED_PIN 16              // RGB LED on GPIO16
-#define BUTTON_PIN 15           // BOOT/TEST button
-#define I2C_SDA_PIN 14          // SE050 I2C SDA
-#define I2C_SCL_PIN 15          // SE050 I2C SCL
-#define I2C_BAUDRATE 400000     // 400kHz I2C
+// Pins, the SE050 I2C instance and its clock come from the board profile
+// (hal/boards.hpp) through board.h
 
 // SE050 I2C address
 #define SE050_I2C_ADDR 0x48
 
+// SE050 transport limits (se050_i2c.c)
+#define SE050_I2C_MAX_ATTEMPTS 4
+#define SE050_I2C_BACKOFF_MS 2                  // Doubles with each retry
+#define SE050_I2C_TIMEOUT_US(len) (2000u + (uint32_t)(len) * 100u)
+#define SE050_I2C_HALF_CLOCK_US 5               // Bus recovery clocking, ~100 kHz
+
+#ifndef CASHSTICK_I2C_FAULT_INJECTION
+#define CASHSTICK_I2C_FAULT_INJECTION 0
+#endif
+
+// SE050 bus transcript ring (see i2c_trace.c); 0 leaves the recorder out
+#ifndef CASHSTICK_I2C_TRACE_SIZE
+#define CASHSTICK_I2C_TRACE_SIZE 4096
+#endif
+#define I2C_TRACE_MAX_DATA 255          // Bytes kept per transfer
+
+#if CASHSTICK_I2C_TRACE_SIZE > 0 && CASHSTICK_I2C_TRACE_SIZE < 512
+#error "CASHSTICK_I2C_TRACE_SIZE must hold at least one full-length record"
+#endif
+
+// Watchdog - the main loop feeds it on every wakeup, and a repeating alarm
+// guarantees a wakeup at least every service interval while idle
+#define WATCHDOG_TIMEOUT_MS 8000
+#define WATCHDOG_SERVICE_INTERVAL_MS 4000
+
+// Idle-time scrub of the two device record copies (see flash_storage.c)
+#ifndef FLASH_SCRUB_INTERVAL_MS
+#define FLASH_SCRUB_INTERVAL_MS 60000
+#endif
+
+// Dormant mode while the USB bus is suspended (opt-in, see power_management.c)
+#ifndef CASHSTICK_DORMANT_ON_USB_SUSPEND
+#define CASHSTICK_DORMANT_ON_USB_SUSPEND 0
+#endif
+
+// Power management wake events
+#define POWER_EVENT_BUTTON  (1u << 0)   // BOOT/TEST button pressed
+#define POWER_EVENT_USB     (1u << 1)   // USB controller activity
+#define POWER_EVENT_ALARM   (1u << 2)   // Watchdog service alarm
+#define POWER_EVENT_KEY_POOL (1u << 3)  // Background keygen step due
+
+// Pre-generated key pool - spare keypairs kept ready in SE050 object slots
+#ifndef CASHSTICK_KEY_POOL_DEPTH
+#define CASHSTICK_KEY_POOL_DEPTH 2
+#endif
+#define KEY_POOL_MAX_SLOTS 8
+#define KEY_POOL_BASE_OBJECT_ID 0x0010
+#define SE050_KEYGEN_TIME_MS 2000       // Worst-case on-chip keygen time
+#define SE050_RANDOM_CHUNK 64           // Max TRNG bytes per request
+
+// On-device DRBG seeded from the SE050 TRNG (see entropy.c)
+#ifndef CASHSTICK_DRBG_RESEED_INTERVAL
+#define CASHSTICK_DRBG_RESEED_INTERVAL 4096     // Generate calls between reseeds
+#endif
+#define ENTROPY_RESEED_PERIOD_MS (10 * 60 * 1000)  // Time-based reseed of core 0
+
+// Measured boot - Merkle tree over 4 KB flash chunks (see measured_boot.c)
+#define MEASURE_CHUNK_SIZE 4096
+#define MEASURE_MAX_IMAGE_CHUNKS 64     // FLASH_TARGET_OFFSET / MEASURE_CHUNK_SIZE
+#define MEASURE_DATA_CHUNKS 4           // Keys, state, seal and key pool sectors
+#define MEASURE_MAX_LEAVES (MEASURE_MAX_IMAGE_CHUNKS + MEASURE_DATA_CHUNKS)
+
+// Bulk flash digests - tree hash leaves split across both cores (see
+// bulk_digest.c). 0 keeps every job on core 0.
+#ifndef CASHSTICK_DUAL_CORE_DIGEST
+#define CASHSTICK_DUAL_CORE_DIGEST 1
+#endif
+#define BULK_DIGEST_CHUNK_SIZE MEASURE_CHUNK_SIZE
+#define BULK_DIGEST_PREFETCH_SIZE 512   // DMA piece; two buffers per core
+
+// Latency histograms (see metrics.c): bucket 0 is 0 us, bucket b covers
+// [2^(b-1), 2^b) us and the last bucket everything from 2^(N-2) us up
+#define METRIC_BUCKETS 24
+
+// Scratch arena for transient operation buffers (see memory.c). Sized for
+// the measured-boot working set, the largest user.
+#ifndef CASHSTICK_SCRATCH_SIZE
+#define CASHSTICK_SCRATCH_SIZE 8192
+#endif
+
+// RAM overlay for host writes to the mass-storage volume (see
+// usb_msc_disk.c), in 512-byte sectors. 0 keeps the volume read-only.
+#ifndef CASHSTICK_MSC_OVERLAY_SECTORS
+#define CASHSTICK_MSC_OVERLAY_SECTORS 16
+#endif
+
+// Signed UF2 images in update mode (see firmware_update.c): blocks the
+// host may write ahead of the next one in address order, 256 bytes of
+// RAM each, 1 to 32
+#ifndef CASHSTICK_UF2_REORDER_WINDOW
+#define CASHSTICK_UF2_REORDER_WINDOW 8
+#endif
+
+// Compressed secp256k1 key whose signature an update (UF2 image or delta
+// patch) must carry, set with CASHSTICK_VENDOR_PUBKEY in CMake. A
+// development build may opt into the development key instead with
+// CASHSTICK_DEV_SIGNING_KEY: its private key is 1, so anyone can sign,
+// and STATUS and INFO.TXT say so.
+#ifndef CASHSTICK_DEV_SIGNING_KEY
+#define CASHSTICK_DEV_SIGNING_KEY 0
+#endif
+#if CASHSTICK_DEV_SIGNING_KEY
+#ifdef CASHSTICK_VENDOR_PUBKEY
+#error "CASHSTICK_DEV_SIGNING_KEY and CASHSTICK_VENDOR_PUBKEY are both set"
+#endif
+#define CASHSTICK_VENDOR_PUBKEY { \
+    0x02, 0x79, 0xBE, 0x66, 0x7E, 0xF9, 0xDC, 0xBB, 0xAC, 0x55, 0xA0, 0x62, 0x95, 0xCE, 0x87, 0x0B, 0x07, \
+    0x02, 0x9B, 0xFC, 0xDB, 0x2D, 0xCE, 0x28, 0xD9, 0x59, 0xF2, 0x81, 0x5B, 0x16, 0xF8, 0x17, 0x98 }
+#endif
+
+// Open the SE050 secure channel with the public GlobalPlatform test keys
+// rather than SE050_SCP03_KEY_ENC/_MAC/_DEK (see se050_interface.c). For
+// development builds only; STATUS and INFO.TXT say so.
+#ifndef CASHSTICK_DEV_SCP03_KEYS
+#define CASHSTICK_DEV_SCP03_KEYS 0
+#endif
+
+// Bind the firmware image root into the tamper seal. Off by default: with
+// it on, installing new firmware breaks the seal and reveals the keys.
+#ifndef CASHSTICK_SEAL_BIND_MEASUREMENT
+#define CASHSTICK_SEAL_BIND_MEASUREMENT 0
+#endif
+
+#if CASHSTICK_UF2_REORDER_WINDOW < 1 || CASHSTICK_UF2_REORDER_WINDOW > 32
+#error "CASHSTICK_UF2_REORDER_WINDOW must be 1 to 32 blocks"
+#endif
+
+#if CASHSTICK_KEY_POOL_DEPTH < 1 || CASHSTICK_KEY_POOL_DEPTH >= KEY_POOL_MAX_SLOTS
+#error "CASHSTICK_KEY_POOL_DEPTH must leave at least one slot for the wallet key"
+#endif
+
 // LED States
 typedef enum {
     LED_STATE_NEW = 0,      // Blue - Device is new/uninitialized
@@ -45,18 +178,235 @@ typedef enum {
     SE050_CMD_GENERATE_KEYPAIR = 0x02,
     SE050_CMD_SIGN_HASH = 0x03,
     SE050_CMD_GET_PUBKEY = 0x04,
-    SE050_CMD_SET_TAMPER_CONFIG = 0x05
+    SE050_CMD_SET_TAMPER_CONFIG = 0x05,
+    SE050_CMD_GET_TAMPER_STATUS = 0x06,
+    SE050_CMD_DELETE_OBJECT = 0x07,
+    SE050_CMD_GET_RANDOM = 0x08,
+    SE050_CMD_COMPUTE_SEAL = 0x09
 } se050_cmd_t;
 
 // Bitcoin key structure
 typedef struct {
     uint8_t private_key[32];
     uint8_t public_key[33];
-    char address[42];        // Bitcoin address string
+    address_table_t addresses;  // Every address encoding, derived once at keygen
     bool is_sealed;
     bool keys_revealed;      // True when tamper seal broken and keys exposed
+    uint16_t key_object_id;  // SE050 object slot holding the private key
 } bitcoin_keys_t;
 
+// Device lifecycle events (see device_state.c for the transition table)
+typedef enum {
+    DEVICE_EVENT_KEYS_CREATED = 0,   // Wallet key claimed and the device sealed
+    DEVICE_EVENT_KEYS_REFRESHED,     // Derived key data rebuilt, same key
+    DEVICE_EVENT_TAMPER_DETECTED,    // Integrity check failed
+    DEVICE_EVENT_FACTORY_RESET,      // Long BOOT press
+    DEVICE_EVENT_COUNT
+} device_event_t;
+
+// Keys, state and seal are one flash record, so a transition is one erase
+typedef struct {
+    bitcoin_keys_t keys;
+    device_state_t state;
+    uint8_t seal[32];       // Tamper seal MAC, all zero until sealed
+} device_record_t;
+
+// Key pool slot states (persisted)
+typedef enum {
+    KEY_SLOT_EMPTY = 0,     // Free, will be (re)generated in the background
+    KEY_SLOT_READY = 1,     // Keypair generated and unclaimed
+    KEY_SLOT_CLAIMED = 2    // In use as the wallet key
+} key_slot_status_t;
+
+typedef struct {
+    uint8_t status;
+    uint8_t public_key[33];
+} key_pool_slot_t;
+
+typedef struct {
+    key_pool_slot_t slots[KEY_POOL_MAX_SLOTS];  // Slot i is object KEY_POOL_BASE_OBJECT_ID + i
+} key_pool_t;
+
+// SE050 transport counters
+typedef struct {
+    uint32_t transfers;         // Individual reads and writes attempted
+    uint32_t timeouts;
+    uint32_t retries;
+    uint32_t recoveries;        // Bus recovery sequences run
+    uint32_t failures;          // Commands that failed after all attempts
+    uint32_t max_latency_us;    // Slowest successful exchange
+} i2c_stats_t;
+
+// SE050 secure channel (SCP03) counters
+typedef struct {
+    uint32_t handshakes;        // Full handshakes, each deriving session keys
+    uint32_t resumed;           // Boots that carried on with the last session
+    uint32_t rewinds;           // Commands never delivered, session rolled back
+    uint32_t lost_replies;      // Delivered commands whose reply was lost
+    uint32_t rejected;          // Dropped by the SE050, or reply MAC bad
+} se050_session_stats_t;
+
+// Mass-storage write overlay counters since boot
+typedef struct {
+    uint32_t capacity;          // Sectors
+    uint32_t used;
+    uint32_t writes;            // Sectors written by the host
+    uint32_t read_hits;         // Sectors read back from the overlay
+    uint32_t evictions;
+    uint32_t pinned_evictions;  // Of those, FAT or directory sectors
+    uint32_t discards;          // Overlay dropped on eject, unmount or refresh
+} usb_msc_overlay_stats_t;
+
+// One SE050 bus transaction in the transcript
+typedef enum {
+    I2C_TRACE_WRITE = 0,
+    I2C_TRACE_READ = 1,
+    I2C_TRACE_RECOVER = 2       // Bus recovery sequence, no data
+} i2c_trace_op_t;
+
+typedef struct {
+    uint32_t start_us;
+    uint32_t duration_us;
+    uint32_t gap_us;            // Since the previous transaction ended
+    uint16_t len;               // Bytes requested
+    int16_t result;             // Bytes transferred or a PICO_ERROR_ code
+    i2c_trace_op_t op;
+    uint8_t stored;             // Bytes kept, up to I2C_TRACE_MAX_DATA
+} i2c_trace_record_t;
+
+typedef struct {
+    bool recording;
+    uint32_t records;
+    uint32_t used;
+    uint32_t size;
+    uint32_t dropped;           // Overwritten before they were read
+} i2c_trace_stats_t;
+
+// Measured boot cache - per-chunk fast CRC and leaf hash from the last boot
+typedef struct {
+    uint32_t generation;                // Bumped whenever a leaf changes
+    uint32_t image_len;
+    uint32_t leaf_count;
+    uint32_t leaf_crc[MEASURE_MAX_LEAVES];
+    uint8_t leaf_hash[MEASURE_MAX_LEAVES][SHA256_DIGEST_SIZE];
+} measure_cache_t;
+
+typedef struct {
+    uint8_t root[SHA256_DIGEST_SIZE];       // Image and data region together
+    uint8_t image_root[SHA256_DIGEST_SIZE];
+    uint8_t data_root[SHA256_DIGEST_SIZE];
+    uint32_t generation;
+    uint32_t leaf_count;
+    uint32_t rehashed;                  // Leaves re-hashed this boot
+    uint32_t boot_us;                   // Time spent measuring
+} measurement_t;
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t elapsed_us;
+    uint32_t leaves[2];                 // Hashed by each core
+} bulk_digest_stats_t;
+
+// Monotonic counter kept as cleared bits in a pair of flash sectors.
+// Sector offsets are relative to FLASH_TARGET_OFFSET.
+typedef struct {
+    uint32_t sector_offset[2];
+} flash_counter_t;
+
+// Operations with a counter and latency histogram
+typedef enum {
+    METRIC_SE050_CMD = 0,       // Command/response exchange incl. retries
+    METRIC_I2C_TRANSFER,        // Single I2C read or write
+    METRIC_FLASH_ERASE,         // One 4 KB sector
+    METRIC_FLASH_PROGRAM,       // One program call (one or more pages)
+    METRIC_TAMPER_CHECK,
+    METRIC_USB_REQUEST,         // Command line in to reply out
+    METRIC_BOOT_MEASURE,
+    METRIC_BOOT_SE050,          // SE050 init and DRBG seeding
+    METRIC_BOOT_TAMPER,
+    METRIC_BOOT_TOTAL,          // Reset to end of system_init
+    METRIC_FLASH_SCRUB,         // Device record copy checked while idle
+    METRIC_FLASH_REPAIR,        // Copy rewritten from the other one
+    METRIC_ATTEST,              // Claims gathered and signed
+    METRIC_SCP03_HANDSHAKE,     // Secure channel opened, key derivation included
+    METRIC_SCP03_CRYPTO,        // Wrap and unwrap of one command, no bus time
+    METRIC_COUNT
+} metric_id_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t buckets[METRIC_BUCKETS];
+} metric_snapshot_t;
+
+// Stack high-water marks (per core) and scratch arena usage, in bytes
+typedef struct {
+    uint32_t stack_size[2];
+    uint32_t stack_used[2];     // Deepest point reached since boot
+    uint32_t scratch_size;
+    uint32_t scratch_used;
+    uint32_t scratch_peak;
+    uint32_t scratch_failures;  // Allocations refused
+} memory_stats_t;
+
+// Firmware update staged from a delta patch or a signed UF2 (see
+// firmware_update.c)
+typedef enum {
+    UPDATE_IDLE = 0,
+    UPDATE_RECEIVING,       // Patch or UF2 streaming into the staging slot
+    UPDATE_STAGED,          // Verified image waiting to be installed
+    UPDATE_FAILED
+} update_state_t;
+
+typedef struct {
+    update_state_t state;
+    uint32_t received;          // Patch (or UF2) bytes so far
+    uint32_t written;           // Image bytes programmed into the slot
+    uint32_t target_len;
+    uint32_t sectors_erased;
+    uint32_t elapsed_us;        // Since the first patch byte
+    const char *error;          // Why the last patch failed, or NULL
+    bool from_uf2;              // Dropped on the drive rather than sent over UPDATE
+    uint32_t reordered;         // UF2 blocks that arrived early and waited
+    uint32_t verify_us;         // Vendor signature check
+} update_status_t;
+
+// Custody journal events (see journal.c); at most 15
+typedef enum {
+    JOURNAL_EVENT_BOOT = 0,         // arg: 1 after a watchdog reset
+    JOURNAL_EVENT_TEST_PRESS,
+    JOURNAL_EVENT_TAMPER_CHECK,     // arg: 1 intact, 0 broken; on change only
+    JOURNAL_EVENT_USB_CONNECT,
+    JOURNAL_EVENT_SIGN,             // arg: first 4 bytes of the signed hash
+    JOURNAL_EVENT_STATE,            // arg: new device_state_t
+    JOURNAL_EVENT_COUNT
+} journal_event_t;
+
+typedef struct {
+    uint32_t boot;              // Boot number, counted by the journal
+    uint32_t time_ms;           // Since that boot's reset
+    journal_event_t event;
+    uint32_t arg;
+} journal_entry_t;
+
+// Read position; journal_next() decodes straight from flash
+typedef struct {
+    uint32_t sequence;          // Segment
+    uint32_t offset;            // Next record within it
+    uint32_t boot;
+    uint32_t time_ms;
+} journal_cursor_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t segments;
+    uint32_t active_used;       // Bytes of the segment being appended to
+    uint32_t boot;
+    uint32_t reclaimed;         // Segments erased to make room, ever
+} journal_stats_t;
+
 // Tamper detection structure
 typedef struct {
     bool is_intact;
@@ -64,6 +414,51 @@ typedef struct {
     uint32_t last_check_time;
 } tamper_status_t;
 
+// Result of one-shot provisioning (PROVISION command); times in us
+typedef struct {
+    const char *failed_stage;   // NULL on success
+    bool from_pool;             // Key was pre-generated in the background
+    bool self_test_passed;
+    uint32_t keygen_us;         // Claim or generate, plus address derivation
+    uint32_t seal_us;
+    uint32_t commit_us;
+    uint32_t self_test_us;
+    uint32_t total_us;
+    uint32_t flash_commits;
+} provision_result_t;
+
+// Signed attestation (ATTEST command); times in us
+typedef struct {
+    attestation_claims_t claims;
+    uint8_t signature[ATTESTATION_SIGNATURE_SIZE];
+    uint32_t claims_us;         // Tamper check and state gathered
+    uint32_t sign_us;           // SE050 signature
+} attestation_result_t;
+
+// Clock governor operating points
+typedef enum {
+    CLOCK_OP_IDLE = 0,      // 48 MHz from PLL_USB, PLL_SYS stopped
+    CLOCK_OP_NOMINAL = 1,   // 125 MHz SDK default
+    CLOCK_OP_BOOST = 2,     // 200 MHz at raised core voltage
+    CLOCK_OP_COUNT
+} clock_op_t;
+
+// USB command transports
+typedef enum {
+    USB_TRANSPORT_CDC = 0,
+    USB_TRANSPORT_HID = 1
+} usb_transport_t;
+
+// Idle wakeup accounting
+typedef struct {
+    uint32_t wakeups;           // Total returns from WFI/dormant
+    uint32_t wakeups_per_hour;  // Average since power_init
+    uint32_t button_events;
+    uint32_t usb_events;
+    uint32_t alarm_events;
+    uint32_t dormant_entries;
+} power_stats_t;
+
 // Function declarations
 
 // LED Control
@@ -72,18 +467,83 @@ void led_set_state(led_state_t state);
 void led_set_rgb(uint8_t r, uint8_t g, uint8_t b);
 void led_blink(led_state_t state, uint16_t duration_ms);
 
+// SE050 I2C Transport
+void se050_i2c_init(void);
+int se050_i2c_write(const uint8_t *data, size_t len);
+int se050_i2c_read(uint8_t *data, size_t len);
+bool se050_i2c_send(const uint8_t *cmd, size_t cmd_len);
+bool se050_i2c_receive(uint8_t *resp, size_t resp_len);
+bool se050_i2c_exchange(const uint8_t *cmd, size_t cmd_len, uint8_t *resp, size_t resp_len,
+                        uint32_t wait_ms, bool *delivered);
+bool se050_i2c_transceive(const uint8_t *cmd, size_t cmd_len,
+                          uint8_t *resp, size_t resp_len, uint32_t wait_ms);
+void se050_i2c_bus_recover(void);
+void se050_i2c_get_stats(i2c_stats_t *stats);
+#if CASHSTICK_I2C_FAULT_INJECTION
+void se050_i2c_inject_faults(uint32_t permille);
+#endif
+
+// SE050 Bus Transcript
+#if CASHSTICK_I2C_TRACE_SIZE > 0
+void i2c_trace_enable(bool on);
+void i2c_trace_clear(void);
+void i2c_trace_record(i2c_trace_op_t op, const uint8_t *data, size_t len, int result, uint32_t start_us);
+size_t i2c_trace_peek(void);
+bool i2c_trace_pop(i2c_trace_record_t *record, uint8_t data[I2C_TRACE_MAX_DATA]);
+void i2c_trace_get_stats(i2c_trace_stats_t *stats);
+#else
+static inline void i2c_trace_record(i2c_trace_op_t op, const uint8_t *data, size_t len,
+                                    int result, uint32_t start_us) {}
+#endif
+
 // SE050 Interface
 bool se050_init(void);
+bool se050_open_session(void);
+bool se050_command(const uint8_t header[4], const uint8_t *data, size_t len,
+                   uint8_t *resp, size_t resp_len, uint32_t wait_ms);
+void se050_get_session_stats(se050_session_stats_t *stats);
 bool se050_generate_bitcoin_keys(bitcoin_keys_t *keys);
-bool se050_sign_transaction(const uint8_t *hash, uint8_t *signature);
+bool se050_keygen_begin(uint16_t object_id);
+uint32_t se050_keygen_remaining_ms(void);
+bool se050_keygen_collect(uint16_t *object_id, uint8_t *public_key);
+bool se050_delete_key(uint16_t object_id);
+void se050_wait_idle(void);
+bool se050_sign_transaction(uint16_t key_id, const uint8_t *hash, uint8_t *signature);
 bool se050_get_device_info(uint8_t *info, size_t *info_len);
 bool se050_configure_tamper_detection(void);
+bool se050_get_random(uint8_t *out, size_t len);
+bool se050_compute_seal(const uint8_t *context, uint8_t *seal);
+
+// Bulk Digests
+bool bulk_digest_leaves(const uint32_t *flash_offsets, uint32_t count, uint8_t (*leaves)[SHA256_DIGEST_SIZE],
+                        bool dual_core, bulk_digest_stats_t *stats);
+bool bulk_digest_flash(uint32_t flash_offset, uint32_t len, uint8_t root[SHA256_DIGEST_SIZE],
+                       bool dual_core, bulk_digest_stats_t *stats);
+
+// Measured Boot
+bool measured_boot_run(void);
+const measurement_t *measured_boot_get(void);
+
+// Entropy (per-core HMAC-DRBG)
+bool entropy_init(void);
+void entropy_service(void);
+bool entropy_random(uint8_t *out, size_t len);
 
 // USB Handler
 void usb_init(void);
+void usb_lock(void);
+void usb_unlock(void);
 void usb_handle_commands(void);
 void usb_mass_storage_mode(void);
 bool usb_is_connected(void);
+bool usb_is_mass_storage_mode(void);
+void usb_send_response(const char *response);
+void usb_send_device_status(void);
+void usb_create_virtual_filesystem(void);
+void usb_create_key_reveal_files(const bitcoin_keys_t *keys);
+void usb_msc_discard_overlay(void);
+void usb_msc_get_overlay_stats(usb_msc_overlay_stats_t *stats);
+uint32_t get_device_serial(void);
 
 // Button Handler
 void button_init(void);
@@ -93,16 +553,110 @@ void button_handle_test_mode(void);
 
 // Bitcoin Wallet Functions
 bool wallet_generate_new_keys(void);
-bool wallet_get_address(char *address_out, size_t max_len);
+bool wallet_provision(provision_result_t *result);
+bool wallet_get_address(address_format_t format, char *address_out, size_t max_len);
 bool wallet_export_public_key(uint8_t *pubkey_out);
 bool wallet_reveal_private_key(uint8_t *privkey_out);
 bool wallet_are_keys_revealed(void);
+bool wallet_is_initialized(void);
+bool wallet_attest(const uint8_t challenge[ATTESTATION_CHALLENGE_SIZE], attestation_result_t *result);
+void wallet_get_status(char *status_json, size_t max_len);
+
+// Key Pool
+void key_pool_init(void);
+void key_pool_service(void);
+bool key_pool_claim(bitcoin_keys_t *keys);
+void key_pool_release(uint16_t object_id);
+uint32_t key_pool_ready_count(void);
+uint32_t key_pool_depth(void);
+
+// Device State Machine
+void device_state_init(void);
+device_state_t device_state_get(void);
+const bitcoin_keys_t *device_state_keys(void);
+bool device_state_dispatch(device_event_t event, const bitcoin_keys_t *keys);
+void device_state_stage_seal(const uint8_t seal[32]);
+const uint8_t *device_state_seal(void);
+uint32_t device_state_commit_count(void);
 
 // Tamper Detection
 bool tamper_init(void);
 tamper_status_t tamper_check_integrity(void);
-void tamper_seal_device(void);
+bool tamper_seal_device(void);
+bool tamper_self_test(void);
 bool tamper_is_device_compromised(void);
+void tamper_reveal_keys_to_filesystem(void);
+
+// Power Management
+void power_init(void);
+void power_signal_event(uint32_t events);
+uint32_t power_wait_for_event(void);
+void power_set_usb_suspended(bool suspended);
+void power_get_stats(power_stats_t *stats);
+
+// Clock Governor
+void clock_governor_init(void);
+void clock_governor_set_op(clock_op_t op);
+clock_op_t clock_governor_get_op(void);
+void clock_governor_enter_idle(void);
+void clock_governor_exit_idle(void);
+void clock_boost_begin(void);
+void clock_boost_end(void);
+uint32_t clock_governor_op_khz(clock_op_t op);
+const char *clock_governor_op_name(clock_op_t op);
+uint32_t clock_governor_estimate_energy_uj(clock_op_t op, uint32_t elapsed_us);
+uint32_t clock_governor_get_switch_count(void);
+
+// Metrics
+void metrics_record(metric_id_t id, uint32_t elapsed_us, bool ok);
+void metrics_snapshot(metric_id_t id, metric_snapshot_t *out);
+void metrics_reset(void);
+const char *metrics_name(metric_id_t id);
+
+static inline uint32_t metrics_start(void) {
+    return time_us_32();
+}
+
+static inline void metrics_end(metric_id_t id, uint32_t start_us, bool ok) {
+    metrics_record(id, time_us_32() - start_us, ok);
+}
+
+// Memory Budget
+void memory_init(void);
+void memory_get_stats(memory_stats_t *stats);
+void *scratch_alloc(size_t size);
+size_t scratch_mark(void);
+void scratch_release(size_t mark);
+
+// Firmware Update
+void update_init(void);
+bool update_begin(void);
+bool update_write(const uint8_t *data, size_t len);
+bool update_finish(void);
+void update_abort(void);
+void update_install(void);
+void update_get_status(update_status_t *status);
+bool update_hold(void);
+void update_release(void);
+bool update_uf2_block(const uint8_t *block);
+void update_uf2_reset(void);
+void update_service(void);
+
+// Custody Journal
+bool journal_init(void);
+bool journal_append(journal_event_t event, uint32_t arg);
+bool journal_cursor_at(journal_cursor_t *cursor, uint32_t position);
+bool journal_next(journal_cursor_t *cursor, journal_entry_t *entry);
+uint32_t journal_position(const journal_cursor_t *cursor);
+void journal_get_stats(journal_stats_t *stats);
+
+// Benchmarks (built with CASHSTICK_BENCHMARKS)
+void benchmark_run_all(void);
+
+// Sampling profiler (built with CASHSTICK_BENCHMARKS)
+void profiler_start(uint32_t period_us);
+void profiler_stop(void);
+void profiler_dump(void);
 
 // Utility Functions
 void system_init(void);
@@ -111,9 +665,18 @@ uint32_t get_system_time_ms(void);
 void delay_ms(uint32_t ms);
 
 // Flash Storage Functions
-bool flash_write_keys(const bitcoin_keys_t *keys);
-bool flash_read_keys(bitcoin_keys_t *keys);
-bool flash_write_device_state(device_state_t state);
-device_state_t flash_read_device_state(void);
+bool flash_write_device_record(const device_record_t *record);
+bool flash_read_device_record(device_record_t *record);
+bool flash_write_key_pool(const key_pool_t *pool);
+bool flash_read_key_pool(key_pool_t *pool);
+bool flash_write_measure_cache(const measure_cache_t *cache);
+bool flash_read_measure_cache(measure_cache_t *cache);
+uint32_t flash_crc32(uint32_t flash_offset, size_t len);
+void flash_scrub_service(void);
+
+// Flash Counters
+bool flash_counter_init(const flash_counter_t *counter);
+uint32_t flash_counter_read(const flash_counter_t *counter);
+bool flash_counter_increment(const flash_counter_t *counter);
 
 #endif // CASHSTICK_H
\ No newline at end of file
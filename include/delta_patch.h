@@ -0,0 +1,99 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+// Streaming decoder for delta firmware patches. Kept free of SDK
+// dependencies so the same code builds for the firmware and for
+// host-side tools.
+//
+// A patch rebuilds a target image from a source image (the one already
+// installed). It is a 144-byte header followed by a stream of operations
+// that together produce exactly target_len bytes, in order:
+//
+//   0x01 COPY    zigzag varint source delta, varint length
+//                Copy from the source, starting delta bytes after where
+//                the previous COPY ended (the first starts from 0)
+//   0x02 INSERT  varint length, then that many literal bytes
+//
+// Varints are unsigned LEB128, at most 5 bytes. Header, little-endian:
+//
+//   0   u32  magic "CSDP"
+//   4   u16  version (2)
+//   6   u16  flags (0)
+//   8   u32  source_len      0: the patch carries the whole image
+//   12  u32  target_len
+//   16  [32] SHA-256 of the source image
+//   48  [32] SHA-256 of the target image
+//   80  [64] ECDSA r || s by the vendor key over the target SHA-256
+//
+// The signature is over the same digest as a signed UF2's, so one signed
+// digest vouches for an image whichever way it is delivered. The digest
+// covers target_len bytes exactly, so it commits to the length too. The
+// decoder only carries the signature; checking it against the rebuilt
+// image is left to the caller.
+//
+// The decoder holds a few words of state; patch bytes can be fed in
+// pieces of any size.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DELTA_PATCH_MAGIC 0x50445343    // "CSDP" read little-endian
+#define DELTA_PATCH_VERSION 2
+#define DELTA_PATCH_HEADER_SIZE 144
+#define DELTA_PATCH_SIGNATURE_SIZE 64
+#define DELTA_PATCH_OP_COPY 0x01
+#define DELTA_PATCH_OP_INSERT 0x02
+
+typedef struct {
+    uint32_t source_len;
+    uint32_t target_len;
+    uint8_t source_hash[32];
+    uint8_t target_hash[32];
+    uint8_t signature[DELTA_PATCH_SIGNATURE_SIZE];
+} delta_patch_header_t;
+
+typedef struct {
+    // Source image, addressable in place (XIP-mapped flash on the device)
+    const uint8_t *source;
+    uint32_t source_len;
+
+    // Called once the header is in; returning false stops the patch
+    bool (*header)(void *user, const delta_patch_header_t *header);
+    // Target bytes, in order; returning false stops the patch
+    bool (*output)(void *user, const uint8_t *data, size_t len);
+    void *user;
+
+    // Decoder state
+    delta_patch_header_t info;
+    uint8_t header_buf[DELTA_PATCH_HEADER_SIZE];
+    uint32_t header_len;
+    uint32_t produced;
+    uint32_t copy_start;
+    uint32_t copy_end;
+    uint32_t varint;
+    uint8_t varint_shift;
+    uint8_t state;
+    uint8_t op;
+    const char *error;      // Set when delta_patch_feed() fails
+} delta_patch_t;
+
+// Set up a decoder; fill in source, callbacks and user first
+void delta_patch_init(delta_patch_t *patch);
+
+// Feed the next piece of the patch. False on a malformed patch or when a
+// callback refused; patch->error says why and further feeds fail too.
+bool delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len);
+
+// True once the whole target has been produced
+bool delta_patch_done(const delta_patch_t *patch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DELTA_PATCH_H
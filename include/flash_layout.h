@@ -0,0 +1,42 @@
+#ifndef FLASH_LAYOUT_H
+#define FLASH_LAYOUT_H
+
+// Flash memory layout. Firmware occupies the first FLASH_TARGET_OFFSET
+// bytes; persistent records live in 4 KB sectors after it.
+
+#define FLASH_TARGET_OFFSET (256 * 1024)  // 256KB offset for user data
+
+#ifndef FLASH_SECTOR_SIZE
+#define FLASH_SECTOR_SIZE 4096
+#endif
+
+// Record sectors, relative to FLASH_TARGET_OFFSET
+#define KEYS_SECTOR_OFFSET 0          // Device record: keys, state, seal
+#define STATE_SECTOR_OFFSET 4096      // Legacy state record, read to migrate
+#define KEYS_MIRROR_SECTOR_OFFSET STATE_SECTOR_OFFSET  // Then the second copy of the device record
+#define SEAL_SECTOR_OFFSET 8192       // Legacy seal record, read to migrate
+#define KEY_POOL_SECTOR_OFFSET 12288
+#define MEASURE_SECTOR_OFFSET 16384
+#define TAMPER_COUNTER_A_SECTOR_OFFSET 20480   // Bit-clearing counter, two
+#define TAMPER_COUNTER_B_SECTOR_OFFSET 24576   // sectors for atomic rollover
+#define UPDATE_MARKER_SECTOR_OFFSET 28672      // Staged firmware update marker
+#define JOURNAL_SECTOR_OFFSET 32768            // Custody journal, a ring of
+#define JOURNAL_SECTORS 8                      // one-sector segments
+
+// Firmware update staging slot, one image long
+#define UPDATE_SLOT_SECTOR_OFFSET 65536
+#define UPDATE_SLOT_SIZE FLASH_TARGET_OFFSET
+
+// Calculate flash addresses
+#define KEYS_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + KEYS_SECTOR_OFFSET)
+#define STATE_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + STATE_SECTOR_OFFSET)
+#define SEAL_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + SEAL_SECTOR_OFFSET)
+#define KEY_POOL_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + KEY_POOL_SECTOR_OFFSET)
+#define MEASURE_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + MEASURE_SECTOR_OFFSET)
+#define TAMPER_COUNTER_A_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + TAMPER_COUNTER_A_SECTOR_OFFSET)
+#define TAMPER_COUNTER_B_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + TAMPER_COUNTER_B_SECTOR_OFFSET)
+#define UPDATE_MARKER_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + UPDATE_MARKER_SECTOR_OFFSET)
+#define JOURNAL_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + JOURNAL_SECTOR_OFFSET)
+#define UPDATE_SLOT_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + UPDATE_SLOT_SECTOR_OFFSET)
+
+#endif // FLASH_LAYOUT_H
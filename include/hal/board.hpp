@@ -0,0 +1,31 @@
+#ifndef CASHSTICK_HAL_BOARD_HPP
+#define CASHSTICK_HAL_BOARD_HPP
+
+// The board this build is for: the CASHSTICK_BOARD profile over the
+// RP2040 backend, or over the simulator when CASHSTICK_HAL_SIM is set
+
+#include "hal/boards.hpp"
+
+#if CASHSTICK_HAL_SIM
+#include "hal/sim_backend.hpp"
+#else
+#include "hal/pico_backend.hpp"
+#endif
+
+namespace hal {
+
+#if CASHSTICK_HAL_SIM
+using Backend = SimBackend;
+#else
+using Backend = PicoBackend;
+#endif
+
+#if defined(CASHSTICK_BOARD_PICO_DEVBOARD)
+using Board = PicoDevBoard<Backend>;
+#else
+using Board = CashStickRev1<Backend>;
+#endif
+
+} // namespace hal
+
+#endif // CASHSTICK_HAL_BOARD_HPP
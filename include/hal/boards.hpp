@@ -0,0 +1,46 @@
+#ifndef CASHSTICK_HAL_BOARDS_HPP
+#define CASHSTICK_HAL_BOARDS_HPP
+
+// Board profiles: which part sits on which pins. A profile is a template
+// over the backend, so the same profile drives the real board and the
+// host simulation. The build picks one with CASHSTICK_BOARD (see
+// hal/board.hpp); a profile that wires two parts to one GPIO, or an I2C
+// bus to pins its instance cannot reach, does not compile.
+
+#include "hal/hal.hpp"
+
+namespace hal {
+
+// CashStick rev 1: status LED on GPIO16, BOOT/TEST button, tamper loop,
+// SE050 on I2C1
+template <class Backend>
+struct CashStickRev1 {
+    static constexpr const char *name = "cashstick_rev1";
+
+    using Led = MonoLed<Backend, 16>;
+    using TestButton = Button<Backend, 13>;
+    using TamperLoop = InputPin<Backend, 17>;
+    using Se050Bus = I2cBus<Backend, 1, 14, 15, 400000>;
+
+    static_assert(pins_distinct<Led, TestButton, TamperLoop, Se050Bus>(),
+                  "cashstick_rev1: two parts share a GPIO");
+};
+
+// Raspberry Pi Pico with an SE050 breakout on I2C0, for bring-up: the
+// on-board LED, a button on GP13 and the tamper loop on GP16
+template <class Backend>
+struct PicoDevBoard {
+    static constexpr const char *name = "pico_devboard";
+
+    using Led = MonoLed<Backend, 25>;
+    using TestButton = Button<Backend, 13>;
+    using TamperLoop = InputPin<Backend, 16>;
+    using Se050Bus = I2cBus<Backend, 0, 4, 5, 400000>;
+
+    static_assert(pins_distinct<Led, TestButton, TamperLoop, Se050Bus>(),
+                  "pico_devboard: two parts share a GPIO");
+};
+
+} // namespace hal
+
+#endif // CASHSTICK_HAL_BOARDS_HPP
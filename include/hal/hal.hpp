@@ -0,0 +1,210 @@
+#ifndef CASHSTICK_HAL_HPP
+#define CASHSTICK_HAL_HPP
+
+// Hardware parts as compile-time types. Each part is a template over a
+// backend - the static functions that actually touch the hardware - and
+// its pins. Every call resolves at compile time: with PicoBackend a part's
+// functions inline down to the SDK calls they wrap, and with SimBackend
+// the same code runs against a simulated pin map on the host.
+//
+// A backend provides, all static:
+//   gpio_init(pin)  gpio_set_output(pin, bool)  gpio_put(pin, bool)
+//   gpio_get(pin)  gpio_set_pull(pin, Pull)  gpio_set_i2c(pin)
+//   delay_us(us)
+//   i2c_init(instance, baudrate)  i2c_deinit(instance)
+//   i2c_set_baudrate(instance, baudrate)
+//   i2c_write(instance, addr, data, len, timeout_us)
+//   i2c_read(instance, addr, data, len, timeout_us)
+//
+// Every part lists the GPIOs it uses in `pins`, so a board profile can
+// check with pins_distinct() that no two parts share one.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace hal {
+
+constexpr unsigned kGpioCount = 30;     // RP2040 user GPIOs
+
+enum class Pull : uint8_t { kNone, kUp, kDown };
+
+// Plain digital input, e.g. a tamper loop
+template <class Backend, unsigned Pin, Pull PullMode = Pull::kUp>
+struct InputPin {
+    static_assert(Pin < kGpioCount, "input GPIO out of range");
+
+    static constexpr std::array<uint8_t, 1> pins = {{(uint8_t)Pin}};
+    static constexpr unsigned gpio = Pin;
+
+    static void init() {
+        Backend::gpio_init(Pin);
+        Backend::gpio_set_output(Pin, false);
+        Backend::gpio_set_pull(Pin, PullMode);
+    }
+
+    static bool read() {
+        return Backend::gpio_get(Pin);
+    }
+};
+
+// Push button to ground (or to 3V3 with ActiveLow false)
+template <class Backend, unsigned Pin, bool ActiveLow = true>
+struct Button {
+    static_assert(Pin < kGpioCount, "button GPIO out of range");
+
+    static constexpr std::array<uint8_t, 1> pins = {{(uint8_t)Pin}};
+    static constexpr unsigned gpio = Pin;
+
+    static void init() {
+        Backend::gpio_init(Pin);
+        Backend::gpio_set_output(Pin, false);
+        Backend::gpio_set_pull(Pin, ActiveLow ? Pull::kUp : Pull::kDown);
+    }
+
+    static bool pressed() {
+        return Backend::gpio_get(Pin) != ActiveLow;
+    }
+};
+
+// Single-colour LED: lit for any colour but black
+template <class Backend, unsigned Pin, bool ActiveLow = false>
+struct MonoLed {
+    static_assert(Pin < kGpioCount, "LED GPIO out of range");
+
+    static constexpr std::array<uint8_t, 1> pins = {{(uint8_t)Pin}};
+
+    static void init() {
+        Backend::gpio_init(Pin);
+        Backend::gpio_put(Pin, ActiveLow);
+        Backend::gpio_set_output(Pin, true);
+    }
+
+    static void set(uint8_t r, uint8_t g, uint8_t b) {
+        Backend::gpio_put(Pin, ((r | g | b) != 0) != ActiveLow);
+    }
+};
+
+// RGB LED with one GPIO per channel; a channel is on from half scale up,
+// which is enough for the status colours
+template <class Backend, unsigned RedPin, unsigned GreenPin, unsigned BluePin, bool ActiveLow = false>
+struct RgbLed {
+    static_assert(RedPin < kGpioCount && GreenPin < kGpioCount && BluePin < kGpioCount,
+                  "LED GPIO out of range");
+
+    static constexpr std::array<uint8_t, 3> pins = {{(uint8_t)RedPin, (uint8_t)GreenPin, (uint8_t)BluePin}};
+
+    static void init() {
+        for (uint8_t pin : pins) {
+            Backend::gpio_init(pin);
+            Backend::gpio_put(pin, ActiveLow);
+            Backend::gpio_set_output(pin, true);
+        }
+    }
+
+    static void set(uint8_t r, uint8_t g, uint8_t b) {
+        Backend::gpio_put(RedPin, (r >= 0x80) != ActiveLow);
+        Backend::gpio_put(GreenPin, (g >= 0x80) != ActiveLow);
+        Backend::gpio_put(BluePin, (b >= 0x80) != ActiveLow);
+    }
+};
+
+// I2C controller. On the RP2040 GPIO n can only carry I2C(n / 2 % 2), SDA
+// when n is even and SCL when odd, so the pins pin down the instance.
+template <class Backend, unsigned Instance, unsigned SdaPin, unsigned SclPin, uint32_t Baudrate>
+struct I2cBus {
+    static_assert(Instance < 2, "the RP2040 has I2C0 and I2C1");
+    static_assert(SdaPin < kGpioCount && SclPin < kGpioCount, "I2C GPIO out of range");
+    static_assert(SdaPin % 4 == Instance * 2, "SDA GPIO is not routable to this I2C instance");
+    static_assert(SclPin % 4 == Instance * 2 + 1, "SCL GPIO is not routable to this I2C instance");
+    static_assert(Baudrate > 0 && Baudrate <= 1000000, "I2C runs at up to 1 MHz (Fast-mode Plus)");
+
+    static constexpr std::array<uint8_t, 2> pins = {{(uint8_t)SdaPin, (uint8_t)SclPin}};
+    static constexpr unsigned instance = Instance;
+    static constexpr uint32_t baudrate = Baudrate;
+
+    static void init() {
+        Backend::i2c_init(Instance, Baudrate);
+        Backend::gpio_set_i2c(SdaPin);
+        Backend::gpio_set_i2c(SclPin);
+        Backend::gpio_set_pull(SdaPin, Pull::kUp);
+        Backend::gpio_set_pull(SclPin, Pull::kUp);
+    }
+
+    // The divider follows clk_peri, so it is re-derived after clock changes
+    static void restore_baudrate() {
+        Backend::i2c_set_baudrate(Instance, Baudrate);
+    }
+
+    // Byte count or a PICO_ERROR_ code
+    static int write(uint8_t addr, const uint8_t *data, size_t len, uint32_t timeout_us) {
+        return Backend::i2c_write(Instance, addr, data, len, timeout_us);
+    }
+
+    static int read(uint8_t addr, uint8_t *data, size_t len, uint32_t timeout_us) {
+        return Backend::i2c_read(Instance, addr, data, len, timeout_us);
+    }
+
+    // Release a target holding SDA low: clock SCL up to 9 times until SDA
+    // reads high, then generate a STOP and hand the pins back to the I2C
+    // block. Returns the clocks it took.
+    static unsigned recover(uint32_t half_clock_us) {
+        Backend::i2c_deinit(Instance);
+
+        Backend::gpio_init(SdaPin);
+        Backend::gpio_init(SclPin);
+        Backend::gpio_set_output(SdaPin, false);
+        Backend::gpio_set_pull(SdaPin, Pull::kUp);
+        Backend::gpio_put(SclPin, true);
+        Backend::gpio_set_output(SclPin, true);
+        Backend::delay_us(half_clock_us);
+
+        unsigned clocks = 0;
+        while (clocks < 9 && !Backend::gpio_get(SdaPin)) {
+            Backend::gpio_put(SclPin, false);
+            Backend::delay_us(half_clock_us);
+            Backend::gpio_put(SclPin, true);
+            Backend::delay_us(half_clock_us);
+            clocks++;
+        }
+
+        // STOP: SDA rises while SCL is high
+        Backend::gpio_put(SclPin, false);
+        Backend::gpio_put(SdaPin, false);
+        Backend::gpio_set_output(SdaPin, true);
+        Backend::delay_us(half_clock_us);
+        Backend::gpio_put(SclPin, true);
+        Backend::delay_us(half_clock_us);
+        Backend::gpio_set_output(SdaPin, false);
+        Backend::delay_us(half_clock_us);
+
+        init();
+        return clocks;
+    }
+};
+
+namespace detail {
+
+template <size_t N>
+constexpr bool claim_pins(bool (&used)[kGpioCount], const std::array<uint8_t, N> &pins) {
+    for (uint8_t pin : pins) {
+        if (used[pin]) {
+            return false;
+        }
+        used[pin] = true;
+    }
+    return true;
+}
+
+} // namespace detail
+
+// True if no GPIO is used by more than one of the parts
+template <class... Parts>
+constexpr bool pins_distinct() {
+    bool used[kGpioCount] = {};
+    return (detail::claim_pins(used, Parts::pins) && ...);
+}
+
+} // namespace hal
+
+#endif // CASHSTICK_HAL_HPP
@@ -0,0 +1,48 @@
+#ifndef CASHSTICK_HAL_PICO_BACKEND_HPP
+#define CASHSTICK_HAL_PICO_BACKEND_HPP
+
+// HAL backend for the RP2040: each function is the SDK call it names
+
+#include "hal/hal.hpp"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/timer.h"
+
+namespace hal {
+
+struct PicoBackend {
+    static void gpio_init(unsigned pin) { ::gpio_init(pin); }
+    static void gpio_set_output(unsigned pin, bool output) { ::gpio_set_dir(pin, output); }
+    static void gpio_put(unsigned pin, bool level) { ::gpio_put(pin, level); }
+    static bool gpio_get(unsigned pin) { return ::gpio_get(pin); }
+    static void gpio_set_i2c(unsigned pin) { ::gpio_set_function(pin, GPIO_FUNC_I2C); }
+    static void delay_us(uint32_t us) { ::busy_wait_us_32(us); }
+
+    static void gpio_set_pull(unsigned pin, Pull pull) {
+        ::gpio_set_pulls(pin, pull == Pull::kUp, pull == Pull::kDown);
+    }
+
+    static void i2c_init(unsigned instance, uint32_t baudrate) {
+        ::i2c_init(i2c_get_instance(instance), baudrate);
+    }
+
+    static void i2c_deinit(unsigned instance) {
+        ::i2c_deinit(i2c_get_instance(instance));
+    }
+
+    static void i2c_set_baudrate(unsigned instance, uint32_t baudrate) {
+        ::i2c_set_baudrate(i2c_get_instance(instance), baudrate);
+    }
+
+    static int i2c_write(unsigned instance, uint8_t addr, const uint8_t *data, size_t len, uint32_t timeout_us) {
+        return ::i2c_write_timeout_us(i2c_get_instance(instance), addr, data, len, false, timeout_us);
+    }
+
+    static int i2c_read(unsigned instance, uint8_t addr, uint8_t *data, size_t len, uint32_t timeout_us) {
+        return ::i2c_read_timeout_us(i2c_get_instance(instance), addr, data, len, false, timeout_us);
+    }
+};
+
+} // namespace hal
+
+#endif // CASHSTICK_HAL_PICO_BACKEND_HPP
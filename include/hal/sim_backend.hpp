@@ -0,0 +1,151 @@
+#ifndef CASHSTICK_HAL_SIM_BACKEND_HPP
+#define CASHSTICK_HAL_SIM_BACKEND_HPP
+
+// HAL backend for host builds. It keeps a model of the GPIO bank (direction,
+// level, pulls, function) and of the two I2C blocks, so board profiles and
+// driver code run unchanged on a PC. Pins read as the wired-AND of what the
+// chip drives and what the outside world holds; I2C transfers go to a
+// target function the test installs.
+
+#include "hal/hal.hpp"
+
+#include <functional>
+
+namespace hal {
+
+struct SimPin {
+    bool output = false;
+    bool level = false;
+    bool i2c = false;
+    Pull pull = Pull::kNone;
+    bool held_low = false;          // Pulled low from outside
+    int release_clock = -1;         // Let go after edges on this pin
+    unsigned release_edges = 0;
+    unsigned rising_edges = 0;
+};
+
+struct SimI2c {
+    bool enabled = false;
+    uint32_t baudrate = 0;
+};
+
+struct SimBackend {
+    using Pin = SimPin;
+    using I2c = SimI2c;
+
+    // Target on a simulated bus: (instance, addr, read, data, len, timeout_us)
+    // returns what the SDK call would
+    using Target = std::function<int(unsigned, uint8_t, bool, uint8_t *, size_t, uint32_t)>;
+
+    static inline Pin pins[kGpioCount];
+    static inline I2c i2c[2];
+    static inline Target target;
+    static inline uint64_t now_us = 0;
+
+    // Test side
+
+    static void reset() {
+        for (Pin &pin : pins) {
+            pin = Pin();
+        }
+        i2c[0] = i2c[1] = I2c();
+        target = nullptr;
+        now_us = 0;
+    }
+
+    static void hold_low(unsigned pin, bool low) {
+        pins[pin].held_low = low;
+        pins[pin].release_clock = -1;
+    }
+
+    // Model a target stuck mid-byte: holds `pin` low until `clock` has
+    // risen `edges` more times
+    static void hold_low_for_clocks(unsigned pin, unsigned clock, unsigned edges) {
+        pins[pin].held_low = true;
+        pins[pin].release_clock = (int)clock;
+        pins[pin].release_edges = edges;
+    }
+
+    // Backend side
+
+    static void gpio_init(unsigned pin) {
+        pins[pin].output = false;
+        pins[pin].level = false;
+        pins[pin].i2c = false;
+    }
+
+    static void gpio_set_output(unsigned pin, bool output) {
+        pins[pin].output = output;
+    }
+
+    static void gpio_put(unsigned pin, bool level) {
+        Pin &p = pins[pin];
+        bool rising = level && !p.level && p.output;
+        p.level = level;
+        if (!rising) {
+            return;
+        }
+        p.rising_edges++;
+        for (Pin &other : pins) {
+            if (other.release_clock == (int)pin && other.release_edges > 0 && --other.release_edges == 0) {
+                other.held_low = false;
+                other.release_clock = -1;
+            }
+        }
+    }
+
+    static bool gpio_get(unsigned pin) {
+        const Pin &p = pins[pin];
+        if (p.held_low) {
+            return false;
+        }
+        if (p.output) {
+            return p.level;
+        }
+        return p.i2c || p.pull == Pull::kUp;
+    }
+
+    static void gpio_set_pull(unsigned pin, Pull pull) {
+        pins[pin].pull = pull;
+    }
+
+    static void gpio_set_i2c(unsigned pin) {
+        pins[pin].i2c = true;
+        pins[pin].output = false;
+    }
+
+    static void delay_us(uint32_t us) {
+        now_us += us;
+    }
+
+    static void i2c_init(unsigned instance, uint32_t baudrate) {
+        i2c[instance].enabled = true;
+        i2c[instance].baudrate = baudrate;
+    }
+
+    static void i2c_deinit(unsigned instance) {
+        i2c[instance].enabled = false;
+    }
+
+    static void i2c_set_baudrate(unsigned instance, uint32_t baudrate) {
+        i2c[instance].baudrate = baudrate;
+    }
+
+    static int i2c_write(unsigned instance, uint8_t addr, const uint8_t *data, size_t len, uint32_t timeout_us) {
+        if (!i2c[instance].enabled || !target) {
+            return -1;                  // PICO_ERROR_GENERIC, as for a NAK
+        }
+        return target(instance, addr, false, const_cast<uint8_t *>(data), len, timeout_us);
+    }
+
+    static int i2c_read(unsigned instance, uint8_t addr, uint8_t *data, size_t len, uint32_t timeout_us) {
+        if (!i2c[instance].enabled || !target) {
+            return -1;
+        }
+        return target(instance, addr, true, data, len, timeout_us);
+    }
+};
+
+} // namespace hal
+
+#endif // CASHSTICK_HAL_SIM_BACKEND_HPP
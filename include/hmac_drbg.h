@@ -0,0 +1,52 @@
+#ifndef HMAC_DRBG_H
+#define HMAC_DRBG_H
+
+// Portable HMAC_DRBG with SHA-256 (NIST SP 800-90A rev. 1, section 10.1.2).
+// No prediction resistance: the caller supplies fresh entropy through
+// hmac_drbg_reseed() whenever hmac_drbg_generate() asks for it.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HMAC_DRBG_SEED_LEN 32           // Security strength in bytes
+#define HMAC_DRBG_MAX_REQUEST 65536     // SP 800-90A limit: 2^19 bits
+#define HMAC_DRBG_MAX_RESEED_INTERVAL (1ull << 48)
+
+typedef enum {
+    HMAC_DRBG_OK = 0,
+    HMAC_DRBG_RESEED_REQUIRED,
+    HMAC_DRBG_BAD_ARGS
+} hmac_drbg_result_t;
+
+typedef struct {
+    uint8_t key[SHA256_DIGEST_SIZE];
+    uint8_t v[SHA256_DIGEST_SIZE];
+    uint64_t reseed_counter;
+    uint64_t reseed_interval;       // Generate calls allowed between reseeds
+    bool instantiated;
+} hmac_drbg_t;
+
+// entropy_len must be at least HMAC_DRBG_SEED_LEN; the nonce should carry
+// at least half that again (or be folded into the entropy input)
+hmac_drbg_result_t hmac_drbg_instantiate(hmac_drbg_t *drbg, uint64_t reseed_interval,
+                                         const uint8_t *entropy, size_t entropy_len,
+                                         const uint8_t *nonce, size_t nonce_len,
+                                         const uint8_t *personalization, size_t pers_len);
+hmac_drbg_result_t hmac_drbg_reseed(hmac_drbg_t *drbg,
+                                    const uint8_t *entropy, size_t entropy_len,
+                                    const uint8_t *additional, size_t add_len);
+hmac_drbg_result_t hmac_drbg_generate(hmac_drbg_t *drbg, uint8_t *out, size_t out_len,
+                                      const uint8_t *additional, size_t add_len);
+void hmac_drbg_uninstantiate(hmac_drbg_t *drbg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HMAC_DRBG_H
@@ -0,0 +1,14 @@
+#ifndef HOT_FUNCTIONS_H
+#define HOT_FUNCTIONS_H
+
+// Functions copied to SRAM when built with CASHSTICK_RAM_FUNCTIONS (see
+// ram_functions.h). Regenerate from an on-target profile with
+//   tools/hot_functions.py select --map cashstick_firmware.elf.map BENCH.LOG
+// Until a profile has been taken this is the seed set: the hash
+// compression functions and the secp256k1 field multiply.
+
+#define CASHSTICK_HOT_sha256_transform 1
+#define CASHSTICK_HOT_ripemd160_transform 1
+#define CASHSTICK_HOT_fe_mul 1
+
+#endif // HOT_FUNCTIONS_H
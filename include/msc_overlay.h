@@ -0,0 +1,67 @@
+#ifndef MSC_OVERLAY_H
+#define MSC_OVERLAY_H
+
+// Bounded RAM write-overlay for the mass-storage volume. Host writes land
+// here as whole sectors, reads check here before the generated volume,
+// and the lot is dropped on eject or when the volume is re-rendered.
+// Hosts write metadata to any drive they mount (.Trashes, .fseventsd,
+// System Volume Information, access dates), and accepting it in RAM
+// keeps mounting fast without touching flash. Kept free of SDK
+// dependencies so the same code builds for the firmware and for host-side
+// trace replay.
+//
+// A full overlay evicts its least recently used sector. Sectors below
+// pin_below (boot sector, FAT and root directory) only go once nothing
+// else is left: losing a host's directory entry makes it see the old one
+// again, losing file data only shows stale bytes. The caller owns the
+// storage, so the capacity is a build choice.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MSC_OVERLAY_SECTOR_SIZE 512
+
+typedef struct {
+    uint32_t writes;            // Sectors written by the host
+    uint32_t read_hits;         // Sector reads served from the overlay
+    uint32_t evictions;
+    uint32_t pinned_evictions;  // Of those, metadata sectors
+    uint32_t discards;          // Whole overlay dropped
+} msc_overlay_stats_t;
+
+typedef struct {
+    uint8_t (*sectors)[MSC_OVERLAY_SECTOR_SIZE];
+    uint32_t *lba;
+    uint32_t *last_use;         // LRU clock value of the last access
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t clock;
+    uint32_t pin_below;
+    msc_overlay_stats_t stats;
+} msc_overlay_t;
+
+void msc_overlay_init(msc_overlay_t *overlay, uint8_t (*sectors)[MSC_OVERLAY_SECTOR_SIZE],
+                      uint32_t *lba, uint32_t *last_use, uint32_t capacity, uint32_t pin_below);
+
+// Copy the overlay's sector into out; false if the host never wrote it
+// (or it was evicted)
+bool msc_overlay_read(msc_overlay_t *overlay, uint32_t lba, uint8_t out[MSC_OVERLAY_SECTOR_SIZE]);
+
+// The overlay's copy of lba for a partial write, or NULL if there is
+// none: the caller then starts from the generated sector
+uint8_t *msc_overlay_find(msc_overlay_t *overlay, uint32_t lba);
+
+// Keep a whole sector, evicting if full
+void msc_overlay_write(msc_overlay_t *overlay, uint32_t lba, const uint8_t data[MSC_OVERLAY_SECTOR_SIZE]);
+
+void msc_overlay_discard(msc_overlay_t *overlay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MSC_OVERLAY_H
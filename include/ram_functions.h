@@ -0,0 +1,51 @@
+#ifndef RAM_FUNCTIONS_H
+#define RAM_FUNCTIONS_H
+
+// Profile-guided SRAM placement. Code normally runs from QSPI flash
+// through the 16 KB XIP cache, and a miss - common right after a flash
+// erase or program flushes the cache - stalls the core for the whole
+// QSPI transfer. Functions that may be hot are written as
+//
+//   static void RAM_FUNC(sha256_transform)(uint32_t state[8], ...)
+//
+// and tables they read as
+//
+//   static const uint32_t sha256_k[64] RAM_TABLE(sha256_k, sha256_transform) = { ... };
+//
+// With CASHSTICK_RAM_FUNCTIONS on, those named in hot_functions.h (the
+// list generated from a profile by tools/hot_functions.py) are placed in
+// .time_critical sections, which the SDK's startup copies to SRAM; a
+// table follows its reader. Everything else stays in flash as before.
+// A placed function is kept out of line: inlined into a caller in flash
+// it would run from flash after all.
+
+#ifndef CASHSTICK_RAM_FUNCTIONS
+#define CASHSTICK_RAM_FUNCTIONS 0
+#endif
+
+#if CASHSTICK_RAM_FUNCTIONS
+#include "pico/platform.h"
+#include "hot_functions.h"
+
+// HOT_IS_LISTED(CASHSTICK_HOT_x) is 1 when the list defines it as 1, else 0
+#define HOT_PLACEHOLDER_1 0,
+#define HOT_SECOND(ignored, value, ...) value
+#define HOT_IS_LISTED(macro) HOT_IS_LISTED_(macro)
+#define HOT_IS_LISTED_(value) HOT_IS_LISTED__(HOT_PLACEHOLDER_##value)
+#define HOT_IS_LISTED__(placeholder_or_junk) HOT_SECOND(placeholder_or_junk 1, 0, 0)
+
+#define HOT_SELECT(listed, then_, else_) HOT_SELECT_(listed, then_, else_)
+#define HOT_SELECT_(listed, then_, else_) HOT_SELECT_##listed(then_, else_)
+#define HOT_SELECT_1(then_, else_) then_
+#define HOT_SELECT_0(then_, else_) else_
+
+#define RAM_FUNC(name) \
+    HOT_SELECT(HOT_IS_LISTED(CASHSTICK_HOT_##name), __noinline __not_in_flash_func(name), name)
+#define RAM_TABLE(name, reader) \
+    HOT_SELECT(HOT_IS_LISTED(CASHSTICK_HOT_##reader), __not_in_flash(#name), )
+#else
+#define RAM_FUNC(name) name
+#define RAM_TABLE(name, reader)
+#endif
+
+#endif // RAM_FUNCTIONS_H
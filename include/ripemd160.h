@@ -0,0 +1,24 @@
+#ifndef RIPEMD160_H
+#define RIPEMD160_H
+
+// Portable RIPEMD-160, used for Bitcoin HASH160 (RIPEMD-160 of SHA-256).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RIPEMD160_DIGEST_SIZE 20
+
+void ripemd160(const uint8_t *data, size_t len, uint8_t digest[RIPEMD160_DIGEST_SIZE]);
+
+// RIPEMD-160(SHA-256(data))
+void hash160(const uint8_t *data, size_t len, uint8_t digest[RIPEMD160_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RIPEMD160_H
@@ -0,0 +1,124 @@
+#ifndef SCP03_H
+#define SCP03_H
+
+// GlobalPlatform SCP03 secure channel (Amendment D), host side, at security
+// level C-MAC + C-DECRYPTION + R-MAC + R-ENCRYPTION. Kept free of SDK
+// dependencies so the same code builds for the firmware and for host-side
+// simulators, which also use the card-side helpers at the end.
+//
+// A session starts with INITIALIZE UPDATE (host challenge out, card
+// challenge and card cryptogram back) and EXTERNAL AUTHENTICATE (host
+// cryptogram, MACed). Session keys come from the static keys with the
+// SP 800-108 counter-mode KDF over CMAC, context host || card challenge.
+// After that every command is
+//
+//   CLA|0x04 INS P1 P2 Lc  AES-CBC(S-ENC, ICV, data || 80 00..)  C-MAC[8]
+//
+// with ICV = AES(S-ENC, counter) and C-MAC = CMAC(S-MAC, chain || header
+// || encrypted data); the full CMAC becomes the next chain value. A reply
+// is encrypted data || R-MAC[8] || SW1 SW2, R-MAC = CMAC(S-RMAC, chain ||
+// encrypted data || SW), its ICV AES(S-ENC, 0x80 || counter). Error
+// replies carry the status word only.
+//
+// Everything the two ends share is the chain value and the counter, both
+// advanced by the host when it wraps a command. A command that never
+// reached the card is undone with scp03_rewind() to the mark taken before
+// scp03_wrap(); one the card took but whose reply was lost needs nothing,
+// so an I2C fault never forces a new handshake.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "aes128.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCP03_CHALLENGE_SIZE 8
+#define SCP03_CRYPTOGRAM_SIZE 8
+#define SCP03_MAC_SIZE 8
+#define SCP03_SECURITY_LEVEL 0x33       // C-MAC, C-DECRYPTION, R-MAC, R-ENCRYPTION
+#define SCP03_INIT_UPDATE_SIZE 14       // Command, Le included
+#define SCP03_INIT_RESPONSE_SIZE 31     // 29 bytes of data and the status word
+#define SCP03_EXT_AUTH_SIZE 21
+#define SCP03_MAX_DATA 239              // Plaintext per command: Lc stays below 256
+#define SCP03_SW_OK 0x9000
+#define SCP03_SW_SECURITY 0x6982        // Card dropped the session (bad MAC)
+
+typedef struct {
+    uint8_t enc[AES128_KEY_SIZE];
+    uint8_t mac[AES128_KEY_SIZE];
+    uint8_t dek[AES128_KEY_SIZE];
+} scp03_static_keys_t;
+
+typedef struct {
+    aes128_ctx_t s_enc;
+    aes128_ctx_t s_mac;
+    aes128_ctx_t s_rmac;
+    uint8_t context[2 * SCP03_CHALLENGE_SIZE];  // Host || card challenge
+    uint8_t chain[AES128_BLOCK_SIZE];           // MAC chaining value
+    uint32_t counter;                           // Of the last wrapped command
+    bool authenticated;
+} scp03_session_t;
+
+// What wrapping a command changes
+typedef struct {
+    uint8_t chain[AES128_BLOCK_SIZE];
+    uint32_t counter;
+} scp03_mark_t;
+
+// INITIALIZE UPDATE for key version 0 (the default keyset)
+void scp03_initialize_update(const uint8_t host_challenge[SCP03_CHALLENGE_SIZE],
+                             uint8_t command[SCP03_INIT_UPDATE_SIZE]);
+
+// Check the card's answer and derive the session keys. False if it is
+// not SCP03 or the card cryptogram is wrong (not our static keys).
+bool scp03_begin(scp03_session_t *session, const scp03_static_keys_t *keys,
+                 const uint8_t host_challenge[SCP03_CHALLENGE_SIZE],
+                 const uint8_t response[SCP03_INIT_RESPONSE_SIZE]);
+
+// EXTERNAL AUTHENTICATE with the host cryptogram. The session counts as
+// authenticated from here; drop it if the card does not answer SCP03_SW_OK.
+void scp03_external_authenticate(scp03_session_t *session, uint8_t command[SCP03_EXT_AUTH_SIZE]);
+
+// Wrap a command for the card: the frame length, or 0 if data is longer
+// than SCP03_MAX_DATA or the frame would not fit in max_len
+size_t scp03_wrap(scp03_session_t *session, const uint8_t header[4], const uint8_t *data, size_t len,
+                  uint8_t *frame, size_t max_len);
+
+// Take back a wrapped command that never reached the card
+void scp03_mark(const scp03_session_t *session, scp03_mark_t *mark);
+void scp03_rewind(scp03_session_t *session, const scp03_mark_t *mark);
+
+// Frame length of a successful reply carrying len bytes
+size_t scp03_response_size(size_t len);
+
+// Check and decrypt the reply to the last wrapped command; *len is the
+// room in data on entry and the bytes written on return. Returns false on
+// a bad R-MAC or padding. An error status word comes back with no data.
+bool scp03_unwrap(const scp03_session_t *session, const uint8_t *frame, size_t frame_len,
+                  uint8_t *data, size_t *len, uint16_t *sw);
+
+// Card side, for simulators and tests
+
+void scp03_card_initialize(scp03_session_t *session, const scp03_static_keys_t *keys,
+                           const uint8_t command[SCP03_INIT_UPDATE_SIZE],
+                           const uint8_t card_challenge[SCP03_CHALLENGE_SIZE],
+                           uint8_t response[SCP03_INIT_RESPONSE_SIZE]);
+bool scp03_card_authenticate(scp03_session_t *session, const uint8_t command[SCP03_EXT_AUTH_SIZE]);
+
+// Check and decrypt a wrapped command; header gets the plain CLA INS P1 P2
+// and *len works as for scp03_unwrap()
+bool scp03_card_unwrap(scp03_session_t *session, const uint8_t *frame, size_t frame_len,
+                       uint8_t header[4], uint8_t *data, size_t *len);
+
+// Reply to the last unwrapped command: the frame length, as scp03_response_size()
+size_t scp03_card_wrap(const scp03_session_t *session, const uint8_t *data, size_t len, uint16_t sw,
+                       uint8_t *frame, size_t max_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCP03_H
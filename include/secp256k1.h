@@ -0,0 +1,55 @@
+#ifndef SECP256K1_H
+#define SECP256K1_H
+
+// Minimal portable secp256k1 group arithmetic for public-key operations
+// (key parsing, x-only keys, tweaking, ECDSA verification). Variable time:
+// only ever use it on public data, never on private scalars.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Field element mod p, 8 little-endian 32-bit limbs, always fully reduced
+typedef struct {
+    uint32_t v[8];
+} secp256k1_fe_t;
+
+typedef struct {
+    secp256k1_fe_t x;
+    secp256k1_fe_t y;
+    bool infinity;
+} secp256k1_point_t;
+
+// Scalars are 32-byte big-endian, as in Bitcoin serializations
+bool secp256k1_scalar_is_valid(const uint8_t scalar[32]);   // 0 < s < n
+
+bool secp256k1_pubkey_parse(const uint8_t pubkey[33], secp256k1_point_t *point);
+void secp256k1_pubkey_serialize(const secp256k1_point_t *point, uint8_t pubkey[33]);
+bool secp256k1_lift_x(const uint8_t x[32], secp256k1_point_t *point);   // Even-y point (BIP340)
+
+void secp256k1_point_add(const secp256k1_point_t *a, const secp256k1_point_t *b, secp256k1_point_t *out);
+void secp256k1_point_mul(const secp256k1_point_t *point, const uint8_t scalar[32], secp256k1_point_t *out);
+void secp256k1_mul_base(const uint8_t scalar[32], secp256k1_point_t *out);
+
+// BIP341 key-path tweak: Q = lift_x(internal_x) + tweak * G
+bool secp256k1_xonly_tweak_add(const uint8_t internal_x[32], const uint8_t tweak[32],
+                               uint8_t output_x[32], bool *output_odd);
+
+// ECDSA with 64-byte r || s signatures over a 32-byte hash. Verification
+// accepts high-s signatures, as the SE050 does not normalise them.
+bool secp256k1_ecdsa_verify(const uint8_t pubkey[33], const uint8_t hash[32], const uint8_t signature[64]);
+
+// Signing is here for host-side simulators and tests only: it is variable
+// time and takes the nonce from the caller. The firmware signs in the SE050.
+bool secp256k1_ecdsa_sign(const uint8_t private_key[32], const uint8_t hash[32], const uint8_t nonce[32],
+                          uint8_t signature[64]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SECP256K1_H
@@ -0,0 +1,48 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+// Portable SHA-256 (FIPS 180-4). Kept free of SDK dependencies so the
+// same code builds for the firmware and for host-side tools.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t total_len;
+    uint8_t buffer[SHA256_BLOCK_SIZE];
+    size_t buffer_len;
+} sha256_ctx_t;
+
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len);
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// HMAC-SHA256 (RFC 2104)
+typedef struct {
+    sha256_ctx_t inner;
+    sha256_ctx_t outer;
+} hmac_sha256_ctx_t;
+
+void hmac_sha256_init(hmac_sha256_ctx_t *ctx, const uint8_t *key, size_t key_len);
+void hmac_sha256_update(hmac_sha256_ctx_t *ctx, const uint8_t *data, size_t len);
+void hmac_sha256_final(hmac_sha256_ctx_t *ctx, uint8_t mac[SHA256_DIGEST_SIZE]);
+
+// One-shot helpers
+void sha256(const uint8_t *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256d(const uint8_t *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);  // Bitcoin double hash
+void hmac_sha256(const uint8_t *key, size_t key_len, const uint8_t *data, size_t len,
+                 uint8_t mac[SHA256_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SHA256_H
@@ -0,0 +1,55 @@
+#ifndef TREE_HASH_H
+#define TREE_HASH_H
+
+// SHA-256 Merkle tree over fixed-size chunks, the construction measured
+// boot reports: leaves are SHA-256(0x00 || chunk), nodes SHA-256(0x01 ||
+// left || right), and an odd node at the end of a level is carried up
+// unchanged. Leaves hash independently, which is what lets both cores
+// share a large region. Kept free of SDK dependencies so the same code
+// builds for the firmware and for host-side tools.
+//
+// The builder takes leaves in order and keeps only one pending subtree
+// per height, so a root needs no array of every leaf: the carried-up
+// tree is the one whose left subtrees are the largest powers of two.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TREE_HASH_MAX_HEIGHT 32         // Up to 2^32 leaves
+
+void tree_hash_leaf_init(sha256_ctx_t *ctx);     // Prefixed; feed the chunk, then sha256_final()
+void tree_hash_leaf(const uint8_t *chunk, size_t len, uint8_t out[SHA256_DIGEST_SIZE]);
+void tree_hash_node(const uint8_t left[SHA256_DIGEST_SIZE], const uint8_t right[SHA256_DIGEST_SIZE],
+                    uint8_t out[SHA256_DIGEST_SIZE]);
+
+typedef struct {
+    uint8_t pending[TREE_HASH_MAX_HEIGHT][SHA256_DIGEST_SIZE];
+    uint8_t height[TREE_HASH_MAX_HEIGHT];
+    uint32_t depth;
+    uint64_t leaves;
+} tree_hash_builder_t;
+
+void tree_hash_builder_init(tree_hash_builder_t *builder);
+void tree_hash_builder_add(tree_hash_builder_t *builder, const uint8_t leaf[SHA256_DIGEST_SIZE]);
+// Root of the leaves added so far; all zeros for none
+void tree_hash_builder_root(const tree_hash_builder_t *builder, uint8_t root[SHA256_DIGEST_SIZE]);
+
+// Root over leaves already hashed, reducing level by level in work
+// (count digests of room); all zeros for none
+void tree_hash_root(const uint8_t (*leaves)[SHA256_DIGEST_SIZE], uint32_t count,
+                    uint8_t (*work)[SHA256_DIGEST_SIZE], uint8_t root[SHA256_DIGEST_SIZE]);
+
+// Single-threaded reference: the root over data in chunk_size pieces,
+// the last one possibly short
+void tree_hash(const uint8_t *data, size_t len, size_t chunk_size, uint8_t root[SHA256_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_HASH_H
@@ -0,0 +1,34 @@
+#ifndef TUSB_CONFIG_H
+#define TUSB_CONFIG_H
+
+// TinyUSB configuration for the CashStick composite device:
+// CDC (command protocol + log output), MSC (virtual drive with the
+// address files) and an optional generic HID endpoint for driverless
+// host tooling.
+
+#ifndef CASHSTICK_USB_HID
+#define CASHSTICK_USB_HID 1
+#endif
+
+// Device stack on the RP2040's only port (MCU/OS set by the Pico SDK)
+#define CFG_TUSB_RHPORT0_MODE   OPT_MODE_DEVICE
+#define CFG_TUD_ENDPOINT0_SIZE  64
+
+// Class drivers
+#define CFG_TUD_CDC             1
+#define CFG_TUD_MSC             1
+#define CFG_TUD_HID             CASHSTICK_USB_HID
+#define CFG_TUD_MIDI            0
+#define CFG_TUD_VENDOR          0
+
+// CDC FIFO sizes
+#define CFG_TUD_CDC_RX_BUFSIZE  256
+#define CFG_TUD_CDC_TX_BUFSIZE  256
+
+// MSC transfer buffer - one full virtual-disk cluster per transfer
+#define CFG_TUD_MSC_EP_BUFSIZE  4096
+
+// HID reports are 64 bytes in both directions
+#define CFG_TUD_HID_EP_BUFSIZE  64
+
+#endif // TUSB_CONFIG_H
@@ -0,0 +1,103 @@
+#ifndef UF2_STREAM_H
+#define UF2_STREAM_H
+
+// Streaming reader for signed UF2 firmware images written to the
+// mass-storage drive. Kept free of SDK dependencies so the same code
+// builds for the firmware and for host-side tools.
+//
+// A UF2 file is a run of 512-byte blocks, each carrying 256 image bytes
+// and its own target address, so the blocks are recognisable whatever
+// sectors the host puts the file in. Hosts mostly write a file in order,
+// but not always. Blocks that arrive early wait in a small reorder window
+// and the image comes out of output() strictly in address order, ready to
+// be hashed and programmed in the same pass.
+//
+// A signed image carries one extra block, flagged "not main flash" so the
+// boot ROM skips it, whose payload is (little-endian):
+//
+//   0   u32  magic "CSIG"
+//   4   u32  image length, a multiple of 256
+//   8   [64] ECDSA r || s by the vendor key over SHA-256 of the image
+//
+// The stream completes once every block of the file is in, the signature
+// block included. Checking the signature is left to the caller.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UF2_BLOCK_SIZE 512
+#define UF2_PAYLOAD_SIZE 256
+#define UF2_MAGIC_START0 0x0A324655u
+#define UF2_MAGIC_START1 0x9E5D5157u
+#define UF2_MAGIC_END 0x0AB16F30u
+#define UF2_FLAG_NOT_MAIN_FLASH 0x00000001u
+#define UF2_FLAG_FAMILY_ID 0x00002000u
+#define UF2_FAMILY_RP2040 0xE48BFF56u
+#define UF2_SIGNATURE_MAGIC 0x47495343u     // "CSIG" read little-endian
+#define UF2_SIGNATURE_SIZE 64
+#define UF2_STREAM_MAX_WINDOW 32            // Blocks held out of order
+
+typedef enum {
+    UF2_STREAM_NOT_UF2 = 0,     // Not a UF2 block: an ordinary sector
+    UF2_STREAM_ACCEPTED,
+    UF2_STREAM_COMPLETE,        // Last block in; image and signature ready
+    UF2_STREAM_ERROR            // stream->error says why
+} uf2_stream_result_t;
+
+typedef struct {
+    // Target address of image byte 0 and the most the image may take
+    uint32_t base;
+    uint32_t max_len;
+
+    // Reorder window, window_size (at most UF2_STREAM_MAX_WINDOW) blocks
+    // of caller storage
+    uint8_t (*window)[UF2_PAYLOAD_SIZE];
+    uint32_t window_size;
+
+    // Image bytes in address order; returning false stops the stream
+    bool (*output)(void *user, const uint8_t *data, size_t len);
+    void *user;
+
+    // Set once the signature block is in
+    bool signed_image;
+    uint32_t length;
+    uint8_t signature[UF2_SIGNATURE_SIZE];
+
+    // State
+    uint32_t num_blocks;        // Blocks in the file, from the first one seen
+    uint32_t seen;              // Distinct blocks taken
+    uint32_t next;              // Image offset output() wants next
+    uint32_t held;              // Window slots in use, bit per slot
+    bool failed;
+
+    // Counters
+    uint32_t reordered;         // Blocks that waited in the window
+    uint32_t duplicates;        // Blocks written again, ignored
+    uint32_t max_ahead;         // Furthest a block arrived ahead, in blocks
+    const char *error;
+} uf2_stream_t;
+
+// Set up a stream; fill in base, max_len, window and output first
+void uf2_stream_init(uf2_stream_t *stream);
+
+// Is this sector a UF2 block at all
+bool uf2_is_block(const uint8_t block[UF2_BLOCK_SIZE]);
+
+// Take the next block the host wrote. Once it fails, a stream keeps
+// failing until uf2_stream_init() starts it over.
+uf2_stream_result_t uf2_stream_feed(uf2_stream_t *stream, const uint8_t block[UF2_BLOCK_SIZE]);
+
+// One 512-byte block, for host-side tools that build UF2 files
+void uf2_encode_block(uint32_t target, uint32_t flags, uint32_t block_no, uint32_t num_blocks,
+                      const uint8_t payload[UF2_PAYLOAD_SIZE], uint8_t block[UF2_BLOCK_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UF2_STREAM_H
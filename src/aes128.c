@@ -0,0 +1,268 @@
+#include "aes128.h"
+#include "ram_functions.h"
+#include <string.h>
+
+static const uint8_t aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static const uint8_t aes_inv_sbox[256] = {
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+    0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+    0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+    0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+    0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+    0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+    0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+    0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+    0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+    0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+    0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
+};
+
+static uint32_t aes_blocks = 0;
+
+// Multiply by x in GF(2^8)
+static uint8_t aes_xtime(uint8_t a) {
+    return (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1b : 0x00));
+}
+
+static uint8_t aes_mul(uint8_t a, uint8_t b) {
+    uint8_t product = 0;
+    while (b) {
+        if (b & 1) {
+            product ^= a;
+        }
+        a = aes_xtime(a);
+        b >>= 1;
+    }
+    return product;
+}
+
+static void aes_add_round_key(uint8_t state[16], const uint8_t key[16]) {
+    for (int i = 0; i < 16; i++) {
+        state[i] ^= key[i];
+    }
+}
+
+// State is column-major, as the bytes arrive: state[col * 4 + row]
+static void aes_shift_rows(uint8_t s[16]) {
+    uint8_t t;
+    t = s[1];  s[1] = s[5];   s[5] = s[9];   s[9] = s[13];  s[13] = t;
+    t = s[2];  s[2] = s[10];  s[10] = t;
+    t = s[6];  s[6] = s[14];  s[14] = t;
+    t = s[15]; s[15] = s[11]; s[11] = s[7];  s[7] = s[3];   s[3] = t;
+}
+
+static void aes_inv_shift_rows(uint8_t s[16]) {
+    uint8_t t;
+    t = s[13]; s[13] = s[9];  s[9] = s[5];   s[5] = s[1];   s[1] = t;
+    t = s[2];  s[2] = s[10];  s[10] = t;
+    t = s[6];  s[6] = s[14];  s[14] = t;
+    t = s[3];  s[3] = s[7];   s[7] = s[11];  s[11] = s[15]; s[15] = t;
+}
+
+static void aes_mix_columns(uint8_t s[16]) {
+    for (int c = 0; c < 4; c++) {
+        uint8_t *col = s + c * 4;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+        col[0] ^= all ^ aes_xtime(a0 ^ a1);
+        col[1] ^= all ^ aes_xtime(a1 ^ a2);
+        col[2] ^= all ^ aes_xtime(a2 ^ a3);
+        col[3] ^= all ^ aes_xtime(a3 ^ a0);
+    }
+}
+
+static void aes_inv_mix_columns(uint8_t s[16]) {
+    for (int c = 0; c < 4; c++) {
+        uint8_t *col = s + c * 4;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        col[0] = aes_mul(a0, 14) ^ aes_mul(a1, 11) ^ aes_mul(a2, 13) ^ aes_mul(a3, 9);
+        col[1] = aes_mul(a0, 9) ^ aes_mul(a1, 14) ^ aes_mul(a2, 11) ^ aes_mul(a3, 13);
+        col[2] = aes_mul(a0, 13) ^ aes_mul(a1, 9) ^ aes_mul(a2, 14) ^ aes_mul(a3, 11);
+        col[3] = aes_mul(a0, 11) ^ aes_mul(a1, 13) ^ aes_mul(a2, 9) ^ aes_mul(a3, 14);
+    }
+}
+
+// Subkey doubling: shift left one bit, reduce with 0x87
+static void cmac_double(uint8_t block[16]) {
+    uint8_t carry = block[0] & 0x80;
+    for (int i = 0; i < 15; i++) {
+        block[i] = (uint8_t)(block[i] << 1 | block[i + 1] >> 7);
+    }
+    block[15] = (uint8_t)(block[15] << 1);
+    if (carry) {
+        block[15] ^= 0x87;
+    }
+}
+
+void aes128_init(aes128_ctx_t *ctx, const uint8_t key[AES128_KEY_SIZE]) {
+    uint8_t rcon = 0x01;
+    memcpy(ctx->round_keys[0], key, AES128_KEY_SIZE);
+
+    for (int round = 1; round <= 10; round++) {
+        const uint8_t *prev = ctx->round_keys[round - 1];
+        uint8_t *next = ctx->round_keys[round];
+
+        // RotWord, SubWord, Rcon on the last word of the previous key
+        next[0] = prev[0] ^ aes_sbox[prev[13]] ^ rcon;
+        next[1] = prev[1] ^ aes_sbox[prev[14]];
+        next[2] = prev[2] ^ aes_sbox[prev[15]];
+        next[3] = prev[3] ^ aes_sbox[prev[12]];
+        for (int i = 4; i < 16; i++) {
+            next[i] = prev[i] ^ next[i - 4];
+        }
+        rcon = aes_xtime(rcon);
+    }
+
+    memset(ctx->cmac_k1, 0, sizeof(ctx->cmac_k1));
+    aes128_encrypt_block(ctx, ctx->cmac_k1, ctx->cmac_k1);
+    cmac_double(ctx->cmac_k1);
+}
+
+void RAM_FUNC(aes128_encrypt_block)(const aes128_ctx_t *ctx, const uint8_t in[AES128_BLOCK_SIZE],
+                                    uint8_t out[AES128_BLOCK_SIZE]) {
+    uint8_t s[16];
+    memcpy(s, in, 16);
+    aes_add_round_key(s, ctx->round_keys[0]);
+
+    for (int round = 1; round <= 10; round++) {
+        for (int i = 0; i < 16; i++) {
+            s[i] = aes_sbox[s[i]];
+        }
+        aes_shift_rows(s);
+        if (round < 10) {
+            aes_mix_columns(s);
+        }
+        aes_add_round_key(s, ctx->round_keys[round]);
+    }
+
+    memcpy(out, s, 16);
+    aes_blocks++;
+}
+
+void aes128_decrypt_block(const aes128_ctx_t *ctx, const uint8_t in[AES128_BLOCK_SIZE],
+                          uint8_t out[AES128_BLOCK_SIZE]) {
+    uint8_t s[16];
+    memcpy(s, in, 16);
+    aes_add_round_key(s, ctx->round_keys[10]);
+
+    for (int round = 9; round >= 0; round--) {
+        aes_inv_shift_rows(s);
+        for (int i = 0; i < 16; i++) {
+            s[i] = aes_inv_sbox[s[i]];
+        }
+        aes_add_round_key(s, ctx->round_keys[round]);
+        if (round > 0) {
+            aes_inv_mix_columns(s);
+        }
+    }
+
+    memcpy(out, s, 16);
+    aes_blocks++;
+}
+
+void aes128_cbc_encrypt(const aes128_ctx_t *ctx, const uint8_t iv[AES128_BLOCK_SIZE],
+                        const uint8_t *in, uint8_t *out, size_t len) {
+    uint8_t chain[16];
+    memcpy(chain, iv, 16);
+
+    for (size_t offset = 0; offset + 16 <= len; offset += 16) {
+        for (int i = 0; i < 16; i++) {
+            chain[i] ^= in[offset + i];
+        }
+        aes128_encrypt_block(ctx, chain, chain);
+        memcpy(out + offset, chain, 16);
+    }
+}
+
+void aes128_cbc_decrypt(const aes128_ctx_t *ctx, const uint8_t iv[AES128_BLOCK_SIZE],
+                        const uint8_t *in, uint8_t *out, size_t len) {
+    uint8_t chain[16], block[16];
+    memcpy(chain, iv, 16);
+
+    for (size_t offset = 0; offset + 16 <= len; offset += 16) {
+        memcpy(block, in + offset, 16);
+        aes128_decrypt_block(ctx, block, out + offset);
+        for (int i = 0; i < 16; i++) {
+            out[offset + i] ^= chain[i];
+        }
+        memcpy(chain, block, 16);
+    }
+}
+
+void aes128_cmac_init(aes128_cmac_ctx_t *ctx, const aes128_ctx_t *cipher) {
+    ctx->cipher = cipher;
+    memset(ctx->state, 0, sizeof(ctx->state));
+    ctx->buffer_len = 0;
+}
+
+void aes128_cmac_update(aes128_cmac_ctx_t *ctx, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        // The last block is held back: final() has to tweak it
+        if (ctx->buffer_len == 16) {
+            for (int i = 0; i < 16; i++) {
+                ctx->state[i] ^= ctx->buffer[i];
+            }
+            aes128_encrypt_block(ctx->cipher, ctx->state, ctx->state);
+            ctx->buffer_len = 0;
+        }
+
+        size_t take = 16 - ctx->buffer_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(ctx->buffer + ctx->buffer_len, data, take);
+        ctx->buffer_len += take;
+        data += take;
+        len -= take;
+    }
+}
+
+void aes128_cmac_final(aes128_cmac_ctx_t *ctx, uint8_t mac[AES128_BLOCK_SIZE]) {
+    uint8_t subkey[16];
+    memcpy(subkey, ctx->cipher->cmac_k1, sizeof(subkey));   // K1 for a complete last block
+
+    if (ctx->buffer_len < 16) {
+        cmac_double(subkey);            // K2 for a padded one
+        ctx->buffer[ctx->buffer_len] = 0x80;
+        memset(ctx->buffer + ctx->buffer_len + 1, 0, 15 - ctx->buffer_len);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        ctx->state[i] ^= ctx->buffer[i] ^ subkey[i];
+    }
+    aes128_encrypt_block(ctx->cipher, ctx->state, mac);
+}
+
+void aes128_cmac(const aes128_ctx_t *cipher, const uint8_t *data, size_t len, uint8_t mac[AES128_BLOCK_SIZE]) {
+    aes128_cmac_ctx_t ctx;
+    aes128_cmac_init(&ctx, cipher);
+    aes128_cmac_update(&ctx, data, len);
+    aes128_cmac_final(&ctx, mac);
+}
+
+uint32_t aes128_block_count(void) {
+    return aes_blocks;
+}
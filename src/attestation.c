@@ -0,0 +1,37 @@
+#include "attestation.h"
+#include "secp256k1.h"
+#include "sha256.h"
+#include <string.h>
+
+static void put_u32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+void attestation_encode(const attestation_claims_t *claims, uint8_t message[ATTESTATION_MESSAGE_SIZE]) {
+    put_u32(message, ATTESTATION_MAGIC);
+    message[4] = (uint8_t)ATTESTATION_VERSION;
+    message[5] = (uint8_t)(ATTESTATION_VERSION >> 8);
+    message[6] = claims->tamper_intact ? 1 : 0;
+    message[7] = 0;
+    memcpy(message + 8, claims->challenge, ATTESTATION_CHALLENGE_SIZE);
+    put_u32(message + 40, claims->serial);
+    put_u32(message + 44, claims->tamper_count);
+    put_u32(message + 48, claims->state_counter);
+    memcpy(message + 52, claims->firmware_root, 32);
+}
+
+void attestation_digest(const attestation_claims_t *claims, uint8_t digest[32]) {
+    uint8_t message[ATTESTATION_MESSAGE_SIZE];
+    attestation_encode(claims, message);
+    sha256(message, sizeof(message), digest);
+}
+
+bool attestation_verify(const attestation_claims_t *claims, const uint8_t pubkey[33],
+                        const uint8_t signature[ATTESTATION_SIGNATURE_SIZE]) {
+    uint8_t digest[32];
+    attestation_digest(claims, digest);
+    return secp256k1_ecdsa_verify(pubkey, digest, signature);
+}
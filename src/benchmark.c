@@ -0,0 +1,348 @@
+#include "cashstick.h"
+#include "ripemd160.h"
+#include "tree_hash.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/xip_ctrl.h"
+
+// On-target benchmarks, built only with -DCASHSTICK_BENCHMARKS=ON.
+// Results are printed over stdio as one line per measurement.
+
+#define BENCH_SIGHASH_TX_LEN 1024
+#define BENCH_PROFILE_PERIOD_US 97      // Prime, so sampling does not beat with loops
+#define BENCH_PROFILE_ROUNDS 8
+
+typedef struct {
+    const char *name;
+    uint32_t iterations;
+    void (*run)(void);
+} bench_workload_t;
+
+static uint8_t bench_tx[BENCH_SIGHASH_TX_LEN];
+static volatile uint8_t bench_sink;
+
+// Full address table (hash160 encodings + taproot tweak) for a fixed key
+static void bench_address_derivation(void) {
+    static const uint8_t pubkey[33] = {
+        0x02, 0x79, 0xbe, 0x66, 0x7e, 0xf9, 0xdc, 0xbb, 0xac, 0x55, 0xa0, 0x62, 0x95, 0xce, 0x87, 0x0b,
+        0x07, 0x02, 0x9b, 0xfc, 0xdb, 0x2d, 0xce, 0x28, 0xd9, 0x59, 0xf2, 0x81, 0x5b, 0x16, 0xf8, 0x17, 0x98
+    };
+    address_table_t table;
+    address_table_build(pubkey, &table);
+    bench_sink = (uint8_t)table.p2tr[4];
+}
+
+// Sighash-sized double SHA-256 over a 1 KB serialized transaction
+static void bench_sighash(void) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256d(bench_tx, sizeof(bench_tx), digest);
+    bench_sink = digest[0];
+}
+
+static void bench_hash160(void) {
+    uint8_t digest[RIPEMD160_DIGEST_SIZE];
+    hash160(bench_tx, 33, digest);
+    bench_sink = digest[0];
+}
+
+static void bench_drbg(void) {
+    uint8_t buffer[256];
+    entropy_random(buffer, sizeof(buffer));
+    bench_sink = buffer[0];
+}
+
+static const bench_workload_t clock_workloads[] = {
+    { "address_derivation", 8,  bench_address_derivation },
+    { "sighash_1k",         64, bench_sighash },
+};
+
+// Latency and estimated energy per operation at each operating point
+static void bench_clock_operating_points(void) {
+    clock_op_t restore_op = clock_governor_get_op();
+
+    printf("BENCH: clock operating points (energy is an estimate)\n");
+    for (size_t w = 0; w < count_of(clock_workloads); w++) {
+        const bench_workload_t *workload = &clock_workloads[w];
+
+        for (clock_op_t op = CLOCK_OP_IDLE; op < CLOCK_OP_COUNT; op++) {
+            clock_governor_set_op(op);
+            workload->run();  // Warm the XIP cache
+
+            uint64_t start = time_us_64();
+            for (uint32_t i = 0; i < workload->iterations; i++) {
+                workload->run();
+            }
+            uint32_t elapsed_us = (uint32_t)(time_us_64() - start);
+            uint32_t per_op_us = elapsed_us / workload->iterations;
+
+            printf("BENCH: %-20s %-8s %6lu kHz %8lu us/op %8lu uJ/op\n",
+                   workload->name,
+                   clock_governor_op_name(op),
+                   (unsigned long)clock_governor_op_khz(op),
+                   (unsigned long)per_op_us,
+                   (unsigned long)clock_governor_estimate_energy_uj(op, per_op_us));
+        }
+    }
+
+    clock_governor_set_op(restore_op);
+}
+
+// Kernels for cycle counts and the profile
+static const bench_workload_t kernel_workloads[] = {
+    { "sighash_1k",         16, bench_sighash },
+    { "hash160",            64, bench_hash160 },
+    { "drbg_256",           16, bench_drbg },
+    { "address_derivation", 2,  bench_address_derivation },
+};
+
+static void bench_flush_xip_cache(void) {
+    xip_ctrl_hw->flush = 1;
+    (void)xip_ctrl_hw->flush;   // Read blocks until the flush completes
+}
+
+// Cycles per operation with a cold XIP cache (flushed before every run,
+// as after a flash write) and a warm one. Run once with and once without
+// CASHSTICK_RAM_FUNCTIONS and compare with tools/hot_functions.py compare.
+static void bench_kernel_cycles(void) {
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+
+    printf("BENCH: cycles per op, RAM functions %s\n", CASHSTICK_RAM_FUNCTIONS ? "on" : "off");
+    for (size_t w = 0; w < count_of(kernel_workloads); w++) {
+        const bench_workload_t *workload = &kernel_workloads[w];
+
+        uint64_t cold_us = 0;
+        for (uint32_t i = 0; i < workload->iterations; i++) {
+            bench_flush_xip_cache();
+            uint64_t start = time_us_64();
+            workload->run();
+            cold_us += time_us_64() - start;
+        }
+
+        workload->run();
+        uint64_t start = time_us_64();
+        for (uint32_t i = 0; i < workload->iterations; i++) {
+            workload->run();
+        }
+        uint64_t warm_us = time_us_64() - start;
+
+        printf("BENCH: cycles %-20s cold %10lu warm %10lu\n", workload->name,
+               (unsigned long)(cold_us * mhz / workload->iterations),
+               (unsigned long)(warm_us * mhz / workload->iterations));
+        watchdog_update();
+    }
+}
+
+// Where the kernels spend their time, for tools/hot_functions.py select
+static void bench_profile(void) {
+    printf("BENCH: profiling kernels\n");
+    profiler_start(BENCH_PROFILE_PERIOD_US);
+    for (uint32_t round = 0; round < BENCH_PROFILE_ROUNDS; round++) {
+        for (size_t w = 0; w < count_of(kernel_workloads); w++) {
+            // Every other round cold, so post-write misses show up too
+            if (round & 1) {
+                bench_flush_xip_cache();
+            }
+            for (uint32_t i = 0; i < kernel_workloads[w].iterations; i++) {
+                kernel_workloads[w].run();
+            }
+        }
+        watchdog_update();
+    }
+    profiler_stop();
+    profiler_dump();
+}
+
+// Random-byte throughput: DRBG from RAM vs asking the SE050 every time
+static void bench_entropy(void) {
+    static const size_t request_sizes[] = { 4, 32, 256 };
+    uint8_t buffer[256];
+
+    printf("BENCH: random bytes, DRBG vs direct SE050 TRNG\n");
+    for (size_t s = 0; s < count_of(request_sizes); s++) {
+        size_t len = request_sizes[s];
+        const uint32_t iterations = 32;
+
+        uint64_t start = time_us_64();
+        for (uint32_t i = 0; i < iterations; i++) {
+            entropy_random(buffer, len);
+        }
+        uint32_t drbg_us = (uint32_t)(time_us_64() - start) / iterations;
+
+        start = time_us_64();
+        for (uint32_t i = 0; i < iterations; i++) {
+            se050_get_random(buffer, len);
+        }
+        uint32_t se050_us = (uint32_t)(time_us_64() - start) / iterations;
+        bench_sink = buffer[0];
+
+        printf("BENCH: random_%-3u        drbg %8lu us/op   se050 %8lu us/op\n",
+               (unsigned)len, (unsigned long)drbg_us, (unsigned long)se050_us);
+    }
+}
+
+#define BENCH_FAULT_SAMPLES 128
+#define BENCH_ATTEST_SAMPLES 16
+#define BENCH_STATUS_POLLS 64
+
+static uint32_t bench_latency_us[BENCH_FAULT_SAMPLES];
+
+static void bench_sort_u32(uint32_t *values, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        uint32_t v = values[i];
+        size_t j = i;
+        while (j > 0 && values[j - 1] > v) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = v;
+    }
+}
+
+// ATTEST latency on the stick, split into gathering the claims (tamper
+// check included) and the SE050 signature
+static void bench_attestation(void) {
+    static uint32_t sign_us[BENCH_ATTEST_SAMPLES];
+    uint8_t challenge[ATTESTATION_CHALLENGE_SIZE];
+    attestation_result_t result;
+
+    if (!wallet_is_initialized()) {
+        printf("BENCH: attestation skipped, no wallet\n");
+        return;
+    }
+
+    uint32_t samples = 0;
+    for (uint32_t i = 0; i < BENCH_ATTEST_SAMPLES; i++) {
+        entropy_random(challenge, sizeof(challenge));
+        uint64_t start = time_us_64();
+        if (wallet_attest(challenge, &result)) {
+            bench_latency_us[samples] = (uint32_t)(time_us_64() - start);
+            sign_us[samples] = result.sign_us;
+            samples++;
+        }
+        watchdog_update();
+    }
+    if (samples == 0) {
+        printf("BENCH: attestation failed\n");
+        return;
+    }
+
+    bench_sort_u32(bench_latency_us, samples);
+    bench_sort_u32(sign_us, samples);
+    printf("BENCH: attest p50 %7lu us  max %7lu us  (sign p50 %7lu us)  %lu/%u ok\n",
+           (unsigned long)bench_latency_us[samples / 2], (unsigned long)bench_latency_us[samples - 1],
+           (unsigned long)sign_us[samples / 2], (unsigned long)samples, BENCH_ATTEST_SAMPLES);
+}
+
+// Tree hash of the firmware image on one core, then on two. The root
+// must match the measured image root, which measured boot built from its
+// leaf cache.
+static void bench_bulk_digest(void) {
+    extern char __flash_binary_end;
+    uint32_t image_len = (uint32_t)((uintptr_t)&__flash_binary_end - XIP_BASE);
+    uint32_t len = (image_len + BULK_DIGEST_CHUNK_SIZE - 1) / BULK_DIGEST_CHUNK_SIZE * BULK_DIGEST_CHUNK_SIZE;
+    const uint8_t *image_root = measured_boot_get()->image_root;
+
+    printf("BENCH: bulk digest of %lu byte image\n", (unsigned long)len);
+    for (int cores = 1; cores <= 2; cores++) {
+        uint8_t root[SHA256_DIGEST_SIZE];
+        bulk_digest_stats_t stats;
+        watchdog_update();
+        clock_boost_begin();
+        bool ok = bulk_digest_flash(0, len, root, cores == 2, &stats);
+        clock_boost_end();
+
+        uint32_t kb_per_s = stats.elapsed_us > 0 ? (uint32_t)((uint64_t)stats.bytes * 1000000 / 1024 / stats.elapsed_us) : 0;
+        printf("BENCH: digest %d core%s %8lu us  %4lu.%02lu MB/s  leaves %lu/%lu  %s\n",
+               cores, cores == 1 ? " " : "s", (unsigned long)stats.elapsed_us,
+               (unsigned long)(kb_per_s / 1024), (unsigned long)(kb_per_s % 1024 * 100 / 1024),
+               (unsigned long)stats.leaves[0], (unsigned long)stats.leaves[1],
+               !ok ? "FAILED" : memcmp(root, image_root, SHA256_DIGEST_SIZE) == 0 ? "matches image root" : "MISMATCH");
+    }
+}
+
+// A host polling STATUS runs the full tamper check each time. However
+// often it polls, the custody journal must not grow, nor the tamper count
+// and device record change.
+static void bench_status_polling(void) {
+    journal_stats_t before, after;
+    tamper_status_t status = tamper_check_integrity();  // The boot's first verdict is journaled
+    uint32_t tamper_count = status.tamper_count;
+    uint32_t commits = device_state_commit_count();
+    journal_get_stats(&before);
+
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < BENCH_STATUS_POLLS; i++) {
+        status = tamper_check_integrity();
+        watchdog_update();
+    }
+    uint32_t elapsed_us = (uint32_t)(time_us_64() - start);
+
+    journal_get_stats(&after);
+    bool unchanged = after.records == before.records && after.reclaimed == before.reclaimed &&
+                     status.tamper_count == tamper_count && device_state_commit_count() == commits;
+    printf("BENCH: %u STATUS polls  %7lu us each  journal records %lu -> %lu  tamper count %lu -> %lu  %s\n",
+           BENCH_STATUS_POLLS, (unsigned long)(elapsed_us / BENCH_STATUS_POLLS),
+           (unsigned long)before.records, (unsigned long)after.records,
+           (unsigned long)tamper_count, (unsigned long)status.tamper_count,
+           unchanged ? "unchanged" : "CHANGED");
+}
+
+#if CASHSTICK_I2C_FAULT_INJECTION
+
+// SE050 command latency percentiles with injected bus faults
+static void bench_i2c_faults(void) {
+    static const uint32_t fault_rates[] = { 0, 10, 50, 200 };   // Per mille
+    uint8_t buffer[32];
+
+    printf("BENCH: SE050 32-byte random under injected I2C faults\n");
+    for (size_t r = 0; r < count_of(fault_rates); r++) {
+        i2c_stats_t before, after;
+        se050_session_stats_t session_before, session_after;
+        se050_i2c_get_stats(&before);
+        se050_get_session_stats(&session_before);
+        se050_i2c_inject_faults(fault_rates[r]);
+
+        uint32_t failed = 0;
+        for (uint32_t i = 0; i < BENCH_FAULT_SAMPLES; i++) {
+            uint64_t start = time_us_64();
+            if (!se050_get_random(buffer, sizeof(buffer))) {
+                failed++;
+            }
+            bench_latency_us[i] = (uint32_t)(time_us_64() - start);
+            watchdog_update();
+        }
+
+        se050_i2c_inject_faults(0);
+        se050_i2c_get_stats(&after);
+        se050_get_session_stats(&session_after);
+        bench_sort_u32(bench_latency_us, BENCH_FAULT_SAMPLES);
+
+        printf("BENCH: faults %4lu/1000  p50 %7lu us  p99 %7lu us  max %7lu us  failed %lu  recoveries %lu  handshakes %lu\n",
+               (unsigned long)fault_rates[r],
+               (unsigned long)bench_latency_us[BENCH_FAULT_SAMPLES / 2],
+               (unsigned long)bench_latency_us[(BENCH_FAULT_SAMPLES * 99) / 100],
+               (unsigned long)bench_latency_us[BENCH_FAULT_SAMPLES - 1],
+               (unsigned long)failed,
+               (unsigned long)(after.recoveries - before.recoveries),
+               (unsigned long)(session_after.handshakes - session_before.handshakes));
+    }
+}
+#endif
+
+void benchmark_run_all(void) {
+    for (size_t i = 0; i < sizeof(bench_tx); i++) {
+        bench_tx[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    printf("BENCH: Starting benchmarks\n");
+    bench_clock_operating_points();
+    bench_entropy();
+    bench_kernel_cycles();
+    bench_profile();
+    bench_attestation();
+    bench_bulk_digest();
+    bench_status_polling();
+#if CASHSTICK_I2C_FAULT_INJECTION
+    bench_i2c_faults();
+#endif
+    printf("BENCH: Done\n");
+}
@@ -0,0 +1,236 @@
+#include "bitcoin_address.h"
+#include "ripemd160.h"
+#include "secp256k1.h"
+#include "sha256.h"
+#include <string.h>
+
+#define ADDRESS_HRP "bc"
+#define P2PKH_VERSION 0x00
+
+#define BECH32_CONST 1u
+#define BECH32M_CONST 0x2bc830a3u
+
+static const char *const address_format_names[ADDRESS_FORMAT_COUNT] = {
+    [ADDRESS_FORMAT_P2WPKH] = "p2wpkh",
+    [ADDRESS_FORMAT_P2TR]   = "p2tr",
+    [ADDRESS_FORMAT_P2PKH]  = "p2pkh",
+};
+
+static const char base58_alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+static const char bech32_charset[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+static bool taproot_output_key(const uint8_t pubkey[33], uint8_t output_x[32]);
+
+bool address_table_build(const uint8_t pubkey[33], address_table_t *table) {
+    if (!pubkey || !table) {
+        return false;
+    }
+
+    memset(table, 0, sizeof(*table));
+    table->version = ADDRESS_TABLE_VERSION;
+
+    uint8_t key_hash[RIPEMD160_DIGEST_SIZE];
+    hash160(pubkey, 33, key_hash);
+
+    if (segwit_address_encode(ADDRESS_HRP, 0, key_hash, sizeof(key_hash),
+                              table->p2wpkh, sizeof(table->p2wpkh))) {
+        table->format_mask |= 1u << ADDRESS_FORMAT_P2WPKH;
+    }
+
+    if (base58check_encode(P2PKH_VERSION, key_hash, sizeof(key_hash),
+                           table->p2pkh, sizeof(table->p2pkh))) {
+        table->format_mask |= 1u << ADDRESS_FORMAT_P2PKH;
+    }
+
+    // The taproot tweak is the expensive one (a full scalar multiplication)
+    uint8_t output_x[32];
+    if (taproot_output_key(pubkey, output_x) &&
+        segwit_address_encode(ADDRESS_HRP, 1, output_x, sizeof(output_x),
+                              table->p2tr, sizeof(table->p2tr))) {
+        table->format_mask |= 1u << ADDRESS_FORMAT_P2TR;
+    }
+
+    return table->format_mask != 0;
+}
+
+const char *address_table_get(const address_table_t *table, address_format_t format) {
+    if (!table || format >= ADDRESS_FORMAT_COUNT || !(table->format_mask & (1u << format))) {
+        return NULL;
+    }
+
+    switch (format) {
+        case ADDRESS_FORMAT_P2WPKH:
+            return table->p2wpkh;
+        case ADDRESS_FORMAT_P2TR:
+            return table->p2tr;
+        case ADDRESS_FORMAT_P2PKH:
+            return table->p2pkh;
+        default:
+            return NULL;
+    }
+}
+
+bool address_table_is_current(const address_table_t *table) {
+    return table && table->version == ADDRESS_TABLE_VERSION && table->format_mask != 0;
+}
+
+const char *address_format_name(address_format_t format) {
+    return format < ADDRESS_FORMAT_COUNT ? address_format_names[format] : "unknown";
+}
+
+bool address_format_parse(const char *name, address_format_t *format) {
+    for (int i = 0; i < ADDRESS_FORMAT_COUNT; i++) {
+        if (strcmp(name, address_format_names[i]) == 0) {
+            *format = (address_format_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool base58check_encode(uint8_t version, const uint8_t *payload, size_t payload_len,
+                        char *out, size_t out_len) {
+    uint8_t data[1 + 32 + 4];
+    if (payload_len > 32) {
+        return false;
+    }
+
+    // version || payload || first four bytes of sha256d
+    uint8_t checksum[SHA256_DIGEST_SIZE];
+    data[0] = version;
+    memcpy(data + 1, payload, payload_len);
+    sha256d(data, 1 + payload_len, checksum);
+    memcpy(data + 1 + payload_len, checksum, 4);
+    size_t data_len = 1 + payload_len + 4;
+
+    // Base conversion into digits, least significant first
+    uint8_t digits[64] = {0};
+    size_t digit_count = 0;
+    for (size_t i = 0; i < data_len; i++) {
+        uint32_t carry = data[i];
+        for (size_t j = 0; j < digit_count; j++) {
+            carry += (uint32_t)digits[j] << 8;
+            digits[j] = (uint8_t)(carry % 58);
+            carry /= 58;
+        }
+        while (carry > 0) {
+            digits[digit_count++] = (uint8_t)(carry % 58);
+            carry /= 58;
+        }
+    }
+
+    // Each leading zero byte is written as '1'
+    size_t leading_zeros = 0;
+    while (leading_zeros < data_len && data[leading_zeros] == 0) {
+        leading_zeros++;
+    }
+
+    if (leading_zeros + digit_count + 1 > out_len) {
+        return false;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < leading_zeros; i++) {
+        out[pos++] = '1';
+    }
+    for (size_t i = digit_count; i > 0; i--) {
+        out[pos++] = base58_alphabet[digits[i - 1]];
+    }
+    out[pos] = '\0';
+    return true;
+}
+
+// BIP173 checksum polynomial
+static uint32_t bech32_polymod_step(uint32_t chk, uint8_t value) {
+    uint32_t top = chk >> 25;
+    chk = ((chk & 0x1ffffff) << 5) ^ value;
+    if (top & 1) chk ^= 0x3b6a57b2;
+    if (top & 2) chk ^= 0x26508e6d;
+    if (top & 4) chk ^= 0x1ea119fa;
+    if (top & 8) chk ^= 0x3d4233dd;
+    if (top & 16) chk ^= 0x2a1462b3;
+    return chk;
+}
+
+bool segwit_address_encode(const char *hrp, uint8_t witness_version,
+                           const uint8_t *program, size_t program_len,
+                           char *out, size_t out_len) {
+    // Witness version followed by the program regrouped into 5-bit words
+    uint8_t words[1 + 52];
+    size_t word_count = 0;
+    if (program_len > 32) {
+        return false;
+    }
+
+    words[word_count++] = witness_version;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < program_len; i++) {
+        acc = (acc << 8) | program[i];
+        bits += 8;
+        while (bits >= 5) {
+            bits -= 5;
+            words[word_count++] = (acc >> bits) & 0x1f;
+        }
+    }
+    if (bits > 0) {
+        words[word_count++] = (acc << (5 - bits)) & 0x1f;
+    }
+
+    size_t hrp_len = strlen(hrp);
+    if (hrp_len + 1 + word_count + 6 + 1 > out_len) {
+        return false;
+    }
+
+    // Checksum over the expanded HRP, the data and six zero words
+    uint32_t chk = 1;
+    for (size_t i = 0; i < hrp_len; i++) {
+        chk = bech32_polymod_step(chk, (uint8_t)(hrp[i] >> 5));
+    }
+    chk = bech32_polymod_step(chk, 0);
+    for (size_t i = 0; i < hrp_len; i++) {
+        chk = bech32_polymod_step(chk, (uint8_t)(hrp[i] & 0x1f));
+    }
+    for (size_t i = 0; i < word_count; i++) {
+        chk = bech32_polymod_step(chk, words[i]);
+    }
+    for (int i = 0; i < 6; i++) {
+        chk = bech32_polymod_step(chk, 0);
+    }
+    // Version 0 uses bech32, later versions bech32m (BIP350)
+    chk ^= (witness_version == 0) ? BECH32_CONST : BECH32M_CONST;
+
+    size_t pos = 0;
+    memcpy(out, hrp, hrp_len);
+    pos += hrp_len;
+    out[pos++] = '1';
+    for (size_t i = 0; i < word_count; i++) {
+        out[pos++] = bech32_charset[words[i]];
+    }
+    for (int i = 0; i < 6; i++) {
+        out[pos++] = bech32_charset[(chk >> (5 * (5 - i))) & 0x1f];
+    }
+    out[pos] = '\0';
+    return true;
+}
+
+// Internal helper functions
+
+// BIP86 key-path-only output key: Q = P + H_TapTweak(P.x) * G
+static bool taproot_output_key(const uint8_t pubkey[33], uint8_t output_x[32]) {
+    static const char tag[] = "TapTweak";
+    uint8_t tag_hash[SHA256_DIGEST_SIZE];
+    uint8_t tweak[SHA256_DIGEST_SIZE];
+    const uint8_t *internal_x = pubkey + 1;
+
+    // Tagged hash: sha256(sha256(tag) || sha256(tag) || x)
+    sha256((const uint8_t *)tag, sizeof(tag) - 1, tag_hash);
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, tag_hash, sizeof(tag_hash));
+    sha256_update(&ctx, tag_hash, sizeof(tag_hash));
+    sha256_update(&ctx, internal_x, 32);
+    sha256_final(&ctx, tweak);
+
+    return secp256k1_xonly_tweak_add(internal_x, tweak, output_x, NULL);
+}
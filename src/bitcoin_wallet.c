@@ -1,65 +1,134 @@
 #include "cashstick.h"
+#include "secp256k1.h"
 
-// Global wallet state
-static bitcoin_keys_t wallet_keys = {0};
-static bool wallet_initialized = false;
+// The wallet keys are owned by the device state machine (device_state.c)
 
 bool wallet_generate_new_keys(void) {
-    printf("WALLET: Generating new Bitcoin keys\n");
+    provision_result_t result;
+    return wallet_provision(&result);
+}
+
+// Keygen, address derivation, seal, one flash commit and a tamper self-test
+// in one call, each stage timed. Runs boosted end to end; the only flash
+// erase is the device record commit.
+bool wallet_provision(provision_result_t *result) {
+    memset(result, 0, sizeof(*result));
     
-    led_set_state(LED_STATE_BUSY);
+    printf("WALLET: Provisioning\n");
     
-    // Use SE050 to generate cryptographically secure keys
-    if (!se050_generate_bitcoin_keys(&wallet_keys)) {
-        printf("WALLET: Key generation failed\n");
-        led_set_state(LED_STATE_UNSEALED);
+    if (device_state_get() != DEVICE_STATE_NEW && device_state_get() != DEVICE_STATE_INITIALIZED) {
+        result->failed_stage = "state";
         return false;
     }
     
-    // Store keys securely in flash
-    if (!flash_write_keys(&wallet_keys)) {
-        printf("WALLET: Failed to store keys\n");
+    led_set_state(LED_STATE_BUSY);
+    clock_boost_begin();
+    
+    uint32_t commits_before = device_state_commit_count();
+    uint64_t start = time_us_64();
+    uint64_t stage = start;
+    
+    // Take a keypair pre-generated by the SE050 (or generate one now)
+    bitcoin_keys_t keys;
+    result->from_pool = key_pool_ready_count() > 0;
+    bool claimed = key_pool_claim(&keys);
+    bool ok = claimed;
+    result->keygen_us = (uint32_t)(time_us_64() - stage);
+    if (!ok) {
+        result->failed_stage = "keygen";
+    }
+    
+    // Seal first, so the keys, the seal and the SEALED state go to flash
+    // in one commit
+    if (ok) {
+        stage = time_us_64();
+        ok = tamper_seal_device();
+        result->seal_us = (uint32_t)(time_us_64() - stage);
+        if (!ok) {
+            result->failed_stage = "seal";
+        }
+    }
+    
+    if (ok) {
+        stage = time_us_64();
+        ok = device_state_dispatch(DEVICE_EVENT_KEYS_CREATED, &keys);
+        result->commit_us = (uint32_t)(time_us_64() - stage);
+        if (!ok) {
+            result->failed_stage = "commit";
+        }
+    }
+    
+    // Nothing references the key yet; let the pool regenerate its slot
+    if (!ok && claimed) {
+        key_pool_release(keys.key_object_id);
+    }
+    
+    // Verify what was just written, without tripping the tamper response
+    if (ok) {
+        stage = time_us_64();
+        result->self_test_passed = tamper_self_test();
+        result->self_test_us = (uint32_t)(time_us_64() - stage);
+        if (!result->self_test_passed) {
+            result->failed_stage = "selftest";
+            ok = false;
+        }
+    }
+    
+    result->total_us = (uint32_t)(time_us_64() - start);
+    result->flash_commits = device_state_commit_count() - commits_before;
+    clock_boost_end();
+    
+    if (!ok) {
+        printf("WALLET: Provisioning failed at %s\n", result->failed_stage);
         led_set_state(LED_STATE_UNSEALED);
         return false;
     }
     
-    wallet_initialized = true;
-    printf("WALLET: New Bitcoin address: %s\n", wallet_keys.address);
-    
-    // Seal the device after key generation
-    tamper_seal_device();
+    printf("WALLET: New Bitcoin address: %s (%lu us)\n",
+           address_table_get(&keys.addresses, ADDRESS_FORMAT_DEFAULT), (unsigned long)result->total_us);
     
     led_set_state(LED_STATE_SEALED);
     return true;
 }
 
-bool wallet_get_address(char *address_out, size_t max_len) {
-    if (!wallet_initialized) {
-        // Try to load keys from flash
-        if (!flash_read_keys(&wallet_keys)) {
+bool wallet_get_address(address_format_t format, char *address_out, size_t max_len) {
+    const bitcoin_keys_t *keys = device_state_keys();
+    if (!keys->is_sealed) {
+        return false;
+    }
+    
+    // Tables from older firmware are rebuilt once and stored back
+    if (!address_table_is_current(&keys->addresses)) {
+        printf("WALLET: Rebuilding address table\n");
+        bitcoin_keys_t rebuilt = *keys;
+        clock_boost_begin();
+        bool built = address_table_build(rebuilt.public_key, &rebuilt.addresses);
+        clock_boost_end();
+        if (!built || !device_state_dispatch(DEVICE_EVENT_KEYS_REFRESHED, &rebuilt)) {
             return false;
         }
-        wallet_initialized = true;
     }
     
-    if (!wallet_keys.is_sealed || strlen(wallet_keys.address) == 0) {
+    const char *address = address_table_get(&keys->addresses, format);
+    if (!address) {
         return false;
     }
     
-    strncpy(address_out, wallet_keys.address, max_len - 1);
+    strncpy(address_out, address, max_len - 1);
     address_out[max_len - 1] = '\0';
     
     return true;
 }
 
 bool wallet_reveal_private_key(uint8_t *privkey_out) {
-    if (!wallet_initialized || !privkey_out) {
+    if (!wallet_is_initialized() || !privkey_out) {
         return false;
     }
     
-    // Only reveal private key if device has been tampered (seal broken)
+    // Only reveal private key if device has been tampered (seal broken);
+    // a failed check has already recorded the reveal
     tamper_status_t tamper_status = tamper_check_integrity();
-    if (tamper_status.is_intact) {
+    if (tamper_status.is_intact || !wallet_are_keys_revealed()) {
         printf("WALLET: Device still sealed - private key not accessible\n");
         return false;
     }
@@ -67,42 +136,71 @@ bool wallet_reveal_private_key(uint8_t *privkey_out) {
     printf("WALLET: Revealing private key for owner to sweep\n");
     
     // Copy private key for owner
-    memcpy(privkey_out, wallet_keys.private_key, 32);
-    wallet_keys.keys_revealed = true;
-    flash_write_keys(&wallet_keys);
+    memcpy(privkey_out, device_state_keys()->private_key, 32);
     
     return true;
 }
 
 bool wallet_are_keys_revealed(void) {
-    return wallet_keys.keys_revealed;
+    return device_state_keys()->keys_revealed;
 }
 
 bool wallet_export_public_key(uint8_t *pubkey_out) {
-    if (!wallet_initialized || !wallet_keys.is_sealed) {
+    if (!wallet_is_initialized()) {
         return false;
     }
     
-    memcpy(pubkey_out, wallet_keys.public_key, 33);
+    memcpy(pubkey_out, device_state_keys()->public_key, 33);
     return true;
 }
 
 bool wallet_verify_signature(const uint8_t *message, const uint8_t *signature) {
-    // Verify a signature against the wallet's public key
-    // This would implement ECDSA verification
+    // Verify a signature over a 32-byte hash against the wallet's public key
+    if (!wallet_is_initialized()) {
+        return false;
+    }
     
-    if (!wallet_initialized) {
+    return secp256k1_ecdsa_verify(device_state_keys()->public_key, message, signature);
+}
+
+// Sign the host's challenge together with serial, tamper state, record
+// commit count and firmware root (message layout in attestation.h)
+bool wallet_attest(const uint8_t challenge[ATTESTATION_CHALLENGE_SIZE], attestation_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    
+    if (!wallet_is_initialized()) {
         return false;
     }
     
-    // Use SE050 to verify signature (if supported)
-    // Otherwise implement software ECDSA verification
+    uint32_t metric_start = metrics_start();
+    uint64_t start = time_us_64();
     
-    return true;  // Placeholder
+    attestation_claims_t *claims = &result->claims;
+    tamper_status_t tamper_status = tamper_check_integrity();
+    memcpy(claims->challenge, challenge, ATTESTATION_CHALLENGE_SIZE);
+    claims->serial = get_device_serial();
+    claims->tamper_intact = tamper_status.is_intact;
+    claims->tamper_count = tamper_status.tamper_count;
+    claims->state_counter = device_state_commit_count();
+    memcpy(claims->firmware_root, measured_boot_get()->image_root, sizeof(claims->firmware_root));
+    
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    attestation_digest(claims, digest);
+    uint64_t signing = time_us_64();
+    result->claims_us = (uint32_t)(signing - start);
+    
+    bool ok = se050_sign_transaction(device_state_keys()->key_object_id, digest, result->signature);
+    result->sign_us = (uint32_t)(time_us_64() - signing);
+    metrics_end(METRIC_ATTEST, metric_start, ok);
+    
+    if (!ok) {
+        printf("WALLET: Attestation signature failed\n");
+    }
+    return ok;
 }
 
 bool wallet_is_initialized(void) {
-    return wallet_initialized && wallet_keys.is_sealed;
+    return device_state_keys()->is_sealed;
 }
 
 void wallet_get_status(char *status_json, size_t max_len) {
@@ -111,6 +209,8 @@ void wallet_get_status(char *status_json, size_t max_len) {
     }
     
     tamper_status_t tamper_status = tamper_check_integrity();
+    const bitcoin_keys_t *keys = device_state_keys();
+    const char *address = address_table_get(&keys->addresses, ADDRESS_FORMAT_DEFAULT);
     
     snprintf(status_json, max_len,
         "{"
@@ -118,12 +218,16 @@ void wallet_get_status(char *status_json, size_t max_len) {
         "\"sealed\":%s,"
         "\"address\":\"%s\","
         "\"tamper_intact\":%s,"
-        "\"tamper_count\":%d"
+        "\"tamper_count\":%d,"
+        "\"key_pool_ready\":%lu,"
+        "\"key_pool_depth\":%lu"
         "}",
-        wallet_initialized ? "true" : "false",
-        wallet_keys.is_sealed ? "true" : "false",
-        wallet_keys.is_sealed ? wallet_keys.address : "",
+        device_state_get() != DEVICE_STATE_NEW ? "true" : "false",
+        keys->is_sealed ? "true" : "false",
+        (keys->is_sealed && address) ? address : "",
         tamper_status.is_intact ? "true" : "false",
-        tamper_status.tamper_count
+        tamper_status.tamper_count,
+        (unsigned long)key_pool_ready_count(),
+        (unsigned long)key_pool_depth()
     );
 }
\ No newline at end of file
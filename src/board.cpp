@@ -0,0 +1,60 @@
+#include "board.h"
+#include "hal/board.hpp"
+#include "ram_functions.h"
+
+// The profile's parts are static types, so each wrapper below compiles to
+// the SDK call(s) for this board's pins with the constants folded in
+
+using Board = hal::Board;
+
+const char *board_name(void) {
+    return Board::name;
+}
+
+void board_led_init(void) {
+    Board::Led::init();
+}
+
+void board_led_set(uint8_t r, uint8_t g, uint8_t b) {
+    Board::Led::set(r, g, b);
+}
+
+void board_button_init(void) {
+    Board::TestButton::init();
+}
+
+bool board_button_pressed(void) {
+    return Board::TestButton::pressed();
+}
+
+unsigned board_button_gpio(void) {
+    return Board::TestButton::gpio;
+}
+
+void board_tamper_init(void) {
+    Board::TamperLoop::init();
+}
+
+bool board_tamper_loop_high(void) {
+    return Board::TamperLoop::read();
+}
+
+void board_se050_bus_init(void) {
+    Board::Se050Bus::init();
+}
+
+void board_se050_bus_restore_baudrate(void) {
+    Board::Se050Bus::restore_baudrate();
+}
+
+unsigned board_se050_bus_recover(uint32_t half_clock_us) {
+    return Board::Se050Bus::recover(half_clock_us);
+}
+
+int RAM_FUNC(board_se050_write)(uint8_t addr, const uint8_t *data, size_t len, uint32_t timeout_us) {
+    return Board::Se050Bus::write(addr, data, len, timeout_us);
+}
+
+int RAM_FUNC(board_se050_read)(uint8_t addr, uint8_t *data, size_t len, uint32_t timeout_us) {
+    return Board::Se050Bus::read(addr, data, len, timeout_us);
+}
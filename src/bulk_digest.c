@@ -0,0 +1,255 @@
+#include "cashstick.h"
+#include "tree_hash.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+
+// Bulk flash digests on both cores. The leaves of a tree hash
+// (tree_hash.h) are independent, so each core claims the next leaf under
+// a hardware spinlock and hashes it on its own. Flash is read by DMA
+// through the non-caching XIP alias into two small SRAM buffers per core:
+// the next piece streams in while the current one is hashed, and a region
+// far larger than the 16 KB XIP cache passes through without evicting the
+// code both cores are running from it.
+//
+// Core 1 is launched for each batch and held in reset again when it ends,
+// so it is never running while flash is erased or programmed. A batch
+// also holds the USB lock: the USB task programs flash itself while a
+// UF2 image streams in, and must not while core 1 or the DMA reads it. Only core 0
+// touches the scratch arena, metrics and the tree builder.
+
+#define BULK_DIGEST_DONE 0xD16E5700u
+#define BULK_DIGEST_WINDOW 32           // Leaves per batch in bulk_digest_flash
+
+typedef struct {
+    const uint32_t *offsets;            // Flash offset per leaf, or NULL: contiguous
+    uint32_t base;                      // Contiguous: region start and length
+    uint32_t len;
+    uint32_t first;                     // Contiguous: region leaf of batch leaf 0
+    uint32_t count;
+    uint8_t (*leaves)[SHA256_DIGEST_SIZE];
+    uint8_t *buffers[2][2];             // Per core, double-buffered prefetch
+    int dma_channel[2];
+    uint32_t next;                      // Next leaf to claim, under the lock
+    uint32_t hashed[2];
+} bulk_digest_job_t;
+
+static bulk_digest_job_t job;
+static spin_lock_t *job_lock = NULL;
+
+static bool bulk_digest_begin(bool dual_core);
+static void bulk_digest_end(bool dual_core);
+static void bulk_digest_run(bool dual_core);
+static void bulk_digest_core1_main(void);
+static void bulk_digest_worker(uint32_t core);
+static void bulk_digest_leaf(uint32_t core, uint32_t flash_offset, uint32_t len, uint8_t out[SHA256_DIGEST_SIZE]);
+static void bulk_digest_prefetch(int chan, uint8_t *dst, const uint8_t *src, uint32_t len);
+
+// Leaf hashes of whole chunks at arbitrary flash offsets, leaves[i] for
+// flash_offsets[i]
+bool bulk_digest_leaves(const uint32_t *flash_offsets, uint32_t count, uint8_t (*leaves)[SHA256_DIGEST_SIZE],
+                        bool dual_core, bulk_digest_stats_t *stats) {
+    uint32_t start = time_us_32();
+    size_t scratch = scratch_mark();
+    dual_core = dual_core && CASHSTICK_DUAL_CORE_DIGEST && count > 1;
+
+    if (!bulk_digest_begin(dual_core)) {
+        scratch_release(scratch);
+        return false;
+    }
+
+    job.offsets = flash_offsets;
+    job.count = count;
+    job.leaves = leaves;
+    bulk_digest_run(dual_core);
+    bulk_digest_end(dual_core);
+    scratch_release(scratch);
+
+    if (stats) {
+        stats->bytes = count * BULK_DIGEST_CHUNK_SIZE;
+        stats->elapsed_us = time_us_32() - start;
+        stats->leaves[0] = job.hashed[0];
+        stats->leaves[1] = job.hashed[1];
+    }
+    return true;
+}
+
+// Tree hash root of a flash region; len a multiple of 4, the last chunk
+// may be short
+bool bulk_digest_flash(uint32_t flash_offset, uint32_t len, uint8_t root[SHA256_DIGEST_SIZE],
+                       bool dual_core, bulk_digest_stats_t *stats) {
+    if (len % 4 != 0) {
+        return false;
+    }
+
+    uint32_t start = time_us_32();
+    uint32_t leaf_count = (len + BULK_DIGEST_CHUNK_SIZE - 1) / BULK_DIGEST_CHUNK_SIZE;
+    size_t scratch = scratch_mark();
+    tree_hash_builder_t *builder = scratch_alloc(sizeof(*builder));
+    uint8_t (*window)[SHA256_DIGEST_SIZE] = scratch_alloc(BULK_DIGEST_WINDOW * SHA256_DIGEST_SIZE);
+    dual_core = dual_core && CASHSTICK_DUAL_CORE_DIGEST && leaf_count > 1;
+
+    if (!builder || !window || !bulk_digest_begin(dual_core)) {
+        scratch_release(scratch);
+        return false;
+    }
+
+    tree_hash_builder_init(builder);
+    job.offsets = NULL;
+    job.base = flash_offset;
+    job.len = len;
+    job.leaves = window;
+
+    uint32_t hashed[2] = {0, 0};
+    for (uint32_t first = 0; first < leaf_count; first += BULK_DIGEST_WINDOW) {
+        job.first = first;
+        job.count = leaf_count - first < BULK_DIGEST_WINDOW ? leaf_count - first : BULK_DIGEST_WINDOW;
+        bulk_digest_run(dual_core);
+
+        // Leaves join the tree in order, whichever core hashed them
+        for (uint32_t i = 0; i < job.count; i++) {
+            tree_hash_builder_add(builder, window[i]);
+        }
+        hashed[0] += job.hashed[0];
+        hashed[1] += job.hashed[1];
+    }
+
+    tree_hash_builder_root(builder, root);
+    bulk_digest_end(dual_core);
+    scratch_release(scratch);
+
+    if (stats) {
+        stats->bytes = len;
+        stats->elapsed_us = time_us_32() - start;
+        stats->leaves[0] = hashed[0];
+        stats->leaves[1] = hashed[1];
+    }
+    return true;
+}
+
+// Internal helper functions
+
+// Prefetch buffers and DMA channels for the cores taking part; the
+// caller releases the scratch
+static bool bulk_digest_begin(bool dual_core) {
+    uint32_t cores = dual_core ? 2 : 1;
+    uint8_t *buffers = scratch_alloc(cores * 2 * BULK_DIGEST_PREFETCH_SIZE);
+    if (!buffers) {
+        return false;
+    }
+
+    if (!job_lock) {
+        job_lock = spin_lock_init(spin_lock_claim_unused(true));
+    }
+
+    memset(&job, 0, sizeof(job));
+    for (uint32_t core = 0; core < cores; core++) {
+        job.buffers[core][0] = buffers + (core * 2) * BULK_DIGEST_PREFETCH_SIZE;
+        job.buffers[core][1] = buffers + (core * 2 + 1) * BULK_DIGEST_PREFETCH_SIZE;
+        job.dma_channel[core] = dma_claim_unused_channel(true);
+    }
+    return true;
+}
+
+static void bulk_digest_end(bool dual_core) {
+    dma_channel_unclaim(job.dma_channel[0]);
+    if (dual_core) {
+        dma_channel_unclaim(job.dma_channel[1]);
+    }
+}
+
+// One batch: core 1 joins in for its duration
+static void bulk_digest_run(bool dual_core) {
+    job.next = 0;
+    job.hashed[0] = job.hashed[1] = 0;
+    usb_lock();
+
+    if (dual_core) {
+        multicore_reset_core1();
+        multicore_fifo_drain();
+        multicore_launch_core1(bulk_digest_core1_main);
+    }
+
+    bulk_digest_worker(0);
+
+    if (dual_core) {
+        while (multicore_fifo_pop_blocking() != BULK_DIGEST_DONE) {
+        }
+        multicore_reset_core1();
+    }
+    usb_unlock();
+}
+
+static void bulk_digest_core1_main(void) {
+    bulk_digest_worker(1);
+    multicore_fifo_push_blocking(BULK_DIGEST_DONE);
+
+    // Parked until core 0 resets it
+    while (true) {
+        __wfe();
+    }
+}
+
+static void bulk_digest_worker(uint32_t core) {
+    while (true) {
+        uint32_t save = spin_lock_blocking(job_lock);
+        uint32_t index = job.next;
+        if (index < job.count) {
+            job.next++;
+        }
+        spin_unlock(job_lock, save);
+
+        if (index >= job.count) {
+            return;
+        }
+
+        uint32_t offset;
+        uint32_t len = BULK_DIGEST_CHUNK_SIZE;
+        if (job.offsets) {
+            offset = job.offsets[index];
+        } else {
+            offset = job.base + (job.first + index) * BULK_DIGEST_CHUNK_SIZE;
+            if (job.base + job.len - offset < len) {
+                len = job.base + job.len - offset;
+            }
+        }
+
+        bulk_digest_leaf(core, offset, len, job.leaves[index]);
+        job.hashed[core]++;
+    }
+}
+
+// Hash one leaf, each piece streaming in by DMA while the last is hashed
+static void bulk_digest_leaf(uint32_t core, uint32_t flash_offset, uint32_t len, uint8_t out[SHA256_DIGEST_SIZE]) {
+    const uint8_t *src = (const uint8_t*)(XIP_NOCACHE_NOALLOC_BASE + flash_offset);
+    int chan = job.dma_channel[core];
+    sha256_ctx_t ctx;
+    tree_hash_leaf_init(&ctx);
+
+    uint32_t piece = len < BULK_DIGEST_PREFETCH_SIZE ? len : BULK_DIGEST_PREFETCH_SIZE;
+    bulk_digest_prefetch(chan, job.buffers[core][0], src, piece);
+
+    uint32_t done = 0;
+    for (uint32_t n = 0; done < len; n++) {
+        dma_channel_wait_for_finish_blocking(chan);
+        const uint8_t *ready = job.buffers[core][n & 1];
+        uint32_t ready_len = piece;
+        done += piece;
+
+        if (done < len) {
+            piece = len - done < BULK_DIGEST_PREFETCH_SIZE ? len - done : BULK_DIGEST_PREFETCH_SIZE;
+            bulk_digest_prefetch(chan, job.buffers[core][(n + 1) & 1], src + done, piece);
+        }
+        sha256_update(&ctx, ready, ready_len);
+    }
+
+    sha256_final(&ctx, out);
+}
+
+static void bulk_digest_prefetch(int chan, uint8_t *dst, const uint8_t *src, uint32_t len) {
+    dma_channel_config config = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, true);
+    dma_channel_configure(chan, &config, dst, src, len / 4, true);
+}
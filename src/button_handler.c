@@ -4,13 +4,11 @@ static uint32_t button_press_start_time = 0;
 static bool button_was_pressed = false;
 
 void button_init(void) {
-    gpio_init(BUTTON_PIN);
-    gpio_set_dir(BUTTON_PIN, GPIO_IN);
-    gpio_pull_up(BUTTON_PIN);  // Active low button
+    board_button_init();
 }
 
 bool button_is_pressed(void) {
-    return !gpio_get(BUTTON_PIN);  // Active low
+    return board_button_pressed();
 }
 
 void button_handle_boot_mode(void) {
@@ -25,6 +23,7 @@ void button_handle_boot_mode(void) {
         
         // Wait for button release and measure duration
         while (button_is_pressed()) {
+            watchdog_update();
             delay_ms(10);
             press_duration = get_system_time_ms() - start_time;
             
@@ -41,10 +40,8 @@ void button_handle_boot_mode(void) {
             printf("BOOT: Factory reset initiated\n");
             led_blink(LED_STATE_UNSEALED, 500);
             
-            // Clear all stored keys and reset device
-            bitcoin_keys_t empty_keys = {0};
-            flash_write_keys(&empty_keys);
-            flash_write_device_state(DEVICE_STATE_NEW);
+            // Clear the stored keys and state in one commit, then reset
+            device_state_dispatch(DEVICE_EVENT_FACTORY_RESET, NULL);
             
             // Restart device
             watchdog_enable(100, 1);
@@ -94,9 +91,7 @@ void button_handle_test_mode(void) {
         }
         led_set_state(LED_STATE_UNSEALED);
         
-        // Update device state
-        current_device_state = DEVICE_STATE_COMPROMISED;
-        flash_write_device_state(current_device_state);
+        // tamper_check_integrity has already recorded the state change
     }
 }
 
@@ -117,6 +112,7 @@ uint32_t button_get_press_duration(void) {
     
     uint32_t start_time = get_system_time_ms();
     while (button_is_pressed()) {
+        watchdog_update();
         delay_ms(10);
     }
     
@@ -0,0 +1,136 @@
+#include "cashstick.h"
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+
+// Operating point table. Current figures are approximate whole-chip
+// active draw used only for energy estimates - measure on the bench
+// before relying on them.
+typedef struct {
+    const char *name;
+    uint32_t sys_khz;
+    enum vreg_voltage voltage;
+    uint16_t active_ma_x10;     // Estimated active current, 0.1 mA units
+} clock_op_point_t;
+
+static const clock_op_point_t op_points[CLOCK_OP_COUNT] = {
+    [CLOCK_OP_IDLE]    = { "idle",    48000,  VREG_VOLTAGE_1_00,  85 },
+    [CLOCK_OP_NOMINAL] = { "nominal", 125000, VREG_VOLTAGE_1_10, 240 },
+    [CLOCK_OP_BOOST]   = { "boost",   200000, VREG_VOLTAGE_1_15, 400 },
+};
+
+// Time for the regulator to settle after a voltage increase
+#define VREG_SETTLE_US 1000
+
+static clock_op_t current_op = CLOCK_OP_NOMINAL;
+static uint32_t boost_depth = 0;
+static uint32_t op_switches = 0;
+
+static void clock_apply_op(clock_op_t op);
+
+void clock_governor_init(void) {
+    boost_depth = 0;
+    op_switches = 0;
+
+    // The SDK boots at the nominal point; make sure the table agrees
+    current_op = CLOCK_OP_COUNT;
+    clock_apply_op(CLOCK_OP_NOMINAL);
+
+    printf("CLOCK: Governor initialized at %lu kHz\n", (unsigned long)op_points[current_op].sys_khz);
+}
+
+void clock_governor_set_op(clock_op_t op) {
+    if (op >= CLOCK_OP_COUNT) {
+        return;
+    }
+    clock_apply_op(op);
+}
+
+clock_op_t clock_governor_get_op(void) {
+    return current_op;
+}
+
+void clock_governor_enter_idle(void) {
+    // Never drop below a boost a caller is still relying on
+    if (boost_depth == 0) {
+        clock_apply_op(CLOCK_OP_IDLE);
+    }
+}
+
+void clock_governor_exit_idle(void) {
+    if (current_op == CLOCK_OP_IDLE) {
+        clock_apply_op(CLOCK_OP_NOMINAL);
+    }
+}
+
+void clock_boost_begin(void) {
+    if (boost_depth++ == 0) {
+        clock_apply_op(CLOCK_OP_BOOST);
+    }
+}
+
+void clock_boost_end(void) {
+    if (boost_depth == 0) {
+        return;
+    }
+    if (--boost_depth == 0) {
+        clock_apply_op(CLOCK_OP_NOMINAL);
+    }
+}
+
+uint32_t clock_governor_op_khz(clock_op_t op) {
+    return op < CLOCK_OP_COUNT ? op_points[op].sys_khz : 0;
+}
+
+const char *clock_governor_op_name(clock_op_t op) {
+    return op < CLOCK_OP_COUNT ? op_points[op].name : "unknown";
+}
+
+// Estimated energy in microjoules for running at an operating point for
+// the given time, assuming a 3.3 V supply
+uint32_t clock_governor_estimate_energy_uj(clock_op_t op, uint32_t elapsed_us) {
+    if (op >= CLOCK_OP_COUNT) {
+        return 0;
+    }
+    // mA/10 * 3.3 V * us / 1000 = uJ
+    return (uint32_t)(((uint64_t)op_points[op].active_ma_x10 * 33u * elapsed_us) / 100000u);
+}
+
+uint32_t clock_governor_get_switch_count(void) {
+    return op_switches;
+}
+
+// Internal helper functions
+
+static void clock_apply_op(clock_op_t op) {
+    if (op == current_op) {
+        return;
+    }
+
+    const clock_op_point_t *target = &op_points[op];
+    bool raising = (current_op >= CLOCK_OP_COUNT) || (target->sys_khz > op_points[current_op].sys_khz);
+
+    // Raise the core voltage before the clock, lower it after
+    if (raising) {
+        vreg_set_voltage(target->voltage);
+        busy_wait_us_32(VREG_SETTLE_US);
+    }
+
+    if (op == CLOCK_OP_IDLE) {
+        // Run clk_sys straight from PLL_USB and stop PLL_SYS altogether
+        set_sys_clock_48mhz();
+    } else {
+        set_sys_clock_khz(target->sys_khz, true);
+    }
+
+    if (!raising) {
+        vreg_set_voltage(target->voltage);
+    }
+
+    // clk_peri follows clk_sys, so the I2C divider has to be re-derived.
+    // clk_usb runs from PLL_USB and clk_ref from the crystal, so USB and
+    // the timer/watchdog tick are unaffected.
+    board_se050_bus_restore_baudrate();
+
+    current_op = op;
+    op_switches++;
+}
@@ -0,0 +1,199 @@
+#include "delta_patch.h"
+#include <string.h>
+
+enum {
+    PATCH_STATE_HEADER = 0,
+    PATCH_STATE_OP,
+    PATCH_STATE_COPY_DELTA,
+    PATCH_STATE_COPY_LEN,
+    PATCH_STATE_INSERT_LEN,
+    PATCH_STATE_INSERT_DATA,
+    PATCH_STATE_DONE,
+    PATCH_STATE_FAILED
+};
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool patch_fail(delta_patch_t *patch, const char *error) {
+    patch->state = PATCH_STATE_FAILED;
+    patch->error = error;
+    return false;
+}
+
+// Accumulate one LEB128 byte: 1 when the varint is complete, 0 for more,
+// -1 if it runs past 32 bits
+static int patch_varint(delta_patch_t *patch, uint8_t byte) {
+    if (patch->varint_shift > 28 || (patch->varint_shift == 28 && (byte & 0x70))) {
+        return -1;
+    }
+    patch->varint |= (uint32_t)(byte & 0x7F) << patch->varint_shift;
+    patch->varint_shift += 7;
+    return (byte & 0x80) ? 0 : 1;
+}
+
+static bool patch_parse_header(delta_patch_t *patch) {
+    const uint8_t *h = patch->header_buf;
+    if (get_u32(h) != DELTA_PATCH_MAGIC) {
+        return patch_fail(patch, "not a delta patch");
+    }
+    if ((h[4] | h[5] << 8) != DELTA_PATCH_VERSION) {
+        return patch_fail(patch, "unsupported patch version");
+    }
+
+    patch->info.source_len = get_u32(h + 8);
+    patch->info.target_len = get_u32(h + 12);
+    memcpy(patch->info.source_hash, h + 16, 32);
+    memcpy(patch->info.target_hash, h + 48, 32);
+    memcpy(patch->info.signature, h + 80, DELTA_PATCH_SIGNATURE_SIZE);
+
+    if (patch->info.source_len > patch->source_len) {
+        return patch_fail(patch, "patch is for a larger source image");
+    }
+    if (patch->info.target_len == 0) {
+        return patch_fail(patch, "empty target");
+    }
+    if (patch->header && !patch->header(patch->user, &patch->info)) {
+        return patch_fail(patch, "patch header refused");
+    }
+
+    patch->state = PATCH_STATE_OP;
+    return true;
+}
+
+// Account for len bytes about to be produced
+static bool patch_produce(delta_patch_t *patch, uint32_t len) {
+    if (len > patch->info.target_len - patch->produced) {
+        return patch_fail(patch, "patch overruns the target");
+    }
+    patch->produced += len;
+    return true;
+}
+
+static void patch_next_op(delta_patch_t *patch) {
+    patch->state = patch->produced == patch->info.target_len ? PATCH_STATE_DONE : PATCH_STATE_OP;
+}
+
+void delta_patch_init(delta_patch_t *patch) {
+    memset(&patch->info, 0, sizeof(patch->info));
+    patch->header_len = 0;
+    patch->produced = 0;
+    patch->copy_start = 0;
+    patch->copy_end = 0;
+    patch->varint = 0;
+    patch->varint_shift = 0;
+    patch->state = PATCH_STATE_HEADER;
+    patch->op = 0;
+    patch->error = NULL;
+}
+
+bool delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len) {
+        switch (patch->state) {
+            case PATCH_STATE_HEADER: {
+                size_t take = DELTA_PATCH_HEADER_SIZE - patch->header_len;
+                if (take > len - i) {
+                    take = len - i;
+                }
+                memcpy(patch->header_buf + patch->header_len, data + i, take);
+                patch->header_len += (uint32_t)take;
+                i += take;
+                if (patch->header_len == DELTA_PATCH_HEADER_SIZE && !patch_parse_header(patch)) {
+                    return false;
+                }
+                break;
+            }
+
+            case PATCH_STATE_OP:
+                patch->op = data[i++];
+                patch->varint = 0;
+                patch->varint_shift = 0;
+                if (patch->op == DELTA_PATCH_OP_COPY) {
+                    patch->state = PATCH_STATE_COPY_DELTA;
+                } else if (patch->op == DELTA_PATCH_OP_INSERT) {
+                    patch->state = PATCH_STATE_INSERT_LEN;
+                } else {
+                    return patch_fail(patch, "unknown patch operation");
+                }
+                break;
+
+            case PATCH_STATE_COPY_DELTA:
+            case PATCH_STATE_COPY_LEN:
+            case PATCH_STATE_INSERT_LEN: {
+                int complete = patch_varint(patch, data[i++]);
+                if (complete < 0) {
+                    return patch_fail(patch, "varint overflow");
+                }
+                if (complete == 0) {
+                    break;
+                }
+
+                uint32_t value = patch->varint;
+                patch->varint = 0;
+                patch->varint_shift = 0;
+
+                if (patch->state == PATCH_STATE_COPY_DELTA) {
+                    // Zigzag: 0, -1, 1, -2, ... as 0, 1, 2, 3, ...
+                    int32_t delta = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+                    patch->copy_start = patch->copy_end + (uint32_t)delta;
+                    patch->state = PATCH_STATE_COPY_LEN;
+                } else if (patch->state == PATCH_STATE_COPY_LEN) {
+                    uint32_t start = patch->copy_start;
+                    if (start > patch->info.source_len || value > patch->info.source_len - start) {
+                        return patch_fail(patch, "copy outside the source image");
+                    }
+                    if (!patch_produce(patch, value)) {
+                        return false;
+                    }
+                    if (value > 0 && !patch->output(patch->user, patch->source + start, value)) {
+                        return patch_fail(patch, "output refused");
+                    }
+                    patch->copy_end = start + value;
+                    patch_next_op(patch);
+                } else {
+                    if (!patch_produce(patch, value)) {
+                        return false;
+                    }
+                    // patch->varint now counts literal bytes still to come
+                    patch->varint = value;
+                    patch->state = PATCH_STATE_INSERT_DATA;
+                    if (value == 0) {
+                        patch_next_op(patch);
+                    }
+                }
+                break;
+            }
+
+            case PATCH_STATE_INSERT_DATA: {
+                size_t take = patch->varint;
+                if (take > len - i) {
+                    take = len - i;
+                }
+                if (!patch->output(patch->user, data + i, take)) {
+                    return patch_fail(patch, "output refused");
+                }
+                patch->varint -= (uint32_t)take;
+                i += take;
+                if (patch->varint == 0) {
+                    patch_next_op(patch);
+                }
+                break;
+            }
+
+            case PATCH_STATE_DONE:
+                return patch_fail(patch, "data after the end of the patch");
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool delta_patch_done(const delta_patch_t *patch) {
+    return patch->state == PATCH_STATE_DONE;
+}
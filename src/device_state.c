@@ -0,0 +1,201 @@
+#include "cashstick.h"
+
+// Device lifecycle. The state and the wallet keys are owned here and only
+// change through device_state_dispatch(), which looks the event up in the
+// transition table below. A transition builds the next record (state,
+// keys and seal) and commits it as a single flash record - and only if it
+// differs from what is already stored, so repeating an event (a second
+// failed tamper check, say) costs no erase at all. A new seal is staged
+// first and goes out with the next transition's commit.
+//
+// Actions only build the next record. Anything else a transition does -
+// returning a key slot to the pool, say - happens in its committed hook,
+// once the record is in flash: should the commit fail, the stored record
+// still refers to everything it did before.
+
+#define STATE_BIT(s) (1u << (s))
+#define ANY_STATE 0xFFFFFFFFu
+
+typedef bool (*device_guard_t)(const device_record_t *current, const bitcoin_keys_t *keys);
+typedef void (*device_action_t)(device_record_t *next, const bitcoin_keys_t *keys);
+typedef void (*device_hook_t)(const device_record_t *previous);
+
+typedef struct {
+    uint32_t from;              // STATE_BIT() mask the event is accepted in
+    device_event_t event;
+    device_state_t to;
+    device_guard_t guard;       // NULL: always taken
+    device_action_t action;     // NULL: state change only
+    device_hook_t committed;    // Run after a successful commit; NULL: none
+} device_transition_t;
+
+static bool guard_keys_valid(const device_record_t *current, const bitcoin_keys_t *keys);
+static bool guard_same_key(const device_record_t *current, const bitcoin_keys_t *keys);
+static void action_store_keys(device_record_t *next, const bitcoin_keys_t *keys);
+static void action_reveal_keys(device_record_t *next, const bitcoin_keys_t *keys);
+static void action_clear_keys(device_record_t *next, const bitcoin_keys_t *keys);
+static void committed_release_key(const device_record_t *previous);
+
+// First matching row wins
+static const device_transition_t transitions[] = {
+    { STATE_BIT(DEVICE_STATE_NEW) | STATE_BIT(DEVICE_STATE_INITIALIZED),
+      DEVICE_EVENT_KEYS_CREATED, DEVICE_STATE_SEALED, guard_keys_valid, action_store_keys },
+
+    { STATE_BIT(DEVICE_STATE_SEALED),
+      DEVICE_EVENT_KEYS_REFRESHED, DEVICE_STATE_SEALED, guard_same_key, action_store_keys },
+    { STATE_BIT(DEVICE_STATE_COMPROMISED),
+      DEVICE_EVENT_KEYS_REFRESHED, DEVICE_STATE_COMPROMISED, guard_same_key, action_store_keys },
+
+    // Only a sealed device has a seal to break; the reveal and the state
+    // change land in the same commit
+    { STATE_BIT(DEVICE_STATE_SEALED),
+      DEVICE_EVENT_TAMPER_DETECTED, DEVICE_STATE_COMPROMISED, NULL, action_reveal_keys },
+    { STATE_BIT(DEVICE_STATE_COMPROMISED),
+      DEVICE_EVENT_TAMPER_DETECTED, DEVICE_STATE_COMPROMISED, NULL, NULL },
+
+    { ANY_STATE,
+      DEVICE_EVENT_FACTORY_RESET, DEVICE_STATE_NEW, NULL, action_clear_keys, committed_release_key },
+};
+
+static const char *const state_names[] = { "NEW", "INITIALIZED", "SEALED", "COMPROMISED" };
+static const char *const event_names[DEVICE_EVENT_COUNT] = {
+    "KEYS_CREATED", "KEYS_REFRESHED", "TAMPER_DETECTED", "FACTORY_RESET"
+};
+
+static device_record_t device_record;
+static uint32_t commit_count = 0;
+static uint8_t staged_seal[32];
+static bool seal_staged = false;
+
+static bool device_state_commit(const device_record_t *next);
+
+void device_state_init(void) {
+    memset(&device_record, 0, sizeof(device_record));
+    if (!flash_read_device_record(&device_record)) {
+        memset(&device_record, 0, sizeof(device_record));
+        device_record.state = DEVICE_STATE_NEW;
+    }
+
+    printf("STATE: %s\n", state_names[device_record.state]);
+}
+
+device_state_t device_state_get(void) {
+    return device_record.state;
+}
+
+const bitcoin_keys_t *device_state_keys(void) {
+    return &device_record.keys;
+}
+
+void device_state_stage_seal(const uint8_t seal[32]) {
+    memcpy(staged_seal, seal, sizeof(staged_seal));
+    seal_staged = true;
+}
+
+const uint8_t *device_state_seal(void) {
+    return device_record.seal;
+}
+
+bool device_state_dispatch(device_event_t event, const bitcoin_keys_t *keys) {
+    // A staged seal rides on this dispatch or not at all
+    bool take_seal = seal_staged;
+    seal_staged = false;
+
+    for (size_t i = 0; i < sizeof(transitions) / sizeof(transitions[0]); i++) {
+        const device_transition_t *t = &transitions[i];
+        if (t->event != event || !(t->from & STATE_BIT(device_record.state))) {
+            continue;
+        }
+
+        if (t->guard && !t->guard(&device_record, keys)) {
+            printf("STATE: %s rejected in %s\n", event_names[event], state_names[device_record.state]);
+            return false;
+        }
+
+        // Copy bytewise so padding compares equal in the commit check
+        device_record_t next;
+        memcpy(&next, &device_record, sizeof(next));
+        next.state = t->to;
+        if (take_seal) {
+            memcpy(next.seal, staged_seal, sizeof(next.seal));
+        }
+        if (t->action) {
+            t->action(&next, keys);
+        }
+
+        bool changed = next.state != device_record.state;
+        if (changed) {
+            printf("STATE: %s -> %s on %s\n", state_names[device_record.state],
+                   state_names[next.state], event_names[event]);
+        }
+
+        device_record_t previous;
+        memcpy(&previous, &device_record, sizeof(previous));
+        if (!device_state_commit(&next)) {
+            return false;
+        }
+        if (t->committed) {
+            t->committed(&previous);
+        }
+        if (changed) {
+            journal_append(JOURNAL_EVENT_STATE, (uint32_t)next.state);
+        }
+        return true;
+    }
+
+    printf("STATE: %s ignored in %s\n", event_names[event], state_names[device_record.state]);
+    return false;
+}
+
+uint32_t device_state_commit_count(void) {
+    return commit_count;
+}
+
+// Internal helper functions
+
+// Write-on-change: an unchanged record is already in flash
+static bool device_state_commit(const device_record_t *next) {
+    if (memcmp(next, &device_record, sizeof(device_record)) == 0) {
+        return true;
+    }
+
+    if (!flash_write_device_record(next)) {
+        return false;
+    }
+
+    memcpy(&device_record, next, sizeof(device_record));
+    commit_count++;
+    return true;
+}
+
+static bool guard_keys_valid(const device_record_t *current, const bitcoin_keys_t *keys) {
+    return keys && keys->is_sealed;
+}
+
+static bool guard_same_key(const device_record_t *current, const bitcoin_keys_t *keys) {
+    return keys && memcmp(keys->public_key, current->keys.public_key, 33) == 0;
+}
+
+static void action_store_keys(device_record_t *next, const bitcoin_keys_t *keys) {
+    // Carry the reveal flag over; it is only ever set by a tamper event
+    bool revealed = next->keys.keys_revealed;
+    memcpy(&next->keys, keys, sizeof(next->keys));
+    next->keys.keys_revealed = revealed;
+}
+
+static void action_reveal_keys(device_record_t *next, const bitcoin_keys_t *keys) {
+    if (next->keys.is_sealed) {
+        next->keys.keys_revealed = true;
+    }
+}
+
+static void action_clear_keys(device_record_t *next, const bitcoin_keys_t *keys) {
+    memset(&next->keys, 0, sizeof(next->keys));
+    memset(next->seal, 0, sizeof(next->seal));
+}
+
+// The record no longer refers to the wallet key: its SE050 slot can go
+// back to the pool for regeneration, which deletes the key
+static void committed_release_key(const device_record_t *previous) {
+    key_pool_release(previous->keys.key_object_id);
+}
@@ -0,0 +1,146 @@
+#include "cashstick.h"
+#include "hardware/sync.h"
+
+// Random bytes for the RP2040 side (nonces, request IDs, blinding) come
+// from an HMAC-DRBG seeded by the SE050 TRNG, so a request is served from
+// RAM instead of costing an I2C round trip.
+//
+// Each core has its own instance and never touches the other's state, so
+// no lock is needed on the generate path and the two output streams
+// cannot repeat each other. Only core 0 talks to the SE050: it reseeds
+// its own instance directly and keeps a one-shot seed reservoir filled
+// for core 1, which reseeds from that.
+
+#define ENTROPY_NUM_CORES 2
+#define ENTROPY_NONCE_LEN 16
+
+static hmac_drbg_t drbg[ENTROPY_NUM_CORES];
+static uint32_t last_reseed_ms = 0;
+
+// Seed material handed from core 0 to core 1
+static uint8_t core1_seed[HMAC_DRBG_SEED_LEN];
+static volatile bool core1_seed_ready = false;
+static spin_lock_t *core1_seed_lock;
+
+static bool entropy_reseed_core0(void);
+static void entropy_refill_core1_seed(void);
+
+bool entropy_init(void) {
+    core1_seed_lock = spin_lock_init(spin_lock_claim_unused(true));
+
+    pico_unique_board_id_t board_id;
+    pico_get_unique_board_id(&board_id);
+
+    for (uint core = 0; core < ENTROPY_NUM_CORES; core++) {
+        uint8_t seed[HMAC_DRBG_SEED_LEN + ENTROPY_NONCE_LEN];
+        if (!se050_get_random(seed, sizeof(seed))) {
+            printf("ENTROPY: SE050 TRNG unavailable\n");
+            return false;
+        }
+
+        // Personalization separates the instances even if the TRNG repeats
+        uint8_t personalization[16 + PICO_UNIQUE_BOARD_ID_SIZE_BYTES];
+        memcpy(personalization, "CashStick DRBG", 14);
+        personalization[14] = 'c';
+        personalization[15] = (uint8_t)('0' + core);
+        memcpy(personalization + 16, board_id.id, PICO_UNIQUE_BOARD_ID_SIZE_BYTES);
+
+        hmac_drbg_instantiate(&drbg[core], CASHSTICK_DRBG_RESEED_INTERVAL,
+                              seed, HMAC_DRBG_SEED_LEN,
+                              seed + HMAC_DRBG_SEED_LEN, ENTROPY_NONCE_LEN,
+                              personalization, sizeof(personalization));
+        memset(seed, 0, sizeof(seed));
+    }
+
+    last_reseed_ms = get_system_time_ms();
+    entropy_refill_core1_seed();
+
+    printf("ENTROPY: HMAC-DRBG ready (reseed every %d requests)\n", CASHSTICK_DRBG_RESEED_INTERVAL);
+    return true;
+}
+
+// Called from the core 0 main loop
+void entropy_service(void) {
+    if (!drbg[0].instantiated) {
+        return;
+    }
+
+    if (get_system_time_ms() - last_reseed_ms >= ENTROPY_RESEED_PERIOD_MS) {
+        entropy_reseed_core0();
+    }
+
+    if (!core1_seed_ready) {
+        entropy_refill_core1_seed();
+    }
+}
+
+bool entropy_random(uint8_t *out, size_t len) {
+    uint core = get_core_num();
+    hmac_drbg_t *instance = &drbg[core];
+
+    while (len > 0) {
+        size_t take = len < HMAC_DRBG_MAX_REQUEST ? len : HMAC_DRBG_MAX_REQUEST;
+
+        hmac_drbg_result_t result = hmac_drbg_generate(instance, out, take, NULL, 0);
+        if (result == HMAC_DRBG_RESEED_REQUIRED) {
+            bool reseeded = false;
+
+            if (core == 0) {
+                reseeded = entropy_reseed_core0();
+            } else {
+                uint32_t save = spin_lock_blocking(core1_seed_lock);
+                if (core1_seed_ready) {
+                    reseeded = hmac_drbg_reseed(instance, core1_seed, sizeof(core1_seed), NULL, 0) == HMAC_DRBG_OK;
+                    memset(core1_seed, 0, sizeof(core1_seed));
+                    core1_seed_ready = false;
+                }
+                spin_unlock(core1_seed_lock, save);
+            }
+
+            if (!reseeded) {
+                return false;
+            }
+            result = hmac_drbg_generate(instance, out, take, NULL, 0);
+        }
+
+        if (result != HMAC_DRBG_OK) {
+            return false;
+        }
+
+        out += take;
+        len -= take;
+    }
+
+    return true;
+}
+
+// Internal helper functions
+
+static bool entropy_reseed_core0(void) {
+    uint8_t seed[HMAC_DRBG_SEED_LEN];
+    if (!se050_get_random(seed, sizeof(seed))) {
+        return false;
+    }
+
+    bool ok = hmac_drbg_reseed(&drbg[0], seed, sizeof(seed), NULL, 0) == HMAC_DRBG_OK;
+    memset(seed, 0, sizeof(seed));
+
+    if (ok) {
+        last_reseed_ms = get_system_time_ms();
+    }
+    return ok;
+}
+
+static void entropy_refill_core1_seed(void) {
+    uint8_t seed[HMAC_DRBG_SEED_LEN];
+    if (!se050_get_random(seed, sizeof(seed))) {
+        return;
+    }
+
+    uint32_t save = spin_lock_blocking(core1_seed_lock);
+    memcpy(core1_seed, seed, sizeof(core1_seed));
+    core1_seed_ready = true;
+    spin_unlock(core1_seed_lock, save);
+
+    memset(seed, 0, sizeof(seed));
+}
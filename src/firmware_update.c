@@ -0,0 +1,562 @@
+#include "cashstick.h"
+#include "delta_patch.h"
+#include "secp256k1.h"
+#include "uf2_stream.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+#include "hardware/structs/watchdog.h"
+#include "pico/multicore.h"
+#include "flash_layout.h"
+
+// Firmware updates from delta patches (see delta_patch.h for the format).
+//
+// The patch streams in over the command interface (UPDATE data) and is
+// applied as it arrives: COPY operations read the running image through
+// XIP, and the rebuilt image is compared page by page with the running
+// one. Only sectors with a changed page are written to the staging slot
+// (the pages before the first change come from the running image), so an
+// update erases each changed sector twice - once staged, once installed -
+// and leaves the rest of the flash alone. RAM use is one flash page plus
+// the decoder state, whatever the size of the patch.
+//
+// The target hash in the patch header is checked against a running
+// SHA-256 of the rebuilt image, and the vendor signature in the header
+// against that hash, before anything is committed; only then is the
+// marker sector, with the bitmap of staged sectors, written. The hash
+// alone proves nothing - whoever wrote the patch chose it. UPDATE install
+// copies the staged sectors over the running image from a routine in SRAM
+// and resets.
+//
+// Signed UF2 images dropped on the drive in update mode take the same
+// path in a single pass. The USB task feeds each block to uf2_stream.h,
+// which puts early blocks aside in a small reorder window and hands the
+// image on in address order, to be hashed and staged like a rebuilt one.
+// Once the last block is in, the running hash is the image digest: the
+// main loop checks the vendor signature over it (too slow for the USB
+// task) without reading the image back from flash, and only then writes
+// the marker and installs.
+//
+// Sector 0 carries boot2, which the boot ROM checksums. The installer
+// erases it first and programs it last, so a power cut part-way through
+// leaves an image the ROM will not boot: the stick comes up in BOOTSEL
+// and a full UF2 recovers it.
+
+#ifdef PICO_FLASH_SIZE_BYTES
+_Static_assert(FLASH_TARGET_OFFSET + UPDATE_SLOT_SECTOR_OFFSET + UPDATE_SLOT_SIZE <= PICO_FLASH_SIZE_BYTES,
+               "staging slot must fit in flash");
+#endif
+
+#ifndef CASHSTICK_VENDOR_PUBKEY
+#error "Set CASHSTICK_VENDOR_PUBKEY, or CASHSTICK_DEV_SIGNING_KEY for a development build"
+#endif
+
+#define UPDATE_MARKER_MAGIC 0x54445055  // "UPDT"
+#define UPDATE_SLOT_SECTORS (UPDATE_SLOT_SIZE / FLASH_SECTOR_SIZE)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    uint8_t hash[SHA256_DIGEST_SIZE];
+    uint32_t staged[UPDATE_SLOT_SECTORS / 32];  // Sectors held in the slot
+    uint32_t check;     // ~(magic ^ length ^ staged words)
+} update_marker_t;
+
+static delta_patch_t update_patch;
+static sha256_ctx_t update_hash;
+static uint8_t update_page[FLASH_PAGE_SIZE];
+static uint32_t update_page_len = 0;
+static uint32_t update_written = 0;     // Slot bytes programmed
+static uint32_t update_received = 0;
+static uint32_t update_sectors_erased = 0;
+static uint32_t update_start_us = 0;
+static update_state_t update_state = UPDATE_IDLE;
+static const char *update_error = NULL;
+static update_marker_t update_marker;   // Built up while receiving
+
+static const uint8_t vendor_pubkey[33] = CASHSTICK_VENDOR_PUBKEY;
+static uf2_stream_t update_uf2;
+static uint8_t update_uf2_window[CASHSTICK_UF2_REORDER_WINDOW][UF2_PAYLOAD_SIZE];
+static bool update_from_uf2 = false;
+static volatile bool update_verify_pending = false;    // UF2 image in, signature unchecked
+static volatile bool update_held = false;              // A thread-side caller is in
+static uint8_t update_image_hash[SHA256_DIGEST_SIZE];
+static uint32_t update_verify_us = 0;
+
+static bool update_on_header(void *user, const delta_patch_header_t *header);
+static bool update_on_output(void *user, const uint8_t *data, size_t len);
+static bool update_flush(uint8_t hash[SHA256_DIGEST_SIZE]);
+static bool update_stage(const uint8_t hash[SHA256_DIGEST_SIZE], uint32_t length);
+static void update_begin_uf2(void);
+static bool update_uf2_fail(const char *error);
+static bool update_program_page(void);
+static bool update_stage_sector(uint32_t sector);
+static bool update_slot_program(uint32_t image_offset, const uint8_t *page);
+static bool update_sector_staged(const update_marker_t *marker, uint32_t sector);
+static uint32_t update_marker_check(const update_marker_t *marker);
+static bool update_marker_valid(update_marker_t *marker);
+static bool update_write_marker(const update_marker_t *marker);
+static void update_erase_marker(void);
+static bool update_fail(const char *error);
+static void update_copy_image(const update_marker_t *marker);
+
+void update_init(void) {
+    if (update_marker_valid(&update_marker)) {
+        update_state = UPDATE_STAGED;
+        update_written = update_marker.length;
+        printf("UPDATE: Staged image waiting (%lu bytes)\n", (unsigned long)update_marker.length);
+    }
+}
+
+bool update_begin(void) {
+    update_abort();
+
+    update_patch.source = (const uint8_t*)XIP_BASE;
+    update_patch.source_len = FLASH_TARGET_OFFSET;
+    update_patch.header = update_on_header;
+    update_patch.output = update_on_output;
+    update_patch.user = NULL;
+    delta_patch_init(&update_patch);
+    sha256_init(&update_hash);
+
+    update_state = UPDATE_RECEIVING;
+    update_start_us = time_us_32();
+    return true;
+}
+
+bool update_write(const uint8_t *data, size_t len) {
+    if (update_state != UPDATE_RECEIVING) {
+        return update_fail("no update in progress");
+    }
+
+    update_received += (uint32_t)len;
+    if (!delta_patch_feed(&update_patch, data, len)) {
+        // A callback may already have said why
+        return update_fail(update_error ? update_error : update_patch.error);
+    }
+    return true;
+}
+
+bool update_finish(void) {
+    if (update_state != UPDATE_RECEIVING) {
+        return update_fail("no update in progress");
+    }
+    if (update_from_uf2 || !delta_patch_done(&update_patch)) {
+        return update_fail("patch incomplete");
+    }
+
+    uint8_t hash[SHA256_DIGEST_SIZE];
+    if (!update_flush(hash)) {
+        return false;
+    }
+    if (memcmp(hash, update_patch.info.target_hash, SHA256_DIGEST_SIZE) != 0) {
+        return update_fail("image hash mismatch");
+    }
+
+    uint32_t start = time_us_32();
+    clock_boost_begin();
+    bool valid = secp256k1_ecdsa_verify(vendor_pubkey, hash, update_patch.info.signature);
+    clock_boost_end();
+    update_verify_us = time_us_32() - start;
+    if (!valid) {
+        return update_fail("bad signature");
+    }
+    return update_stage(hash, update_patch.info.target_len);
+}
+
+// One sector the host wrote in update mode (USB task context). False
+// refuses the write.
+bool update_uf2_block(const uint8_t *block) {
+    if (update_verify_pending) {
+        return true;    // Image complete; the host rewrote a block
+    }
+    if (update_held || (update_state == UPDATE_RECEIVING && !update_from_uf2)) {
+        return false;   // A patch is streaming in over UPDATE
+    }
+    if (update_state == UPDATE_FAILED && update_from_uf2) {
+        return false;   // Until the drive is ejected
+    }
+    if (update_state != UPDATE_RECEIVING) {
+        update_begin_uf2();
+    }
+
+    update_received += UF2_BLOCK_SIZE;
+    switch (uf2_stream_feed(&update_uf2, block)) {
+        case UF2_STREAM_ACCEPTED:
+            return true;
+
+        case UF2_STREAM_COMPLETE:
+            if (!update_flush(update_image_hash)) {
+                return update_uf2_fail(update_error);
+            }
+            update_verify_pending = true;
+            power_signal_event(POWER_EVENT_USB);
+            return true;
+
+        default:
+            // The output callback may already have said why
+            return update_uf2_fail(update_error ? update_error : update_uf2.error);
+    }
+}
+
+// Drive ejected or host gone (USB task context): a UF2 image cut short
+// is dropped, so the next copy starts clean
+void update_uf2_reset(void) {
+    if (update_from_uf2 && !update_verify_pending && !update_held &&
+        (update_state == UPDATE_RECEIVING || update_state == UPDATE_FAILED)) {
+        update_abort();
+    }
+}
+
+// Thread-side callers of update_begin/write/finish/abort/install bracket
+// them with these, so a UF2 block arriving in the USB task meanwhile is
+// refused rather than interleaved. False while a UF2 image owns the
+// update.
+bool update_hold(void) {
+    update_held = true;
+    __compiler_memory_barrier();
+    if (update_from_uf2 && (update_state == UPDATE_RECEIVING || update_verify_pending)) {
+        update_held = false;
+        return false;
+    }
+    return true;
+}
+
+void update_release(void) {
+    __compiler_memory_barrier();
+    update_held = false;
+}
+
+// A complete UF2 image waits here for its signature check and install
+// (thread context). The USB task leaves the update alone until this
+// clears update_verify_pending.
+void update_service(void) {
+    if (!update_verify_pending) {
+        return;
+    }
+
+    uint32_t start = time_us_32();
+    clock_boost_begin();
+    bool valid = secp256k1_ecdsa_verify(vendor_pubkey, update_image_hash, update_uf2.signature);
+    clock_boost_end();
+    update_verify_us = time_us_32() - start;
+
+    bool staged = valid ? update_stage(update_image_hash, update_uf2.length) : update_fail("bad signature");
+    update_verify_pending = false;
+
+    if (staged) {
+        update_install();
+    }
+}
+
+void update_abort(void) {
+    if (update_state == UPDATE_STAGED) {
+        update_erase_marker();
+    }
+    memset(&update_marker, 0, sizeof(update_marker));
+    update_state = UPDATE_IDLE;
+    update_from_uf2 = false;
+    update_verify_us = 0;
+    update_error = NULL;
+    update_page_len = 0;
+    update_written = 0;
+    update_received = 0;
+    update_sectors_erased = 0;
+}
+
+void update_install(void) {
+    if (update_state != UPDATE_STAGED || !update_marker_valid(&update_marker)) {
+        return;
+    }
+
+    printf("UPDATE: Installing %lu byte image\n", (unsigned long)update_marker.length);
+
+    // Let the reply and log drain over USB, then stop everything that
+    // could run from flash while it is being rewritten. The watchdog is
+    // serviced from a timer interrupt, and a worst-case install outlasts
+    // its timeout.
+    sleep_ms(100);
+    multicore_reset_core1();
+    hw_clear_bits(&watchdog_hw->ctrl, WATCHDOG_CTRL_ENABLE_BITS);
+    save_and_disable_interrupts();
+    update_copy_image(&update_marker);
+}
+
+void update_get_status(update_status_t *status) {
+    status->state = update_state;
+    status->received = update_received;
+    status->written = update_written;
+    status->target_len = update_state == UPDATE_STAGED ? update_marker.length :
+                         update_state == UPDATE_IDLE ? 0 :
+                         update_from_uf2 ? update_uf2.length : update_patch.info.target_len;
+    status->sectors_erased = update_sectors_erased;
+    status->elapsed_us = update_state == UPDATE_RECEIVING ? time_us_32() - update_start_us : 0;
+    status->error = update_error;
+    status->from_uf2 = update_from_uf2;
+    status->reordered = update_from_uf2 ? update_uf2.reordered : 0;
+    status->verify_us = update_verify_us;
+}
+
+// Internal helper functions
+
+static bool update_on_header(void *user, const delta_patch_header_t *header) {
+    (void)user;
+
+    if (header->target_len > UPDATE_SLOT_SIZE) {
+        update_error = "image larger than the firmware region";
+        return false;
+    }
+
+    // The patch only makes sense against the image it was made from
+    if (header->source_len > 0) {
+        uint8_t hash[SHA256_DIGEST_SIZE];
+        clock_boost_begin();
+        sha256((const uint8_t*)XIP_BASE, header->source_len, hash);
+        clock_boost_end();
+        if (memcmp(hash, header->source_hash, SHA256_DIGEST_SIZE) != 0) {
+            update_error = "patch is for a different image";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool update_on_output(void *user, const uint8_t *data, size_t len) {
+    (void)user;
+
+    sha256_update(&update_hash, data, len);
+    while (len > 0) {
+        size_t take = FLASH_PAGE_SIZE - update_page_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(update_page + update_page_len, data, take);
+        update_page_len += (uint32_t)take;
+        data += take;
+        len -= take;
+
+        if (update_page_len == FLASH_PAGE_SIZE && !update_program_page()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Pad out and program the last page; the hash only covers the image itself
+static bool update_flush(uint8_t hash[SHA256_DIGEST_SIZE]) {
+    if (update_page_len > 0) {
+        memset(update_page + update_page_len, 0xFF, FLASH_PAGE_SIZE - update_page_len);
+        update_page_len = FLASH_PAGE_SIZE;
+        if (!update_program_page()) {
+            return false;
+        }
+    }
+    sha256_final(&update_hash, hash);
+    return true;
+}
+
+// Commit a verified image: only now does the marker say there is one
+static bool update_stage(const uint8_t hash[SHA256_DIGEST_SIZE], uint32_t length) {
+    update_marker.magic = UPDATE_MARKER_MAGIC;
+    update_marker.length = length;
+    memcpy(update_marker.hash, hash, SHA256_DIGEST_SIZE);
+    update_marker.check = update_marker_check(&update_marker);
+    if (!update_write_marker(&update_marker)) {
+        return update_fail("marker write failed");
+    }
+
+    update_state = UPDATE_STAGED;
+    printf("UPDATE: Image staged (%lu bytes from %lu %s bytes, %lu sectors changed, %lu ms)\n",
+           (unsigned long)update_marker.length, (unsigned long)update_received,
+           update_from_uf2 ? "UF2" : "patch", (unsigned long)update_sectors_erased,
+           (unsigned long)((time_us_32() - update_start_us) / 1000));
+    return true;
+}
+
+static void update_begin_uf2(void) {
+    update_abort();
+
+    update_uf2.base = XIP_BASE;
+    update_uf2.max_len = UPDATE_SLOT_SIZE;
+    update_uf2.window = update_uf2_window;
+    update_uf2.window_size = CASHSTICK_UF2_REORDER_WINDOW;
+    update_uf2.output = update_on_output;
+    update_uf2.user = NULL;
+    uf2_stream_init(&update_uf2);
+    sha256_init(&update_hash);
+
+    update_from_uf2 = true;
+    update_state = UPDATE_RECEIVING;
+    update_start_us = time_us_32();
+}
+
+// One page of the rebuilt image. Pages matching the running image cost
+// nothing until their sector turns out to have changed; sector 0 is always
+// staged, since the installer erases it first.
+static bool update_program_page(void) {
+    uint32_t sector = update_written / FLASH_SECTOR_SIZE;
+
+    if (!update_sector_staged(&update_marker, sector)) {
+        if (sector != 0 &&
+            memcmp((const void*)(XIP_BASE + update_written), update_page, FLASH_PAGE_SIZE) == 0) {
+            update_written += FLASH_PAGE_SIZE;
+            update_page_len = 0;
+            return true;
+        }
+        if (!update_stage_sector(sector)) {
+            return false;
+        }
+    }
+
+    if (!update_slot_program(update_written, update_page)) {
+        return false;
+    }
+    update_written += FLASH_PAGE_SIZE;
+    update_page_len = 0;
+    return true;
+}
+
+// Start a sector's copy in the slot, carrying over the pages already
+// passed, which matched the running image
+static bool update_stage_sector(uint32_t sector) {
+    uint32_t offset = sector * FLASH_SECTOR_SIZE;
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = metrics_start();
+    flash_range_erase(FLASH_TARGET_OFFSET + UPDATE_SLOT_SECTOR_OFFSET + offset, FLASH_SECTOR_SIZE);
+    metrics_end(METRIC_FLASH_ERASE, start, true);
+    restore_interrupts(ints);
+
+    update_marker.staged[sector / 32] |= 1u << (sector % 32);
+    update_sectors_erased++;
+
+    uint8_t page[FLASH_PAGE_SIZE];
+    for (uint32_t page_offset = offset; page_offset < update_written; page_offset += FLASH_PAGE_SIZE) {
+        memcpy(page, (const void*)(XIP_BASE + page_offset), FLASH_PAGE_SIZE);
+        if (!update_slot_program(page_offset, page)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool update_slot_program(uint32_t image_offset, const uint8_t *page) {
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = metrics_start();
+    flash_range_program(FLASH_TARGET_OFFSET + UPDATE_SLOT_SECTOR_OFFSET + image_offset, page, FLASH_PAGE_SIZE);
+    metrics_end(METRIC_FLASH_PROGRAM, start, true);
+    restore_interrupts(ints);
+
+    if (memcmp((const void*)(UPDATE_SLOT_FLASH_ADDR + image_offset), page, FLASH_PAGE_SIZE) != 0) {
+        update_error = "slot program verify failed";
+        return false;
+    }
+    return true;
+}
+
+static bool update_sector_staged(const update_marker_t *marker, uint32_t sector) {
+    return (marker->staged[sector / 32] >> (sector % 32)) & 1;
+}
+
+static uint32_t update_marker_check(const update_marker_t *marker) {
+    uint32_t check = marker->magic ^ marker->length;
+    for (size_t i = 0; i < count_of(marker->staged); i++) {
+        check ^= marker->staged[i];
+    }
+    return ~check;
+}
+
+static bool update_marker_valid(update_marker_t *marker) {
+    memcpy(marker, (const void*)UPDATE_MARKER_FLASH_ADDR, sizeof(*marker));
+    return marker->magic == UPDATE_MARKER_MAGIC &&
+           marker->check == update_marker_check(marker) &&
+           marker->length > 0 && marker->length <= UPDATE_SLOT_SIZE;
+}
+
+static bool update_write_marker(const update_marker_t *marker) {
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, marker, sizeof(*marker));
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = metrics_start();
+    flash_range_erase(FLASH_TARGET_OFFSET + UPDATE_MARKER_SECTOR_OFFSET, FLASH_SECTOR_SIZE);
+    metrics_end(METRIC_FLASH_ERASE, start, true);
+    start = metrics_start();
+    flash_range_program(FLASH_TARGET_OFFSET + UPDATE_MARKER_SECTOR_OFFSET, page, FLASH_PAGE_SIZE);
+    metrics_end(METRIC_FLASH_PROGRAM, start, true);
+    restore_interrupts(ints);
+
+    update_marker_t check;
+    return update_marker_valid(&check) && memcmp(&check, marker, sizeof(check)) == 0;
+}
+
+static void update_erase_marker(void) {
+    update_marker_t marker;
+    if (!update_marker_valid(&marker)) {
+        return;
+    }
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = metrics_start();
+    flash_range_erase(FLASH_TARGET_OFFSET + UPDATE_MARKER_SECTOR_OFFSET, FLASH_SECTOR_SIZE);
+    metrics_end(METRIC_FLASH_ERASE, start, true);
+    restore_interrupts(ints);
+}
+
+static bool update_fail(const char *error) {
+    if (update_state == UPDATE_RECEIVING) {
+        update_state = UPDATE_FAILED;
+    }
+    update_error = error;
+    printf("UPDATE: %s\n", error);
+    return false;
+}
+
+// update_fail() for the USB task, which must not printf: stdio goes out
+// over the USB stack it is running. update_service() reports the outcome.
+static bool update_uf2_fail(const char *error) {
+    update_state = UPDATE_FAILED;
+    update_error = error;
+    return false;
+}
+
+// Runs from SRAM with interrupts off and never returns: once sector 0 is
+// erased nothing in flash may run. Only the SDK's RAM-resident flash
+// routines are called, and bytes are moved with a plain loop rather than
+// memcpy, which may live in flash. The marker is a copy in RAM.
+static void __no_inline_not_in_flash_func(update_copy_image)(const update_marker_t *marker) {
+    const volatile uint8_t *slot = (const volatile uint8_t*)UPDATE_SLOT_FLASH_ADDR;
+    uint32_t length = marker->length;
+    uint32_t sectors = (length + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
+    uint8_t page[FLASH_PAGE_SIZE];
+
+    flash_range_erase(0, FLASH_SECTOR_SIZE);
+
+    // Highest sector first, so sector 0 - and with it a bootable image -
+    // comes back last
+    for (uint32_t sector = sectors; sector-- > 0;) {
+        if (!((marker->staged[sector / 32] >> (sector % 32)) & 1)) {
+            continue;
+        }
+
+        uint32_t offset = sector * FLASH_SECTOR_SIZE;
+        if (sector != 0) {
+            flash_range_erase(offset, FLASH_SECTOR_SIZE);
+        }
+        for (uint32_t page_offset = offset; page_offset < offset + FLASH_SECTOR_SIZE && page_offset < length;
+             page_offset += FLASH_PAGE_SIZE) {
+            for (uint32_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+                page[i] = slot[page_offset + i];
+            }
+            flash_range_program(page_offset, page, FLASH_PAGE_SIZE);
+        }
+    }
+
+    flash_range_erase(FLASH_TARGET_OFFSET + UPDATE_MARKER_SECTOR_OFFSET, FLASH_SECTOR_SIZE);
+
+    scb_hw->aircr = (0x05FAu << M0PLUS_AIRCR_VECTKEY_LSB) | M0PLUS_AIRCR_SYSRESETREQ_BITS;
+    while (true) {
+        tight_loop_contents();
+    }
+}
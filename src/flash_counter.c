@@ -0,0 +1,183 @@
+#include "cashstick.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "flash_layout.h"
+
+// Monotonic counters that survive power cycles without a sector erase per
+// increment. The value is a unary bitmap: NOR flash can program any 1 bit
+// to 0 in place, so each increment clears one more bit by re-programming a
+// single page that is 0xFF everywhere else. Reading is a popcount over the
+// XIP-mapped words.
+//
+// Each counter owns two sectors. Page 0 of a sector is a header carrying
+// the value at the time the sector was started (base) and a sequence
+// number; the remaining pages are the bitmap. When the bitmap is spent the
+// other sector is erased and given a header with the current value and a
+// higher sequence, programmed in one page write. Until that write lands
+// the old sector stays authoritative, so a rollover cut short by power
+// loss never changes the value.
+
+#define FLASH_COUNTER_MAGIC 0xC0A7E125
+#define FLASH_COUNTER_BITMAP_OFFSET FLASH_PAGE_SIZE
+#define FLASH_COUNTER_BITMAP_WORDS ((FLASH_SECTOR_SIZE - FLASH_COUNTER_BITMAP_OFFSET) / 4)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t base;
+    uint32_t check;     // ~(magic ^ sequence ^ base)
+} flash_counter_header_t;
+
+static const volatile uint32_t *counter_bitmap(uint32_t sector_offset);
+static bool counter_header_valid(uint32_t sector_offset, flash_counter_header_t *header);
+static int counter_active_sector(const flash_counter_t *counter, flash_counter_header_t *header);
+static uint32_t counter_bitmap_used(uint32_t sector_offset, int *next_word);
+static bool counter_start_sector(uint32_t sector_offset, uint32_t sequence, uint32_t base);
+static void counter_program_word(uint32_t sector_offset, int word, uint32_t value);
+
+bool flash_counter_init(const flash_counter_t *counter) {
+    flash_counter_header_t header;
+    if (counter_active_sector(counter, &header) >= 0) {
+        return true;
+    }
+
+    printf("FLASH: Formatting counter at 0x%05lx\n", (unsigned long)counter->sector_offset[0]);
+    return counter_start_sector(counter->sector_offset[0], 1, 0);
+}
+
+uint32_t flash_counter_read(const flash_counter_t *counter) {
+    flash_counter_header_t header;
+    int active = counter_active_sector(counter, &header);
+    if (active < 0) {
+        return 0;
+    }
+
+    return header.base + counter_bitmap_used(counter->sector_offset[active], NULL);
+}
+
+bool flash_counter_increment(const flash_counter_t *counter) {
+    flash_counter_header_t header;
+    int active = counter_active_sector(counter, &header);
+    if (active < 0) {
+        return false;
+    }
+
+    uint32_t sector = counter->sector_offset[active];
+    int next_word;
+    uint32_t used = counter_bitmap_used(sector, &next_word);
+
+    if (next_word < 0) {
+        // Bitmap spent - carry the value into the other sector
+        sector = counter->sector_offset[active ^ 1];
+        if (!counter_start_sector(sector, header.sequence + 1, header.base + used)) {
+            return false;
+        }
+        next_word = 0;
+    }
+
+    // Clear the lowest bit still set in the first unspent word
+    uint32_t word = counter_bitmap(sector)[next_word];
+    counter_program_word(sector, next_word, word & (word - 1));
+
+    return counter_bitmap(sector)[next_word] != word;
+}
+
+// Internal helper functions
+
+static const volatile uint32_t *counter_bitmap(uint32_t sector_offset) {
+    return (const volatile uint32_t*)(XIP_BASE + FLASH_TARGET_OFFSET + sector_offset + FLASH_COUNTER_BITMAP_OFFSET);
+}
+
+static bool counter_header_valid(uint32_t sector_offset, flash_counter_header_t *header) {
+    memcpy(header, (const void*)(XIP_BASE + FLASH_TARGET_OFFSET + sector_offset), sizeof(*header));
+    return header->magic == FLASH_COUNTER_MAGIC &&
+           header->check == ~(header->magic ^ header->sequence ^ header->base);
+}
+
+// Index of the authoritative sector, or -1 if neither has a header
+static int counter_active_sector(const flash_counter_t *counter, flash_counter_header_t *header) {
+    flash_counter_header_t headers[2];
+    bool valid[2];
+    for (int i = 0; i < 2; i++) {
+        valid[i] = counter_header_valid(counter->sector_offset[i], &headers[i]);
+    }
+
+    int active;
+    if (valid[0] && valid[1]) {
+        active = (int32_t)(headers[1].sequence - headers[0].sequence) > 0 ? 1 : 0;
+    } else if (valid[0] || valid[1]) {
+        active = valid[0] ? 0 : 1;
+    } else {
+        return -1;
+    }
+
+    *header = headers[active];
+    return active;
+}
+
+// Bits cleared so far. Words are spent in order, so the scan stops at the
+// first untouched word. next_word is the first word with a bit left, or -1
+// when the bitmap is full.
+static uint32_t counter_bitmap_used(uint32_t sector_offset, int *next_word) {
+    const volatile uint32_t *bitmap = counter_bitmap(sector_offset);
+    uint32_t used = 0;
+
+    for (int i = 0; i < FLASH_COUNTER_BITMAP_WORDS; i++) {
+        uint32_t word = bitmap[i];
+        used += 32 - (uint32_t)__builtin_popcount(word);
+        if (word != 0) {
+            if (next_word) {
+                *next_word = i;
+            }
+            // Later words are still erased unless this one is spent
+            return used;
+        }
+    }
+
+    if (next_word) {
+        *next_word = -1;
+    }
+    return used;
+}
+
+static bool counter_start_sector(uint32_t sector_offset, uint32_t sequence, uint32_t base) {
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+
+    flash_counter_header_t header = {
+        .magic = FLASH_COUNTER_MAGIC,
+        .sequence = sequence,
+        .base = base,
+        .check = ~(FLASH_COUNTER_MAGIC ^ sequence ^ base)
+    };
+    memcpy(page, &header, sizeof(header));
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = metrics_start();
+    flash_range_erase(FLASH_TARGET_OFFSET + sector_offset, FLASH_SECTOR_SIZE);
+    metrics_end(METRIC_FLASH_ERASE, start, true);
+    start = metrics_start();
+    flash_range_program(FLASH_TARGET_OFFSET + sector_offset, page, FLASH_PAGE_SIZE);
+    metrics_end(METRIC_FLASH_PROGRAM, start, true);
+    restore_interrupts(ints);
+
+    flash_counter_header_t check;
+    return counter_header_valid(sector_offset, &check) && check.sequence == sequence;
+}
+
+// Re-program the page holding one bitmap word; 0xFF bytes leave the rest
+// of the page untouched
+static void counter_program_word(uint32_t sector_offset, int word, uint32_t value) {
+    uint32_t byte_offset = FLASH_COUNTER_BITMAP_OFFSET + (uint32_t)word * 4;
+    uint32_t page_offset = byte_offset & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page + (byte_offset - page_offset), &value, sizeof(value));
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = metrics_start();
+    flash_range_program(FLASH_TARGET_OFFSET + sector_offset + page_offset, page, FLASH_PAGE_SIZE);
+    metrics_end(METRIC_FLASH_PROGRAM, start, true);
+    restore_interrupts(ints);
+}
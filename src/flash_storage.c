@@ -1,24 +1,36 @@
 #include "cashstick.h"
 #include "hardware/flash.h"
 #include "hardware/sync.h"
+#include "hardware/dma.h"
+#include "flash_layout.h"
 
-// Flash memory layout
-#define FLASH_TARGET_OFFSET (256 * 1024)  // 256KB offset for user data
-#define FLASH_SECTOR_SIZE 4096
-#define KEYS_SECTOR_OFFSET 0
-#define STATE_SECTOR_OFFSET 4096
-#define SEAL_SECTOR_OFFSET 8192
+// The device record (keys, state, seal) is kept in two copies, each with
+// a CRC32 taken by the DMA sniffer. A write goes to the older copy first,
+// so power loss part way leaves the newer one whole; reads take the valid
+// copy with the higher generation, and flash_scrub_service() rewrites a
+// copy that is damaged or stale from the other while the device is idle.
+typedef struct {
+    device_record_t record;
+    uint32_t generation;    // Higher wins when the copies differ
+    uint32_t timestamp;
+    uint32_t magic;
+    uint32_t crc;           // CRC32 of everything above
+} stored_device_record_t;
 
-// Calculate flash addresses
-#define KEYS_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + KEYS_SECTOR_OFFSET)
-#define STATE_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + STATE_SECTOR_OFFSET)
-#define SEAL_FLASH_ADDR (XIP_BASE + FLASH_TARGET_OFFSET + SEAL_SECTOR_OFFSET)
+// Single-copy device record written by earlier firmware
+typedef struct {
+    device_record_t record;
+    uint32_t timestamp;
+    uint32_t checksum;
+    uint32_t magic;  // Validation marker
+} stored_device_record_v1_t;
 
-// Storage structures with checksums
+// Separate keys, state and seal records written by earlier firmware; read
+// once to migrate, then superseded by the device record
 typedef struct {
     bitcoin_keys_t keys;
     uint32_t checksum;
-    uint32_t magic;  // Validation marker
+    uint32_t magic;
 } stored_keys_t;
 
 typedef struct {
@@ -28,149 +40,342 @@ typedef struct {
     uint32_t magic;
 } stored_state_t;
 
-#define KEYS_MAGIC 0xBTC12345
-#define STATE_MAGIC 0xDEV12345
+typedef struct {
+    key_pool_t pool;
+    uint32_t checksum;
+    uint32_t magic;
+} stored_key_pool_t;
+
+typedef struct {
+    measure_cache_t cache;
+    uint32_t checksum;
+    uint32_t magic;
+} stored_measure_cache_t;
+
+#define DEVICE_RECORD_MAGIC 0xDE7C1236  // Two copies, CRC32
+#define DEVICE_RECORD_V1_MAGIC 0xDE7C1235  // Single copy, carries the tamper seal
+#define KEYS_MAGIC 0xB7C12346  // Legacy, migrated into the device record
+#define STATE_MAGIC 0xDE512345
+#define SEAL_MAGIC 0x5EA11234  // Legacy, migrated into the device record
+#define KEY_POOL_MAGIC 0x9001C0DE
+#define MEASURE_MAGIC 0x3EA5C0DE
+
+#define DEVICE_RECORD_COPIES 2
+#define DEVICE_RECORD_CRC_LEN offsetof(stored_device_record_t, crc)
+
+_Static_assert(DEVICE_RECORD_CRC_LEN % 4 == 0, "the DMA CRC runs over whole words");
+
+static const uint32_t device_record_sectors[DEVICE_RECORD_COPIES] = {
+    KEYS_SECTOR_OFFSET, KEYS_MIRROR_SECTOR_OFFSET
+};
+static uint32_t device_record_generation = 0;  // Of the newest copy in flash
+static int device_record_newest = 0;
 
 // Internal functions
 static uint32_t calculate_checksum(const uint8_t *data, size_t len);
+static uint32_t dma_crc32(const void *data, size_t len);
+static bool device_record_copy_valid(int copy, stored_device_record_t *stored);
+static int device_record_pick(const bool valid[DEVICE_RECORD_COPIES],
+                              const stored_device_record_t stored[DEVICE_RECORD_COPIES]);
 static bool flash_write_sector(uint32_t offset, const uint8_t *data, size_t len);
 static bool flash_read_sector(uint32_t offset, uint8_t *data, size_t len);
+static bool flash_read_legacy_seal(uint8_t *seal_data, size_t len);
+
+bool flash_write_device_record(const device_record_t *record) {
+    if (!record) {
+        return false;
+    }
+    
+    stored_device_record_t stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.record = *record;
+    stored.generation = device_record_generation + 1;
+    stored.timestamp = get_system_time_ms();
+    stored.magic = DEVICE_RECORD_MAGIC;
+    stored.crc = dma_crc32(&stored, DEVICE_RECORD_CRC_LEN);
+    
+    printf("FLASH: Writing device record (state %d, generation %lu)\n",
+           record->state, (unsigned long)stored.generation);
+    
+    // Older copy first; once it verifies the record is committed
+    int first = device_record_newest ^ 1;
+    if (!flash_write_sector(device_record_sectors[first], (uint8_t*)&stored, sizeof(stored))) {
+        printf("FLASH: Failed to write device record\n");
+        return false;
+    }
+    device_record_generation = stored.generation;
+    device_record_newest = first;
+    
+    // A failure here leaves a stale copy for the scrubber to repair
+    if (!flash_write_sector(device_record_sectors[first ^ 1], (uint8_t*)&stored, sizeof(stored))) {
+        printf("FLASH: Device record copy %d not updated\n", first ^ 1);
+    }
+    
+    printf("FLASH: Device record written successfully\n");
+    return true;
+}
 
-bool flash_write_keys(const bitcoin_keys_t *keys) {
-    if (!keys) {
+bool flash_read_device_record(device_record_t *record) {
+    if (!record) {
         return false;
     }
     
+    stored_device_record_t stored[DEVICE_RECORD_COPIES];
+    bool valid[DEVICE_RECORD_COPIES];
+    for (int i = 0; i < DEVICE_RECORD_COPIES; i++) {
+        valid[i] = device_record_copy_valid(i, &stored[i]);
+    }
+    
+    int newest = device_record_pick(valid, stored);
+    if (newest >= 0) {
+        device_record_generation = stored[newest].generation;
+        device_record_newest = newest;
+        if (!valid[newest ^ 1]) {
+            printf("FLASH: Device record copy %d damaged, using copy %d\n", newest ^ 1, newest);
+        }
+        
+        *record = stored[newest].record;
+        printf("FLASH: Device record read: state %d (generation %lu, timestamp: %lu)\n",
+               stored[newest].record.state, (unsigned long)stored[newest].generation,
+               (unsigned long)stored[newest].timestamp);
+        return true;
+    }
+    
+    stored_device_record_v1_t stored_v1 = {0};
+    if (flash_read_sector(KEYS_SECTOR_OFFSET, (uint8_t*)&stored_v1, sizeof(stored_v1)) &&
+        stored_v1.magic == DEVICE_RECORD_V1_MAGIC) {
+        uint32_t calculated_checksum = calculate_checksum((uint8_t*)&stored_v1.record, sizeof(device_record_t) + sizeof(uint32_t));
+        if (stored_v1.checksum != calculated_checksum) {
+            printf("FLASH: Device record checksum mismatch\n");
+            return false;
+        }
+        
+        // Gains its second copy on the next write
+        *record = stored_v1.record;
+        printf("FLASH: Single-copy device record read: state %d\n", stored_v1.record.state);
+        return true;
+    }
+    
+    // Fall back to the separate keys, state and seal records of earlier firmware
+    memset(record, 0, sizeof(*record));
+    record->state = DEVICE_STATE_NEW;
+    
     stored_keys_t stored_keys = {0};
-    stored_keys.keys = *keys;
-    stored_keys.magic = KEYS_MAGIC;
-    stored_keys.checksum = calculate_checksum((uint8_t*)&stored_keys.keys, sizeof(bitcoin_keys_t));
+    stored_state_t stored_state = {0};
+    bool have_keys = false;
+    bool have_state = false;
+    
+    if (flash_read_sector(KEYS_SECTOR_OFFSET, (uint8_t*)&stored_keys, sizeof(stored_keys)) &&
+        stored_keys.magic == KEYS_MAGIC &&
+        stored_keys.checksum == calculate_checksum((uint8_t*)&stored_keys.keys, sizeof(bitcoin_keys_t))) {
+        record->keys = stored_keys.keys;
+        have_keys = true;
+    }
     
-    printf("FLASH: Writing Bitcoin keys\n");
+    if (flash_read_sector(STATE_SECTOR_OFFSET, (uint8_t*)&stored_state, sizeof(stored_state)) &&
+        stored_state.magic == STATE_MAGIC &&
+        stored_state.checksum == calculate_checksum((uint8_t*)&stored_state.state, sizeof(device_state_t) + sizeof(uint32_t))) {
+        record->state = stored_state.state;
+        have_state = true;
+    }
     
-    bool success = flash_write_sector(KEYS_SECTOR_OFFSET, (uint8_t*)&stored_keys, sizeof(stored_keys));
+    if (!flash_read_legacy_seal(record->seal, sizeof(record->seal))) {
+        memset(record->seal, 0, sizeof(record->seal));
+    }
     
-    if (success) {
-        printf("FLASH: Keys written successfully\n");
-    } else {
-        printf("FLASH: Failed to write keys\n");
+    if (!have_keys && !have_state) {
+        printf("FLASH: No device record, defaulting to NEW\n");
+        return false;
     }
     
-    return success;
+    printf("FLASH: Migrating legacy keys/state/seal records (state %d)\n", record->state);
+    return true;
 }
 
-bool flash_read_keys(bitcoin_keys_t *keys) {
-    if (!keys) {
+// Key pool storage functions
+bool flash_write_key_pool(const key_pool_t *pool) {
+    if (!pool) {
         return false;
     }
     
-    stored_keys_t stored_keys = {0};
+    stored_key_pool_t stored_pool = {0};
+    stored_pool.pool = *pool;
+    stored_pool.magic = KEY_POOL_MAGIC;
+    stored_pool.checksum = calculate_checksum((uint8_t*)&stored_pool.pool, sizeof(key_pool_t));
+    
+    printf("FLASH: Writing key pool\n");
     
-    if (!flash_read_sector(KEYS_SECTOR_OFFSET, (uint8_t*)&stored_keys, sizeof(stored_keys))) {
-        printf("FLASH: Failed to read keys sector\n");
+    return flash_write_sector(KEY_POOL_SECTOR_OFFSET, (uint8_t*)&stored_pool, sizeof(stored_pool));
+}
+
+bool flash_read_key_pool(key_pool_t *pool) {
+    if (!pool) {
         return false;
     }
     
-    // Validate magic number
-    if (stored_keys.magic != KEYS_MAGIC) {
-        printf("FLASH: Invalid keys magic number\n");
+    stored_key_pool_t stored_pool = {0};
+    
+    if (!flash_read_sector(KEY_POOL_SECTOR_OFFSET, (uint8_t*)&stored_pool, sizeof(stored_pool))) {
         return false;
     }
     
-    // Validate checksum
-    uint32_t calculated_checksum = calculate_checksum((uint8_t*)&stored_keys.keys, sizeof(bitcoin_keys_t));
-    if (stored_keys.checksum != calculated_checksum) {
-        printf("FLASH: Keys checksum mismatch\n");
+    if (stored_pool.magic != KEY_POOL_MAGIC) {
+        printf("FLASH: No key pool record\n");
         return false;
     }
     
-    *keys = stored_keys.keys;
-    printf("FLASH: Keys read successfully\n");
+    uint32_t calculated_checksum = calculate_checksum((uint8_t*)&stored_pool.pool, sizeof(key_pool_t));
+    if (stored_pool.checksum != calculated_checksum) {
+        printf("FLASH: Key pool checksum mismatch\n");
+        return false;
+    }
     
+    *pool = stored_pool.pool;
     return true;
 }
 
-bool flash_write_device_state(device_state_t state) {
-    stored_state_t stored_state = {0};
-    stored_state.state = state;
-    stored_state.timestamp = get_system_time_ms();
-    stored_state.magic = STATE_MAGIC;
-    stored_state.checksum = calculate_checksum((uint8_t*)&stored_state.state, sizeof(device_state_t) + sizeof(uint32_t));
+// Measured boot cache storage functions
+bool flash_write_measure_cache(const measure_cache_t *cache) {
+    if (!cache) {
+        return false;
+    }
     
-    printf("FLASH: Writing device state: %d\n", state);
+    // Too big for the stack
+    size_t scratch = scratch_mark();
+    stored_measure_cache_t *measure_record = scratch_alloc(sizeof(*measure_record));
+    if (!measure_record) {
+        return false;
+    }
     
-    bool success = flash_write_sector(STATE_SECTOR_OFFSET, (uint8_t*)&stored_state, sizeof(stored_state));
+    measure_record->cache = *cache;
+    measure_record->magic = MEASURE_MAGIC;
+    measure_record->checksum = calculate_checksum((uint8_t*)&measure_record->cache, sizeof(measure_cache_t));
     
-    if (success) {
-        printf("FLASH: Device state written successfully\n");
-    } else {
-        printf("FLASH: Failed to write device state\n");
-    }
+    printf("FLASH: Writing measurement cache\n");
     
+    bool success = flash_write_sector(MEASURE_SECTOR_OFFSET, (uint8_t*)measure_record, sizeof(*measure_record));
+    scratch_release(scratch);
     return success;
 }
 
-device_state_t flash_read_device_state(void) {
-    stored_state_t stored_state = {0};
+bool flash_read_measure_cache(measure_cache_t *cache) {
+    if (!cache) {
+        return false;
+    }
     
-    if (!flash_read_sector(STATE_SECTOR_OFFSET, (uint8_t*)&stored_state, sizeof(stored_state))) {
-        printf("FLASH: Failed to read state sector, defaulting to NEW\n");
-        return DEVICE_STATE_NEW;
+    // Validated in place: the cache is only copied out once it checks out
+    const stored_measure_cache_t *measure_record =
+        (const stored_measure_cache_t*)(XIP_BASE + FLASH_TARGET_OFFSET + MEASURE_SECTOR_OFFSET);
+    
+    if (measure_record->magic != MEASURE_MAGIC) {
+        printf("FLASH: No measurement cache\n");
+        return false;
     }
     
-    // Validate magic number
-    if (stored_state.magic != STATE_MAGIC) {
-        printf("FLASH: Invalid state magic number, defaulting to NEW\n");
-        return DEVICE_STATE_NEW;
+    uint32_t calculated_checksum = calculate_checksum((const uint8_t*)&measure_record->cache, sizeof(measure_cache_t));
+    if (measure_record->checksum != calculated_checksum) {
+        printf("FLASH: Measurement cache checksum mismatch\n");
+        return false;
     }
     
-    // Validate checksum
-    uint32_t calculated_checksum = calculate_checksum((uint8_t*)&stored_state.state, sizeof(device_state_t) + sizeof(uint32_t));
-    if (stored_state.checksum != calculated_checksum) {
-        printf("FLASH: State checksum mismatch, defaulting to NEW\n");
-        return DEVICE_STATE_NEW;
+    *cache = measure_record->cache;
+    return true;
+}
+
+// CRC-32 of a flash range (offset from the start of flash). Reads bypass
+// the XIP cache to avoid evicting code. len must be a multiple of 4.
+uint32_t flash_crc32(uint32_t flash_offset, size_t len) {
+    return dma_crc32((const void*)(XIP_NOCACHE_NOALLOC_BASE + flash_offset), len);
+}
+
+// Idle-time scrub of the device record copies, at most once per
+// FLASH_SCRUB_INTERVAL_MS. Each copy checked is a METRIC_FLASH_SCRUB
+// sample (an error if it was damaged or stale); each rewrite from the
+// other copy is a METRIC_FLASH_REPAIR sample.
+void flash_scrub_service(void) {
+    static uint32_t last_pass_ms;
+    static bool scrubbed = false;
+    
+    uint32_t now = get_system_time_ms();
+    if (scrubbed && now - last_pass_ms < FLASH_SCRUB_INTERVAL_MS) {
+        return;
+    }
+    scrubbed = true;
+    last_pass_ms = now;
+    
+    stored_device_record_t stored[DEVICE_RECORD_COPIES];
+    bool valid[DEVICE_RECORD_COPIES];
+    for (int i = 0; i < DEVICE_RECORD_COPIES; i++) {
+        uint32_t start = metrics_start();
+        valid[i] = device_record_copy_valid(i, &stored[i]);
+        metrics_end(METRIC_FLASH_SCRUB, start, valid[i]);
+    }
+    
+    // Nothing to go on until a record has been written in this format
+    int good = device_record_pick(valid, stored);
+    if (good < 0) {
+        return;
     }
     
-    printf("FLASH: Device state read: %d (timestamp: %d)\n", stored_state.state, stored_state.timestamp);
+    int bad = good ^ 1;
+    if (valid[bad] && stored[bad].generation == stored[good].generation) {
+        return;
+    }
     
-    return stored_state.state;
+    printf("FLASH: Scrub repairing device record copy %d from copy %d\n", bad, good);
+    uint32_t start = metrics_start();
+    bool repaired = flash_write_sector(device_record_sectors[bad], (uint8_t*)&stored[good], sizeof(stored[good]));
+    metrics_end(METRIC_FLASH_REPAIR, start, repaired);
 }
 
-// Tamper seal storage functions
-bool flash_write_seal_data(const uint8_t *seal_data, size_t len) {
-    if (!seal_data || len > FLASH_SECTOR_SIZE - 8) {  // Leave room for metadata
-        return false;
-    }
+// Internal helper functions
+
+// CRC-32 of memory computed by the DMA sniffer while the data streams past,
+// so it costs no CPU time per byte. len must be a multiple of 4.
+static uint32_t dma_crc32(const void *data, size_t len) {
+    static uint32_t crc_sink;
     
-    // Add magic number and checksum
-    uint8_t sector_data[FLASH_SECTOR_SIZE] = {0};
-    uint32_t magic = 0x5EAL1234;
-    uint32_t checksum = calculate_checksum(seal_data, len);
+    int chan = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_sniff_enable(&config, true);
     
-    memcpy(sector_data, &magic, sizeof(magic));
-    memcpy(sector_data + 4, &checksum, sizeof(checksum));
-    memcpy(sector_data + 8, seal_data, len);
+    dma_sniffer_enable(chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32, true);
+    dma_sniffer_set_data_accumulator(0xFFFFFFFF);
     
-    printf("FLASH: Writing tamper seal data\n");
+    dma_channel_configure(chan, &config, &crc_sink, data, len / 4, true);
+    dma_channel_wait_for_finish_blocking(chan);
     
-    return flash_write_sector(SEAL_SECTOR_OFFSET, sector_data, FLASH_SECTOR_SIZE);
+    uint32_t crc = dma_sniffer_get_data_accumulator();
+    dma_sniffer_disable();
+    dma_channel_unclaim(chan);
+    
+    return crc;
 }
 
-bool flash_read_seal_data(uint8_t *seal_data, size_t len) {
+// Seal record written by earlier firmware; the seal now lives in the
+// device record
+static bool flash_read_legacy_seal(uint8_t *seal_data, size_t len) {
     if (!seal_data) {
         return false;
     }
     
-    uint8_t sector_data[FLASH_SECTOR_SIZE];
+    // Magic and checksum header, then the seal - not the whole sector
+    uint8_t sector_data[8 + 32];
+    if (len > sizeof(sector_data) - 8) {
+        return false;
+    }
     
-    if (!flash_read_sector(SEAL_SECTOR_OFFSET, sector_data, FLASH_SECTOR_SIZE)) {
+    if (!flash_read_sector(SEAL_SECTOR_OFFSET, sector_data, 8 + len)) {
         return false;
     }
     
     // Validate magic number
     uint32_t magic;
     memcpy(&magic, sector_data, sizeof(magic));
-    if (magic != 0x5EAL1234) {
+    if (magic != SEAL_MAGIC) {
         printf("FLASH: Invalid seal magic number\n");
         return false;
     }
@@ -191,9 +396,30 @@ bool flash_read_seal_data(uint8_t *seal_data, size_t len) {
     return true;
 }
 
-// Internal helper functions
+// Copy of the device record in this format with an intact CRC. The CRC is
+// taken straight from flash, bypassing the XIP cache.
+static bool device_record_copy_valid(int copy, stored_device_record_t *stored) {
+    uint32_t offset = device_record_sectors[copy];
+    if (!flash_read_sector(offset, (uint8_t*)stored, sizeof(*stored)) ||
+        stored->magic != DEVICE_RECORD_MAGIC) {
+        return false;
+    }
+    return flash_crc32(FLASH_TARGET_OFFSET + offset, DEVICE_RECORD_CRC_LEN) == stored->crc;
+}
 
-static uint32_t calculate_checksum(const uint8_t *data, size_t len) {
+// The valid copy with the higher generation, or -1 if neither is valid
+static int device_record_pick(const bool valid[DEVICE_RECORD_COPIES],
+                              const stored_device_record_t stored[DEVICE_RECORD_COPIES]) {
+    if (valid[0] && valid[1]) {
+        return (int32_t)(stored[1].generation - stored[0].generation) > 0 ? 1 : 0;
+    }
+    if (valid[0] || valid[1]) {
+        return valid[0] ? 0 : 1;
+    }
+    return -1;
+}
+
+static uint32_t RAM_FUNC(calculate_checksum)(const uint8_t *data, size_t len) {
     uint32_t checksum = 0;
     
     for (size_t i = 0; i < len; i++) {
@@ -213,10 +439,24 @@ static bool flash_write_sector(uint32_t offset, const uint8_t *data, size_t len)
     uint32_t ints = save_and_disable_interrupts();
     
     // Erase the sector first
+    uint32_t start = metrics_start();
     flash_range_erase(FLASH_TARGET_OFFSET + offset, FLASH_SECTOR_SIZE);
-    
-    // Write the data
-    flash_range_program(FLASH_TARGET_OFFSET + offset, data, FLASH_SECTOR_SIZE);
+    metrics_end(METRIC_FLASH_ERASE, start, true);
+    
+    // Write the data - whole pages straight from the caller, the tail
+    // through a padded page buffer so we never read past the record
+    start = metrics_start();
+    size_t full_pages = len - (len % FLASH_PAGE_SIZE);
+    if (full_pages > 0) {
+        flash_range_program(FLASH_TARGET_OFFSET + offset, data, full_pages);
+    }
+    if (len > full_pages) {
+        uint8_t page[FLASH_PAGE_SIZE];
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, data + full_pages, len - full_pages);
+        flash_range_program(FLASH_TARGET_OFFSET + offset + full_pages, page, FLASH_PAGE_SIZE);
+    }
+    metrics_end(METRIC_FLASH_PROGRAM, start, true);
     
     // Restore interrupts
     restore_interrupts(ints);
@@ -0,0 +1,113 @@
+#include "hmac_drbg.h"
+#include <string.h>
+
+// HMAC_DRBG_Update (10.1.2.2). Up to three pieces of provided data are
+// hashed in sequence so callers never have to concatenate them.
+static void hmac_drbg_update(hmac_drbg_t *drbg,
+                             const uint8_t *data1, size_t len1,
+                             const uint8_t *data2, size_t len2,
+                             const uint8_t *data3, size_t len3) {
+    bool have_data = (len1 + len2 + len3) > 0;
+
+    for (uint8_t round = 0x00; round <= 0x01; round++) {
+        hmac_sha256_ctx_t ctx;
+
+        // K = HMAC(K, V || round || provided_data)
+        hmac_sha256_init(&ctx, drbg->key, sizeof(drbg->key));
+        hmac_sha256_update(&ctx, drbg->v, sizeof(drbg->v));
+        hmac_sha256_update(&ctx, &round, 1);
+        if (len1 > 0) {
+            hmac_sha256_update(&ctx, data1, len1);
+        }
+        if (len2 > 0) {
+            hmac_sha256_update(&ctx, data2, len2);
+        }
+        if (len3 > 0) {
+            hmac_sha256_update(&ctx, data3, len3);
+        }
+        hmac_sha256_final(&ctx, drbg->key);
+
+        // V = HMAC(K, V)
+        hmac_sha256(drbg->key, sizeof(drbg->key), drbg->v, sizeof(drbg->v), drbg->v);
+
+        // The second round only runs when there is provided data
+        if (!have_data) {
+            break;
+        }
+    }
+}
+
+hmac_drbg_result_t hmac_drbg_instantiate(hmac_drbg_t *drbg, uint64_t reseed_interval,
+                                         const uint8_t *entropy, size_t entropy_len,
+                                         const uint8_t *nonce, size_t nonce_len,
+                                         const uint8_t *personalization, size_t pers_len) {
+    if (!drbg || !entropy || entropy_len < HMAC_DRBG_SEED_LEN ||
+        reseed_interval == 0 || reseed_interval > HMAC_DRBG_MAX_RESEED_INTERVAL) {
+        return HMAC_DRBG_BAD_ARGS;
+    }
+
+    memset(drbg->key, 0x00, sizeof(drbg->key));
+    memset(drbg->v, 0x01, sizeof(drbg->v));
+    hmac_drbg_update(drbg, entropy, entropy_len, nonce, nonce ? nonce_len : 0,
+                     personalization, personalization ? pers_len : 0);
+
+    drbg->reseed_counter = 1;
+    drbg->reseed_interval = reseed_interval;
+    drbg->instantiated = true;
+    return HMAC_DRBG_OK;
+}
+
+hmac_drbg_result_t hmac_drbg_reseed(hmac_drbg_t *drbg,
+                                    const uint8_t *entropy, size_t entropy_len,
+                                    const uint8_t *additional, size_t add_len) {
+    if (!drbg || !drbg->instantiated || !entropy || entropy_len < HMAC_DRBG_SEED_LEN) {
+        return HMAC_DRBG_BAD_ARGS;
+    }
+
+    hmac_drbg_update(drbg, entropy, entropy_len, additional, additional ? add_len : 0, NULL, 0);
+    drbg->reseed_counter = 1;
+    return HMAC_DRBG_OK;
+}
+
+hmac_drbg_result_t hmac_drbg_generate(hmac_drbg_t *drbg, uint8_t *out, size_t out_len,
+                                      const uint8_t *additional, size_t add_len) {
+    if (!drbg || !drbg->instantiated || (!out && out_len > 0) || out_len > HMAC_DRBG_MAX_REQUEST) {
+        return HMAC_DRBG_BAD_ARGS;
+    }
+
+    if (drbg->reseed_counter > drbg->reseed_interval) {
+        return HMAC_DRBG_RESEED_REQUIRED;
+    }
+
+    if (!additional) {
+        add_len = 0;
+    }
+    if (add_len > 0) {
+        hmac_drbg_update(drbg, additional, add_len, NULL, 0, NULL, 0);
+    }
+
+    while (out_len > 0) {
+        hmac_sha256(drbg->key, sizeof(drbg->key), drbg->v, sizeof(drbg->v), drbg->v);
+
+        size_t take = out_len < sizeof(drbg->v) ? out_len : sizeof(drbg->v);
+        memcpy(out, drbg->v, take);
+        out += take;
+        out_len -= take;
+    }
+
+    hmac_drbg_update(drbg, additional, add_len, NULL, 0, NULL, 0);
+    drbg->reseed_counter++;
+    return HMAC_DRBG_OK;
+}
+
+void hmac_drbg_uninstantiate(hmac_drbg_t *drbg) {
+    if (!drbg) {
+        return;
+    }
+
+    // volatile so the wipe is not optimized away
+    volatile uint8_t *p = (volatile uint8_t *)drbg;
+    for (size_t i = 0; i < sizeof(*drbg); i++) {
+        p[i] = 0;
+    }
+}
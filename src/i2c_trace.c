@@ -0,0 +1,147 @@
+#include "cashstick.h"
+
+#if CASHSTICK_I2C_TRACE_SIZE > 0
+
+// SE050 bus transcript. While recording, every transfer se050_i2c.c makes
+// (and every bus recovery) is appended to a RAM ring as a fixed header -
+// times, direction, result - followed by the bytes that crossed the bus.
+// The ring is a flight recorder: when it fills, the oldest records make
+// way and are counted as dropped. TRACE read drains it over USB.
+
+typedef struct {
+    uint32_t start_us;
+    uint32_t duration_us;
+    uint32_t gap_us;
+    uint16_t len;
+    int16_t result;
+    uint8_t op;
+    uint8_t stored;
+} i2c_trace_header_t;
+
+static uint8_t trace_ring[CASHSTICK_I2C_TRACE_SIZE];
+static size_t trace_head = 0;       // Next byte written
+static size_t trace_tail = 0;       // Oldest record
+static size_t trace_used = 0;
+static uint32_t trace_records = 0;
+static uint32_t trace_dropped = 0;
+static uint32_t trace_last_end_us = 0;
+static bool trace_recording = false;
+
+static void trace_put(const void *src, size_t len);
+static void trace_get(size_t offset, void *dst, size_t len);
+static void trace_drop_oldest(void);
+
+void i2c_trace_enable(bool on) {
+    if (on && !trace_recording) {
+        trace_last_end_us = time_us_32();
+    }
+    trace_recording = on;
+    printf("I2C: transcript %s\n", on ? "recording" : "stopped");
+}
+
+void i2c_trace_clear(void) {
+    trace_head = 0;
+    trace_tail = 0;
+    trace_used = 0;
+    trace_records = 0;
+    trace_dropped = 0;
+}
+
+void i2c_trace_record(i2c_trace_op_t op, const uint8_t *data, size_t len, int result, uint32_t start_us) {
+    if (!trace_recording) {
+        return;
+    }
+
+    uint32_t now = time_us_32();
+    i2c_trace_header_t header = {
+        .start_us = start_us,
+        .duration_us = now - start_us,
+        .gap_us = start_us - trace_last_end_us,
+        .len = (uint16_t)len,
+        .result = (int16_t)result,
+        .op = (uint8_t)op,
+        // Failed reads carry no data worth keeping
+        .stored = (uint8_t)((op == I2C_TRACE_READ && result < 0) ? 0 :
+                            (len < I2C_TRACE_MAX_DATA ? len : I2C_TRACE_MAX_DATA)),
+    };
+    trace_last_end_us = now;
+
+    size_t need = sizeof(header) + header.stored;
+    while (trace_used + need > sizeof(trace_ring)) {
+        trace_drop_oldest();
+    }
+
+    trace_put(&header, sizeof(header));
+    trace_put(data, header.stored);
+    trace_records++;
+}
+
+// Length the next record takes when formatted: 0 if the ring is empty
+size_t i2c_trace_peek(void) {
+    if (trace_records == 0) {
+        return 0;
+    }
+    i2c_trace_header_t header;
+    trace_get(trace_tail, &header, sizeof(header));
+    return (size_t)header.stored * 2 + 64;
+}
+
+bool i2c_trace_pop(i2c_trace_record_t *record, uint8_t data[I2C_TRACE_MAX_DATA]) {
+    if (trace_records == 0) {
+        return false;
+    }
+
+    i2c_trace_header_t header;
+    trace_get(trace_tail, &header, sizeof(header));
+    trace_get(trace_tail + sizeof(header), data, header.stored);
+    trace_drop_oldest();
+    trace_dropped--;    // Handed out, not lost
+
+    record->start_us = header.start_us;
+    record->duration_us = header.duration_us;
+    record->gap_us = header.gap_us;
+    record->len = header.len;
+    record->result = header.result;
+    record->op = (i2c_trace_op_t)header.op;
+    record->stored = header.stored;
+    return true;
+}
+
+void i2c_trace_get_stats(i2c_trace_stats_t *stats) {
+    stats->recording = trace_recording;
+    stats->records = trace_records;
+    stats->used = (uint32_t)trace_used;
+    stats->size = sizeof(trace_ring);
+    stats->dropped = trace_dropped;
+}
+
+// Internal helper functions
+
+static void trace_put(const void *src, size_t len) {
+    const uint8_t *bytes = (const uint8_t*)src;
+    for (size_t i = 0; i < len; i++) {
+        trace_ring[trace_head] = bytes[i];
+        trace_head = (trace_head + 1) % sizeof(trace_ring);
+    }
+    trace_used += len;
+}
+
+static void trace_get(size_t offset, void *dst, size_t len) {
+    uint8_t *bytes = (uint8_t*)dst;
+    for (size_t i = 0; i < len; i++) {
+        bytes[i] = trace_ring[(offset + i) % sizeof(trace_ring)];
+    }
+}
+
+static void trace_drop_oldest(void) {
+    i2c_trace_header_t header;
+    trace_get(trace_tail, &header, sizeof(header));
+
+    size_t len = sizeof(header) + header.stored;
+    trace_tail = (trace_tail + len) % sizeof(trace_ring);
+    trace_used -= len;
+    trace_records--;
+    trace_dropped++;
+}
+
+#endif // CASHSTICK_I2C_TRACE_SIZE > 0
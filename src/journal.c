@@ -0,0 +1,416 @@
+#include "cashstick.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "flash_layout.h"
+
+// Custody journal: an append-only event log in JOURNAL_SECTORS flash
+// sectors, used as a ring of one-sector segments.
+//
+// A segment starts with a header (sequence, and the boot number and
+// uptime the first record is relative to) followed by packed records:
+//
+//   byte 0      event << 4 | body length (3..11)
+//   varint      ms since the previous record, or since reset for BOOT
+//   varint      event argument
+//   byte        CRC-8 over the bytes before it
+//
+// so a typical record is 4-6 bytes. Appends only program bytes that are
+// still erased - page writes padded with 0xFF - and never erase. When the
+// active segment is full the next one, the oldest, is erased and started
+// with a higher sequence. A record cut short by power loss fails its CRC;
+// the scan at boot then closes that segment and appends carry on in the
+// next.
+//
+// Readers decode straight from XIP flash. A position is
+// sequence << 12 | byte offset, so a reader can stop and resume later.
+//
+// Appends program flash with interrupts off and are made from thread
+// context only; interrupt handlers leave a flag for the main loop.
+
+#define JOURNAL_MAGIC 0x4C4E524A            // "JRNL"
+#define JOURNAL_RECORDS_OFFSET 32           // After the segment header
+#define JOURNAL_MAX_RECORD 12
+#define JOURNAL_POSITION_BITS 12
+
+_Static_assert(FLASH_SECTOR_SIZE == 1u << JOURNAL_POSITION_BITS, "journal position packs a sector offset");
+_Static_assert(JOURNAL_EVENT_COUNT < 15, "event 15 would read as erased flash");
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t boot;          // Boot number in effect at the segment start
+    uint32_t base_ms;       // Uptime the first record's delta is from
+    uint32_t check;         // ~(magic ^ sequence ^ boot ^ base_ms)
+} journal_header_t;
+
+typedef struct {
+    journal_event_t event;
+    uint32_t delta_ms;
+    uint32_t arg;
+    uint32_t len;
+} journal_record_t;
+
+// Writer state
+static bool journal_ready = false;
+static int active_segment;
+static journal_header_t active_header;
+static uint32_t write_offset;       // FLASH_SECTOR_SIZE once closed
+static uint32_t last_boot;          // Boot and uptime of the last record
+static uint32_t last_ms;
+static uint32_t record_count;
+
+static const uint8_t *journal_segment(int segment);
+static bool journal_header_valid(int segment, journal_header_t *header);
+static int journal_find_segment(uint32_t sequence, journal_header_t *header);
+static int journal_oldest_segment(journal_header_t *header);
+static bool journal_decode(const uint8_t *segment, uint32_t offset, journal_record_t *record);
+static uint32_t journal_scan(int segment, const journal_header_t *header, uint32_t *end_offset,
+                             uint32_t *boot, uint32_t *time_ms);
+static size_t journal_encode(uint8_t *out, journal_event_t event, uint32_t delta_ms, uint32_t arg);
+static bool journal_start_segment(int segment, uint32_t sequence);
+static bool journal_program(int segment, uint32_t offset, const uint8_t *data, size_t len);
+static uint8_t journal_crc8(const uint8_t *data, size_t len);
+
+bool journal_init(void) {
+    journal_header_t header;
+    active_segment = -1;
+    record_count = 0;
+
+    for (int i = 0; i < JOURNAL_SECTORS; i++) {
+        if (!journal_header_valid(i, &header)) {
+            continue;
+        }
+        uint32_t end, boot, time_ms;
+        record_count += journal_scan(i, &header, &end, &boot, &time_ms);
+        if (active_segment < 0 || (int32_t)(header.sequence - active_header.sequence) > 0) {
+            active_segment = i;
+            active_header = header;
+            write_offset = end;
+            last_boot = boot;
+            last_ms = time_ms;
+        }
+    }
+
+    if (active_segment < 0) {
+        printf("JOURNAL: Formatting %d segments\n", JOURNAL_SECTORS);
+        last_boot = 0;
+        last_ms = 0;
+        if (!journal_start_segment(0, 1)) {
+            return false;
+        }
+    }
+
+    journal_ready = true;
+    printf("JOURNAL: %lu records, boot %lu\n", (unsigned long)record_count, (unsigned long)last_boot + 1);
+    return journal_append(JOURNAL_EVENT_BOOT, watchdog_caused_reboot() ? 1 : 0);
+}
+
+bool journal_append(journal_event_t event, uint32_t arg) {
+    if (!journal_ready || event >= JOURNAL_EVENT_COUNT) {
+        return false;
+    }
+
+    uint32_t now = get_system_time_ms();
+    uint32_t delta = event == JOURNAL_EVENT_BOOT ? now : now - last_ms;
+    uint8_t record[JOURNAL_MAX_RECORD];
+    size_t len = journal_encode(record, event, delta, arg);
+
+    if (write_offset + len > FLASH_SECTOR_SIZE) {
+        // Reclaim the oldest segment
+        int next = (active_segment + 1) % JOURNAL_SECTORS;
+        journal_header_t old;
+        if (journal_header_valid(next, &old)) {
+            uint32_t end, boot, time_ms;
+            record_count -= journal_scan(next, &old, &end, &boot, &time_ms);
+        }
+        if (!journal_start_segment(next, active_header.sequence + 1)) {
+            return false;
+        }
+    }
+
+    if (!journal_program(active_segment, write_offset, record, len)) {
+        // Whatever landed would fail its CRC; start afresh in the next segment
+        printf("JOURNAL: Append failed at 0x%03lx\n", (unsigned long)write_offset);
+        write_offset = FLASH_SECTOR_SIZE;
+        return false;
+    }
+
+    write_offset += len;
+    record_count++;
+    if (event == JOURNAL_EVENT_BOOT) {
+        last_boot++;
+    }
+    last_ms = now;
+    return true;
+}
+
+bool journal_cursor_at(journal_cursor_t *cursor, uint32_t position) {
+    journal_header_t header;
+    uint32_t sequence = position >> JOURNAL_POSITION_BITS;
+    uint32_t offset = position & (FLASH_SECTOR_SIZE - 1);
+
+    int segment = position != 0 ? journal_find_segment(sequence, &header) : -1;
+    bool found = segment >= 0;
+    if (!found) {
+        // Start of the journal, or the position has since been reclaimed
+        segment = journal_oldest_segment(&header);
+        offset = 0;
+    }
+    if (segment < 0) {
+        memset(cursor, 0, sizeof(*cursor));
+        return false;
+    }
+
+    cursor->sequence = header.sequence;
+    cursor->offset = JOURNAL_RECORDS_OFFSET;
+    cursor->boot = header.boot;
+    cursor->time_ms = header.base_ms;
+
+    // Replay the segment up to the position for its boot and uptime
+    const uint8_t *data = journal_segment(segment);
+    journal_record_t record;
+    while (cursor->offset < offset && journal_decode(data, cursor->offset, &record)) {
+        cursor->boot += record.event == JOURNAL_EVENT_BOOT ? 1 : 0;
+        cursor->time_ms = record.event == JOURNAL_EVENT_BOOT ? record.delta_ms : cursor->time_ms + record.delta_ms;
+        cursor->offset += record.len;
+    }
+    return found || position == 0;
+}
+
+bool journal_next(journal_cursor_t *cursor, journal_entry_t *entry) {
+    journal_header_t header;
+
+    while (true) {
+        int segment = journal_find_segment(cursor->sequence, &header);
+        if (segment < 0) {
+            return false;
+        }
+
+        journal_record_t record;
+        if (journal_decode(journal_segment(segment), cursor->offset, &record)) {
+            if (record.event == JOURNAL_EVENT_BOOT) {
+                cursor->boot++;
+                cursor->time_ms = record.delta_ms;
+            } else {
+                cursor->time_ms += record.delta_ms;
+            }
+            cursor->offset += record.len;
+
+            entry->boot = cursor->boot;
+            entry->time_ms = cursor->time_ms;
+            entry->event = record.event;
+            entry->arg = record.arg;
+            return true;
+        }
+
+        // End of this segment; the active one may still grow
+        if (!journal_ready || segment == active_segment ||
+            journal_find_segment(cursor->sequence + 1, &header) < 0) {
+            return false;
+        }
+        cursor->sequence = header.sequence;
+        cursor->offset = JOURNAL_RECORDS_OFFSET;
+        cursor->boot = header.boot;
+        cursor->time_ms = header.base_ms;
+    }
+}
+
+uint32_t journal_position(const journal_cursor_t *cursor) {
+    return cursor->sequence << JOURNAL_POSITION_BITS | cursor->offset;
+}
+
+void journal_get_stats(journal_stats_t *stats) {
+    journal_header_t oldest;
+    int segment = journal_ready ? journal_oldest_segment(&oldest) : -1;
+
+    stats->records = record_count;
+    stats->segments = JOURNAL_SECTORS;
+    stats->active_used = journal_ready && write_offset < FLASH_SECTOR_SIZE ? write_offset : FLASH_SECTOR_SIZE;
+    stats->boot = last_boot;
+    stats->reclaimed = segment >= 0 ? oldest.sequence - 1 : 0;
+}
+
+// Internal helper functions
+
+static const uint8_t *journal_segment(int segment) {
+    return (const uint8_t*)(JOURNAL_FLASH_ADDR + (uint32_t)segment * FLASH_SECTOR_SIZE);
+}
+
+static bool journal_header_valid(int segment, journal_header_t *header) {
+    memcpy(header, journal_segment(segment), sizeof(*header));
+    return header->magic == JOURNAL_MAGIC &&
+           header->check == ~(header->magic ^ header->sequence ^ header->boot ^ header->base_ms);
+}
+
+static int journal_find_segment(uint32_t sequence, journal_header_t *header) {
+    for (int i = 0; i < JOURNAL_SECTORS; i++) {
+        if (journal_header_valid(i, header) && header->sequence == sequence) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// The oldest segment still held is the one after the active one, or the
+// first valid one going round from there
+static int journal_oldest_segment(journal_header_t *header) {
+    for (int i = 1; i <= JOURNAL_SECTORS; i++) {
+        int segment = (active_segment + i) % JOURNAL_SECTORS;
+        if (journal_header_valid(segment, header)) {
+            return segment;
+        }
+    }
+    return -1;
+}
+
+static bool journal_get_varint(const uint8_t *p, const uint8_t *end, uint32_t *value, const uint8_t **next) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *value = v;
+            *next = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Erased flash, a torn write or a record past the end all decode as false
+static bool journal_decode(const uint8_t *segment, uint32_t offset, journal_record_t *record) {
+    if (offset + 4 > FLASH_SECTOR_SIZE) {
+        return false;
+    }
+
+    const uint8_t *p = segment + offset;
+    uint32_t body = p[0] & 0x0F;
+    uint32_t event = p[0] >> 4;
+    if (event >= JOURNAL_EVENT_COUNT || body < 3 || offset + 1 + body > FLASH_SECTOR_SIZE ||
+        journal_crc8(p, body) != p[body]) {
+        return false;
+    }
+
+    const uint8_t *end = p + body;
+    const uint8_t *q = p + 1;
+    if (!journal_get_varint(q, end, &record->delta_ms, &q) ||
+        !journal_get_varint(q, end, &record->arg, &q) || q != end) {
+        return false;
+    }
+
+    record->event = (journal_event_t)event;
+    record->len = 1 + body;
+    return true;
+}
+
+// Records in a segment; also where appending would resume (the sector size
+// if a damaged record closed it) and the boot and uptime of the last record
+static uint32_t journal_scan(int segment, const journal_header_t *header, uint32_t *end_offset,
+                             uint32_t *boot, uint32_t *time_ms) {
+    const uint8_t *data = journal_segment(segment);
+    uint32_t offset = JOURNAL_RECORDS_OFFSET;
+    uint32_t count = 0;
+    journal_record_t record;
+
+    *boot = header->boot;
+    *time_ms = header->base_ms;
+    while (journal_decode(data, offset, &record)) {
+        *boot += record.event == JOURNAL_EVENT_BOOT ? 1 : 0;
+        *time_ms = record.event == JOURNAL_EVENT_BOOT ? record.delta_ms : *time_ms + record.delta_ms;
+        offset += record.len;
+        count++;
+    }
+
+    // Anything other than erased flash after the last record is damage
+    *end_offset = offset < FLASH_SECTOR_SIZE && data[offset] != 0xFF ? FLASH_SECTOR_SIZE : offset;
+    return count;
+}
+
+static size_t journal_encode(uint8_t *out, journal_event_t event, uint32_t delta_ms, uint32_t arg) {
+    size_t len = 1;
+    uint32_t fields[2] = { delta_ms, arg };
+
+    for (int i = 0; i < 2; i++) {
+        uint32_t v = fields[i];
+        while (v >= 0x80) {
+            out[len++] = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        out[len++] = (uint8_t)v;
+    }
+
+    out[0] = (uint8_t)((uint32_t)event << 4 | len);
+    out[len] = journal_crc8(out, len);
+    return len + 1;
+}
+
+static bool journal_start_segment(int segment, uint32_t sequence) {
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+
+    journal_header_t header = {
+        .magic = JOURNAL_MAGIC,
+        .sequence = sequence,
+        .boot = last_boot,
+        .base_ms = last_ms,
+        .check = ~(JOURNAL_MAGIC ^ sequence ^ last_boot ^ last_ms)
+    };
+    memcpy(page, &header, sizeof(header));
+
+    uint32_t offset = JOURNAL_SECTOR_OFFSET + (uint32_t)segment * FLASH_SECTOR_SIZE;
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = metrics_start();
+    flash_range_erase(FLASH_TARGET_OFFSET + offset, FLASH_SECTOR_SIZE);
+    metrics_end(METRIC_FLASH_ERASE, start, true);
+    start = metrics_start();
+    flash_range_program(FLASH_TARGET_OFFSET + offset, page, FLASH_PAGE_SIZE);
+    metrics_end(METRIC_FLASH_PROGRAM, start, true);
+    restore_interrupts(ints);
+
+    if (!journal_header_valid(segment, &header) || header.sequence != sequence) {
+        printf("JOURNAL: Failed to start segment %d\n", segment);
+        return false;
+    }
+    active_segment = segment;
+    active_header = header;
+    write_offset = JOURNAL_RECORDS_OFFSET;
+    return true;
+}
+
+// Program bytes into erased flash, one page write per page touched; the
+// 0xFF padding leaves the rest of each page as it was
+static bool journal_program(int segment, uint32_t offset, const uint8_t *data, size_t len) {
+    uint32_t base = JOURNAL_SECTOR_OFFSET + (uint32_t)segment * FLASH_SECTOR_SIZE;
+    uint8_t page[FLASH_PAGE_SIZE];
+    size_t done = 0;
+
+    while (done < len) {
+        uint32_t at = offset + (uint32_t)done;
+        uint32_t page_offset = at & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+        size_t n = FLASH_PAGE_SIZE - (at - page_offset);
+        n = n < len - done ? n : len - done;
+
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page + (at - page_offset), data + done, n);
+
+        uint32_t ints = save_and_disable_interrupts();
+        uint32_t start = metrics_start();
+        flash_range_program(FLASH_TARGET_OFFSET + base + page_offset, page, FLASH_PAGE_SIZE);
+        metrics_end(METRIC_FLASH_PROGRAM, start, true);
+        restore_interrupts(ints);
+        done += n;
+    }
+
+    return memcmp(journal_segment(segment) + offset, data, len) == 0;
+}
+
+static uint8_t journal_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (uint8_t)(crc << 1 ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
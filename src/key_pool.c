@@ -0,0 +1,209 @@
+#include "cashstick.h"
+
+// Spare keypairs are generated in the background while the device idles,
+// so creating a wallet only has to claim a READY slot and derive its
+// address. Slot i lives in SE050 object KEY_POOL_BASE_OBJECT_ID + i; only
+// the public half and the slot status are kept in flash. A claim is not
+// written here: it becomes durable with the device record that names the
+// slot, and key_pool_init() marks that slot CLAIMED again on every boot.
+
+// Back off after a failed keygen rather than hammering the SE050
+#define KEY_POOL_RETRY_MS 60000
+
+static key_pool_t key_pool = {0};
+static int keygen_slot = -1;            // Slot with a keygen in flight
+static uint32_t retry_after_ms = 0;
+static alarm_id_t service_alarm = 0;
+
+static bool key_pool_collect(void);
+static int key_pool_find_slot(key_slot_status_t status);
+static void key_pool_schedule(uint32_t delay_ms);
+static int64_t key_pool_alarm_cb(alarm_id_t id, void *user_data);
+
+void key_pool_init(void) {
+    if (!flash_read_key_pool(&key_pool)) {
+        memset(&key_pool, 0, sizeof(key_pool));
+    }
+
+    // Only the slot named by the device record is claimed; a claim that
+    // never reached a commit is regenerated
+    const bitcoin_keys_t *wallet = device_state_keys();
+    for (int i = 0; i < KEY_POOL_MAX_SLOTS; i++) {
+        bool is_wallet = wallet->is_sealed && wallet->key_object_id == KEY_POOL_BASE_OBJECT_ID + i;
+        if (is_wallet) {
+            key_pool.slots[i].status = KEY_SLOT_CLAIMED;
+        } else if (key_pool.slots[i].status == KEY_SLOT_CLAIMED) {
+            memset(&key_pool.slots[i], 0, sizeof(key_pool.slots[i]));
+        }
+    }
+
+    keygen_slot = -1;
+    retry_after_ms = 0;
+
+    printf("KEYPOOL: %lu of %d keys ready\n", (unsigned long)key_pool_ready_count(), CASHSTICK_KEY_POOL_DEPTH);
+
+    // Start topping up from the main loop
+    power_signal_event(POWER_EVENT_KEY_POOL);
+}
+
+void key_pool_service(void) {
+    // Not finished yet - come back when it is
+    uint32_t remaining = se050_keygen_remaining_ms();
+    if (keygen_slot >= 0 && remaining > 0) {
+        key_pool_schedule(remaining);
+        return;
+    }
+
+    key_pool_collect();
+
+    if (key_pool_ready_count() >= CASHSTICK_KEY_POOL_DEPTH) {
+        return;
+    }
+
+    int32_t backoff = (int32_t)(retry_after_ms - get_system_time_ms());
+    if (backoff > 0) {
+        key_pool_schedule((uint32_t)backoff);
+        return;
+    }
+
+    int slot = key_pool_find_slot(KEY_SLOT_EMPTY);
+    if (slot < 0) {
+        return;
+    }
+
+    if (!se050_keygen_begin(KEY_POOL_BASE_OBJECT_ID + slot)) {
+        printf("KEYPOOL: Failed to start keygen for slot %d\n", slot);
+        retry_after_ms = get_system_time_ms() + KEY_POOL_RETRY_MS;
+        key_pool_schedule(KEY_POOL_RETRY_MS);
+        return;
+    }
+
+    keygen_slot = slot;
+    key_pool_schedule(SE050_KEYGEN_TIME_MS);
+}
+
+bool key_pool_claim(bitcoin_keys_t *keys) {
+    if (!keys) {
+        return false;
+    }
+
+    // Finish any keygen in flight so its slot can be used and the SE050 is free
+    key_pool_collect();
+
+    memset(keys, 0, sizeof(*keys));
+
+    int slot = key_pool_find_slot(KEY_SLOT_READY);
+    if (slot >= 0) {
+        keys->key_object_id = KEY_POOL_BASE_OBJECT_ID + slot;
+        memcpy(keys->public_key, key_pool.slots[slot].public_key, 33);
+
+        // Address derivation is the only work left (software crypto burst)
+        clock_boost_begin();
+        bool address_ok = address_table_build(keys->public_key, &keys->addresses);
+        clock_boost_end();
+        if (!address_ok) {
+            return false;
+        }
+        keys->is_sealed = true;
+
+        printf("KEYPOOL: Claimed pre-generated key in slot %d\n", slot);
+    } else {
+        // Pool drained - fall back to generating in the foreground
+        slot = key_pool_find_slot(KEY_SLOT_EMPTY);
+        if (slot < 0) {
+            return false;
+        }
+
+        keys->key_object_id = KEY_POOL_BASE_OBJECT_ID + slot;
+        if (!se050_generate_bitcoin_keys(keys)) {
+            return false;
+        }
+
+        printf("KEYPOOL: Pool empty, generated key in slot %d\n", slot);
+    }
+
+    // Made durable by the caller's device record commit (see key_pool_init)
+    key_pool.slots[slot].status = KEY_SLOT_CLAIMED;
+
+    // Refill in the background
+    power_signal_event(POWER_EVENT_KEY_POOL);
+    return true;
+}
+
+void key_pool_release(uint16_t object_id) {
+    if (object_id < KEY_POOL_BASE_OBJECT_ID || object_id >= KEY_POOL_BASE_OBJECT_ID + KEY_POOL_MAX_SLOTS) {
+        return;
+    }
+
+    int slot = object_id - KEY_POOL_BASE_OBJECT_ID;
+    if (key_pool.slots[slot].status != KEY_SLOT_CLAIMED) {
+        return;
+    }
+
+    // The private key is destroyed when the slot is regenerated
+    memset(&key_pool.slots[slot], 0, sizeof(key_pool.slots[slot]));
+    flash_write_key_pool(&key_pool);
+}
+
+uint32_t key_pool_ready_count(void) {
+    uint32_t ready = 0;
+    for (int i = 0; i < KEY_POOL_MAX_SLOTS; i++) {
+        if (key_pool.slots[i].status == KEY_SLOT_READY) {
+            ready++;
+        }
+    }
+    return ready;
+}
+
+uint32_t key_pool_depth(void) {
+    return CASHSTICK_KEY_POOL_DEPTH;
+}
+
+// Internal helper functions
+
+// Store the result of the keygen in flight, blocking until it is done
+static bool key_pool_collect(void) {
+    if (keygen_slot < 0) {
+        return false;
+    }
+
+    int slot = keygen_slot;
+    keygen_slot = -1;
+
+    uint8_t public_key[33];
+    if (!se050_keygen_collect(NULL, public_key)) {
+        printf("KEYPOOL: Keygen failed for slot %d\n", slot);
+        retry_after_ms = get_system_time_ms() + KEY_POOL_RETRY_MS;
+        return false;
+    }
+
+    key_pool.slots[slot].status = KEY_SLOT_READY;
+    memcpy(key_pool.slots[slot].public_key, public_key, 33);
+    flash_write_key_pool(&key_pool);
+
+    printf("KEYPOOL: Slot %d ready (%lu of %d)\n", slot,
+           (unsigned long)key_pool_ready_count(), CASHSTICK_KEY_POOL_DEPTH);
+    return true;
+}
+
+static int key_pool_find_slot(key_slot_status_t status) {
+    for (int i = 0; i < KEY_POOL_MAX_SLOTS; i++) {
+        if (key_pool.slots[i].status == status) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void key_pool_schedule(uint32_t delay_ms) {
+    if (service_alarm > 0) {
+        cancel_alarm(service_alarm);
+    }
+    service_alarm = add_alarm_in_ms(delay_ms, key_pool_alarm_cb, NULL, true);
+}
+
+static int64_t key_pool_alarm_cb(alarm_id_t id, void *user_data) {
+    service_alarm = 0;
+    power_signal_event(POWER_EVENT_KEY_POOL);
+    return 0;  // One-shot
+}
@@ -1,27 +1,16 @@
 #include "cashstick.h"
 
-// RGB LED PWM channels (using GPIO16 with WS2812B or similar RGB LED)
-static uint slice_num;
-
 void led_init(void) {
-    // Initialize GPIO for LED
-    gpio_init(LED_PIN);
-    gpio_set_dir(LED_PIN, GPIO_OUT);
-    gpio_put(LED_PIN, 0);
+    // LED type and pins come from the board profile
+    board_led_init();
     
     // Set initial state to busy (yellow) during boot
     led_set_state(LED_STATE_BUSY);
 }
 
 void led_set_rgb(uint8_t r, uint8_t g, uint8_t b) {
-    // For simplicity using basic GPIO control
-    // In production, implement WS2812B protocol or use RGB LED with PWM
-    
-    if (r > 0 || g > 0 || b > 0) {
-        gpio_put(LED_PIN, 1);  // Turn on LED
-    } else {
-        gpio_put(LED_PIN, 0);  // Turn off LED
-    }
+    // A single-colour LED lights for any colour, an RGB one per channel
+    board_led_set(r, g, b);
 }
 
 void led_set_state(led_state_t state) {
@@ -1,8 +1,6 @@
 #include "cashstick.h"
 
-// Global state variables
-static device_state_t current_device_state = DEVICE_STATE_NEW;
-static bitcoin_keys_t device_keys = {0};
+// Global state variables (device state and keys live in device_state.c)
 static bool firmware_mode_active = false;
 
 // Main initialization function
@@ -19,24 +17,45 @@ void system_init(void) {
     led_set_state(LED_STATE_BUSY);
     
     // Initialize I2C for SE050
-    i2c_init(i2c1, I2C_BAUDRATE);
-    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA_PIN);
-    gpio_pull_up(I2C_SCL_PIN);
+    se050_i2c_init();
+    
+    // Clock governor re-derives the I2C divider on every change, so it
+    // starts once the bus is configured
+    clock_governor_init();
+    
+    // Measure the firmware image and record sectors before anything
+    // (including the tamper seal) depends on them
+    uint32_t stage = metrics_start();
+    bool measured = measured_boot_run();
+    metrics_end(METRIC_BOOT_MEASURE, stage, measured);
+    
+    // Load the device record (keys + state) from flash
+    device_state_init();
+    
+    // Pick up a verified update left staged for UPDATE install
+    update_init();
+    
+    // Custody journal; records this boot
+    journal_init();
     
     // Initialize SE050 secure element
+    stage = metrics_start();
     if (!se050_init()) {
         // SE050 initialization failed - indicate error
+        metrics_end(METRIC_BOOT_SE050, stage, false);
         led_set_state(LED_STATE_UNSEALED);
         return;
     }
     
-    // Read device state from flash
-    current_device_state = flash_read_device_state();
+    // Seed the on-device DRBG from the SE050 TRNG
+    entropy_init();
+    metrics_end(METRIC_BOOT_SE050, stage, true);
     
     // Initialize tamper detection
-    if (!tamper_init()) {
+    stage = metrics_start();
+    bool tamper_ready = tamper_init();
+    metrics_end(METRIC_BOOT_TAMPER, stage, tamper_ready);
+    if (!tamper_ready) {
         led_set_state(LED_STATE_UNSEALED);
         return;
     }
@@ -44,13 +63,12 @@ void system_init(void) {
     // Check tamper status
     tamper_status_t tamper_status = tamper_check_integrity();
     if (!tamper_status.is_intact) {
-        current_device_state = DEVICE_STATE_COMPROMISED;
         led_set_state(LED_STATE_UNSEALED);
         return;
     }
     
     // Set LED based on device state
-    switch (current_device_state) {
+    switch (device_state_get()) {
         case DEVICE_STATE_NEW:
             led_set_state(LED_STATE_NEW);        // Blue
             break;
@@ -68,24 +86,41 @@ void system_init(void) {
 
 // Main firmware loop
 int main() {
+    // Paint the stacks for high-water tracking before anything runs deep
+    memory_init();
+    
     // System initialization
     system_init();
+    metrics_record(METRIC_BOOT_TOTAL, time_us_32(), true);  // Since reset
     
     // Check if device should enter firmware update mode
     // This happens on first boot or when BOOT button is held during power-on
-    if (current_device_state == DEVICE_STATE_NEW || button_is_pressed()) {
+    if (device_state_get() == DEVICE_STATE_NEW || button_is_pressed()) {
         // Enter USB mass storage mode for drag-and-drop firmware installation
         usb_mass_storage_mode();
         firmware_mode_active = true;
     }
     
     printf("CashStick Firmware v1.0.0 - Starting...\n");
-    printf("Device State: %d\n", current_device_state);
+    printf("Device State: %d\n", device_state_get());
+    
+#if CASHSTICK_BENCHMARKS
+    benchmark_run_all();
+#endif
+    
+    // Power management starts last so the watchdog is only armed once
+    // initialization (including SE050 bring-up) is complete
+    power_init();
+    
+    // Background keygen is driven by POWER_EVENT_KEY_POOL
+    key_pool_init();
     
-    // Main event loop
+    // Main event loop - sleeps until a button, USB or alarm interrupt
     while (true) {
+        uint32_t events = power_wait_for_event();
+        
         // Handle button presses
-        if (button_is_pressed()) {
+        if ((events & POWER_EVENT_BUTTON) && button_is_pressed()) {
             led_set_state(LED_STATE_BUSY);
             
             if (firmware_mode_active) {
@@ -93,44 +128,41 @@ int main() {
                 button_handle_boot_mode();
             } else {
                 // TEST mode - run tamper integrity check
+                journal_append(JOURNAL_EVENT_TEST_PRESS, 0);
                 button_handle_test_mode();
-                
-                tamper_status_t tamper_status = tamper_check_integrity();
-                if (tamper_status.is_intact) {
-                    // Flash green 3 times for "integrity OK"
-                    for (int i = 0; i < 3; i++) {
-                        led_blink(LED_STATE_SEALED, 200);
-                        delay_ms(200);
-                    }
-                    led_set_state(LED_STATE_SEALED);
-                } else {
-                    // Flash red 5 times for "tamper detected"
-                    for (int i = 0; i < 5; i++) {
-                        led_blink(LED_STATE_UNSEALED, 200);
-                        delay_ms(200);
-                    }
-                    led_set_state(LED_STATE_UNSEALED);
-                    current_device_state = DEVICE_STATE_COMPROMISED;
-                    flash_write_device_state(current_device_state);
-                }
             }
             
             // Wait for button release
             while (button_is_pressed()) {
+                watchdog_update();
                 delay_ms(10);
             }
         }
         
+        // Top up the pre-generated key pool
+        if (events & POWER_EVENT_KEY_POOL) {
+            key_pool_service();
+        }
+        
+        // Check and install a signed UF2 dropped on the drive
+        if (events & POWER_EVENT_USB) {
+            update_service();
+        }
+        
         // Handle USB communication
-        if (usb_is_connected()) {
+        if ((events & POWER_EVENT_USB) && usb_is_connected()) {
             usb_handle_commands();
         }
         
-        // Watchdog feed
-        watchdog_update();
+        // Periodic DRBG reseed and core 1 seed refill; check and repair
+        // the device record copies
+        if (events & POWER_EVENT_ALARM) {
+            entropy_service();
+            flash_scrub_service();
+        }
         
-        // Small delay to prevent busy waiting
-        delay_ms(10);
+        // Watchdog feed - every wakeup, including the service alarm
+        watchdog_update();
     }
     
     return 0;
@@ -141,8 +173,7 @@ void system_shutdown(void) {
     // Set LED to indicate shutdown
     led_set_state(LED_STATE_BUSY);
     
-    // Save any pending state to flash
-    flash_write_device_state(current_device_state);
+    // Nothing to save: the device record is committed as it changes
     
     // Turn off LED
     led_set_rgb(0, 0, 0);
@@ -0,0 +1,138 @@
+#include "cashstick.h"
+#include "flash_layout.h"
+#include "tree_hash.h"
+
+// Measured boot. The firmware image and the record sectors are hashed as
+// a Merkle tree over 4 KB chunks. Hashing every chunk with SHA-256 on each
+// power-on is slow on the M0+, so the leaf hashes are cached in flash with
+// the DMA-computed CRC of each chunk; at boot every chunk is CRC'd (DMA,
+// memory speed) and only chunks whose CRC moved are re-hashed.
+//
+// The chunks that did move are hashed on both cores (bulk_digest.c).
+//
+// The CRC only decides what to re-hash - it is not a security boundary.
+// Anything able to rewrite flash can rewrite the cache too; the tamper
+// seal is what binds the measurement to the device.
+//
+// Leaves are SHA-256(0x00 || chunk) and nodes SHA-256(0x01 || left ||
+// right), an odd node being carried up unchanged (tree_hash.h). The
+// reported root is node(image_root, data_root).
+
+_Static_assert(MEASURE_MAX_IMAGE_CHUNKS * MEASURE_CHUNK_SIZE == FLASH_TARGET_OFFSET,
+               "image chunks must cover the firmware region");
+_Static_assert(MEASURE_CHUNK_SIZE == FLASH_SECTOR_SIZE, "chunks are flash sectors");
+
+extern char __flash_binary_end;
+
+// Record sectors covered by the data subtree. The measurement cache itself
+// is deliberately not measured.
+static const uint32_t measured_data_sectors[MEASURE_DATA_CHUNKS] = {
+    KEYS_SECTOR_OFFSET,
+    STATE_SECTOR_OFFSET,
+    SEAL_SECTOR_OFFSET,
+    KEY_POOL_SECTOR_OFFSET,
+};
+
+static measurement_t measurement = {0};
+
+static uint32_t measure_chunk_offset(uint32_t leaf, uint32_t image_chunks);
+
+bool measured_boot_run(void) {
+    uint64_t start = time_us_64();
+
+    uint32_t image_len = (uint32_t)((uintptr_t)&__flash_binary_end - XIP_BASE);
+    uint32_t image_chunks = (image_len + MEASURE_CHUNK_SIZE - 1) / MEASURE_CHUNK_SIZE;
+    if (image_chunks > MEASURE_MAX_IMAGE_CHUNKS) {
+        printf("MEASURE: Image overlaps the data region\n");
+        return false;
+    }
+    uint32_t leaf_count = image_chunks + MEASURE_DATA_CHUNKS;
+
+    // The cache and the Merkle work area are only needed until the roots
+    // are out, so they live in the scratch arena
+    size_t scratch = scratch_mark();
+    measure_cache_t *cache = scratch_alloc(sizeof(*cache));
+    uint8_t (*work)[SHA256_DIGEST_SIZE] = scratch_alloc(MEASURE_MAX_LEAVES * SHA256_DIGEST_SIZE);
+    uint32_t *rehash_offsets = scratch_alloc(MEASURE_MAX_LEAVES * sizeof(uint32_t));
+    uint8_t *rehash_leaves = scratch_alloc(MEASURE_MAX_LEAVES);
+    if (!cache || !work || !rehash_offsets || !rehash_leaves) {
+        scratch_release(scratch);
+        return false;
+    }
+    memset(cache, 0, sizeof(*cache));
+
+    // Cached leaves are reusable as long as the tree has the same shape
+    bool cache_valid = flash_read_measure_cache(cache) &&
+                       cache->leaf_count == leaf_count;
+    if (!cache_valid) {
+        uint32_t generation = cache->generation;
+        memset(cache, 0, sizeof(*cache));
+        cache->generation = generation;
+    }
+
+    uint32_t rehashed = 0;
+
+    clock_boost_begin();
+    for (uint32_t leaf = 0; leaf < leaf_count; leaf++) {
+        uint32_t offset = measure_chunk_offset(leaf, image_chunks);
+        uint32_t crc = flash_crc32(offset, MEASURE_CHUNK_SIZE);
+
+        if (cache_valid && crc == cache->leaf_crc[leaf]) {
+            continue;
+        }
+
+        cache->leaf_crc[leaf] = crc;
+        rehash_offsets[rehashed] = offset;
+        rehash_leaves[rehashed] = (uint8_t)leaf;
+        rehashed++;
+    }
+
+    // Fresh leaf hashes land in work, then go to their cache slots
+    bool hashed = rehashed == 0 || bulk_digest_leaves(rehash_offsets, rehashed, work, true, NULL);
+    clock_boost_end();
+    if (!hashed) {
+        scratch_release(scratch);
+        return false;
+    }
+    for (uint32_t i = 0; i < rehashed; i++) {
+        memcpy(cache->leaf_hash[rehash_leaves[i]], work[i], SHA256_DIGEST_SIZE);
+    }
+
+    if (rehashed > 0 || cache->image_len != image_len) {
+        cache->generation++;
+        cache->image_len = image_len;
+        cache->leaf_count = leaf_count;
+        flash_write_measure_cache(cache);
+    }
+
+    tree_hash_root((const uint8_t (*)[SHA256_DIGEST_SIZE])cache->leaf_hash,
+                   image_chunks, work, measurement.image_root);
+    tree_hash_root((const uint8_t (*)[SHA256_DIGEST_SIZE])cache->leaf_hash[image_chunks],
+                   MEASURE_DATA_CHUNKS, work, measurement.data_root);
+    tree_hash_node(measurement.image_root, measurement.data_root, measurement.root);
+
+    measurement.generation = cache->generation;
+    measurement.leaf_count = leaf_count;
+    measurement.rehashed = rehashed;
+    measurement.boot_us = (uint32_t)(time_us_64() - start);
+    scratch_release(scratch);
+
+    printf("MEASURE: %lu chunks, %lu re-hashed, generation %lu, %lu us\n",
+           (unsigned long)leaf_count, (unsigned long)rehashed,
+           (unsigned long)measurement.generation, (unsigned long)measurement.boot_us);
+    return true;
+}
+
+const measurement_t *measured_boot_get(void) {
+    return &measurement;
+}
+
+// Internal helper functions
+
+// Flash offset of a leaf: image chunks first, then the record sectors
+static uint32_t measure_chunk_offset(uint32_t leaf, uint32_t image_chunks) {
+    if (leaf < image_chunks) {
+        return leaf * MEASURE_CHUNK_SIZE;
+    }
+    return FLASH_TARGET_OFFSET + measured_data_sectors[leaf - image_chunks];
+}
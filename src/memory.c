@@ -0,0 +1,101 @@
+#include "cashstick.h"
+
+// Memory budget.
+//
+// Transient operation buffers - the measured-boot working set, long USB
+// replies, legacy record reads - come from one fixed scratch arena rather
+// than each owning a static buffer or a slab of stack. They are never live
+// at the same time, so they share the space. Allocation bumps a pointer;
+// scratch_mark()/scratch_release() hand it back in LIFO order. The arena
+// belongs to core 0's thread context and is never used from an interrupt.
+//
+// Both core stacks are painted with a fill pattern at boot, so the deepest
+// point each has reached can be read back at any time.
+
+#define MEMORY_NUM_CORES 2
+#define SCRATCH_ALIGN 8
+#define STACK_PAINT 0x5AC3A55Cu
+#define STACK_PAINT_MARGIN_WORDS 16     // Left alone below the painting frame
+
+// Stack regions from the SDK linker script: core 0 runs on
+// [__StackBottom, __StackTop), core 1 on [__StackOneBottom, __StackOneTop)
+extern uint32_t __StackBottom, __StackTop, __StackOneBottom, __StackOneTop;
+
+static uint8_t scratch_arena[CASHSTICK_SCRATCH_SIZE] __attribute__((aligned(SCRATCH_ALIGN)));
+static size_t scratch_used = 0;
+static size_t scratch_peak = 0;
+static uint32_t scratch_failures = 0;
+
+static void memory_paint_stack(uint32_t *bottom, uint32_t *top);
+
+// Called first thing in main(), before anything has had a chance to
+// run deep on the stack
+void memory_init(void) {
+    memory_paint_stack(&__StackBottom, &__StackTop);
+    memory_paint_stack(&__StackOneBottom, &__StackOneTop);
+}
+
+void *scratch_alloc(size_t size) {
+    size_t aligned = (size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+
+    if (get_core_num() != 0 || aligned > sizeof(scratch_arena) - scratch_used) {
+        scratch_failures++;
+        printf("SCRATCH: %u bytes requested, %u free\n",
+               (unsigned)size, (unsigned)(sizeof(scratch_arena) - scratch_used));
+        return NULL;
+    }
+
+    void *block = &scratch_arena[scratch_used];
+    scratch_used += aligned;
+    if (scratch_used > scratch_peak) {
+        scratch_peak = scratch_used;
+    }
+    return block;
+}
+
+size_t scratch_mark(void) {
+    return scratch_used;
+}
+
+void scratch_release(size_t mark) {
+    if (mark <= scratch_used) {
+        scratch_used = mark;
+    }
+}
+
+void memory_get_stats(memory_stats_t *stats) {
+    const uint32_t *bottoms[MEMORY_NUM_CORES] = { &__StackBottom, &__StackOneBottom };
+    const uint32_t *tops[MEMORY_NUM_CORES] = { &__StackTop, &__StackOneTop };
+
+    for (int core = 0; core < MEMORY_NUM_CORES; core++) {
+        // Stacks grow down: the first overwritten word from the bottom
+        // marks the deepest point reached
+        const uint32_t *word = bottoms[core];
+        while (word < tops[core] && *word == STACK_PAINT) {
+            word++;
+        }
+        stats->stack_size[core] = (uint32_t)((uintptr_t)tops[core] - (uintptr_t)bottoms[core]);
+        stats->stack_used[core] = (uint32_t)((uintptr_t)tops[core] - (uintptr_t)word);
+    }
+
+    stats->scratch_size = sizeof(scratch_arena);
+    stats->scratch_used = (uint32_t)scratch_used;
+    stats->scratch_peak = (uint32_t)scratch_peak;
+    stats->scratch_failures = scratch_failures;
+}
+
+// Internal helper functions
+
+// Paints [bottom, top), stopping short of the live part of the stack when
+// the range is the one we are running on
+static void memory_paint_stack(uint32_t *bottom, uint32_t *top) {
+    uint32_t *sp;
+    __asm volatile ("mov %0, sp" : "=r" (sp));
+
+    if (sp > bottom && sp <= top) {
+        top = sp - STACK_PAINT_MARGIN_WORDS;
+    }
+    for (uint32_t *word = bottom; word < top; word++) {
+        *word = STACK_PAINT;
+    }
+}
@@ -0,0 +1,90 @@
+#include "cashstick.h"
+#include "hardware/sync.h"
+
+// Per-operation counters and log-bucketed latency histograms.
+//
+// Each core records into its own shard, so the cores never write the same
+// word and nothing is shared to lock. The M0+ has no atomic read-modify-
+// write; a record is made indivisible on its own core (against interrupt
+// handlers) by masking interrupts for the dozen instructions it takes.
+// A snapshot sums both shards: it may be an event behind the other core,
+// but each 32-bit counter is read whole.
+
+#define METRICS_NUM_CORES 2
+
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t buckets[METRIC_BUCKETS];
+} metric_shard_t;
+
+static metric_shard_t shards[METRICS_NUM_CORES][METRIC_COUNT];
+
+static const char *const metric_names[METRIC_COUNT] = {
+    "se050", "i2c", "flash_erase", "flash_program", "tamper",
+    "usb", "boot_measure", "boot_se050", "boot_tamper", "boot",
+    "flash_scrub", "flash_repair", "attest", "scp03_handshake", "scp03",
+};
+
+static uint32_t metric_bucket(uint32_t elapsed_us) {
+    if (elapsed_us == 0) {
+        return 0;
+    }
+    uint32_t bucket = 32 - (uint32_t)__builtin_clz(elapsed_us);
+    return bucket < METRIC_BUCKETS ? bucket : METRIC_BUCKETS - 1;
+}
+
+void RAM_FUNC(metrics_record)(metric_id_t id, uint32_t elapsed_us, bool ok) {
+    if (id >= METRIC_COUNT) {
+        return;
+    }
+
+    uint32_t bucket = metric_bucket(elapsed_us);
+    metric_shard_t *m = &shards[get_core_num()][id];
+
+    uint32_t ints = save_and_disable_interrupts();
+    m->count++;
+    if (!ok) {
+        m->errors++;
+    }
+    m->total_us += elapsed_us;
+    if (elapsed_us > m->max_us) {
+        m->max_us = elapsed_us;
+    }
+    m->buckets[bucket]++;
+    restore_interrupts(ints);
+}
+
+void metrics_snapshot(metric_id_t id, metric_snapshot_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (id >= METRIC_COUNT) {
+        return;
+    }
+
+    for (int core = 0; core < METRICS_NUM_CORES; core++) {
+        const metric_shard_t *m = &shards[core][id];
+        out->count += m->count;
+        out->errors += m->errors;
+        out->total_us += m->total_us;
+        if (m->max_us > out->max_us) {
+            out->max_us = m->max_us;
+        }
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            out->buckets[b] += m->buckets[b];
+        }
+    }
+}
+
+// A record racing on the other core may survive the reset; harmless for
+// statistics
+void metrics_reset(void) {
+    uint32_t ints = save_and_disable_interrupts();
+    memset(shards, 0, sizeof(shards));
+    restore_interrupts(ints);
+}
+
+const char *metrics_name(metric_id_t id) {
+    return id < METRIC_COUNT ? metric_names[id] : "unknown";
+}
@@ -0,0 +1,98 @@
+#include "msc_overlay.h"
+#include <string.h>
+
+static int32_t msc_overlay_slot(const msc_overlay_t *overlay, uint32_t lba);
+static uint32_t msc_overlay_victim(const msc_overlay_t *overlay);
+
+void msc_overlay_init(msc_overlay_t *overlay, uint8_t (*sectors)[MSC_OVERLAY_SECTOR_SIZE],
+                      uint32_t *lba, uint32_t *last_use, uint32_t capacity, uint32_t pin_below) {
+    memset(overlay, 0, sizeof(*overlay));
+    overlay->sectors = sectors;
+    overlay->lba = lba;
+    overlay->last_use = last_use;
+    overlay->capacity = capacity;
+    overlay->pin_below = pin_below;
+}
+
+bool msc_overlay_read(msc_overlay_t *overlay, uint32_t lba, uint8_t out[MSC_OVERLAY_SECTOR_SIZE]) {
+    uint8_t *sector = msc_overlay_find(overlay, lba);
+    if (!sector) {
+        return false;
+    }
+    memcpy(out, sector, MSC_OVERLAY_SECTOR_SIZE);
+    overlay->stats.read_hits++;
+    return true;
+}
+
+uint8_t *msc_overlay_find(msc_overlay_t *overlay, uint32_t lba) {
+    int32_t slot = msc_overlay_slot(overlay, lba);
+    if (slot < 0) {
+        return NULL;
+    }
+    overlay->last_use[slot] = ++overlay->clock;
+    return overlay->sectors[slot];
+}
+
+void msc_overlay_write(msc_overlay_t *overlay, uint32_t lba, const uint8_t data[MSC_OVERLAY_SECTOR_SIZE]) {
+    if (overlay->capacity == 0) {
+        return;
+    }
+    overlay->stats.writes++;
+
+    int32_t slot = msc_overlay_slot(overlay, lba);
+    if (slot < 0) {
+        if (overlay->used < overlay->capacity) {
+            slot = (int32_t)overlay->used++;
+        } else {
+            slot = (int32_t)msc_overlay_victim(overlay);
+            overlay->stats.evictions++;
+            if (overlay->lba[slot] < overlay->pin_below) {
+                overlay->stats.pinned_evictions++;
+            }
+        }
+        overlay->lba[slot] = lba;
+    }
+
+    // A partial write patches the sector msc_overlay_find() returned in place
+    if (overlay->sectors[slot] != data) {
+        memcpy(overlay->sectors[slot], data, MSC_OVERLAY_SECTOR_SIZE);
+    }
+    overlay->last_use[slot] = ++overlay->clock;
+}
+
+void msc_overlay_discard(msc_overlay_t *overlay) {
+    if (overlay->used > 0) {
+        overlay->stats.discards++;
+    }
+    overlay->used = 0;
+    overlay->clock = 0;
+}
+
+// Internal helper functions
+
+// A few dozen slots at most, so a linear scan beats keeping an index
+static int32_t msc_overlay_slot(const msc_overlay_t *overlay, uint32_t lba) {
+    for (uint32_t i = 0; i < overlay->used; i++) {
+        if (overlay->lba[i] == lba) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+// Least recently used data sector, or the least recently used of all if
+// only metadata is held
+static uint32_t msc_overlay_victim(const msc_overlay_t *overlay) {
+    uint32_t victim = 0;
+    bool victim_pinned = true;
+
+    for (uint32_t i = 0; i < overlay->used; i++) {
+        bool pinned = overlay->lba[i] < overlay->pin_below;
+        if (i == 0 || (victim_pinned && !pinned) ||
+            (pinned == victim_pinned && overlay->last_use[i] < overlay->last_use[victim])) {
+            victim = i;
+            victim_pinned = pinned;
+        }
+    }
+    return victim;
+}
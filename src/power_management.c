@@ -0,0 +1,166 @@
+#include "cashstick.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/xosc.h"
+
+// Wake events raised from interrupt context, consumed by the main loop
+static volatile uint32_t pending_events = 0;
+
+// Wakeup accounting - every return from WFI counts, whether or not it
+// carried an event, so the figure reflects the real idle cost
+static power_stats_t power_stats = {0};
+static uint32_t stats_start_ms = 0;
+
+static repeating_timer_t watchdog_service_timer;
+static volatile bool usb_suspended = false;
+
+static void power_gpio_callback(uint gpio, uint32_t events);
+static bool power_watchdog_service_cb(repeating_timer_t *timer);
+#if CASHSTICK_DORMANT_ON_USB_SUSPEND
+static void power_enter_dormant(void);
+#endif
+
+void power_init(void) {
+    pending_events = 0;
+    memset(&power_stats, 0, sizeof(power_stats));
+    stats_start_ms = get_system_time_ms();
+
+    // Button press wakes the core (active low, so falling edge)
+    gpio_set_irq_enabled_with_callback(board_button_gpio(), GPIO_IRQ_EDGE_FALL, true, &power_gpio_callback);
+
+    // USB wake events are raised by the TinyUSB callbacks in usb_handler.c
+
+    // The watchdog is fed by the main loop, not by the alarm itself, so a
+    // wedged loop still resets the device. The alarm only guarantees the
+    // loop wakes often enough to feed it.
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+    add_repeating_timer_ms(-WATCHDOG_SERVICE_INTERVAL_MS, power_watchdog_service_cb, NULL, &watchdog_service_timer);
+
+    printf("POWER: Event-driven idle enabled (watchdog %d ms, service every %d ms)\n",
+           WATCHDOG_TIMEOUT_MS, WATCHDOG_SERVICE_INTERVAL_MS);
+}
+
+void power_signal_event(uint32_t events) {
+    uint32_t ints = save_and_disable_interrupts();
+    pending_events |= events;
+    restore_interrupts(ints);
+}
+
+uint32_t power_wait_for_event(void) {
+    uint32_t ints = save_and_disable_interrupts();
+
+    // Drop to the idle operating point for as long as we sleep
+    if (pending_events == 0) {
+        restore_interrupts(ints);
+        clock_governor_enter_idle();
+        ints = save_and_disable_interrupts();
+    }
+
+    while (pending_events == 0) {
+#if CASHSTICK_DORMANT_ON_USB_SUSPEND
+        if (usb_suspended) {
+            restore_interrupts(ints);
+            power_enter_dormant();
+            power_stats.wakeups++;
+            power_stats.dormant_entries++;
+            ints = save_and_disable_interrupts();
+            continue;
+        }
+#endif
+        // WFI still wakes on an interrupt masked by PRIMASK, so an event
+        // raised between the check above and the sleep is never lost
+        __wfi();
+        restore_interrupts(ints);   // Let the pending handler run
+        power_stats.wakeups++;
+        ints = save_and_disable_interrupts();
+    }
+
+    uint32_t events = pending_events;
+    pending_events = 0;
+    restore_interrupts(ints);
+
+    clock_governor_exit_idle();
+
+    if (events & POWER_EVENT_BUTTON) {
+        power_stats.button_events++;
+    }
+    if (events & POWER_EVENT_USB) {
+        power_stats.usb_events++;
+    }
+    if (events & POWER_EVENT_ALARM) {
+        power_stats.alarm_events++;
+    }
+
+    return events;
+}
+
+void power_set_usb_suspended(bool suspended) {
+    usb_suspended = suspended;
+    power_signal_event(POWER_EVENT_USB);
+}
+
+void power_get_stats(power_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+
+    *stats = power_stats;
+
+    uint32_t elapsed_ms = get_system_time_ms() - stats_start_ms;
+    if (elapsed_ms > 0) {
+        stats->wakeups_per_hour = (uint32_t)(((uint64_t)power_stats.wakeups * 3600000u) / elapsed_ms);
+    }
+}
+
+// Interrupt handlers
+
+static void power_gpio_callback(uint gpio, uint32_t events) {
+    if (gpio == board_button_gpio()) {
+        pending_events |= POWER_EVENT_BUTTON;
+    }
+}
+
+static bool power_watchdog_service_cb(repeating_timer_t *timer) {
+    pending_events |= POWER_EVENT_ALARM;
+    return true;  // Keep repeating
+}
+
+#if CASHSTICK_DORMANT_ON_USB_SUSPEND
+// Stop the PLLs and the crystal until the button pulls its pin low.
+// The watchdog tick comes from clk_ref, so it halts with the crystal and
+// cannot fire while dormant. Note the USB controller is unclocked here,
+// so a host resume alone will not wake the device.
+static void power_enter_dormant(void) {
+    // Leave the governor's idle point first so the core voltage is back at
+    // its default before clocks_init() brings the PLLs up at full speed
+    clock_governor_exit_idle();
+
+    // Run everything from the crystal so the PLLs can be stopped
+    clock_configure(clk_ref, CLOCKS_CLK_REF_CTRL_SRC_VALUE_XOSC_CLKSRC, 0, 12 * MHZ, 12 * MHZ);
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF, 0, 12 * MHZ, 12 * MHZ);
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_XOSC_CLKSRC, 12 * MHZ, 12 * MHZ);
+    clock_stop(clk_usb);
+    clock_stop(clk_adc);
+    clock_stop(clk_rtc);
+    pll_deinit(pll_sys);
+    pll_deinit(pll_usb);
+
+    gpio_set_dormant_irq_enabled(board_button_gpio(), GPIO_IRQ_EDGE_FALL, true);
+
+    // Returns once the wake edge restarts the crystal
+    xosc_dormant();
+
+    gpio_acknowledge_irq(board_button_gpio(), GPIO_IRQ_EDGE_FALL);
+    gpio_set_dormant_irq_enabled(board_button_gpio(), GPIO_IRQ_EDGE_FALL, false);
+
+    // Rebuild the default clock tree (PLLs, clk_usb, watchdog tick)
+    clocks_init();
+    board_se050_bus_restore_baudrate();
+    
+    // The SE050 stayed powered, so its secure session carries on as is
+
+    usb_suspended = false;
+    power_signal_event(POWER_EVENT_BUTTON);
+}
+#endif
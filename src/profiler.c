@@ -0,0 +1,98 @@
+#include "cashstick.h"
+#include "flash_layout.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#include "hardware/structs/timer.h"
+
+// Statistical PC-sampling profiler, built with the benchmarks. A spare
+// hardware alarm interrupts at the highest priority every period; the
+// handler reads the interrupted PC from the exception frame and counts it
+// in a 64-byte bucket of the firmware image. The dump is what
+// tools/hot_functions.py turns into the SRAM placement list.
+
+#define PROFILE_BUCKET_SHIFT 6
+#define PROFILE_BUCKETS (FLASH_TARGET_OFFSET >> PROFILE_BUCKET_SHIFT)
+
+static uint16_t profile_buckets[PROFILE_BUCKETS];
+static uint32_t profile_flash_samples;
+static uint32_t profile_ram_samples;
+static uint32_t profile_other_samples;
+static uint32_t profile_period_us;
+static int profile_alarm = -1;
+
+void profiler_take_sample(const uint32_t *frame);
+
+// Exception entry pushed r0-r3, r12, lr, pc, xPSR at the current stack
+// pointer; hand that frame to the sampler before anything else moves sp
+static void __attribute__((naked)) profiler_irq(void) {
+    __asm volatile (
+        "mov r0, sp\n"
+        "push {r4, lr}\n"
+        "bl profiler_take_sample\n"
+        "pop {r4, pc}\n"
+    );
+}
+
+void profiler_start(uint32_t period_us) {
+    if (profile_alarm < 0) {
+        profile_alarm = hardware_alarm_claim_unused(true);
+    }
+
+    memset(profile_buckets, 0, sizeof(profile_buckets));
+    profile_flash_samples = 0;
+    profile_ram_samples = 0;
+    profile_other_samples = 0;
+    profile_period_us = period_us;
+
+    uint irq = TIMER_IRQ_0 + (uint)profile_alarm;
+    irq_set_exclusive_handler(irq, profiler_irq);
+    irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    hw_set_bits(&timer_hw->inte, 1u << profile_alarm);
+    irq_set_enabled(irq, true);
+    timer_hw->alarm[profile_alarm] = timer_hw->timerawl + period_us;
+}
+
+void profiler_stop(void) {
+    if (profile_alarm < 0) {
+        return;
+    }
+
+    uint irq = TIMER_IRQ_0 + (uint)profile_alarm;
+    irq_set_enabled(irq, false);
+    hw_clear_bits(&timer_hw->inte, 1u << profile_alarm);
+    timer_hw->armed = 1u << profile_alarm;
+    timer_hw->intr = 1u << profile_alarm;
+    irq_remove_handler(irq, profiler_irq);
+}
+
+void profiler_dump(void) {
+    printf("PROFILE: samples %lu flash %lu ram %lu other %lu bucket %u\n",
+           (unsigned long)(profile_flash_samples + profile_ram_samples + profile_other_samples),
+           (unsigned long)profile_flash_samples, (unsigned long)profile_ram_samples,
+           (unsigned long)profile_other_samples, 1u << PROFILE_BUCKET_SHIFT);
+
+    for (uint32_t b = 0; b < PROFILE_BUCKETS; b++) {
+        if (profile_buckets[b] != 0) {
+            printf("PROFILE: %08lx %u\n",
+                   (unsigned long)(XIP_BASE + (b << PROFILE_BUCKET_SHIFT)), profile_buckets[b]);
+        }
+    }
+}
+
+void profiler_take_sample(const uint32_t *frame) {
+    timer_hw->intr = 1u << profile_alarm;
+    timer_hw->alarm[profile_alarm] = timer_hw->timerawl + profile_period_us;
+
+    uint32_t pc = frame[6];
+    if (pc >= XIP_BASE && pc < XIP_BASE + FLASH_TARGET_OFFSET) {
+        uint16_t *bucket = &profile_buckets[(pc - XIP_BASE) >> PROFILE_BUCKET_SHIFT];
+        if (*bucket != UINT16_MAX) {
+            (*bucket)++;
+        }
+        profile_flash_samples++;
+    } else if (pc >= SRAM_BASE && pc < SRAM_END) {
+        profile_ram_samples++;
+    } else {
+        profile_other_samples++;
+    }
+}
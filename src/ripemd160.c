@@ -0,0 +1,127 @@
+#include "ripemd160.h"
+#include "sha256.h"
+#include "ram_functions.h"
+#include <string.h>
+
+// Message word order and rotate amounts for the left and right lines
+static const uint8_t rmd_r_left[80] RAM_TABLE(rmd_r_left, ripemd160_transform) = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+    3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,
+    1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+    4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13
+};
+
+static const uint8_t rmd_r_right[80] RAM_TABLE(rmd_r_right, ripemd160_transform) = {
+    5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,
+    6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+    15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,
+    8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+    12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11
+};
+
+static const uint8_t rmd_s_left[80] RAM_TABLE(rmd_s_left, ripemd160_transform) = {
+    11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,
+    7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+    11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,
+    11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+    9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6
+};
+
+static const uint8_t rmd_s_right[80] RAM_TABLE(rmd_s_right, ripemd160_transform) = {
+    8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,
+    9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+    9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,
+    15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+    8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11
+};
+
+static const uint32_t rmd_k_left[5] RAM_TABLE(rmd_k_left, ripemd160_transform) = { 0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E };
+static const uint32_t rmd_k_right[5] RAM_TABLE(rmd_k_right, ripemd160_transform) = { 0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000 };
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static uint32_t RAM_FUNC(rmd_f)(int round, uint32_t x, uint32_t y, uint32_t z) {
+    switch (round) {
+        case 0: return x ^ y ^ z;
+        case 1: return (x & y) | (~x & z);
+        case 2: return (x | ~y) ^ z;
+        case 3: return (x & z) | (y & ~z);
+        default: return x ^ (y | ~z);
+    }
+}
+
+static void RAM_FUNC(ripemd160_transform)(uint32_t state[5], const uint8_t block[64]) {
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++) {
+        x[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+               ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    uint32_t al = state[0], bl = state[1], cl = state[2], dl = state[3], el = state[4];
+    uint32_t ar = al, br = bl, cr = cl, dr = dl, er = el;
+
+    for (int j = 0; j < 80; j++) {
+        int round = j / 16;
+        uint32_t t;
+
+        t = ROTL(al + rmd_f(round, bl, cl, dl) + x[rmd_r_left[j]] + rmd_k_left[round], rmd_s_left[j]) + el;
+        al = el;
+        el = dl;
+        dl = ROTL(cl, 10);
+        cl = bl;
+        bl = t;
+
+        t = ROTL(ar + rmd_f(4 - round, br, cr, dr) + x[rmd_r_right[j]] + rmd_k_right[round], rmd_s_right[j]) + er;
+        ar = er;
+        er = dr;
+        dr = ROTL(cr, 10);
+        cr = br;
+        br = t;
+    }
+
+    uint32_t t = state[1] + cl + dr;
+    state[1] = state[2] + dl + er;
+    state[2] = state[3] + el + ar;
+    state[3] = state[4] + al + br;
+    state[4] = state[0] + bl + cr;
+    state[0] = t;
+}
+
+void ripemd160(const uint8_t *data, size_t len, uint8_t digest[RIPEMD160_DIGEST_SIZE]) {
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t block[64];
+    uint64_t bit_len = (uint64_t)len * 8;
+
+    while (len >= 64) {
+        ripemd160_transform(state, data);
+        data += 64;
+        len -= 64;
+    }
+
+    // Padding: 0x80, zeros, then the 64-bit little-endian message length
+    memset(block, 0, sizeof(block));
+    memcpy(block, data, len);
+    block[len] = 0x80;
+    if (len >= 56) {
+        ripemd160_transform(state, block);
+        memset(block, 0, sizeof(block));
+    }
+    for (int i = 0; i < 8; i++) {
+        block[56 + i] = (uint8_t)(bit_len >> (8 * i));
+    }
+    ripemd160_transform(state, block);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)state[i];
+        digest[i * 4 + 1] = (uint8_t)(state[i] >> 8);
+        digest[i * 4 + 2] = (uint8_t)(state[i] >> 16);
+        digest[i * 4 + 3] = (uint8_t)(state[i] >> 24);
+    }
+}
+
+void hash160(const uint8_t *data, size_t len, uint8_t digest[RIPEMD160_DIGEST_SIZE]) {
+    uint8_t sha[SHA256_DIGEST_SIZE];
+    sha256(data, len, sha);
+    ripemd160(sha, sizeof(sha), digest);
+}
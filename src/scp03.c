@@ -0,0 +1,336 @@
+#include "scp03.h"
+#include <string.h>
+
+// KDF derivation constants (Amendment D, table 4-1)
+#define SCP03_DERIVE_CARD_CRYPTOGRAM 0x00
+#define SCP03_DERIVE_HOST_CRYPTOGRAM 0x01
+#define SCP03_DERIVE_S_ENC 0x04
+#define SCP03_DERIVE_S_MAC 0x06
+#define SCP03_DERIVE_S_RMAC 0x07
+
+#define SCP03_CLA_SECURE 0x04
+#define SCP03_SCP_ID 0x03
+
+static void scp03_kdf(const aes128_ctx_t *key, uint8_t constant, uint16_t length_bits,
+                      const uint8_t context[2 * SCP03_CHALLENGE_SIZE], uint8_t out[AES128_BLOCK_SIZE]);
+static void scp03_icv(const scp03_session_t *session, bool response, uint8_t icv[AES128_BLOCK_SIZE]);
+static void scp03_mac(const aes128_ctx_t *key, const uint8_t chain[AES128_BLOCK_SIZE],
+                      const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len,
+                      uint8_t mac[AES128_BLOCK_SIZE]);
+static size_t scp03_encrypt(const scp03_session_t *session, bool response, const uint8_t *data, size_t len,
+                            uint8_t *out);
+static bool scp03_decrypt(const scp03_session_t *session, bool response, const uint8_t *in, size_t in_len,
+                          uint8_t *data, size_t *len);
+static bool scp03_equal(const uint8_t *a, const uint8_t *b, size_t len);
+
+void scp03_initialize_update(const uint8_t host_challenge[SCP03_CHALLENGE_SIZE],
+                             uint8_t command[SCP03_INIT_UPDATE_SIZE]) {
+    command[0] = 0x80;
+    command[1] = 0x50;                  // INITIALIZE UPDATE
+    command[2] = 0x00;                  // Key version: default keyset
+    command[3] = 0x00;
+    command[4] = SCP03_CHALLENGE_SIZE;
+    memcpy(command + 5, host_challenge, SCP03_CHALLENGE_SIZE);
+    command[13] = 0x00;                 // Le
+}
+
+bool scp03_begin(scp03_session_t *session, const scp03_static_keys_t *keys,
+                 const uint8_t host_challenge[SCP03_CHALLENGE_SIZE],
+                 const uint8_t response[SCP03_INIT_RESPONSE_SIZE]) {
+    // Key diversification data (10), key info (3), card challenge, card cryptogram
+    const uint8_t *key_info = response + 10;
+    const uint8_t *card_challenge = response + 13;
+    const uint8_t *card_cryptogram = response + 21;
+
+    memset(session, 0, sizeof(*session));
+    if (key_info[1] != SCP03_SCP_ID || response[29] != 0x90 || response[30] != 0x00) {
+        return false;
+    }
+
+    aes128_ctx_t static_enc, static_mac;
+    uint8_t key[AES128_BLOCK_SIZE];
+    memcpy(session->context, host_challenge, SCP03_CHALLENGE_SIZE);
+    memcpy(session->context + SCP03_CHALLENGE_SIZE, card_challenge, SCP03_CHALLENGE_SIZE);
+
+    aes128_init(&static_enc, keys->enc);
+    aes128_init(&static_mac, keys->mac);
+    scp03_kdf(&static_enc, SCP03_DERIVE_S_ENC, 128, session->context, key);
+    aes128_init(&session->s_enc, key);
+    scp03_kdf(&static_mac, SCP03_DERIVE_S_MAC, 128, session->context, key);
+    aes128_init(&session->s_mac, key);
+    scp03_kdf(&static_mac, SCP03_DERIVE_S_RMAC, 128, session->context, key);
+    aes128_init(&session->s_rmac, key);
+    memset(key, 0, sizeof(key));
+
+    uint8_t expected[AES128_BLOCK_SIZE];
+    scp03_kdf(&session->s_mac, SCP03_DERIVE_CARD_CRYPTOGRAM, 64, session->context, expected);
+    return scp03_equal(expected, card_cryptogram, SCP03_CRYPTOGRAM_SIZE);
+}
+
+void scp03_external_authenticate(scp03_session_t *session, uint8_t command[SCP03_EXT_AUTH_SIZE]) {
+    uint8_t cryptogram[AES128_BLOCK_SIZE];
+    scp03_kdf(&session->s_mac, SCP03_DERIVE_HOST_CRYPTOGRAM, 64, session->context, cryptogram);
+
+    command[0] = 0x80 | SCP03_CLA_SECURE;
+    command[1] = 0x82;                  // EXTERNAL AUTHENTICATE
+    command[2] = SCP03_SECURITY_LEVEL;
+    command[3] = 0x00;
+    command[4] = SCP03_CRYPTOGRAM_SIZE + SCP03_MAC_SIZE;
+    memcpy(command + 5, cryptogram, SCP03_CRYPTOGRAM_SIZE);
+
+    memset(session->chain, 0, sizeof(session->chain));
+    scp03_mac(&session->s_mac, session->chain, command, 5 + SCP03_CRYPTOGRAM_SIZE, NULL, 0, session->chain);
+    memcpy(command + 5 + SCP03_CRYPTOGRAM_SIZE, session->chain, SCP03_MAC_SIZE);
+    session->counter = 0;
+    session->authenticated = true;
+}
+
+size_t scp03_wrap(scp03_session_t *session, const uint8_t header[4], const uint8_t *data, size_t len,
+                  uint8_t *frame, size_t max_len) {
+    size_t encrypted_len = len > 0 ? (len / AES128_BLOCK_SIZE + 1) * AES128_BLOCK_SIZE : 0;
+    if (len > SCP03_MAX_DATA || 5 + encrypted_len + SCP03_MAC_SIZE > max_len) {
+        return 0;
+    }
+
+    // The counter moves for every command, with data or without
+    session->counter++;
+
+    frame[0] = header[0] | SCP03_CLA_SECURE;
+    frame[1] = header[1];
+    frame[2] = header[2];
+    frame[3] = header[3];
+    frame[4] = (uint8_t)(encrypted_len + SCP03_MAC_SIZE);
+    scp03_encrypt(session, false, data, len, frame + 5);
+
+    scp03_mac(&session->s_mac, session->chain, frame, 5 + encrypted_len, NULL, 0, session->chain);
+    memcpy(frame + 5 + encrypted_len, session->chain, SCP03_MAC_SIZE);
+    return 5 + encrypted_len + SCP03_MAC_SIZE;
+}
+
+void scp03_mark(const scp03_session_t *session, scp03_mark_t *mark) {
+    memcpy(mark->chain, session->chain, sizeof(mark->chain));
+    mark->counter = session->counter;
+}
+
+void scp03_rewind(scp03_session_t *session, const scp03_mark_t *mark) {
+    memcpy(session->chain, mark->chain, sizeof(session->chain));
+    session->counter = mark->counter;
+}
+
+size_t scp03_response_size(size_t len) {
+    size_t encrypted_len = len > 0 ? (len / AES128_BLOCK_SIZE + 1) * AES128_BLOCK_SIZE : 0;
+    return encrypted_len + SCP03_MAC_SIZE + 2;
+}
+
+bool scp03_unwrap(const scp03_session_t *session, const uint8_t *frame, size_t frame_len,
+                  uint8_t *data, size_t *len, uint16_t *sw) {
+    if (frame_len < 2) {
+        return false;
+    }
+    *sw = (uint16_t)(frame[frame_len - 2] << 8 | frame[frame_len - 1]);
+    if (*sw != SCP03_SW_OK) {
+        *len = 0;
+        return true;
+    }
+
+    if (frame_len < 2 + SCP03_MAC_SIZE) {
+        return false;
+    }
+    size_t encrypted_len = frame_len - 2 - SCP03_MAC_SIZE;
+    uint8_t mac[AES128_BLOCK_SIZE];
+    scp03_mac(&session->s_rmac, session->chain, frame, encrypted_len, frame + frame_len - 2, 2, mac);
+    if (!scp03_equal(mac, frame + encrypted_len, SCP03_MAC_SIZE)) {
+        return false;
+    }
+    return scp03_decrypt(session, true, frame, encrypted_len, data, len);
+}
+
+// Card side
+
+void scp03_card_initialize(scp03_session_t *session, const scp03_static_keys_t *keys,
+                           const uint8_t command[SCP03_INIT_UPDATE_SIZE],
+                           const uint8_t card_challenge[SCP03_CHALLENGE_SIZE],
+                           uint8_t response[SCP03_INIT_RESPONSE_SIZE]) {
+    memset(response, 0, SCP03_INIT_RESPONSE_SIZE);
+    response[10] = 0x30;                // Key version
+    response[11] = SCP03_SCP_ID;
+    response[12] = 0x00;                // i: random card challenge, no R-MAC in INIT
+    memcpy(response + 13, card_challenge, SCP03_CHALLENGE_SIZE);
+    response[29] = 0x90;
+    response[30] = 0x00;
+
+    // Same derivation as the host; only the cryptogram direction differs
+    uint8_t cryptogram[AES128_BLOCK_SIZE];
+    scp03_begin(session, keys, command + 5, response);
+    scp03_kdf(&session->s_mac, SCP03_DERIVE_CARD_CRYPTOGRAM, 64, session->context, cryptogram);
+    memcpy(response + 21, cryptogram, SCP03_CRYPTOGRAM_SIZE);
+}
+
+bool scp03_card_authenticate(scp03_session_t *session, const uint8_t command[SCP03_EXT_AUTH_SIZE]) {
+    uint8_t expected[SCP03_EXT_AUTH_SIZE];
+    scp03_session_t host = *session;
+    if (command[2] != SCP03_SECURITY_LEVEL) {
+        return false;
+    }
+
+    scp03_external_authenticate(&host, expected);
+    if (!scp03_equal(expected, command, SCP03_EXT_AUTH_SIZE)) {
+        return false;
+    }
+    *session = host;
+    return true;
+}
+
+bool scp03_card_unwrap(scp03_session_t *session, const uint8_t *frame, size_t frame_len,
+                       uint8_t header[4], uint8_t *data, size_t *len) {
+    if (!session->authenticated || frame_len < 5 + SCP03_MAC_SIZE || frame_len != 5u + frame[4] ||
+        !(frame[0] & SCP03_CLA_SECURE)) {
+        return false;
+    }
+
+    size_t encrypted_len = frame_len - 5 - SCP03_MAC_SIZE;
+    uint8_t mac[AES128_BLOCK_SIZE];
+    scp03_mac(&session->s_mac, session->chain, frame, 5 + encrypted_len, NULL, 0, mac);
+    if (!scp03_equal(mac, frame + 5 + encrypted_len, SCP03_MAC_SIZE)) {
+        session->authenticated = false;     // A card ends the session on a bad MAC
+        return false;
+    }
+
+    memcpy(session->chain, mac, sizeof(session->chain));
+    session->counter++;
+    header[0] = frame[0] & (uint8_t)~SCP03_CLA_SECURE;
+    header[1] = frame[1];
+    header[2] = frame[2];
+    header[3] = frame[3];
+    return scp03_decrypt(session, false, frame + 5, encrypted_len, data, len);
+}
+
+size_t scp03_card_wrap(const scp03_session_t *session, const uint8_t *data, size_t len, uint16_t sw,
+                       uint8_t *frame, size_t max_len) {
+    if (sw != SCP03_SW_OK) {
+        len = 0;
+    }
+    size_t frame_len = sw != SCP03_SW_OK ? 2 : scp03_response_size(len);
+    if (len > SCP03_MAX_DATA || frame_len > max_len) {
+        return 0;
+    }
+
+    uint8_t status[2] = { (uint8_t)(sw >> 8), (uint8_t)sw };
+    if (sw == SCP03_SW_OK) {
+        size_t encrypted_len = scp03_encrypt(session, true, data, len, frame);
+        uint8_t mac[AES128_BLOCK_SIZE];
+        scp03_mac(&session->s_rmac, session->chain, frame, encrypted_len, status, 2, mac);
+        memcpy(frame + encrypted_len, mac, SCP03_MAC_SIZE);
+    }
+    memcpy(frame + frame_len - 2, status, 2);
+    return frame_len;
+}
+
+// Internal helper functions
+
+// SP 800-108 counter mode, one block: label (11 zero bytes, constant),
+// separator, L in bits, counter 1, context
+static void scp03_kdf(const aes128_ctx_t *key, uint8_t constant, uint16_t length_bits,
+                      const uint8_t context[2 * SCP03_CHALLENGE_SIZE], uint8_t out[AES128_BLOCK_SIZE]) {
+    uint8_t input[16 + 2 * SCP03_CHALLENGE_SIZE] = {0};
+    input[11] = constant;
+    input[12] = 0x00;
+    input[13] = (uint8_t)(length_bits >> 8);
+    input[14] = (uint8_t)length_bits;
+    input[15] = 0x01;
+    memcpy(input + 16, context, 2 * SCP03_CHALLENGE_SIZE);
+    aes128_cmac(key, input, sizeof(input), out);
+}
+
+// Command ICV encrypts the counter; a reply's has 0x80 in front
+static void scp03_icv(const scp03_session_t *session, bool response, uint8_t icv[AES128_BLOCK_SIZE]) {
+    memset(icv, 0, AES128_BLOCK_SIZE);
+    if (response) {
+        icv[0] = 0x80;
+    }
+    icv[12] = (uint8_t)(session->counter >> 24);
+    icv[13] = (uint8_t)(session->counter >> 16);
+    icv[14] = (uint8_t)(session->counter >> 8);
+    icv[15] = (uint8_t)session->counter;
+    aes128_encrypt_block(&session->s_enc, icv, icv);
+}
+
+// CMAC over chain || a || b
+static void scp03_mac(const aes128_ctx_t *key, const uint8_t chain[AES128_BLOCK_SIZE],
+                      const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len,
+                      uint8_t mac[AES128_BLOCK_SIZE]) {
+    aes128_cmac_ctx_t ctx;
+    aes128_cmac_init(&ctx, key);
+    aes128_cmac_update(&ctx, chain, AES128_BLOCK_SIZE);
+    aes128_cmac_update(&ctx, a, a_len);
+    if (b_len > 0) {
+        aes128_cmac_update(&ctx, b, b_len);
+    }
+    aes128_cmac_final(&ctx, mac);
+}
+
+// Pad with 80 00.. and encrypt; nothing at all for empty data
+static size_t scp03_encrypt(const scp03_session_t *session, bool response, const uint8_t *data, size_t len,
+                            uint8_t *out) {
+    if (len == 0) {
+        return 0;
+    }
+    size_t padded_len = (len / AES128_BLOCK_SIZE + 1) * AES128_BLOCK_SIZE;
+    memmove(out, data, len);
+    out[len] = 0x80;
+    memset(out + len + 1, 0, padded_len - len - 1);
+
+    uint8_t icv[AES128_BLOCK_SIZE];
+    scp03_icv(session, response, icv);
+    aes128_cbc_encrypt(&session->s_enc, icv, out, out, padded_len);
+    return padded_len;
+}
+
+static bool scp03_decrypt(const scp03_session_t *session, bool response, const uint8_t *in, size_t in_len,
+                          uint8_t *data, size_t *len) {
+    if (in_len == 0) {
+        *len = 0;
+        return true;
+    }
+    if (in_len % AES128_BLOCK_SIZE != 0 || in_len > *len + AES128_BLOCK_SIZE) {
+        return false;
+    }
+
+    uint8_t block[AES128_BLOCK_SIZE];
+    uint8_t icv[AES128_BLOCK_SIZE];
+    scp03_icv(session, response, icv);
+
+    // Block by block so data only needs room for the plaintext
+    size_t out_len = 0;
+    for (size_t offset = 0; offset < in_len; offset += AES128_BLOCK_SIZE) {
+        aes128_cbc_decrypt(&session->s_enc, icv, in + offset, block, AES128_BLOCK_SIZE);
+        memcpy(icv, in + offset, AES128_BLOCK_SIZE);
+
+        size_t take = AES128_BLOCK_SIZE;
+        if (offset + AES128_BLOCK_SIZE == in_len) {
+            // Strip 80 00.. from the last block
+            while (take > 0 && block[take - 1] == 0x00) {
+                take--;
+            }
+            if (take == 0 || block[take - 1] != 0x80) {
+                return false;
+            }
+            take--;
+        }
+        if (out_len + take > *len) {
+            return false;
+        }
+        memcpy(data + out_len, block, take);
+        out_len += take;
+    }
+    *len = out_len;
+    return true;
+}
+
+static bool scp03_equal(const uint8_t *a, const uint8_t *b, size_t len) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
@@ -0,0 +1,211 @@
+#include "cashstick.h"
+
+// Bounded-latency I2C transport for the SE050. Every transfer has a
+// timeout scaled to its length; a failed command is retried with
+// exponential backoff, and from the second failure on the bus is
+// recovered (9 clocks + STOP) before the next attempt. A command therefore
+// either completes or fails within roughly SE050_I2C_MAX_ATTEMPTS timeouts
+// plus backoff - it can no longer hang system_init or the main loop.
+// None of this touches the secure channel: se050_i2c_exchange() reports
+// whether a command got through so the session can stay in step.
+
+static i2c_stats_t i2c_stats = {0};
+
+#if CASHSTICK_I2C_FAULT_INJECTION
+// Injected faults behave like a real timeout, including the time it takes
+static uint32_t fault_permille = 0;
+static uint32_t fault_rng_state = 0x2545F491;
+
+static bool se050_i2c_fault(void) {
+    if (fault_permille == 0) {
+        return false;
+    }
+    // xorshift32 - no need for the DRBG here, and it would recurse
+    fault_rng_state ^= fault_rng_state << 13;
+    fault_rng_state ^= fault_rng_state >> 17;
+    fault_rng_state ^= fault_rng_state << 5;
+    return (fault_rng_state % 1000) < fault_permille;
+}
+
+void se050_i2c_inject_faults(uint32_t permille) {
+    fault_permille = permille > 1000 ? 1000 : permille;
+}
+#endif
+
+static void se050_i2c_backoff(uint32_t attempt);
+static void se050_i2c_after_failure(uint32_t attempt);
+
+void se050_i2c_init(void) {
+    board_se050_bus_init();
+}
+
+// Single attempt each; these return the byte count or a PICO_ERROR_ code
+
+int RAM_FUNC(se050_i2c_write)(const uint8_t *data, size_t len) {
+    i2c_stats.transfers++;
+    uint32_t start = metrics_start();
+#if CASHSTICK_I2C_FAULT_INJECTION
+    if (se050_i2c_fault()) {
+        busy_wait_us_32(SE050_I2C_TIMEOUT_US(len));
+        i2c_stats.timeouts++;
+        metrics_end(METRIC_I2C_TRANSFER, start, false);
+        i2c_trace_record(I2C_TRACE_WRITE, data, len, PICO_ERROR_TIMEOUT, start);
+        return PICO_ERROR_TIMEOUT;
+    }
+#endif
+    int result = board_se050_write(SE050_I2C_ADDR, data, len, SE050_I2C_TIMEOUT_US(len));
+    if (result == PICO_ERROR_TIMEOUT) {
+        i2c_stats.timeouts++;
+    }
+    metrics_end(METRIC_I2C_TRANSFER, start, result == (int)len);
+    i2c_trace_record(I2C_TRACE_WRITE, data, len, result, start);
+    return result;
+}
+
+int RAM_FUNC(se050_i2c_read)(uint8_t *data, size_t len) {
+    i2c_stats.transfers++;
+    uint32_t start = metrics_start();
+#if CASHSTICK_I2C_FAULT_INJECTION
+    if (se050_i2c_fault()) {
+        busy_wait_us_32(SE050_I2C_TIMEOUT_US(len));
+        i2c_stats.timeouts++;
+        metrics_end(METRIC_I2C_TRANSFER, start, false);
+        i2c_trace_record(I2C_TRACE_READ, data, len, PICO_ERROR_TIMEOUT, start);
+        return PICO_ERROR_TIMEOUT;
+    }
+#endif
+    int result = board_se050_read(SE050_I2C_ADDR, data, len, SE050_I2C_TIMEOUT_US(len));
+    if (result == PICO_ERROR_TIMEOUT) {
+        i2c_stats.timeouts++;
+    }
+    metrics_end(METRIC_I2C_TRANSFER, start, result == (int)len);
+    i2c_trace_record(I2C_TRACE_READ, data, len, result, start);
+    return result;
+}
+
+// Retrying wrappers
+
+bool se050_i2c_send(const uint8_t *cmd, size_t cmd_len) {
+    for (uint32_t attempt = 0; attempt < SE050_I2C_MAX_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            se050_i2c_backoff(attempt);
+        }
+        if (se050_i2c_write(cmd, cmd_len) == (int)cmd_len) {
+            return true;
+        }
+        se050_i2c_after_failure(attempt);
+    }
+
+    i2c_stats.failures++;
+    return false;
+}
+
+bool se050_i2c_receive(uint8_t *resp, size_t resp_len) {
+    for (uint32_t attempt = 0; attempt < SE050_I2C_MAX_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            se050_i2c_backoff(attempt);
+        }
+        if (se050_i2c_read(resp, resp_len) == (int)resp_len) {
+            return true;
+        }
+        // Only back off here: recovering the bus would abort the command
+        // whose response we are waiting for
+        if (attempt + 1 < SE050_I2C_MAX_ATTEMPTS) {
+            i2c_stats.retries++;
+        }
+    }
+
+    i2c_stats.failures++;
+    return false;
+}
+
+// Command/response exchange for commands that must not run twice, such
+// as secure channel frames: the write is retried until it lands, then only
+// the read. *delivered tells whether the SE050 may have acted on it.
+bool se050_i2c_exchange(const uint8_t *cmd, size_t cmd_len, uint8_t *resp, size_t resp_len,
+                        uint32_t wait_ms, bool *delivered) {
+    uint64_t start = time_us_64();
+
+    *delivered = se050_i2c_send(cmd, cmd_len);
+    bool ok = *delivered;
+    if (ok) {
+        if (wait_ms > 0) {
+            delay_ms(wait_ms);
+        }
+        ok = resp_len == 0 || se050_i2c_receive(resp, resp_len);
+    }
+
+    uint32_t elapsed_us = (uint32_t)(time_us_64() - start);
+    if (ok && elapsed_us > i2c_stats.max_latency_us) {
+        i2c_stats.max_latency_us = elapsed_us;
+    }
+    metrics_record(METRIC_SE050_CMD, elapsed_us, ok);
+    return ok;
+}
+
+// Command/response exchange; the whole exchange is retried, so only for
+// commands that are harmless to repeat
+bool se050_i2c_transceive(const uint8_t *cmd, size_t cmd_len,
+                          uint8_t *resp, size_t resp_len, uint32_t wait_ms) {
+    uint64_t start = time_us_64();
+
+    for (uint32_t attempt = 0; attempt < SE050_I2C_MAX_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            se050_i2c_backoff(attempt);
+        }
+
+        if (se050_i2c_write(cmd, cmd_len) == (int)cmd_len) {
+            if (wait_ms > 0) {
+                delay_ms(wait_ms);
+            }
+            if (resp_len == 0 || se050_i2c_read(resp, resp_len) == (int)resp_len) {
+                uint32_t elapsed_us = (uint32_t)(time_us_64() - start);
+                if (elapsed_us > i2c_stats.max_latency_us) {
+                    i2c_stats.max_latency_us = elapsed_us;
+                }
+                metrics_record(METRIC_SE050_CMD, elapsed_us, true);
+                return true;
+            }
+        }
+        se050_i2c_after_failure(attempt);
+    }
+
+    i2c_stats.failures++;
+    metrics_record(METRIC_SE050_CMD, (uint32_t)(time_us_64() - start), false);
+    return false;
+}
+
+// Release a slave holding SDA low: clock SCL up to 9 times until SDA
+// reads high, then generate a STOP and hand the pins back to the I2C block
+void se050_i2c_bus_recover(void) {
+    i2c_stats.recoveries++;
+    uint32_t start = time_us_32();
+
+    board_se050_bus_recover(SE050_I2C_HALF_CLOCK_US);
+    i2c_trace_record(I2C_TRACE_RECOVER, NULL, 0, 0, start);
+}
+
+void se050_i2c_get_stats(i2c_stats_t *stats) {
+    if (stats) {
+        *stats = i2c_stats;
+    }
+}
+
+// Internal helper functions
+
+static void se050_i2c_backoff(uint32_t attempt) {
+    delay_ms(SE050_I2C_BACKOFF_MS << (attempt - 1));
+}
+
+static void se050_i2c_after_failure(uint32_t attempt) {
+    if (attempt + 1 >= SE050_I2C_MAX_ATTEMPTS) {
+        return;  // Out of attempts; the caller reports the failure
+    }
+    i2c_stats.retries++;
+
+    // A single glitch just backs off; repeated failures get a bus
+    // recovery before the next attempt
+    if (attempt >= 1) {
+        se050_i2c_bus_recover();
+    }
+}
@@ -1,22 +1,101 @@
 #include "cashstick.h"
+#include "scp03.h"
+#include "pico/rand.h"
 
-// SE050 communication buffers
+// SE050 communication buffers (a wrapped frame is at most 253 bytes)
 static uint8_t tx_buffer[256];
 static uint8_t rx_buffer[256];
 
-// SE050 session state
+// SCP03 static keys of the default keyset, as provisioned into the SE050.
+// Parts ship with the GlobalPlatform test keys, which are public: only a
+// development build opts into them, and STATUS and INFO.TXT say so.
+#if CASHSTICK_DEV_SCP03_KEYS
+#ifdef SE050_SCP03_KEY_ENC
+#error "CASHSTICK_DEV_SCP03_KEYS and SE050_SCP03_KEY_ENC are both set"
+#endif
+#define SE050_SCP03_KEY_ENC { 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, \
+                              0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F }
+#elif !defined(SE050_SCP03_KEY_ENC)
+#error "Set SE050_SCP03_KEY_ENC (and _MAC, _DEK), or CASHSTICK_DEV_SCP03_KEYS for a development build"
+#endif
+#ifndef SE050_SCP03_KEY_MAC
+#define SE050_SCP03_KEY_MAC SE050_SCP03_KEY_ENC
+#endif
+#ifndef SE050_SCP03_KEY_DEK
+#define SE050_SCP03_KEY_DEK SE050_SCP03_KEY_ENC
+#endif
+
+static const scp03_static_keys_t se050_static_keys = {
+    .enc = SE050_SCP03_KEY_ENC,
+    .mac = SE050_SCP03_KEY_MAC,
+    .dek = SE050_SCP03_KEY_DEK,
+};
+
+// SE050 session state. The SCP03 session lives in RAM the runtime does
+// not clear, so a watchdog or soft reset picks it up again while the
+// SE050 kept power: session keys are derived once per power cycle. USB
+// suspend and dormant mode leave both powered, and nothing re-opens the
+// session on resume.
+#define SE050_SESSION_MAGIC 0x33504353  // "SCP3"
+
+static scp03_session_t __uninitialized_ram(se050_session);
+static uint32_t __uninitialized_ram(se050_session_magic);
 static bool se050_session_open = false;
+static se050_session_stats_t session_stats = {0};
+
+typedef enum {
+    SE050_SECURE_OK = 0,
+    SE050_SECURE_IO_ERROR,      // Bus failure; the session is still in step
+    SE050_SECURE_STATUS,        // Error status word, or a bad request
+    SE050_SECURE_REJECTED       // Session gone on the SE050, or bad R-MAC
+} se050_secure_result_t;
+
+// Background key generation. The SE050 handles one command at a time, so
+// any synchronous command first waits for an in-flight keygen to finish
+// (se050_wait_idle) and parks its result until the key pool collects it.
+typedef enum {
+    SE050_KEYGEN_IDLE = 0,
+    SE050_KEYGEN_RUNNING,
+    SE050_KEYGEN_DONE
+} se050_keygen_phase_t;
+
+static struct {
+    se050_keygen_phase_t phase;
+    uint16_t object_id;
+    uint32_t ready_at_ms;
+    bool ok;
+    uint8_t public_key[33];
+} se050_keygen = {0};
+
+static void se050_keygen_complete(void);
+static se050_secure_result_t se050_secure_exchange(const uint8_t header[4], const uint8_t *data, size_t len,
+                                                   uint8_t *resp, size_t resp_len, uint32_t wait_ms);
+static void se050_close_session(void);
 
 bool se050_init(void) {
     // Test I2C communication with SE050
     uint8_t test_data = 0x00;
-    int result = i2c_write_blocking(i2c1, SE050_I2C_ADDR, &test_data, 1, false);
-    
-    if (result < 0) {
+    if (!se050_i2c_send(&test_data, 1)) {
         printf("SE050: I2C communication failed\n");
         return false;
     }
     
+    // A session left by a soft reset costs one command to confirm; if
+    // the SE050 lost it, se050_command() runs the handshake anyway
+    if (se050_session_magic == SE050_SESSION_MAGIC && se050_session.authenticated) {
+        uint8_t probe[8];
+        uint32_t handshakes = session_stats.handshakes;
+        se050_session_open = true;
+        if (se050_get_random(probe, sizeof(probe))) {
+            if (session_stats.handshakes == handshakes) {
+                session_stats.resumed++;
+                printf("SE050: Resumed secure session\n");
+            }
+            printf("SE050: Initialized successfully\n");
+            return true;
+        }
+    }
+    
     // Initialize SE050 secure session
     if (!se050_open_session()) {
         printf("SE050: Session initialization failed\n");
@@ -27,62 +106,183 @@ bool se050_init(void) {
     return true;
 }
 
+// Full SCP03 handshake: INITIALIZE UPDATE, session key derivation and
+// EXTERNAL AUTHENTICATE at C-MAC + C-DEC + R-MAC + R-ENC
 bool se050_open_session(void) {
-    // Simplified session opening - implement proper SE050 protocol
-    // This would involve authentication and secure channel establishment
-    
-    uint8_t session_cmd[] = {0x80, 0x01, 0x00, 0x00, 0x00}; // Example command
-    
-    int result = i2c_write_blocking(i2c1, SE050_I2C_ADDR, session_cmd, sizeof(session_cmd), false);
-    if (result < 0) {
-        return false;
+    uint8_t host_challenge[SCP03_CHALLENGE_SIZE];
+    uint8_t init_cmd[SCP03_INIT_UPDATE_SIZE];
+    uint8_t auth_cmd[SCP03_EXT_AUTH_SIZE];
+    uint32_t start = metrics_start();
+    
+    se050_close_session();
+    
+    uint64_t nonce = get_rand_64();
+    memcpy(host_challenge, &nonce, sizeof(host_challenge));
+    scp03_initialize_update(host_challenge, init_cmd);
+    
+    // INITIALIZE UPDATE only starts over if repeated, so retry it whole
+    bool ok = se050_i2c_transceive(init_cmd, sizeof(init_cmd), rx_buffer, SCP03_INIT_RESPONSE_SIZE, 5) &&
+              scp03_begin(&se050_session, &se050_static_keys, host_challenge, rx_buffer);
+    if (ok) {
+        bool delivered;
+        scp03_external_authenticate(&se050_session, auth_cmd);
+        ok = se050_i2c_exchange(auth_cmd, sizeof(auth_cmd), rx_buffer, 2, 5, &delivered) &&
+             rx_buffer[0] == (SCP03_SW_OK >> 8) && rx_buffer[1] == (SCP03_SW_OK & 0xFF);
     }
+    metrics_end(METRIC_SCP03_HANDSHAKE, start, ok);
     
-    // Read response
-    delay_ms(10);
-    result = i2c_read_blocking(i2c1, SE050_I2C_ADDR, rx_buffer, 16, false);
-    if (result < 0) {
+    if (!ok) {
+        se050_close_session();
+        printf("SE050: Secure channel handshake failed\n");
         return false;
     }
     
+    session_stats.handshakes++;
+    se050_session_magic = SE050_SESSION_MAGIC;
     se050_session_open = true;
     return true;
 }
 
-bool se050_generate_bitcoin_keys(bitcoin_keys_t *keys) {
-    if (!se050_session_open || !keys) {
+// One command over the secure channel. resp_len is the plaintext the
+// command answers with. Bus errors leave the session usable (see
+// se050_secure_exchange); only a session the SE050 dropped costs a new
+// handshake, after which the command is tried once more.
+bool se050_command(const uint8_t header[4], const uint8_t *data, size_t len,
+                   uint8_t *resp, size_t resp_len, uint32_t wait_ms) {
+    if (!se050_session_open) {
         return false;
     }
     
-    led_set_state(LED_STATE_BUSY);
+    se050_wait_idle();
+    se050_secure_result_t result = se050_secure_exchange(header, data, len, resp, resp_len, wait_ms);
+    if (result == SE050_SECURE_REJECTED) {
+        session_stats.rejected++;
+        if (se050_open_session()) {
+            result = se050_secure_exchange(header, data, len, resp, resp_len, wait_ms);
+        }
+    }
+    return result == SE050_SECURE_OK;
+}
+
+void se050_get_session_stats(se050_session_stats_t *stats) {
+    if (stats) {
+        *stats = session_stats;
+    }
+}
+
+bool se050_keygen_begin(uint16_t object_id) {
+    if (!se050_session_open) {
+        return false;
+    }
+    
+    se050_wait_idle();
+    if (se050_keygen.phase != SE050_KEYGEN_IDLE) {
+        return false;  // Previous result not collected yet
+    }
+    
+    // Clear whatever the slot held before (fails harmlessly if empty)
+    se050_delete_key(object_id);
     
     // Command to generate secp256k1 key pair for Bitcoin using SE050 native support
-    uint8_t keygen_cmd[] = {
-        0x80, 0x02,  // Command: Generate Key Pair
-        0x00, 0x01,  // Object ID: Bitcoin key slot
+    const uint8_t keygen_header[4] = {
+        0x80, SE050_CMD_GENERATE_KEYPAIR,
+        (uint8_t)(object_id >> 8), (uint8_t)object_id   // Object ID: key slot
+    };
+    const uint8_t keygen_data[] = {
         0x20,        // Key length: 32 bytes
         0x40         // Algorithm: Native secp256k1 (SE050 built-in)
     };
     
-    int result = i2c_write_blocking(i2c1, SE050_I2C_ADDR, keygen_cmd, sizeof(keygen_cmd), false);
-    if (result < 0) {
+    // Only the command goes out now; the reply is unwrapped on collect
+    scp03_mark_t mark;
+    scp03_mark(&se050_session, &mark);
+    size_t frame_len = scp03_wrap(&se050_session, keygen_header, keygen_data, sizeof(keygen_data),
+                                  tx_buffer, sizeof(tx_buffer));
+    if (frame_len == 0) {
+        return false;
+    }
+    if (!se050_i2c_send(tx_buffer, frame_len)) {
+        scp03_rewind(&se050_session, &mark);
+        session_stats.rewinds++;
         return false;
     }
     
-    // Wait for key generation (can take several seconds)
-    delay_ms(2000);
+    se050_keygen.phase = SE050_KEYGEN_RUNNING;
+    se050_keygen.object_id = object_id;
+    se050_keygen.ready_at_ms = get_system_time_ms() + SE050_KEYGEN_TIME_MS;
+    return true;
+}
+
+uint32_t se050_keygen_remaining_ms(void) {
+    if (se050_keygen.phase != SE050_KEYGEN_RUNNING) {
+        return 0;
+    }
+    
+    int32_t remaining = (int32_t)(se050_keygen.ready_at_ms - get_system_time_ms());
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+bool se050_keygen_collect(uint16_t *object_id, uint8_t *public_key) {
+    if (se050_keygen.phase == SE050_KEYGEN_IDLE) {
+        return false;
+    }
+    
+    if (se050_keygen.phase == SE050_KEYGEN_RUNNING) {
+        se050_keygen_complete();
+    }
+    
+    if (object_id) {
+        *object_id = se050_keygen.object_id;
+    }
+    if (public_key) {
+        memcpy(public_key, se050_keygen.public_key, 33);
+    }
+    
+    se050_keygen.phase = SE050_KEYGEN_IDLE;
+    return se050_keygen.ok;
+}
+
+void se050_wait_idle(void) {
+    if (se050_keygen.phase == SE050_KEYGEN_RUNNING) {
+        se050_keygen_complete();
+    }
+}
+
+bool se050_delete_key(uint16_t object_id) {
+    if (!se050_session_open) {
+        return false;
+    }
+    
+    const uint8_t delete_header[4] = {
+        0x80, SE050_CMD_DELETE_OBJECT,
+        (uint8_t)(object_id >> 8), (uint8_t)object_id
+    };
+    
+    return se050_command(delete_header, NULL, 0, NULL, 0, 10);
+}
+
+bool se050_generate_bitcoin_keys(bitcoin_keys_t *keys) {
+    if (!se050_session_open || !keys) {
+        return false;
+    }
+    
+    led_set_state(LED_STATE_BUSY);
     
-    // Read generated public key
-    result = i2c_read_blocking(i2c1, SE050_I2C_ADDR, rx_buffer, 64, false);
-    if (result < 0) {
+    // Blocking keygen into the slot named by keys->key_object_id
+    if (!se050_keygen_begin(keys->key_object_id)) {
         return false;
     }
     
-    // Extract public key from response (simplified)
-    memcpy(keys->public_key, rx_buffer + 1, 33);  // Skip status byte
+    // Wait for key generation (can take several seconds)
+    if (!se050_keygen_collect(NULL, keys->public_key)) {
+        return false;
+    }
     
-    // Generate Bitcoin address from public key
-    if (!bitcoin_pubkey_to_address(keys->public_key, keys->address, sizeof(keys->address))) {
+    // Derive every address encoding now (software crypto burst)
+    clock_boost_begin();
+    bool address_ok = address_table_build(keys->public_key, &keys->addresses);
+    clock_boost_end();
+    if (!address_ok) {
         return false;
     }
     
@@ -90,12 +290,12 @@ bool se050_generate_bitcoin_keys(bitcoin_keys_t *keys) {
     keys->is_sealed = true;
     
     printf("SE050: Bitcoin keys generated successfully\n");
-    printf("Address: %s\n", keys->address);
+    printf("Address: %s\n", address_table_get(&keys->addresses, ADDRESS_FORMAT_DEFAULT));
     
     return true;
 }
 
-bool se050_sign_transaction(const uint8_t *hash, uint8_t *signature) {
+bool se050_sign_transaction(uint16_t key_id, const uint8_t *hash, uint8_t *signature) {
     if (!se050_session_open || !hash || !signature) {
         return false;
     }
@@ -103,31 +303,18 @@ bool se050_sign_transaction(const uint8_t *hash, uint8_t *signature) {
     led_set_state(LED_STATE_BUSY);
     
     // Command to sign hash with stored private key
-    uint8_t sign_cmd[40] = {
-        0x80, 0x03,  // Command: Sign Hash
-        0x00, 0x01,  // Key ID
-        0x20         // Hash length: 32 bytes
+    const uint8_t sign_header[4] = {
+        0x80, SE050_CMD_SIGN_HASH,
+        (uint8_t)(key_id >> 8), (uint8_t)key_id  // Key ID
     };
     
-    // Append hash to command
-    memcpy(sign_cmd + 5, hash, 32);
-    
-    int result = i2c_write_blocking(i2c1, SE050_I2C_ADDR, sign_cmd, 37, false);
-    if (result < 0) {
+    // Wait 500 ms for signature generation, then read it
+    if (!se050_command(sign_header, hash, 32, signature, 64, 500)) {
         return false;
     }
     
-    // Wait for signature generation
-    delay_ms(500);
-    
-    // Read signature
-    result = i2c_read_blocking(i2c1, SE050_I2C_ADDR, rx_buffer, 80, false);
-    if (result < 0) {
-        return false;
-    }
-    
-    // Extract signature from response
-    memcpy(signature, rx_buffer + 1, 64);  // Skip status byte
+    journal_append(JOURNAL_EVENT_SIGN, (uint32_t)hash[0] << 24 | (uint32_t)hash[1] << 16 |
+                                       (uint32_t)hash[2] << 8 | hash[3]);
     
     printf("SE050: Transaction signed successfully\n");
     return true;
@@ -139,62 +326,145 @@ bool se050_configure_tamper_detection(void) {
     }
     
     // Configure SE050 tamper detection features
-    uint8_t tamper_cmd[] = {
-        0x80, 0x05,  // Command: Configure Tamper
+    const uint8_t tamper_header[4] = {
+        0x80, SE050_CMD_SET_TAMPER_CONFIG,
         0x01,        // Enable tamper detection
-        0x02,        // Tamper response: clear keys
-        0xFF         // Sensitivity level: maximum
+        0x02         // Tamper response: clear keys
     };
+    const uint8_t sensitivity = 0xFF;   // Maximum
     
-    int result = i2c_write_blocking(i2c1, SE050_I2C_ADDR, tamper_cmd, sizeof(tamper_cmd), false);
-    if (result < 0) {
+    if (!se050_command(tamper_header, &sensitivity, 1, NULL, 0, 100)) {
         return false;
     }
     
-    delay_ms(100);
-    
     printf("SE050: Tamper detection configured\n");
     return true;
 }
 
 bool se050_get_device_info(uint8_t *info, size_t *info_len) {
-    if (!se050_session_open || !info || !info_len) {
+    if (!se050_session_open || !info || !info_len || *info_len > SCP03_MAX_DATA) {
         return false;
     }
     
     // Get SE050 version and device information
-    uint8_t info_cmd[] = {0x80, 0x01, 0x00, 0x00, 0x00};
+    const uint8_t info_header[4] = {0x80, SE050_CMD_GET_VERSION, 0x00, 0x00};
     
-    int result = i2c_write_blocking(i2c1, SE050_I2C_ADDR, info_cmd, sizeof(info_cmd), false);
-    if (result < 0) {
+    return se050_command(info_header, NULL, 0, info, *info_len, 50);
+}
+
+bool se050_get_random(uint8_t *out, size_t len) {
+    if (!se050_session_open || !out) {
         return false;
     }
     
-    delay_ms(50);
+    // The TRNG returns at most SE050_RANDOM_CHUNK bytes per request
+    const uint8_t random_header[4] = {0x80, SE050_CMD_GET_RANDOM, 0x00, 0x00};
+    while (len > 0) {
+        uint8_t chunk = len < SE050_RANDOM_CHUNK ? (uint8_t)len : SE050_RANDOM_CHUNK;
+        
+        if (!se050_command(random_header, &chunk, 1, out, chunk, 5)) {
+            return false;
+        }
+        
+        out += chunk;
+        len -= chunk;
+    }
     
-    result = i2c_read_blocking(i2c1, SE050_I2C_ADDR, info, *info_len, false);
-    if (result > 0) {
-        *info_len = result;
-        return true;
+    return true;
+}
+
+// MAC over a 32-byte seal context with the SE050's device seal key
+bool se050_compute_seal(const uint8_t *context, uint8_t *seal) {
+    if (!se050_session_open || !context || !seal) {
+        return false;
     }
     
-    return false;
+    const uint8_t seal_header[4] = {
+        0x80, SE050_CMD_COMPUTE_SEAL,
+        0x00, 0x02   // Object ID: device seal key
+    };
+    
+    return se050_command(seal_header, context, 32, seal, 32, 10);
 }
 
-// Helper function to convert public key to Bitcoin address
-bool bitcoin_pubkey_to_address(const uint8_t *pubkey, char *address, size_t addr_len) {
-    // Simplified Bitcoin address generation (Bech32 format)
-    // In production, implement full Bitcoin address generation with proper hashing
+// Internal helper functions
+
+static void se050_keygen_complete(void) {
+    uint32_t remaining = se050_keygen_remaining_ms();
+    if (remaining > 0) {
+        delay_ms(remaining);
+    }
     
-    if (!pubkey || !address || addr_len < 42) {
-        return false;
+    // Read generated public key. A lost reply fails this keygen only; the
+    // SE050 took the command, so the session stays in step.
+    size_t reply_len = scp03_response_size(33);
+    size_t key_len = 33;
+    uint16_t sw = 0;
+    se050_keygen.ok = se050_i2c_receive(rx_buffer, reply_len);
+    if (!se050_keygen.ok) {
+        session_stats.lost_replies++;
+    } else if (!scp03_unwrap(&se050_session, rx_buffer, reply_len, se050_keygen.public_key, &key_len, &sw)) {
+        session_stats.rejected++;
+        se050_keygen.ok = false;
+    } else {
+        se050_keygen.ok = sw == SCP03_SW_OK && key_len == 33;
     }
     
-    // Generate a demo Bitcoin address for testing
-    // Format: bc1 + base32 encoded public key hash
-    snprintf(address, addr_len, "bc1q%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
-        pubkey[0], pubkey[1], pubkey[2], pubkey[3], pubkey[4], pubkey[5], pubkey[6], pubkey[7],
-        pubkey[8], pubkey[9], pubkey[10], pubkey[11], pubkey[12], pubkey[13], pubkey[14], pubkey[15]);
+    se050_keygen.phase = SE050_KEYGEN_DONE;
+}
+
+// Wrap, exchange and unwrap one command. A frame that never reached the
+// SE050 rewinds the session; a lost reply leaves it as it is, since the
+// SE050 advanced with us. Either way the next command needs no handshake.
+static se050_secure_result_t se050_secure_exchange(const uint8_t header[4], const uint8_t *data, size_t len,
+                                                   uint8_t *resp, size_t resp_len, uint32_t wait_ms) {
+    scp03_mark_t mark;
+    scp03_mark(&se050_session, &mark);
+    
+    uint32_t start = metrics_start();
+    size_t frame_len = scp03_wrap(&se050_session, header, data, len, tx_buffer, sizeof(tx_buffer));
+    uint32_t crypto_us = time_us_32() - start;
+    size_t reply_len = scp03_response_size(resp_len);
+    if (frame_len == 0 || reply_len > sizeof(rx_buffer)) {
+        scp03_rewind(&se050_session, &mark);
+        return SE050_SECURE_STATUS;
+    }
     
-    return true;
-}
\ No newline at end of file
+    bool delivered = false;
+    if (!se050_i2c_exchange(tx_buffer, frame_len, rx_buffer, reply_len, wait_ms, &delivered)) {
+        if (delivered) {
+            session_stats.lost_replies++;
+        } else {
+            scp03_rewind(&se050_session, &mark);
+            session_stats.rewinds++;
+        }
+        return SE050_SECURE_IO_ERROR;
+    }
+    
+    // An error reply is the status word alone, at the start of the read
+    if (rx_buffer[reply_len - 2] != (SCP03_SW_OK >> 8) || rx_buffer[reply_len - 1] != (SCP03_SW_OK & 0xFF)) {
+        reply_len = 2;
+    }
+    
+    start = time_us_32();
+    size_t out_len = resp_len;
+    uint16_t sw = 0;
+    bool authentic = scp03_unwrap(&se050_session, rx_buffer, reply_len, resp, &out_len, &sw);
+    crypto_us += time_us_32() - start;
+    metrics_record(METRIC_SCP03_CRYPTO, crypto_us, authentic);
+    
+    if (!authentic || sw == SCP03_SW_SECURITY) {
+        return SE050_SECURE_REJECTED;
+    }
+    if (sw != SCP03_SW_OK || out_len != resp_len) {
+        return SE050_SECURE_STATUS;
+    }
+    return SE050_SECURE_OK;
+}
+
+// Forget the session and its keys
+static void se050_close_session(void) {
+    se050_session_open = false;
+    se050_session_magic = 0;
+    memset(&se050_session, 0, sizeof(se050_session));
+}
@@ -0,0 +1,613 @@
+#include "secp256k1.h"
+#include "ram_functions.h"
+#include <string.h>
+
+// Field prime p = 2^256 - 2^32 - 977
+static const secp256k1_fe_t fe_p RAM_TABLE(fe_p, fe_mul) = {{
+    0xFFFFFC2F, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF
+}};
+
+// 2^256 mod p
+#define FE_REDUCE_LOW 977u
+
+// Exponents for inversion (p - 2) and square roots ((p + 1) / 4), big-endian
+static const uint8_t exp_p_minus_2[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF, 0xFC, 0x2D
+};
+static const uint8_t exp_sqrt[32] = {
+    0x3F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xBF, 0xFF, 0xFF, 0x0C
+};
+
+// Group order n, big-endian
+static const uint8_t group_order[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B, 0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41
+};
+
+static const secp256k1_point_t generator = {
+    {{ 0x16F81798, 0x59F2815B, 0x2DCE28D9, 0x029BFCDB, 0xCE870B07, 0x55A06295, 0xF9DCBBAC, 0x79BE667E }},
+    {{ 0xFB10D4B8, 0x9C47D08F, 0xA6855419, 0xFD17B448, 0x0E1108A8, 0x5DA4FBFC, 0x26A3C465, 0x483ADA77 }},
+    false
+};
+
+// Jacobian coordinates: (X, Y, Z) represents (X / Z^2, Y / Z^3)
+typedef struct {
+    secp256k1_fe_t x;
+    secp256k1_fe_t y;
+    secp256k1_fe_t z;
+    bool infinity;
+} secp256k1_jacobian_t;
+
+// Field arithmetic
+
+static bool fe_is_zero(const secp256k1_fe_t *a) {
+    uint32_t acc = 0;
+    for (int i = 0; i < 8; i++) {
+        acc |= a->v[i];
+    }
+    return acc == 0;
+}
+
+static bool fe_equal(const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    return memcmp(a->v, b->v, sizeof(a->v)) == 0;
+}
+
+static void fe_set_int(secp256k1_fe_t *r, uint32_t value) {
+    memset(r, 0, sizeof(*r));
+    r->v[0] = value;
+}
+
+// a >= b
+static bool RAM_FUNC(fe_geq)(const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    for (int i = 7; i >= 0; i--) {
+        if (a->v[i] != b->v[i]) {
+            return a->v[i] > b->v[i];
+        }
+    }
+    return true;
+}
+
+// r = a - b over 256 bits, returning the borrow
+static uint32_t RAM_FUNC(fe_sub_raw)(secp256k1_fe_t *r, const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    int64_t borrow = 0;
+    for (int i = 0; i < 8; i++) {
+        int64_t d = (int64_t)a->v[i] - b->v[i] + borrow;
+        r->v[i] = (uint32_t)d;
+        borrow = d >> 32;
+    }
+    return (uint32_t)(borrow & 1);
+}
+
+static void fe_from_bytes(secp256k1_fe_t *r, const uint8_t in[32]) {
+    for (int i = 0; i < 8; i++) {
+        const uint8_t *b = in + 28 - i * 4;
+        r->v[i] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+    }
+}
+
+static void fe_to_bytes(uint8_t out[32], const secp256k1_fe_t *a) {
+    for (int i = 0; i < 8; i++) {
+        uint8_t *b = out + 28 - i * 4;
+        b[0] = (uint8_t)(a->v[i] >> 24);
+        b[1] = (uint8_t)(a->v[i] >> 16);
+        b[2] = (uint8_t)(a->v[i] >> 8);
+        b[3] = (uint8_t)a->v[i];
+    }
+}
+
+static void RAM_FUNC(fe_add)(secp256k1_fe_t *r, const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    uint64_t carry = 0;
+    for (int i = 0; i < 8; i++) {
+        carry += (uint64_t)a->v[i] + b->v[i];
+        r->v[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry || fe_geq(r, &fe_p)) {
+        fe_sub_raw(r, r, &fe_p);
+    }
+}
+
+static void RAM_FUNC(fe_sub)(secp256k1_fe_t *r, const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    if (fe_sub_raw(r, a, b)) {
+        // Went negative: add p back (the carry out cancels the borrow)
+        uint64_t carry = 0;
+        for (int i = 0; i < 8; i++) {
+            carry += (uint64_t)r->v[i] + fe_p.v[i];
+            r->v[i] = (uint32_t)carry;
+            carry >>= 32;
+        }
+    }
+}
+
+static void RAM_FUNC(fe_mul)(secp256k1_fe_t *r, const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    uint32_t t[16] = {0};
+
+    // Schoolbook 256x256 -> 512
+    for (int i = 0; i < 8; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < 8; j++) {
+            carry += (uint64_t)a->v[i] * b->v[j] + t[i + j];
+            t[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        t[i + 8] = (uint32_t)carry;
+    }
+
+    // Fold the high half: hi * 2^256 = hi * (2^32 + 977) mod p
+    uint32_t u[8];
+    uint64_t carry = 0;
+    for (int i = 0; i < 8; i++) {
+        carry += (uint64_t)t[i] + (uint64_t)t[8 + i] * FE_REDUCE_LOW;
+        if (i > 0) {
+            carry += t[8 + i - 1];
+        }
+        u[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    uint64_t top = carry + t[15];   // Weight 2^256, at most ~2^33
+
+    // Fold again, then once more for a possible final carry
+    carry = (uint64_t)u[0] + top * FE_REDUCE_LOW;
+    r->v[0] = (uint32_t)carry;
+    carry >>= 32;
+    carry += (uint64_t)u[1] + top;
+    r->v[1] = (uint32_t)carry;
+    carry >>= 32;
+    for (int i = 2; i < 8; i++) {
+        carry += u[i];
+        r->v[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry) {
+        carry = (uint64_t)r->v[0] + FE_REDUCE_LOW;
+        r->v[0] = (uint32_t)carry;
+        carry >>= 32;
+        carry += (uint64_t)r->v[1] + 1;
+        r->v[1] = (uint32_t)carry;
+        carry >>= 32;
+        for (int i = 2; i < 8 && carry; i++) {
+            carry += r->v[i];
+            r->v[i] = (uint32_t)carry;
+            carry >>= 32;
+        }
+    }
+
+    if (fe_geq(r, &fe_p)) {
+        fe_sub_raw(r, r, &fe_p);
+    }
+}
+
+static void RAM_FUNC(fe_sqr)(secp256k1_fe_t *r, const secp256k1_fe_t *a) {
+    fe_mul(r, a, a);
+}
+
+static void fe_pow(secp256k1_fe_t *r, const secp256k1_fe_t *a, const uint8_t exponent[32]) {
+    secp256k1_fe_t result;
+    fe_set_int(&result, 1);
+
+    for (int i = 0; i < 32; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            fe_sqr(&result, &result);
+            if ((exponent[i] >> bit) & 1) {
+                fe_mul(&result, &result, a);
+            }
+        }
+    }
+    *r = result;
+}
+
+static void fe_inv(secp256k1_fe_t *r, const secp256k1_fe_t *a) {
+    fe_pow(r, a, exp_p_minus_2);
+}
+
+// Returns false if a has no square root
+static bool fe_sqrt(secp256k1_fe_t *r, const secp256k1_fe_t *a) {
+    secp256k1_fe_t root, check;
+    fe_pow(&root, a, exp_sqrt);
+    fe_sqr(&check, &root);
+    if (!fe_equal(&check, a)) {
+        return false;
+    }
+    *r = root;
+    return true;
+}
+
+// y^2 = x^3 + 7
+static bool fe_curve_y(secp256k1_fe_t *y, const secp256k1_fe_t *x) {
+    secp256k1_fe_t rhs, seven;
+    fe_sqr(&rhs, x);
+    fe_mul(&rhs, &rhs, x);
+    fe_set_int(&seven, 7);
+    fe_add(&rhs, &rhs, &seven);
+    return fe_sqrt(y, &rhs);
+}
+
+// Group arithmetic (Jacobian, a = 0)
+
+static void jacobian_from_affine(secp256k1_jacobian_t *r, const secp256k1_point_t *p) {
+    r->x = p->x;
+    r->y = p->y;
+    fe_set_int(&r->z, 1);
+    r->infinity = p->infinity;
+}
+
+static void jacobian_to_affine(secp256k1_point_t *r, const secp256k1_jacobian_t *p) {
+    if (p->infinity) {
+        memset(r, 0, sizeof(*r));
+        r->infinity = true;
+        return;
+    }
+
+    secp256k1_fe_t zinv, zinv2, zinv3;
+    fe_inv(&zinv, &p->z);
+    fe_sqr(&zinv2, &zinv);
+    fe_mul(&zinv3, &zinv2, &zinv);
+    fe_mul(&r->x, &p->x, &zinv2);
+    fe_mul(&r->y, &p->y, &zinv3);
+    r->infinity = false;
+}
+
+static void RAM_FUNC(jacobian_double)(secp256k1_jacobian_t *r, const secp256k1_jacobian_t *p) {
+    if (p->infinity || fe_is_zero(&p->y)) {
+        r->infinity = true;
+        return;
+    }
+
+    secp256k1_fe_t a, b, c, d, e, f, t;
+    fe_sqr(&a, &p->x);              // A = X^2
+    fe_sqr(&b, &p->y);              // B = Y^2
+    fe_sqr(&c, &b);                 // C = B^2
+    fe_add(&t, &p->x, &b);
+    fe_sqr(&t, &t);
+    fe_sub(&t, &t, &a);
+    fe_sub(&t, &t, &c);
+    fe_add(&d, &t, &t);             // D = 2((X + B)^2 - A - C)
+    fe_add(&e, &a, &a);
+    fe_add(&e, &e, &a);             // E = 3A
+    fe_sqr(&f, &e);                 // F = E^2
+
+    secp256k1_fe_t x3, y3, z3;
+    fe_sub(&x3, &f, &d);
+    fe_sub(&x3, &x3, &d);           // X3 = F - 2D
+    fe_sub(&t, &d, &x3);
+    fe_mul(&y3, &e, &t);
+    fe_add(&c, &c, &c);
+    fe_add(&c, &c, &c);
+    fe_add(&c, &c, &c);
+    fe_sub(&y3, &y3, &c);           // Y3 = E(D - X3) - 8C
+    fe_mul(&z3, &p->y, &p->z);
+    fe_add(&z3, &z3, &z3);          // Z3 = 2YZ
+
+    r->x = x3;
+    r->y = y3;
+    r->z = z3;
+    r->infinity = false;
+}
+
+// r = p + q with q affine
+static void RAM_FUNC(jacobian_add_affine)(secp256k1_jacobian_t *r, const secp256k1_jacobian_t *p, const secp256k1_point_t *q) {
+    if (q->infinity) {
+        *r = *p;
+        return;
+    }
+    if (p->infinity) {
+        jacobian_from_affine(r, q);
+        return;
+    }
+
+    secp256k1_fe_t z1z1, u2, s2, h, rr, t;
+    fe_sqr(&z1z1, &p->z);
+    fe_mul(&u2, &q->x, &z1z1);
+    fe_mul(&s2, &q->y, &p->z);
+    fe_mul(&s2, &s2, &z1z1);
+    fe_sub(&h, &u2, &p->x);
+    fe_sub(&rr, &s2, &p->y);
+
+    if (fe_is_zero(&h)) {
+        if (fe_is_zero(&rr)) {
+            jacobian_double(r, p);
+        } else {
+            r->infinity = true;
+        }
+        return;
+    }
+
+    secp256k1_fe_t hh, hhh, v, x3, y3, z3;
+    fe_sqr(&hh, &h);
+    fe_mul(&hhh, &h, &hh);
+    fe_mul(&v, &p->x, &hh);
+    fe_sqr(&x3, &rr);
+    fe_sub(&x3, &x3, &hhh);
+    fe_sub(&x3, &x3, &v);
+    fe_sub(&x3, &x3, &v);           // X3 = r^2 - H^3 - 2V
+    fe_sub(&t, &v, &x3);
+    fe_mul(&y3, &rr, &t);
+    fe_mul(&t, &p->y, &hhh);
+    fe_sub(&y3, &y3, &t);           // Y3 = r(V - X3) - Y1 H^3
+    fe_mul(&z3, &p->z, &h);         // Z3 = Z1 H
+
+    r->x = x3;
+    r->y = y3;
+    r->z = z3;
+    r->infinity = false;
+}
+
+// Scalar arithmetic mod n, on the field element type
+
+static const secp256k1_fe_t scalar_n = {{
+    0xD0364141, 0xBFD25E8C, 0xAF48A03B, 0xBAAEDCE6, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF
+}};
+
+// 2^256 - n, 129 bits
+static const uint32_t scalar_c[5] = { 0x2FC9BEBF, 0x402DA173, 0x50B75FC4, 0x45512319, 0x00000001 };
+
+// r = t mod n for any 512-bit t (16 little-endian limbs, clobbered)
+static void scalar_reduce(secp256k1_fe_t *r, uint32_t t[16]) {
+    // Fold everything above 2^256 back in as high * (2^256 - n); each
+    // pass shrinks the excess by about 127 bits
+    for (;;) {
+        uint32_t high[8];
+        uint32_t any = 0;
+        for (int i = 0; i < 8; i++) {
+            high[i] = t[8 + i];
+            any |= high[i];
+            t[8 + i] = 0;
+        }
+        if (!any) {
+            break;
+        }
+
+        for (int i = 0; i < 8; i++) {
+            uint64_t carry = 0;
+            for (int j = 0; j < 5; j++) {
+                uint64_t v = (uint64_t)high[i] * scalar_c[j] + t[i + j] + carry;
+                t[i + j] = (uint32_t)v;
+                carry = v >> 32;
+            }
+            for (int k = i + 5; carry && k < 16; k++) {
+                uint64_t v = (uint64_t)t[k] + carry;
+                t[k] = (uint32_t)v;
+                carry = v >> 32;
+            }
+        }
+    }
+
+    memcpy(r->v, t, sizeof(r->v));
+    if (fe_geq(r, &scalar_n)) {
+        fe_sub_raw(r, r, &scalar_n);     // r < 2^256 < 2n, so once is enough
+    }
+}
+
+static void scalar_add(secp256k1_fe_t *r, const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    uint32_t t[16] = {0};
+    uint64_t carry = 0;
+    for (int i = 0; i < 8; i++) {
+        uint64_t v = (uint64_t)a->v[i] + b->v[i] + carry;
+        t[i] = (uint32_t)v;
+        carry = v >> 32;
+    }
+    t[8] = (uint32_t)carry;
+    scalar_reduce(r, t);
+}
+
+static void scalar_mul(secp256k1_fe_t *r, const secp256k1_fe_t *a, const secp256k1_fe_t *b) {
+    uint32_t t[16] = {0};
+    for (int i = 0; i < 8; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < 8; j++) {
+            uint64_t v = (uint64_t)a->v[i] * b->v[j] + t[i + j] + carry;
+            t[i + j] = (uint32_t)v;
+            carry = v >> 32;
+        }
+        t[i + 8] = (uint32_t)carry;
+    }
+    scalar_reduce(r, t);
+}
+
+// r = a^(n - 2) = a^-1 for a != 0 (Fermat)
+static void scalar_inv(secp256k1_fe_t *r, const secp256k1_fe_t *a) {
+    secp256k1_fe_t exponent, acc;
+    fe_set_int(&acc, 2);
+    fe_sub_raw(&exponent, &scalar_n, &acc);
+    fe_set_int(&acc, 1);
+
+    for (int i = 255; i >= 0; i--) {
+        scalar_mul(&acc, &acc, &acc);
+        if ((exponent.v[i / 32] >> (i % 32)) & 1) {
+            scalar_mul(&acc, &acc, a);
+        }
+    }
+    *r = acc;
+}
+
+// a G + b Q in one double-and-add pass (Shamir's trick): half the
+// doublings of two separate multiplications and one affine conversion
+static void point_mul_base_add(const uint8_t a[32], const secp256k1_point_t *q, const uint8_t b[32],
+                               secp256k1_point_t *out) {
+    secp256k1_point_t sum;
+    secp256k1_point_add(&generator, q, &sum);
+    const secp256k1_point_t *table[4] = { NULL, &generator, q, &sum };
+
+    secp256k1_jacobian_t acc;
+    acc.infinity = true;
+    for (int i = 0; i < 32; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            jacobian_double(&acc, &acc);
+            int select = ((a[i] >> bit) & 1) | ((b[i] >> bit) & 1) << 1;
+            if (select) {
+                jacobian_add_affine(&acc, &acc, table[select]);
+            }
+        }
+    }
+
+    jacobian_to_affine(out, &acc);
+}
+
+// Any 32-byte big-endian value, reduced mod n
+static void scalar_from_bytes(secp256k1_fe_t *r, const uint8_t in[32]) {
+    uint32_t t[16] = {0};
+    fe_from_bytes(r, in);
+    memcpy(t, r->v, sizeof(r->v));
+    scalar_reduce(r, t);
+}
+
+// Public API
+
+bool secp256k1_scalar_is_valid(const uint8_t scalar[32]) {
+    bool nonzero = false;
+    for (int i = 0; i < 32; i++) {
+        nonzero |= scalar[i] != 0;
+    }
+    return nonzero && memcmp(scalar, group_order, 32) < 0;
+}
+
+bool secp256k1_pubkey_parse(const uint8_t pubkey[33], secp256k1_point_t *point) {
+    if (pubkey[0] != 0x02 && pubkey[0] != 0x03) {
+        return false;
+    }
+
+    fe_from_bytes(&point->x, pubkey + 1);
+    if (fe_geq(&point->x, &fe_p) || !fe_curve_y(&point->y, &point->x)) {
+        return false;
+    }
+
+    // Pick the root with the requested parity
+    if ((point->y.v[0] & 1) != (pubkey[0] & 1)) {
+        secp256k1_fe_t zero;
+        fe_set_int(&zero, 0);
+        fe_sub(&point->y, &zero, &point->y);
+    }
+    point->infinity = false;
+    return true;
+}
+
+void secp256k1_pubkey_serialize(const secp256k1_point_t *point, uint8_t pubkey[33]) {
+    pubkey[0] = (point->y.v[0] & 1) ? 0x03 : 0x02;
+    fe_to_bytes(pubkey + 1, &point->x);
+}
+
+bool secp256k1_lift_x(const uint8_t x[32], secp256k1_point_t *point) {
+    uint8_t compressed[33];
+    compressed[0] = 0x02;
+    memcpy(compressed + 1, x, 32);
+    return secp256k1_pubkey_parse(compressed, point);
+}
+
+void secp256k1_point_add(const secp256k1_point_t *a, const secp256k1_point_t *b, secp256k1_point_t *out) {
+    secp256k1_jacobian_t acc;
+    jacobian_from_affine(&acc, a);
+    jacobian_add_affine(&acc, &acc, b);
+    jacobian_to_affine(out, &acc);
+}
+
+void secp256k1_point_mul(const secp256k1_point_t *point, const uint8_t scalar[32], secp256k1_point_t *out) {
+    secp256k1_jacobian_t acc;
+    acc.infinity = true;
+
+    // Plain double-and-add, most significant bit first
+    for (int i = 0; i < 32; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            jacobian_double(&acc, &acc);
+            if ((scalar[i] >> bit) & 1) {
+                jacobian_add_affine(&acc, &acc, point);
+            }
+        }
+    }
+
+    jacobian_to_affine(out, &acc);
+}
+
+void secp256k1_mul_base(const uint8_t scalar[32], secp256k1_point_t *out) {
+    secp256k1_point_mul(&generator, scalar, out);
+}
+
+bool secp256k1_xonly_tweak_add(const uint8_t internal_x[32], const uint8_t tweak[32],
+                               uint8_t output_x[32], bool *output_odd) {
+    secp256k1_point_t internal, tweak_point, output;
+
+    if (!secp256k1_lift_x(internal_x, &internal) || !secp256k1_scalar_is_valid(tweak)) {
+        return false;
+    }
+
+    secp256k1_mul_base(tweak, &tweak_point);
+    secp256k1_point_add(&internal, &tweak_point, &output);
+    if (output.infinity) {
+        return false;
+    }
+
+    fe_to_bytes(output_x, &output.x);
+    if (output_odd) {
+        *output_odd = output.y.v[0] & 1;
+    }
+    return true;
+}
+
+bool secp256k1_ecdsa_verify(const uint8_t pubkey[33], const uint8_t hash[32], const uint8_t signature[64]) {
+    secp256k1_point_t q, sum;
+    if (!secp256k1_pubkey_parse(pubkey, &q) ||
+        !secp256k1_scalar_is_valid(signature) || !secp256k1_scalar_is_valid(signature + 32)) {
+        return false;
+    }
+
+    // R = (z / s) G + (r / s) Q, valid if R.x = r mod n
+    secp256k1_fe_t z, r, s, w, u1, u2, rx;
+    scalar_from_bytes(&z, hash);
+    fe_from_bytes(&r, signature);
+    fe_from_bytes(&s, signature + 32);
+    scalar_inv(&w, &s);
+    scalar_mul(&u1, &z, &w);
+    scalar_mul(&u2, &r, &w);
+
+    uint8_t u1_bytes[32], u2_bytes[32];
+    fe_to_bytes(u1_bytes, &u1);
+    fe_to_bytes(u2_bytes, &u2);
+    point_mul_base_add(u1_bytes, &q, u2_bytes, &sum);
+    if (sum.infinity) {
+        return false;
+    }
+
+    uint8_t x_bytes[32];
+    fe_to_bytes(x_bytes, &sum.x);
+    scalar_from_bytes(&rx, x_bytes);
+    return fe_equal(&rx, &r);
+}
+
+bool secp256k1_ecdsa_sign(const uint8_t private_key[32], const uint8_t hash[32], const uint8_t nonce[32],
+                          uint8_t signature[64]) {
+    if (!secp256k1_scalar_is_valid(private_key) || !secp256k1_scalar_is_valid(nonce)) {
+        return false;
+    }
+
+    // r = (kG).x mod n, s = (z + r d) / k, normalised to the low half
+    secp256k1_point_t point;
+    secp256k1_fe_t z, d, k, r, s, t;
+    uint8_t x_bytes[32];
+    secp256k1_mul_base(nonce, &point);
+    fe_to_bytes(x_bytes, &point.x);
+    scalar_from_bytes(&r, x_bytes);
+    scalar_from_bytes(&z, hash);
+    fe_from_bytes(&d, private_key);
+    fe_from_bytes(&k, nonce);
+
+    scalar_mul(&t, &r, &d);
+    scalar_add(&t, &t, &z);
+    scalar_inv(&k, &k);
+    scalar_mul(&s, &t, &k);
+    if (fe_is_zero(&r) || fe_is_zero(&s)) {
+        return false;
+    }
+
+    secp256k1_fe_t half_n;
+    for (int i = 0; i < 8; i++) {
+        half_n.v[i] = (scalar_n.v[i] >> 1) | (i < 7 ? scalar_n.v[i + 1] << 31 : 0);
+    }
+    if (!fe_geq(&half_n, &s)) {
+        fe_sub_raw(&s, &scalar_n, &s);
+    }
+
+    fe_to_bytes(signature, &r);
+    fe_to_bytes(signature + 32, &s);
+    return true;
+}
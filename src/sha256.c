@@ -0,0 +1,188 @@
+#include "sha256.h"
+#include "ram_functions.h"
+#include <string.h>
+
+static const uint32_t sha256_k[64] RAM_TABLE(sha256_k, sha256_transform) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void RAM_FUNC(sha256_transform)(uint32_t state[8], const uint8_t block[SHA256_BLOCK_SIZE]) {
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + sha256_k[i] + w[i];
+        uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void sha256_init(sha256_ctx_t *ctx) {
+    ctx->state[0] = 0x6a09e667;
+    ctx->state[1] = 0xbb67ae85;
+    ctx->state[2] = 0x3c6ef372;
+    ctx->state[3] = 0xa54ff53a;
+    ctx->state[4] = 0x510e527f;
+    ctx->state[5] = 0x9b05688c;
+    ctx->state[6] = 0x1f83d9ab;
+    ctx->state[7] = 0x5be0cd19;
+    ctx->total_len = 0;
+    ctx->buffer_len = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len) {
+    ctx->total_len += len;
+
+    // Top up a partial block first
+    if (ctx->buffer_len > 0) {
+        size_t take = SHA256_BLOCK_SIZE - ctx->buffer_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(ctx->buffer + ctx->buffer_len, data, take);
+        ctx->buffer_len += take;
+        data += take;
+        len -= take;
+
+        if (ctx->buffer_len < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        sha256_transform(ctx->state, ctx->buffer);
+        ctx->buffer_len = 0;
+    }
+
+    // Whole blocks straight from the caller's buffer
+    while (len >= SHA256_BLOCK_SIZE) {
+        sha256_transform(ctx->state, data);
+        data += SHA256_BLOCK_SIZE;
+        len -= SHA256_BLOCK_SIZE;
+    }
+
+    if (len > 0) {
+        memcpy(ctx->buffer, data, len);
+        ctx->buffer_len = len;
+    }
+}
+
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bit_len = ctx->total_len * 8;
+
+    // Padding: 0x80, zeros, then the 64-bit big-endian message length
+    ctx->buffer[ctx->buffer_len++] = 0x80;
+    if (ctx->buffer_len > SHA256_BLOCK_SIZE - 8) {
+        memset(ctx->buffer + ctx->buffer_len, 0, SHA256_BLOCK_SIZE - ctx->buffer_len);
+        sha256_transform(ctx->state, ctx->buffer);
+        ctx->buffer_len = 0;
+    }
+    memset(ctx->buffer + ctx->buffer_len, 0, SHA256_BLOCK_SIZE - 8 - ctx->buffer_len);
+    for (int i = 0; i < 8; i++) {
+        ctx->buffer[SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(bit_len >> (8 * i));
+    }
+    sha256_transform(ctx->state, ctx->buffer);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+void sha256(const uint8_t *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, digest);
+}
+
+void sha256d(const uint8_t *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint8_t first[SHA256_DIGEST_SIZE];
+    sha256(data, len, first);
+    sha256(first, sizeof(first), digest);
+}
+
+void hmac_sha256_init(hmac_sha256_ctx_t *ctx, const uint8_t *key, size_t key_len) {
+    uint8_t block[SHA256_BLOCK_SIZE] = {0};
+
+    // Keys longer than a block are hashed down first
+    if (key_len > SHA256_BLOCK_SIZE) {
+        sha256(key, key_len, block);
+    } else if (key_len > 0) {
+        memcpy(block, key, key_len);
+    }
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        block[i] ^= 0x36;
+    }
+    sha256_init(&ctx->inner);
+    sha256_update(&ctx->inner, block, SHA256_BLOCK_SIZE);
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        block[i] ^= 0x36 ^ 0x5c;
+    }
+    sha256_init(&ctx->outer);
+    sha256_update(&ctx->outer, block, SHA256_BLOCK_SIZE);
+
+    memset(block, 0, sizeof(block));
+}
+
+void hmac_sha256_update(hmac_sha256_ctx_t *ctx, const uint8_t *data, size_t len) {
+    sha256_update(&ctx->inner, data, len);
+}
+
+void hmac_sha256_final(hmac_sha256_ctx_t *ctx, uint8_t mac[SHA256_DIGEST_SIZE]) {
+    uint8_t inner_digest[SHA256_DIGEST_SIZE];
+    sha256_final(&ctx->inner, inner_digest);
+    sha256_update(&ctx->outer, inner_digest, sizeof(inner_digest));
+    sha256_final(&ctx->outer, mac);
+}
+
+void hmac_sha256(const uint8_t *key, size_t key_len, const uint8_t *data, size_t len,
+                 uint8_t mac[SHA256_DIGEST_SIZE]) {
+    hmac_sha256_ctx_t ctx;
+    hmac_sha256_init(&ctx, key, key_len);
+    hmac_sha256_update(&ctx, data, len);
+    hmac_sha256_final(&ctx, mac);
+}
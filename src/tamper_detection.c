@@ -1,18 +1,30 @@
 #include "cashstick.h"
+#include "flash_layout.h"
 
 // Tamper detection state
 static tamper_status_t tamper_state = {0};
-static uint32_t tamper_check_pin = 17;  // Example tamper detect pin
+static bool tamper_checked = false;     // A verdict has been journaled this boot
+
+// Lifetime tamper event count, persisted across power cycles
+static const flash_counter_t tamper_counter = {
+    { TAMPER_COUNTER_A_SECTOR_OFFSET, TAMPER_COUNTER_B_SECTOR_OFFSET }
+};
+
+// Internal functions
+static bool se050_check_tamper_status(void);
+static bool verify_cryptographic_seal(void);
+static bool create_cryptographic_seal(void);
+static bool tamper_seal_present(const uint8_t *seal);
+static void tamper_seal_context(uint8_t context[SHA256_DIGEST_SIZE]);
 
 bool tamper_init(void) {
     // Initialize tamper detection circuitry
-    gpio_init(tamper_check_pin);
-    gpio_set_dir(tamper_check_pin, GPIO_IN);
-    gpio_pull_up(tamper_check_pin);
+    board_tamper_init();
     
     // Initialize tamper status from flash or SE050
     tamper_state.is_intact = true;
-    tamper_state.tamper_count = 0;
+    flash_counter_init(&tamper_counter);
+    tamper_state.tamper_count = flash_counter_read(&tamper_counter);
     tamper_state.last_check_time = get_system_time_ms();
     
     // Configure SE050 tamper detection
@@ -29,10 +41,12 @@ tamper_status_t tamper_check_integrity(void) {
     printf("TAMPER: Running integrity check\n");
     
     // Update check time
+    bool was_intact = tamper_state.is_intact;
     tamper_state.last_check_time = get_system_time_ms();
+    uint32_t start = metrics_start();
     
     // Method 1: Check physical tamper detection circuit
-    bool circuit_intact = gpio_get(tamper_check_pin);
+    bool circuit_intact = board_tamper_loop_high();
     
     // Method 2: Check SE050 tamper registers
     bool se050_intact = se050_check_tamper_status();
@@ -42,13 +56,28 @@ tamper_status_t tamper_check_integrity(void) {
     
     // Device is intact only if all checks pass
     tamper_state.is_intact = circuit_intact && se050_intact && crypto_intact;
+    metrics_end(METRIC_TAMPER_CHECK, start, tamper_state.is_intact);
+
+    // STATUS, TAMPER and ATTEST run this check on every poll, so only the
+    // first verdict of a boot and each change are journaled; a verdict per
+    // poll would soon reclaim the custody history
+    if (!tamper_checked || tamper_state.is_intact != was_intact) {
+        journal_append(JOURNAL_EVENT_TAMPER_CHECK, tamper_state.is_intact ? 1 : 0);
+        tamper_checked = true;
+    }
     
     if (!tamper_state.is_intact) {
-        tamper_state.tamper_count++;
-        printf("TAMPER: Seal broken! Revealing keys for owner - Count: %d\n", tamper_state.tamper_count);
-        
         // Reveal keys in filesystem for owner to sweep
+        bool was_sealed = device_state_get() == DEVICE_STATE_SEALED;
         tamper_reveal_keys_to_filesystem();
+        
+        // Counted once, when the break takes the device out of SEALED:
+        // polls of a broken stick must not program flash each time
+        if (was_sealed && device_state_get() == DEVICE_STATE_COMPROMISED) {
+            flash_counter_increment(&tamper_counter);
+            tamper_state.tamper_count = flash_counter_read(&tamper_counter);
+        }
+        printf("TAMPER: Seal broken! Keys revealed for owner - Count: %d\n", tamper_state.tamper_count);
     } else {
         printf("TAMPER: Device integrity verified - keys remain sealed\n");
     }
@@ -56,23 +85,31 @@ tamper_status_t tamper_check_integrity(void) {
     return tamper_state;
 }
 
-void tamper_seal_device(void) {
+bool tamper_seal_device(void) {
     printf("TAMPER: Sealing device\n");
     
-    // Create cryptographic seal using SE050
+    // Create cryptographic seal using SE050. It is staged, not written: the
+    // caller commits it together with the wallet keys and the SEALED state.
     if (create_cryptographic_seal()) {
         tamper_state.is_intact = true;
-        tamper_state.tamper_count = 0;
-        
-        // Update device state to sealed
-        flash_write_device_state(DEVICE_STATE_SEALED);
         
         printf("TAMPER: Device sealed successfully\n");
         led_set_state(LED_STATE_SEALED);
-    } else {
-        printf("TAMPER: Sealing failed\n");
-        led_set_state(LED_STATE_UNSEALED);
+        return true;
     }
+    
+    printf("TAMPER: Sealing failed\n");
+    led_set_state(LED_STATE_UNSEALED);
+    return false;
+}
+
+// The checks of tamper_check_integrity() without its consequences: a
+// failure here is not counted and reveals nothing. Used to verify a seal
+// right after it was made.
+bool tamper_self_test(void) {
+    return board_tamper_loop_high() &&
+           se050_check_tamper_status() &&
+           verify_cryptographic_seal();
 }
 
 bool tamper_is_device_compromised(void) {
@@ -81,39 +118,34 @@ bool tamper_is_device_compromised(void) {
 
 // Internal helper functions
 
-bool se050_check_tamper_status(void) {
+static bool se050_check_tamper_status(void) {
     // Query SE050 tamper status registers
-    uint8_t tamper_query[] = {0x80, 0x06, 0x00, 0x00};
+    const uint8_t tamper_query[4] = {0x80, SE050_CMD_GET_TAMPER_STATUS, 0x00, 0x00};
     
-    int result = i2c_write_blocking(i2c1, SE050_I2C_ADDR, tamper_query, sizeof(tamper_query), false);
-    if (result < 0) {
-        return false;
-    }
-    
-    delay_ms(10);
-    
-    result = i2c_read_blocking(i2c1, SE050_I2C_ADDR, rx_buffer, 8, false);
-    if (result > 0) {
+    uint8_t status[8];
+    if (se050_command(tamper_query, NULL, 0, status, sizeof(status), 10)) {
         // Check tamper status byte (simplified)
-        return (rx_buffer[1] & 0x01) == 0;  // Bit 0 = tamper detected
+        return (status[0] & 0x01) == 0;  // Bit 0 = tamper detected
     }
     
     return false;
 }
 
-bool verify_cryptographic_seal(void) {
+static bool verify_cryptographic_seal(void) {
     // Verify that the cryptographic seal is intact
     // This involves checking a signature or HMAC stored during sealing
     
-    uint8_t seal_data[32];
-    if (!flash_read_seal_data(seal_data, sizeof(seal_data))) {
+    const uint8_t *seal_data = device_state_seal();
+    if (!tamper_seal_present(seal_data)) {
         printf("TAMPER: No seal data found\n");
         return false;
     }
     
     // Verify seal using SE050 cryptographic operations
+    uint8_t context[SHA256_DIGEST_SIZE];
     uint8_t expected_seal[32];
-    if (!se050_compute_seal_verification(expected_seal)) {
+    tamper_seal_context(context);
+    if (!se050_compute_seal(context, expected_seal)) {
         return false;
     }
     
@@ -121,48 +153,59 @@ bool verify_cryptographic_seal(void) {
     return memcmp(seal_data, expected_seal, 32) == 0;
 }
 
-bool create_cryptographic_seal(void) {
+static bool create_cryptographic_seal(void) {
     // Create tamper-evident cryptographic seal
     uint8_t seal_data[32];
     
     // Generate seal using device-specific data + SE050 crypto
-    if (!se050_generate_device_seal(seal_data)) {
+    uint8_t context[SHA256_DIGEST_SIZE];
+    tamper_seal_context(context);
+    if (!se050_compute_seal(context, seal_data)) {
         return false;
     }
     
-    // Store seal in flash
-    return flash_write_seal_data(seal_data, sizeof(seal_data));
+    // Stored with the next device record commit
+    device_state_stage_seal(seal_data);
+    return true;
+}
+
+static bool tamper_seal_present(const uint8_t *seal) {
+    uint8_t any = 0;
+    for (int i = 0; i < 32; i++) {
+        any |= seal[i];
+    }
+    return any != 0;
 }
 
 void tamper_reveal_keys_to_filesystem(void) {
     printf("TAMPER: Revealing Bitcoin keys to filesystem for owner\n");
     
-    // Load the stored keys
-    bitcoin_keys_t keys;
-    if (flash_read_keys(&keys)) {
-        // Mark keys as revealed
-        keys.keys_revealed = true;
-        flash_write_keys(&keys);
-        
+    // Marks the keys revealed and the device compromised in one commit;
+    // a device that is already compromised is not written again
+    device_state_dispatch(DEVICE_EVENT_TAMPER_DETECTED, NULL);
+    
+    const bitcoin_keys_t *keys = device_state_keys();
+    if (keys->keys_revealed) {
         // Create plaintext files with key data for owner to sweep
-        usb_create_key_reveal_files(&keys);
+        usb_create_key_reveal_files(keys);
         
         printf("TAMPER: Keys revealed - owner can now sweep Bitcoin\n");
     }
-    
-    // Set device state to compromised/revealed
-    flash_write_device_state(DEVICE_STATE_COMPROMISED);
 }
 
-// Flash storage helpers for seal data
-bool flash_write_seal_data(const uint8_t *seal_data, size_t len) {
-    // Write seal to a dedicated flash sector
-    // Implementation depends on flash layout
-    return true;  // Placeholder
+// Device-specific input to the seal MAC: the board ID and, when enabled,
+// the measured firmware image root
+static void tamper_seal_context(uint8_t context[SHA256_DIGEST_SIZE]) {
+    static const char seal_label[] = "CashStick seal";
+    pico_unique_board_id_t board_id;
+    pico_get_unique_board_id(&board_id);
+    
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, (const uint8_t*)seal_label, sizeof(seal_label) - 1);
+    sha256_update(&ctx, board_id.id, PICO_UNIQUE_BOARD_ID_SIZE_BYTES);
+#if CASHSTICK_SEAL_BIND_MEASUREMENT
+    sha256_update(&ctx, measured_boot_get()->image_root, SHA256_DIGEST_SIZE);
+#endif
+    sha256_final(&ctx, context);
 }
-
-bool flash_read_seal_data(uint8_t *seal_data, size_t len) {
-    // Read seal from flash
-    // Implementation depends on flash layout  
-    return true;  // Placeholder
-}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "tree_hash.h"
+#include <string.h>
+
+static const uint8_t tree_hash_leaf_prefix = 0x00;
+static const uint8_t tree_hash_node_prefix = 0x01;
+
+void tree_hash_leaf_init(sha256_ctx_t *ctx) {
+    sha256_init(ctx);
+    sha256_update(ctx, &tree_hash_leaf_prefix, 1);
+}
+
+void tree_hash_leaf(const uint8_t *chunk, size_t len, uint8_t out[SHA256_DIGEST_SIZE]) {
+    sha256_ctx_t ctx;
+    tree_hash_leaf_init(&ctx);
+    sha256_update(&ctx, chunk, len);
+    sha256_final(&ctx, out);
+}
+
+void tree_hash_node(const uint8_t left[SHA256_DIGEST_SIZE], const uint8_t right[SHA256_DIGEST_SIZE],
+                    uint8_t out[SHA256_DIGEST_SIZE]) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, &tree_hash_node_prefix, 1);
+    sha256_update(&ctx, left, SHA256_DIGEST_SIZE);
+    sha256_update(&ctx, right, SHA256_DIGEST_SIZE);
+    sha256_final(&ctx, out);
+}
+
+void tree_hash_builder_init(tree_hash_builder_t *builder) {
+    builder->depth = 0;
+    builder->leaves = 0;
+}
+
+void tree_hash_builder_add(tree_hash_builder_t *builder, const uint8_t leaf[SHA256_DIGEST_SIZE]) {
+    uint8_t node[SHA256_DIGEST_SIZE];
+    uint8_t height = 0;
+    memcpy(node, leaf, SHA256_DIGEST_SIZE);
+
+    // Two complete subtrees of the same height make one a level up
+    while (builder->depth > 0 && builder->height[builder->depth - 1] == height) {
+        builder->depth--;
+        tree_hash_node(builder->pending[builder->depth], node, node);
+        height++;
+    }
+
+    memcpy(builder->pending[builder->depth], node, SHA256_DIGEST_SIZE);
+    builder->height[builder->depth] = height;
+    builder->depth++;
+    builder->leaves++;
+}
+
+void tree_hash_builder_root(const tree_hash_builder_t *builder, uint8_t root[SHA256_DIGEST_SIZE]) {
+    if (builder->depth == 0) {
+        memset(root, 0, SHA256_DIGEST_SIZE);
+        return;
+    }
+
+    // What is left has strictly falling heights; join it right to left
+    uint8_t node[SHA256_DIGEST_SIZE];
+    memcpy(node, builder->pending[builder->depth - 1], SHA256_DIGEST_SIZE);
+    for (uint32_t i = builder->depth - 1; i > 0; i--) {
+        tree_hash_node(builder->pending[i - 1], node, node);
+    }
+    memcpy(root, node, SHA256_DIGEST_SIZE);
+}
+
+void tree_hash_root(const uint8_t (*leaves)[SHA256_DIGEST_SIZE], uint32_t count,
+                    uint8_t (*work)[SHA256_DIGEST_SIZE], uint8_t root[SHA256_DIGEST_SIZE]) {
+    if (count == 0) {
+        memset(root, 0, SHA256_DIGEST_SIZE);
+        return;
+    }
+
+    memcpy(work, leaves, count * SHA256_DIGEST_SIZE);
+
+    // Each level is written over the front of the one below it
+    while (count > 1) {
+        uint32_t next = 0;
+        for (uint32_t i = 0; i + 1 < count; i += 2) {
+            tree_hash_node(work[i], work[i + 1], work[next++]);
+        }
+        if (count & 1) {
+            memcpy(work[next++], work[count - 1], SHA256_DIGEST_SIZE);
+        }
+        count = next;
+    }
+
+    memcpy(root, work[0], SHA256_DIGEST_SIZE);
+}
+
+void tree_hash(const uint8_t *data, size_t len, size_t chunk_size, uint8_t root[SHA256_DIGEST_SIZE]) {
+    tree_hash_builder_t builder;
+    uint8_t leaf[SHA256_DIGEST_SIZE];
+
+    tree_hash_builder_init(&builder);
+    for (size_t offset = 0; offset < len; offset += chunk_size) {
+        size_t take = len - offset < chunk_size ? len - offset : chunk_size;
+        tree_hash_leaf(data + offset, take, leaf);
+        tree_hash_builder_add(&builder, leaf);
+    }
+    tree_hash_builder_root(&builder, root);
+}
@@ -0,0 +1,220 @@
+#include "uf2_stream.h"
+#include <string.h>
+
+static uint32_t uf2_get_u32(const uint8_t *p);
+static void uf2_put_u32(uint8_t *p, uint32_t v);
+static uf2_stream_result_t uf2_stream_fail(uf2_stream_t *stream, const char *error);
+static uf2_stream_result_t uf2_stream_signature(uf2_stream_t *stream, const uint8_t *payload);
+static uf2_stream_result_t uf2_stream_image(uf2_stream_t *stream, uint32_t offset, const uint8_t *payload);
+static bool uf2_stream_emit(uf2_stream_t *stream, const uint8_t *payload);
+static uf2_stream_result_t uf2_stream_progress(uf2_stream_t *stream);
+
+void uf2_stream_init(uf2_stream_t *stream) {
+    stream->signed_image = false;
+    stream->length = 0;
+    stream->num_blocks = 0;
+    stream->seen = 0;
+    stream->next = 0;
+    stream->held = 0;
+    stream->failed = false;
+    stream->reordered = 0;
+    stream->duplicates = 0;
+    stream->max_ahead = 0;
+    stream->error = NULL;
+    if (stream->window_size > UF2_STREAM_MAX_WINDOW) {
+        stream->window_size = UF2_STREAM_MAX_WINDOW;
+    }
+}
+
+bool uf2_is_block(const uint8_t block[UF2_BLOCK_SIZE]) {
+    return uf2_get_u32(block) == UF2_MAGIC_START0 &&
+           uf2_get_u32(block + 4) == UF2_MAGIC_START1 &&
+           uf2_get_u32(block + 508) == UF2_MAGIC_END;
+}
+
+uf2_stream_result_t uf2_stream_feed(uf2_stream_t *stream, const uint8_t block[UF2_BLOCK_SIZE]) {
+    if (!uf2_is_block(block)) {
+        return UF2_STREAM_NOT_UF2;
+    }
+    if (stream->failed) {
+        return UF2_STREAM_ERROR;
+    }
+
+    uint32_t flags = uf2_get_u32(block + 8);
+    uint32_t target = uf2_get_u32(block + 12);
+    uint32_t payload_size = uf2_get_u32(block + 16);
+    uint32_t block_no = uf2_get_u32(block + 20);
+    uint32_t num_blocks = uf2_get_u32(block + 24);
+    const uint8_t *payload = block + 32;
+
+    if (stream->num_blocks == 0) {
+        if (num_blocks < 2) {
+            return uf2_stream_fail(stream, "not a signed image");
+        }
+        stream->num_blocks = num_blocks;
+    } else if (num_blocks != stream->num_blocks) {
+        return uf2_stream_fail(stream, "blocks from another file");
+    }
+    if (block_no >= num_blocks) {
+        return uf2_stream_fail(stream, "bad block number");
+    }
+    if ((flags & UF2_FLAG_FAMILY_ID) && uf2_get_u32(block + 28) != UF2_FAMILY_RP2040) {
+        return uf2_stream_fail(stream, "not an RP2040 image");
+    }
+
+    if (flags & UF2_FLAG_NOT_MAIN_FLASH) {
+        if (uf2_get_u32(payload) != UF2_SIGNATURE_MAGIC) {
+            stream->seen++;     // Someone else's extra block
+            return uf2_stream_progress(stream);
+        }
+        return uf2_stream_signature(stream, payload);
+    }
+
+    if (payload_size != UF2_PAYLOAD_SIZE || target < stream->base ||
+        (target - stream->base) % UF2_PAYLOAD_SIZE != 0) {
+        return uf2_stream_fail(stream, "unaligned block");
+    }
+    return uf2_stream_image(stream, target - stream->base, payload);
+}
+
+void uf2_encode_block(uint32_t target, uint32_t flags, uint32_t block_no, uint32_t num_blocks,
+                      const uint8_t payload[UF2_PAYLOAD_SIZE], uint8_t block[UF2_BLOCK_SIZE]) {
+    memset(block, 0, UF2_BLOCK_SIZE);
+    uf2_put_u32(block, UF2_MAGIC_START0);
+    uf2_put_u32(block + 4, UF2_MAGIC_START1);
+    uf2_put_u32(block + 8, flags | UF2_FLAG_FAMILY_ID);
+    uf2_put_u32(block + 12, target);
+    uf2_put_u32(block + 16, UF2_PAYLOAD_SIZE);
+    uf2_put_u32(block + 20, block_no);
+    uf2_put_u32(block + 24, num_blocks);
+    uf2_put_u32(block + 28, UF2_FAMILY_RP2040);
+    memcpy(block + 32, payload, UF2_PAYLOAD_SIZE);
+    uf2_put_u32(block + 508, UF2_MAGIC_END);
+}
+
+// Internal helper functions
+
+static uint32_t uf2_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void uf2_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uf2_stream_result_t uf2_stream_fail(uf2_stream_t *stream, const char *error) {
+    stream->failed = true;
+    stream->error = error;
+    return UF2_STREAM_ERROR;
+}
+
+static uf2_stream_result_t uf2_stream_signature(uf2_stream_t *stream, const uint8_t *payload) {
+    uint32_t length = uf2_get_u32(payload + 4);
+
+    if (stream->signed_image) {
+        if (length != stream->length || memcmp(stream->signature, payload + 8, UF2_SIGNATURE_SIZE) != 0) {
+            return uf2_stream_fail(stream, "two signatures");
+        }
+        stream->duplicates++;
+        return UF2_STREAM_ACCEPTED;
+    }
+
+    // Image blocks already taken must all lie inside the signed length
+    if (length == 0 || length % UF2_PAYLOAD_SIZE != 0 || length > stream->max_len ||
+        length / UF2_PAYLOAD_SIZE + 1 != stream->num_blocks || stream->next > length) {
+        return uf2_stream_fail(stream, "signed length does not match the image");
+    }
+    uint32_t next_slot = stream->next / UF2_PAYLOAD_SIZE % (stream->window_size ? stream->window_size : 1);
+    for (uint32_t slot = 0; slot < stream->window_size; slot++) {
+        uint32_t ahead = (slot + stream->window_size - next_slot) % stream->window_size;
+        if (ahead == 0) {
+            ahead = stream->window_size;
+        }
+        if ((stream->held >> slot) & 1 && stream->next + ahead * UF2_PAYLOAD_SIZE >= length) {
+            return uf2_stream_fail(stream, "signed length does not match the image");
+        }
+    }
+
+    stream->signed_image = true;
+    stream->length = length;
+    memcpy(stream->signature, payload + 8, UF2_SIGNATURE_SIZE);
+    stream->seen++;
+    return uf2_stream_progress(stream);
+}
+
+static uf2_stream_result_t uf2_stream_image(uf2_stream_t *stream, uint32_t offset, const uint8_t *payload) {
+    uint32_t limit = stream->signed_image ? stream->length : stream->max_len;
+    if (offset >= limit) {
+        return uf2_stream_fail(stream, "block outside the image");
+    }
+
+    // Already hashed and programmed: a rewrite of the same sector
+    if (offset < stream->next) {
+        stream->duplicates++;
+        return UF2_STREAM_ACCEPTED;
+    }
+
+    uint32_t ahead = (offset - stream->next) / UF2_PAYLOAD_SIZE;
+    if (ahead > stream->max_ahead) {
+        stream->max_ahead = ahead;
+    }
+
+    if (ahead == 0) {
+        if (!uf2_stream_emit(stream, payload)) {
+            return uf2_stream_fail(stream, "image write failed");
+        }
+        stream->seen++;
+
+        // Whatever was waiting behind it follows
+        while (stream->held != 0) {
+            uint32_t slot = stream->next / UF2_PAYLOAD_SIZE % stream->window_size;
+            if (!((stream->held >> slot) & 1)) {
+                break;
+            }
+            stream->held &= ~(1u << slot);
+            if (!uf2_stream_emit(stream, stream->window[slot])) {
+                return uf2_stream_fail(stream, "image write failed");
+            }
+        }
+        return uf2_stream_progress(stream);
+    }
+
+    // The window holds the window_size blocks after next, one slot each
+    if (ahead > stream->window_size) {
+        return uf2_stream_fail(stream, "block too far out of order");
+    }
+    uint32_t slot = offset / UF2_PAYLOAD_SIZE % stream->window_size;
+    if ((stream->held >> slot) & 1) {
+        stream->duplicates++;
+        return UF2_STREAM_ACCEPTED;
+    }
+    memcpy(stream->window[slot], payload, UF2_PAYLOAD_SIZE);
+    stream->held |= 1u << slot;
+    stream->reordered++;
+    stream->seen++;
+    return uf2_stream_progress(stream);
+}
+
+static bool uf2_stream_emit(uf2_stream_t *stream, const uint8_t *payload) {
+    if (!stream->output(stream->user, payload, UF2_PAYLOAD_SIZE)) {
+        return false;
+    }
+    stream->next += UF2_PAYLOAD_SIZE;
+    return true;
+}
+
+static uf2_stream_result_t uf2_stream_progress(uf2_stream_t *stream) {
+    if (stream->seen < stream->num_blocks) {
+        return UF2_STREAM_ACCEPTED;
+    }
+    if (!stream->signed_image) {
+        return uf2_stream_fail(stream, "not a signed image");
+    }
+    if (stream->next != stream->length || stream->held != 0) {
+        return uf2_stream_fail(stream, "image incomplete");
+    }
+    return UF2_STREAM_COMPLETE;
+}
@@ -0,0 +1,140 @@
+#include "cashstick.h"
+#include "tusb.h"
+
+// USB identity
+#define USB_VID 0x2E8A          // Raspberry Pi
+#define USB_PID 0x10CA          // CashStick composite
+#define USB_BCD 0x0200
+
+// Interface numbers
+enum {
+    ITF_NUM_CDC = 0,
+    ITF_NUM_CDC_DATA,
+    ITF_NUM_MSC,
+#if CASHSTICK_USB_HID
+    ITF_NUM_HID,
+#endif
+    ITF_NUM_TOTAL
+};
+
+// Endpoint addresses
+#define EP_CDC_NOTIF    0x81
+#define EP_CDC_OUT      0x02
+#define EP_CDC_IN       0x82
+#define EP_MSC_OUT      0x03
+#define EP_MSC_IN       0x83
+#define EP_HID_OUT      0x04
+#define EP_HID_IN       0x84
+
+// String descriptor indices
+enum {
+    STRID_LANGID = 0,
+    STRID_MANUFACTURER,
+    STRID_PRODUCT,
+    STRID_SERIAL,
+    STRID_CDC,
+    STRID_MSC,
+    STRID_HID
+};
+
+static const tusb_desc_device_t device_descriptor = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = USB_BCD,
+
+    // Interface association descriptors require the MISC/IAD triple
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = USB_VID,
+    .idProduct = USB_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = STRID_MANUFACTURER,
+    .iProduct = STRID_PRODUCT,
+    .iSerialNumber = STRID_SERIAL,
+    .bNumConfigurations = 1
+};
+
+#if CASHSTICK_USB_HID
+static const uint8_t hid_report_descriptor[] = {
+    TUD_HID_REPORT_DESC_GENERIC_INOUT(CFG_TUD_HID_EP_BUFSIZE)
+};
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_MSC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#else
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_MSC_DESC_LEN)
+#endif
+
+static const uint8_t configuration_descriptor[] = {
+    // Bus powered, 100 mA is ample (<50 mA typical)
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
+
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC, EP_CDC_NOTIF, 8, EP_CDC_OUT, EP_CDC_IN, 64),
+    TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, STRID_MSC, EP_MSC_OUT, EP_MSC_IN, 64),
+#if CASHSTICK_USB_HID
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, STRID_HID, HID_ITF_PROTOCOL_NONE, sizeof(hid_report_descriptor),
+                             EP_HID_OUT, EP_HID_IN, CFG_TUD_HID_EP_BUFSIZE, 10),
+#endif
+};
+
+static const char *string_descriptors[] = {
+    [STRID_MANUFACTURER] = "CashStick",
+    [STRID_PRODUCT] = "CashStick Bitcoin Bearer Device",
+    [STRID_SERIAL] = NULL,  // Filled from the RP2040 unique ID
+    [STRID_CDC] = "CashStick Commands",
+    [STRID_MSC] = "CashStick Drive",
+    [STRID_HID] = "CashStick Tooling",
+};
+
+static uint16_t string_buffer[33];
+
+const uint8_t *tud_descriptor_device_cb(void) {
+    return (const uint8_t *)&device_descriptor;
+}
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index) {
+    (void)index;
+    return configuration_descriptor;
+}
+
+#if CASHSTICK_USB_HID
+const uint8_t *tud_hid_descriptor_report_cb(uint8_t instance) {
+    (void)instance;
+    return hid_report_descriptor;
+}
+#endif
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    (void)langid;
+    uint8_t char_count;
+
+    if (index == STRID_LANGID) {
+        string_buffer[1] = 0x0409;  // English (US)
+        char_count = 1;
+    } else {
+        char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+        const char *str;
+
+        if (index == STRID_SERIAL) {
+            pico_get_unique_board_id_string(serial, sizeof(serial));
+            str = serial;
+        } else if (index < count_of(string_descriptors) && string_descriptors[index]) {
+            str = string_descriptors[index];
+        } else {
+            return NULL;
+        }
+
+        char_count = (uint8_t)strlen(str);
+        if (char_count > count_of(string_buffer) - 1) {
+            char_count = count_of(string_buffer) - 1;
+        }
+        for (uint8_t i = 0; i < char_count; i++) {
+            string_buffer[1 + i] = (uint8_t)str[i];
+        }
+    }
+
+    // First element is the descriptor header: length and type
+    string_buffer[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * char_count + 2));
+    return string_buffer;
+}
@@ -1,38 +1,138 @@
 #include "cashstick.h"
 #include "pico/bootrom.h"
+#include "pico/mutex.h"
+#include "pico/stdio/driver.h"
+#include "hardware/irq.h"
+#include "tusb.h"
 
-// USB device state
-static bool usb_connected = false;
+// USB device state - driven by the TinyUSB mount/suspend callbacks
+static volatile bool usb_connected = false;
+static volatile bool usb_suspended = false;
+static volatile bool usb_mount_pending = false;     // Connect not journaled yet
 static bool mass_storage_active = false;
 
+// tud_task() runs from a low-priority software interrupt raised by every
+// USB controller interrupt, so enumeration and transfers never wait on
+// the main loop. Thread code takes usb_mutex before touching TinyUSB;
+// the interrupt only runs tud_task() when the mutex is free.
+static mutex_t usb_mutex;
+static uint usb_task_irq;
+
+// Give up on a CDC write if the host stops reading
+#define USB_CDC_WRITE_TIMEOUT_US 500000
+
+// Command line buffers, one per transport; long enough for an UPDATE
+// data line carrying USB_UPDATE_CHUNK bytes as hex
+#define USB_UPDATE_CHUNK 256
+#define USB_COMMAND_MAX_LEN (16 + USB_UPDATE_CHUNK * 2)
+
+// Longest replies, built in the scratch arena
+#define USB_STATUS_REPLY_LEN 512
+#define USB_METRICS_REPLY_LEN 2048
+#define USB_TRACE_REPLY_LEN 1024
+#define USB_JOURNAL_REPLY_LEN 1024
+#define USB_ATTEST_REPLY_LEN 512
+
+typedef struct {
+    char line[USB_COMMAND_MAX_LEN];
+    size_t len;
+    bool overflow;
+} usb_line_buffer_t;
+
+static usb_line_buffer_t cdc_line = {0};
+static usb_transport_t active_transport = USB_TRANSPORT_CDC;
+
+#if CASHSTICK_USB_HID
+#define USB_HID_REPORT_SIZE CFG_TUD_HID_EP_BUFSIZE
+#define USB_HID_RX_SIZE 256
+#define USB_HID_TX_SIZE 1024
+
+static usb_line_buffer_t hid_line = {0};
+static uint8_t hid_rx[USB_HID_RX_SIZE];
+static size_t hid_rx_len = 0;
+static uint8_t hid_tx[USB_HID_TX_SIZE];
+static size_t hid_tx_head = 0;
+static size_t hid_tx_tail = 0;
+
+static void usb_hid_send_next_report(void);
+#endif
+
+static void usb_stdio_out_chars(const char *buf, int len);
+static void usb_stdio_out_flush(void);
+static void usb_cdc_write(const char *data, size_t len);
+static void usb_process_bytes(usb_line_buffer_t *line, usb_transport_t transport, const char *data, size_t len);
+static void usb_dispatch_command(const char *command);
+
+static stdio_driver_t usb_stdio_driver = {
+    .out_chars = usb_stdio_out_chars,
+    .out_flush = usb_stdio_out_flush,
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+    .crlf_enabled = true,
+#endif
+};
+
+static void usb_task_irq_handler(void) {
+    uint32_t owner;
+    if (mutex_try_enter(&usb_mutex, &owner)) {
+        tud_task();
+        mutex_exit(&usb_mutex);
+    }
+}
+
+static void usb_controller_irq(void) {
+    irq_set_pending(usb_task_irq);
+}
+
 void usb_init(void) {
-    // USB is initialized by pico_sdk automatically
     usb_connected = false;
+    usb_suspended = false;
     mass_storage_active = false;
-    
-    printf("USB: Interface initialized\n");
+
+    mutex_init(&usb_mutex);
+    tusb_init();
+
+    usb_task_irq = user_irq_claim_unused(true);
+    irq_set_exclusive_handler(usb_task_irq, usb_task_irq_handler);
+    irq_set_priority(usb_task_irq, PICO_LOWEST_IRQ_PRIORITY);
+    irq_set_enabled(usb_task_irq, true);
+
+    // Runs after TinyUSB's own controller handler has queued its events
+    irq_add_shared_handler(USBCTRL_IRQ, usb_controller_irq, PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY);
+
+    // printf() goes out over the CDC interface
+    stdio_set_driver_enabled(&usb_stdio_driver, true);
+
+    usb_create_virtual_filesystem();
+
+    printf("USB: Composite device initialized (CDC + MSC%s)\n", CASHSTICK_USB_HID ? " + HID" : "");
+}
+
+void usb_lock(void) {
+    mutex_enter_blocking(&usb_mutex);
+}
+
+void usb_unlock(void) {
+    mutex_exit(&usb_mutex);
+    // The task interrupt skips while we hold the mutex; re-run it so any
+    // event that arrived in the meantime is not left queued
+    irq_set_pending(usb_task_irq);
+}
+
+bool usb_is_mass_storage_mode(void) {
+    return mass_storage_active;
 }
 
 bool usb_is_connected(void) {
-    // Check USB connection status
-    // This would check the actual USB state from TinyUSB
-    return usb_connected;
+    return usb_connected && !usb_suspended;
 }
 
 void usb_mass_storage_mode(void) {
     printf("USB: Entering mass storage mode for firmware update\n");
-    
-    led_set_state(LED_STATE_BUSY);
+
+    // The drive is always exposed and serviced from the USB interrupt, so
+    // this only refreshes its contents and flags update mode
     mass_storage_active = true;
-    
-    // Create virtual files for drag-and-drop interface
     usb_create_virtual_filesystem();
-    
-    // Wait in mass storage mode until firmware is updated
-    while (mass_storage_active) {
-        usb_handle_mass_storage_operations();
-        delay_ms(100);
-    }
 }
 
 void usb_handle_commands(void) {
@@ -40,146 +140,818 @@ void usb_handle_commands(void) {
     if (!usb_connected) {
         return;
     }
-    
-    // Example command protocol:
-    // - Get device status
-    // - Get Bitcoin address  
-    // - Sign transaction
-    // - Check tamper status
-    
-    // This would implement a simple command/response protocol
-    // over USB serial or custom HID interface
-}
-
-void usb_create_virtual_filesystem(void) {
-    // Create virtual files that appear when device is connected
-    // These files allow drag-and-drop firmware installation
-    
-    printf("USB: Creating virtual filesystem\n");
-    
-    // Virtual files:
-    // - README.txt: Instructions for firmware installation
-    // - device_info.txt: Device serial number and status
-    // - address.txt: Bitcoin address (if keys are generated)
-    // - status.txt: Tamper and security status
-    
-    // Implementation would create TinyUSB mass storage device
-    // with these virtual files accessible from host computer
-}
-
-void usb_handle_mass_storage_operations(void) {
-    // Handle file operations in mass storage mode
-    
-    // Check for firmware file being written
-    if (usb_check_for_firmware_file()) {
-        printf("USB: New firmware detected\n");
-        
-        // Flash new firmware (this would be handled by bootloader)
-        if (usb_install_firmware()) {
-            printf("USB: Firmware installation successful\n");
-            
-            // After successful firmware install, exit mass storage mode
-            // and reboot into normal operation
-            mass_storage_active = false;
-            
-            // Set device to normal operation mode
-            led_set_state(LED_STATE_NEW);
-            
-            // Reboot to new firmware
-            watchdog_enable(100, 1);
-            while(1);
-        }
-    }
-    
-    // Handle file read operations (device status, address, etc.)
-    usb_handle_file_reads();
-}
-
-bool usb_check_for_firmware_file(void) {
-    // Check if a .uf2 firmware file has been written to the device
-    // This would interface with TinyUSB mass storage to detect file writes
-    return false;  // Placeholder
-}
-
-bool usb_install_firmware(void) {
-    // Install new firmware using Pico bootloader
-    // This would validate the firmware and flash it
-    printf("USB: Installing firmware...\n");
-    
-    // LED feedback during installation
-    for (int i = 0; i < 10; i++) {
-        led_blink(LED_STATE_BUSY, 200);
-        delay_ms(200);
-    }
-    
-    return true;  // Placeholder
-}
-
-void usb_handle_file_reads(void) {
-    // Handle when host computer reads virtual files
-    // This would provide device information back to the host
-    
-    // Examples of virtual file contents:
-    // README.txt: "CashStick Bitcoin Bearer Device v1.0.0\n..."
-    // device_info.txt: Device serial, state, tamper status
-    // address.txt: Current Bitcoin address if available
+
+    // Journal the connect here: the mount callback runs in interrupt context
+    if (usb_mount_pending) {
+        usb_mount_pending = false;
+        journal_append(JOURNAL_EVENT_USB_CONNECT, 0);
+    }
+
+    // Drain the transport buffers in chunks; commands run unlocked since
+    // they print and may block on I2C or flash
+    char chunk[64];
+    uint32_t count;
+
+    do {
+        usb_lock();
+        count = tud_cdc_available() ? tud_cdc_read(chunk, sizeof(chunk)) : 0;
+        usb_unlock();
+
+        usb_process_bytes(&cdc_line, USB_TRANSPORT_CDC, chunk, count);
+    } while (count > 0);
+
+#if CASHSTICK_USB_HID
+    do {
+        usb_lock();
+        count = hid_rx_len < sizeof(chunk) ? hid_rx_len : sizeof(chunk);
+        memcpy(chunk, hid_rx, count);
+        memmove(hid_rx, hid_rx + count, hid_rx_len - count);
+        hid_rx_len -= count;
+        usb_unlock();
+
+        usb_process_bytes(&hid_line, USB_TRANSPORT_HID, chunk, count);
+    } while (count > 0);
+#endif
+}
+
+// Command protocol - one ASCII command per line, one JSON line per reply
+
+typedef struct {
+    const char *name;
+    void (*handler)(const char *args);
+} usb_command_t;
+
+static void usb_cmd_ping(const char *args) {
+    usb_send_response("{\"pong\":true}");
+}
+
+static void usb_cmd_status(const char *args) {
+    usb_send_device_status();
+}
+
+static void usb_cmd_address(const char *args) {
+    char address[ADDRESS_P2TR_LEN];
+    char response[112];
+    address_format_t format = ADDRESS_FORMAT_DEFAULT;
+
+    if (*args != '\0' && !address_format_parse(args, &format)) {
+        usb_send_response("{\"error\":\"unknown format\"}");
+        return;
+    }
+
+    if (!wallet_get_address(format, address, sizeof(address))) {
+        usb_send_response("{\"error\":\"no wallet\"}");
+        return;
+    }
+
+    snprintf(response, sizeof(response), "{\"format\":\"%s\",\"address\":\"%s\"}",
+             address_format_name(format), address);
+    usb_send_response(response);
+}
+
+static void usb_cmd_pubkey(const char *args) {
+    uint8_t pubkey[33];
+    char response[96];
+
+    if (!wallet_export_public_key(pubkey)) {
+        usb_send_response("{\"error\":\"no wallet\"}");
+        return;
+    }
+
+    size_t len = (size_t)snprintf(response, sizeof(response), "{\"pubkey\":\"");
+    for (size_t i = 0; i < sizeof(pubkey); i++) {
+        len += (size_t)snprintf(response + len, sizeof(response) - len, "%02x", pubkey[i]);
+    }
+    snprintf(response + len, sizeof(response) - len, "\"}");
+    usb_send_response(response);
+}
+
+static void usb_cmd_tamper(const char *args) {
+    char response[96];
+    tamper_status_t status = tamper_check_integrity();
+
+    snprintf(response, sizeof(response), "{\"tamper_intact\":%s,\"tamper_count\":%lu}",
+             status.is_intact ? "true" : "false", (unsigned long)status.tamper_count);
+    usb_send_response(response);
+}
+
+static void usb_cmd_power(const char *args) {
+    char response[160];
+    power_stats_t stats;
+    power_get_stats(&stats);
+
+    snprintf(response, sizeof(response),
+             "{\"wakeups\":%lu,\"wakeups_per_hour\":%lu,\"button\":%lu,\"usb\":%lu,\"alarm\":%lu,\"clock\":\"%s\"}",
+             (unsigned long)stats.wakeups, (unsigned long)stats.wakeups_per_hour,
+             (unsigned long)stats.button_events, (unsigned long)stats.usb_events,
+             (unsigned long)stats.alarm_events, clock_governor_op_name(clock_governor_get_op()));
+    usb_send_response(response);
+}
+
+static void usb_cmd_i2c(const char *args) {
+    char response[320];
+    i2c_stats_t stats;
+    se050_session_stats_t session;
+    se050_i2c_get_stats(&stats);
+    se050_get_session_stats(&session);
+
+    snprintf(response, sizeof(response),
+             "{\"transfers\":%lu,\"timeouts\":%lu,\"retries\":%lu,\"recoveries\":%lu,\"failures\":%lu,\"max_latency_us\":%lu,"
+             "\"scp03\":{\"handshakes\":%lu,\"resumed\":%lu,\"rewinds\":%lu,\"lost_replies\":%lu,\"rejected\":%lu}}",
+             (unsigned long)stats.transfers, (unsigned long)stats.timeouts,
+             (unsigned long)stats.retries, (unsigned long)stats.recoveries,
+             (unsigned long)stats.failures, (unsigned long)stats.max_latency_us,
+             (unsigned long)session.handshakes, (unsigned long)session.resumed,
+             (unsigned long)session.rewinds, (unsigned long)session.lost_replies,
+             (unsigned long)session.rejected);
+    usb_send_response(response);
+}
+
+static void usb_cmd_msc(const char *args) {
+    char response[192];
+    usb_msc_overlay_stats_t stats;
+    usb_msc_get_overlay_stats(&stats);
+
+    snprintf(response, sizeof(response),
+             "{\"capacity\":%lu,\"used\":%lu,\"writes\":%lu,\"read_hits\":%lu,\"evictions\":%lu,"
+             "\"pinned_evictions\":%lu,\"discards\":%lu}",
+             (unsigned long)stats.capacity, (unsigned long)stats.used,
+             (unsigned long)stats.writes, (unsigned long)stats.read_hits,
+             (unsigned long)stats.evictions, (unsigned long)stats.pinned_evictions,
+             (unsigned long)stats.discards);
+    usb_send_response(response);
+}
+
+static void usb_cmd_measure(const char *args) {
+    char response[384];     // Three roots and four full-width counters fit
+    const measurement_t *m = measured_boot_get();
+    const struct { const char *name; const uint8_t *digest; } roots[] = {
+        { "root",       m->root },
+        { "image_root", m->image_root },
+        { "data_root",  m->data_root },
+    };
+
+    size_t len = (size_t)snprintf(response, sizeof(response), "{");
+    for (size_t r = 0; r < count_of(roots); r++) {
+        len += (size_t)snprintf(response + len, sizeof(response) - len, "\"%s\":\"", roots[r].name);
+        for (size_t i = 0; i < SHA256_DIGEST_SIZE; i++) {
+            len += (size_t)snprintf(response + len, sizeof(response) - len, "%02x", roots[r].digest[i]);
+        }
+        len += (size_t)snprintf(response + len, sizeof(response) - len, "\",");
+    }
+    snprintf(response + len, sizeof(response) - len,
+             "\"generation\":%lu,\"chunks\":%lu,\"rehashed\":%lu,\"boot_us\":%lu}",
+             (unsigned long)m->generation, (unsigned long)m->leaf_count,
+             (unsigned long)m->rehashed, (unsigned long)m->boot_us);
+    usb_send_response(response);
+}
+
+// Snapshot of the metrics: "name":[count,errors,total_us,max_us,[histogram]]
+// per operation, the histogram cut after its last non-empty bucket.
+// "METRICS <name>" returns one operation, "METRICS reset" clears them all.
+static void usb_cmd_metrics(const char *args) {
+    if (strcmp(args, "reset") == 0) {
+        metrics_reset();
+        usb_send_response("{\"reset\":true}");
+        return;
+    }
+
+    char *response = scratch_alloc(USB_METRICS_REPLY_LEN);
+    if (!response) {
+        usb_send_response("{\"error\":\"out of memory\"}");
+        return;
+    }
+
+    size_t len = (size_t)snprintf(response, USB_METRICS_REPLY_LEN, "{");
+    for (int id = 0; id < METRIC_COUNT && len < USB_METRICS_REPLY_LEN; id++) {
+        if (*args != '\0' && strcmp(args, metrics_name((metric_id_t)id)) != 0) {
+            continue;
+        }
+
+        metric_snapshot_t m;
+        metrics_snapshot((metric_id_t)id, &m);
+
+        int used = METRIC_BUCKETS;
+        while (used > 0 && m.buckets[used - 1] == 0) {
+            used--;
+        }
+
+        len += (size_t)snprintf(response + len, USB_METRICS_REPLY_LEN - len, "%s\"%s\":[%lu,%lu,%llu,%lu,[",
+                                len > 1 ? "," : "", metrics_name((metric_id_t)id),
+                                (unsigned long)m.count, (unsigned long)m.errors,
+                                (unsigned long long)m.total_us, (unsigned long)m.max_us);
+        for (int b = 0; b < used && len < USB_METRICS_REPLY_LEN; b++) {
+            len += (size_t)snprintf(response + len, USB_METRICS_REPLY_LEN - len, "%s%lu",
+                                    b > 0 ? "," : "", (unsigned long)m.buckets[b]);
+        }
+        if (len < USB_METRICS_REPLY_LEN) {
+            len += (size_t)snprintf(response + len, USB_METRICS_REPLY_LEN - len, "]]");
+        }
+    }
+
+    if (len == 1) {
+        usb_send_response("{\"error\":\"unknown metric\"}");
+        return;
+    }
+    if (len + 2 > USB_METRICS_REPLY_LEN) {
+        usb_send_response("{\"error\":\"snapshot too long\"}");
+        return;
+    }
+    snprintf(response + len, USB_METRICS_REPLY_LEN - len, "}");
+    usb_send_response(response);
+}
+
+static void usb_cmd_memory(const char *args) {
+    char response[256];
+    memory_stats_t stats;
+    memory_get_stats(&stats);
+
+    snprintf(response, sizeof(response),
+             "{\"stack0_used\":%lu,\"stack0_size\":%lu,\"stack1_used\":%lu,\"stack1_size\":%lu,"
+             "\"scratch_used\":%lu,\"scratch_peak\":%lu,\"scratch_size\":%lu,\"scratch_failures\":%lu}",
+             (unsigned long)stats.stack_used[0], (unsigned long)stats.stack_size[0],
+             (unsigned long)stats.stack_used[1], (unsigned long)stats.stack_size[1],
+             (unsigned long)stats.scratch_used, (unsigned long)stats.scratch_peak,
+             (unsigned long)stats.scratch_size, (unsigned long)stats.scratch_failures);
+    usb_send_response(response);
+}
+
+// Production-line provisioning: the whole sequence in one round trip, one
+// compact record back
+static void usb_cmd_provision(const char *args) {
+    char response[256];
+    char address[ADDRESS_P2TR_LEN] = "";
+    provision_result_t result;
+
+    bool ok = wallet_provision(&result);
+    if (ok) {
+        wallet_get_address(ADDRESS_FORMAT_DEFAULT, address, sizeof(address));
+    }
+
+    snprintf(response, sizeof(response),
+             "{\"provisioned\":%s,\"device_id\":\"%08lx\",\"stage\":\"%s\",\"address\":\"%s\","
+             "\"pool\":%s,\"selftest\":%s,\"keygen_us\":%lu,\"seal_us\":%lu,\"commit_us\":%lu,"
+             "\"selftest_us\":%lu,\"total_us\":%lu,\"commits\":%lu}",
+             ok ? "true" : "false", (unsigned long)get_device_serial(),
+             ok ? "done" : result.failed_stage, address,
+             result.from_pool ? "true" : "false", result.self_test_passed ? "true" : "false",
+             (unsigned long)result.keygen_us, (unsigned long)result.seal_us,
+             (unsigned long)result.commit_us, (unsigned long)result.self_test_us,
+             (unsigned long)result.total_us, (unsigned long)result.flash_commits);
+    usb_send_response(response);
+}
+
+#if CASHSTICK_I2C_TRACE_SIZE > 0
+// SE050 bus transcript. "TRACE on|off|clear" control the recorder, plain
+// TRACE reports its fill level. "TRACE read" drains as many records as fit
+// in one reply, oldest first, each as
+//   [start_us,duration_us,gap_us,"w"|"r"|"x",result,len,"hex"]
+// with "more" set while records remain.
+static void usb_cmd_trace(const char *args) {
+    static const char op_names[] = { 'w', 'r', 'x' };
+    i2c_trace_stats_t stats;
+
+    if (strcmp(args, "on") == 0 || strcmp(args, "off") == 0) {
+        i2c_trace_enable(args[1] == 'n');
+    } else if (strcmp(args, "clear") == 0) {
+        i2c_trace_clear();
+    } else if (strcmp(args, "read") == 0) {
+        char *response = scratch_alloc(USB_TRACE_REPLY_LEN);
+        uint8_t *data = scratch_alloc(I2C_TRACE_MAX_DATA);
+        if (!response || !data) {
+            usb_send_response("{\"error\":\"out of memory\"}");
+            return;
+        }
+
+        size_t len = (size_t)snprintf(response, USB_TRACE_REPLY_LEN, "{\"trace\":[");
+        bool first = true;
+        size_t need;
+        // Room for this record plus the closing fields
+        while ((need = i2c_trace_peek()) != 0 && len + need + 48 < USB_TRACE_REPLY_LEN) {
+            i2c_trace_record_t r;
+            i2c_trace_pop(&r, data);
+            len += (size_t)snprintf(response + len, USB_TRACE_REPLY_LEN - len,
+                                    "%s[%lu,%lu,%lu,\"%c\",%d,%u,\"", first ? "" : ",",
+                                    (unsigned long)r.start_us, (unsigned long)r.duration_us,
+                                    (unsigned long)r.gap_us, op_names[r.op], r.result, r.len);
+            for (uint8_t i = 0; i < r.stored; i++) {
+                len += (size_t)snprintf(response + len, USB_TRACE_REPLY_LEN - len, "%02x", data[i]);
+            }
+            len += (size_t)snprintf(response + len, USB_TRACE_REPLY_LEN - len, "\"]");
+            first = false;
+        }
+
+        i2c_trace_get_stats(&stats);
+        snprintf(response + len, USB_TRACE_REPLY_LEN - len, "],\"more\":%s,\"dropped\":%lu}",
+                 stats.records > 0 ? "true" : "false", (unsigned long)stats.dropped);
+        usb_send_response(response);
+        return;
+    } else if (*args != '\0') {
+        usb_send_response("{\"error\":\"usage: TRACE [on|off|clear|read]\"}");
+        return;
+    }
+
+    char response[128];
+    i2c_trace_get_stats(&stats);
+    snprintf(response, sizeof(response),
+             "{\"recording\":%s,\"records\":%lu,\"used\":%lu,\"size\":%lu,\"dropped\":%lu}",
+             stats.recording ? "true" : "false", (unsigned long)stats.records,
+             (unsigned long)stats.used, (unsigned long)stats.size, (unsigned long)stats.dropped);
+    usb_send_response(response);
+}
+#endif
+
+// JOURNAL [read [POSITION]]: decoded straight from flash, a reply's worth
+// at a time. "next" resumes the read; "lost" means records between the
+// position and the oldest kept were reclaimed.
+static void usb_cmd_journal(const char *args) {
+    static const char *const event_names[] = { "boot", "test", "tamper", "usb", "sign", "state" };
+    _Static_assert(count_of(event_names) == JOURNAL_EVENT_COUNT, "journal event names");
+
+    if (strncmp(args, "read", 4) == 0 && (args[4] == '\0' || args[4] == ' ')) {
+        char *response = scratch_alloc(USB_JOURNAL_REPLY_LEN);
+        if (!response) {
+            usb_send_response("{\"error\":\"out of memory\"}");
+            return;
+        }
+
+        journal_cursor_t cursor;
+        uint32_t position = (uint32_t)strtoul(args + 4, NULL, 0);
+        bool lost = !journal_cursor_at(&cursor, position);
+
+        size_t len = (size_t)snprintf(response, USB_JOURNAL_REPLY_LEN, "{\"events\":[");
+        bool first = true;
+        bool more = false;
+        journal_entry_t entry;
+        while (true) {
+            // Room for one more event plus the closing fields
+            if (len + 96 >= USB_JOURNAL_REPLY_LEN) {
+                more = true;
+                break;
+            }
+            if (!journal_next(&cursor, &entry)) {
+                break;
+            }
+            len += (size_t)snprintf(response + len, USB_JOURNAL_REPLY_LEN - len, "%s[%lu,%lu,\"%s\",%lu]",
+                                    first ? "" : ",", (unsigned long)entry.boot,
+                                    (unsigned long)entry.time_ms, event_names[entry.event],
+                                    (unsigned long)entry.arg);
+            first = false;
+        }
+
+        snprintf(response + len, USB_JOURNAL_REPLY_LEN - len, "],\"next\":%lu,\"more\":%s,\"lost\":%s}",
+                 (unsigned long)journal_position(&cursor), more ? "true" : "false",
+                 lost ? "true" : "false");
+        usb_send_response(response);
+        return;
+    } else if (*args != '\0') {
+        usb_send_response("{\"error\":\"usage: JOURNAL [read [POSITION]]\"}");
+        return;
+    }
+
+    char response[128];
+    journal_stats_t stats;
+    journal_get_stats(&stats);
+    snprintf(response, sizeof(response),
+             "{\"records\":%lu,\"segments\":%lu,\"active_used\":%lu,\"boot\":%lu,\"reclaimed\":%lu}",
+             (unsigned long)stats.records, (unsigned long)stats.segments,
+             (unsigned long)stats.active_used, (unsigned long)stats.boot,
+             (unsigned long)stats.reclaimed);
+    usb_send_response(response);
+}
+
+// Hex string to bytes: the byte count, or -1 if malformed or too long
+static int usb_parse_hex(const char *hex, uint8_t *out, size_t max_len) {
+    size_t len = 0;
+    while (hex[0] != '\0') {
+        int value = 0;
+        for (int i = 0; i < 2; i++) {
+            char c = hex[i];
+            int nibble = c >= '0' && c <= '9' ? c - '0' :
+                         c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                         c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (nibble < 0) {
+                return -1;
+            }
+            value = value << 4 | nibble;
+        }
+        if (len == max_len) {
+            return -1;
+        }
+        out[len++] = (uint8_t)value;
+        hex += 2;
+    }
+    return (int)len;
+}
+
+// Append bytes as lowercase hex; the new length
+static size_t usb_append_hex(char *out, size_t len, size_t max_len, const uint8_t *data, size_t count) {
+    for (size_t i = 0; i < count && len < max_len; i++) {
+        len += (size_t)snprintf(out + len, max_len - len, "%02x", data[i]);
+    }
+    return len;
+}
+
+// Proof of custody: "ATTEST <64 hex chars>" signs the challenge with the
+// claims it covers (attestation.h); the host rebuilds the message from the
+// reply and checks the signature against the stick's registered key
+static void usb_cmd_attest(const char *args) {
+    uint8_t challenge[ATTESTATION_CHALLENGE_SIZE];
+    if (usb_parse_hex(args, challenge, sizeof(challenge)) != (int)sizeof(challenge)) {
+        usb_send_response("{\"error\":\"usage: ATTEST <32-byte hex challenge>\"}");
+        return;
+    }
+
+    attestation_result_t result;
+    uint8_t pubkey[33];
+    if (!wallet_export_public_key(pubkey)) {
+        usb_send_response("{\"error\":\"no wallet\"}");
+        return;
+    }
+    if (!wallet_attest(challenge, &result)) {
+        usb_send_response("{\"error\":\"attestation failed\"}");
+        return;
+    }
+
+    char *response = scratch_alloc(USB_ATTEST_REPLY_LEN);
+    if (!response) {
+        usb_send_response("{\"error\":\"out of memory\"}");
+        return;
+    }
+
+    const attestation_claims_t *claims = &result.claims;
+    size_t len = (size_t)snprintf(response, USB_ATTEST_REPLY_LEN,
+                                  "{\"serial\":\"%08lx\",\"tamper_intact\":%s,\"tamper_count\":%lu,"
+                                  "\"counter\":%lu,\"firmware\":\"",
+                                  (unsigned long)claims->serial, claims->tamper_intact ? "true" : "false",
+                                  (unsigned long)claims->tamper_count, (unsigned long)claims->state_counter);
+    len = usb_append_hex(response, len, USB_ATTEST_REPLY_LEN, claims->firmware_root, sizeof(claims->firmware_root));
+    len += (size_t)snprintf(response + len, USB_ATTEST_REPLY_LEN - len, "\",\"pubkey\":\"");
+    len = usb_append_hex(response, len, USB_ATTEST_REPLY_LEN, pubkey, sizeof(pubkey));
+    len += (size_t)snprintf(response + len, USB_ATTEST_REPLY_LEN - len, "\",\"signature\":\"");
+    len = usb_append_hex(response, len, USB_ATTEST_REPLY_LEN, result.signature, sizeof(result.signature));
+    snprintf(response + len, USB_ATTEST_REPLY_LEN - len, "\",\"claims_us\":%lu,\"sign_us\":%lu}",
+             (unsigned long)result.claims_us, (unsigned long)result.sign_us);
+    usb_send_response(response);
+}
+
+// Firmware update from a delta patch, streamed as hex:
+//   UPDATE begin, UPDATE data <hex>..., UPDATE end, UPDATE install
+static void usb_update_command(const char *args) {
+    static const char *state_names[] = { "idle", "receiving", "staged", "failed" };
+    char response[256];
+    update_status_t status;
+
+    if (strncmp(args, "data ", 5) == 0) {
+        uint8_t chunk[USB_UPDATE_CHUNK];
+        int len = usb_parse_hex(args + 5, chunk, sizeof(chunk));
+        if (len < 0) {
+            usb_send_response("{\"error\":\"bad hex\"}");
+            return;
+        }
+
+        bool ok = update_write(chunk, (size_t)len);
+        update_get_status(&status);
+        if (ok) {
+            snprintf(response, sizeof(response), "{\"received\":%lu,\"written\":%lu}",
+                     (unsigned long)status.received, (unsigned long)status.written);
+        } else {
+            snprintf(response, sizeof(response), "{\"error\":\"%s\"}", status.error);
+        }
+        usb_send_response(response);
+        return;
+    }
+
+    bool ok = true;
+    if (strcmp(args, "begin") == 0) {
+        ok = update_begin();
+    } else if (strcmp(args, "end") == 0) {
+        ok = update_finish();
+    } else if (strcmp(args, "abort") == 0) {
+        update_abort();
+    } else if (strcmp(args, "install") == 0) {
+        update_get_status(&status);
+        if (status.state != UPDATE_STAGED) {
+            usb_send_response("{\"error\":\"no staged update\"}");
+            return;
+        }
+        usb_send_response("{\"installing\":true}");
+        update_install();   // Resets once the image is in place
+        usb_send_response("{\"error\":\"install failed\"}");
+        return;
+    } else if (*args != '\0') {
+        usb_send_response("{\"error\":\"usage: UPDATE [begin|data HEX|end|abort|install]\"}");
+        return;
+    }
+
+    update_get_status(&status);
+    if (!ok) {
+        snprintf(response, sizeof(response), "{\"error\":\"%s\"}", status.error);
+    } else {
+        int len = snprintf(response, sizeof(response),
+                           "{\"state\":\"%s\",\"received\":%lu,\"written\":%lu,\"target_len\":%lu,"
+                           "\"erased\":%lu,\"elapsed_us\":%lu,\"verify_us\":%lu",
+                           state_names[status.state], (unsigned long)status.received,
+                           (unsigned long)status.written, (unsigned long)status.target_len,
+                           (unsigned long)status.sectors_erased, (unsigned long)status.elapsed_us,
+                           (unsigned long)status.verify_us);
+        if (status.from_uf2) {
+            len += snprintf(response + len, sizeof(response) - (size_t)len,
+                            ",\"source\":\"uf2\",\"reordered\":%lu",
+                            (unsigned long)status.reordered);
+        }
+        snprintf(response + len, sizeof(response) - (size_t)len, status.error ? ",\"last_error\":\"%s\"}" : "}",
+                 status.error);
+    }
+    usb_send_response(response);
+}
+
+// The USB task feeds dropped UF2 images into the same update from its
+// interrupt; the two never interleave
+static void usb_cmd_update(const char *args) {
+    // Replacing the firmware takes update mode, which takes the BOOT
+    // button (or a blank stick): a host alone cannot reflash a device
+    bool changes = *args != '\0' && strcmp(args, "abort") != 0;
+    if (changes && !usb_is_mass_storage_mode()) {
+        usb_send_response("{\"error\":\"not in update mode\"}");
+        return;
+    }
+    if (!update_hold()) {
+        usb_send_response("{\"error\":\"UF2 update in progress\"}");
+        return;
+    }
+    usb_update_command(args);
+    update_release();
+}
+
+static const usb_command_t usb_commands[] = {
+    { "PING",    usb_cmd_ping },
+    { "STATUS",  usb_cmd_status },
+    { "ADDRESS", usb_cmd_address },
+    { "PUBKEY",  usb_cmd_pubkey },
+    { "TAMPER",  usb_cmd_tamper },
+    { "POWER",   usb_cmd_power },
+    { "MEASURE", usb_cmd_measure },
+    { "I2C",     usb_cmd_i2c },
+    { "MSC",     usb_cmd_msc },
+    { "PROVISION", usb_cmd_provision },
+    { "METRICS", usb_cmd_metrics },
+    { "MEMORY",  usb_cmd_memory },
+    { "UPDATE",  usb_cmd_update },
+    { "JOURNAL", usb_cmd_journal },
+    { "ATTEST",  usb_cmd_attest },
+#if CASHSTICK_I2C_TRACE_SIZE > 0
+    { "TRACE",   usb_cmd_trace },
+#endif
+};
+
+static void usb_dispatch_command(const char *command) {
+    uint32_t start = metrics_start();
+
+    for (size_t i = 0; i < count_of(usb_commands); i++) {
+        size_t name_len = strlen(usb_commands[i].name);
+        if (strncmp(command, usb_commands[i].name, name_len) == 0 &&
+            (command[name_len] == '\0' || command[name_len] == ' ')) {
+            const char *args = command + name_len;
+            while (*args == ' ') {
+                args++;
+            }
+            // Whatever the handler takes from the scratch arena is
+            // released once its reply is out
+            size_t scratch = scratch_mark();
+            usb_commands[i].handler(args);
+            scratch_release(scratch);
+            metrics_end(METRIC_USB_REQUEST, start, true);
+            return;
+        }
+    }
+
+    usb_send_response("{\"error\":\"unknown command\"}");
+    metrics_end(METRIC_USB_REQUEST, start, false);
+}
+
+static void RAM_FUNC(usb_process_bytes)(usb_line_buffer_t *line, usb_transport_t transport, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+
+        if (c == '\r' || c == '\n' || c == '\0') {
+            if (line->len > 0 && !line->overflow) {
+                line->line[line->len] = '\0';
+                active_transport = transport;
+                usb_dispatch_command(line->line);
+                active_transport = USB_TRANSPORT_CDC;
+            } else if (line->overflow) {
+                active_transport = transport;
+                usb_send_response("{\"error\":\"command too long\"}");
+                active_transport = USB_TRANSPORT_CDC;
+            }
+            line->len = 0;
+            line->overflow = false;
+        } else if (line->len < sizeof(line->line) - 1) {
+            line->line[line->len++] = c;
+        } else {
+            line->overflow = true;
+        }
+    }
 }
 
 // USB Serial Communication Functions
 void usb_send_response(const char *response) {
-    if (usb_connected) {
-        printf("%s\n", response);
+    if (!usb_connected) {
+        return;
     }
+
+#if CASHSTICK_USB_HID
+    if (active_transport == USB_TRANSPORT_HID) {
+        usb_lock();
+        size_t len = strlen(response);
+        for (size_t i = 0; i <= len; i++) {
+            size_t next = (hid_tx_head + 1) % USB_HID_TX_SIZE;
+            if (next == hid_tx_tail) {
+                break;  // Host is not draining reports; drop the rest
+            }
+            hid_tx[hid_tx_head] = (i < len) ? (uint8_t)response[i] : '\n';
+            hid_tx_head = next;
+        }
+        usb_hid_send_next_report();
+        usb_unlock();
+        return;
+    }
+#endif
+
+    usb_cdc_write(response, strlen(response));
+    usb_cdc_write("\r\n", 2);
 }
 
 void usb_send_device_status(void) {
-    char status_json[512];
-    
-    snprintf(status_json, sizeof(status_json),
+    size_t scratch = scratch_mark();
+    char *status_json = scratch_alloc(USB_STATUS_REPLY_LEN);
+    if (!status_json) {
+        usb_send_response("{\"error\":\"out of memory\"}");
+        return;
+    }
+
+    power_stats_t power_stats;
+    power_get_stats(&power_stats);
+
+    snprintf(status_json, USB_STATUS_REPLY_LEN,
         "{"
-        "\"device_id\":\"%08x\","
+        "\"device_id\":\"%08lx\","
         "\"state\":%d,"
         "\"tamper_intact\":%s,"
         "\"keys_present\":%s,"
-        "\"firmware_version\":\"1.0.0\""
+        "\"wakeups\":%lu,"
+        "\"wakeups_per_hour\":%lu,"
+        "\"key_pool_ready\":%lu,"
+        "\"key_pool_depth\":%lu,"
+        "\"state_commits\":%lu,"
+        "\"firmware_version\":\"1.0.0\","
+        "\"signing_key\":\"%s\","
+        "\"scp03_keys\":\"%s\""
         "}",
-        get_device_serial(),
-        current_device_state,
+        (unsigned long)get_device_serial(),
+        device_state_get(),
         tamper_check_integrity().is_intact ? "true" : "false",
-        device_keys.is_sealed ? "true" : "false"
+        wallet_is_initialized() ? "true" : "false",
+        (unsigned long)power_stats.wakeups,
+        (unsigned long)power_stats.wakeups_per_hour,
+        (unsigned long)key_pool_ready_count(),
+        (unsigned long)key_pool_depth(),
+        (unsigned long)device_state_commit_count(),
+        CASHSTICK_DEV_SIGNING_KEY ? "development" : "vendor",
+        CASHSTICK_DEV_SCP03_KEYS ? "development" : "provisioned"
     );
-    
+
     usb_send_response(status_json);
+    scratch_release(scratch);
 }
 
 // Device identification
-void usb_create_key_reveal_files(const bitcoin_keys_t *keys) {
-    if (!keys || !keys->keys_revealed) {
-        return;
-    }
-    
-    printf("USB: Creating key reveal files for owner\n");
-    
-    // This creates virtual files in mass storage mode containing:
-    // - private_key.txt: Private key in WIF format for import
-    // - public_key.txt: Public key for verification  
-    // - address.txt: Bitcoin address
-    // - sweep_instructions.txt: How to sweep the Bitcoin
-    
-    // Implementation would create TinyUSB mass storage files
-    // containing the revealed key data for the owner
-}
-
 uint32_t get_device_serial(void) {
     // Get unique device ID from RP2040
     pico_unique_board_id_t board_id;
     pico_get_unique_board_id(&board_id);
-    
+
     // Convert to 32-bit serial number
     uint32_t serial = 0;
-    for (int i = 0; i < 4; i++) {
-        serial ^= ((uint32_t*)board_id.id)[i];
+    for (int i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++) {
+        serial ^= (uint32_t)board_id.id[i] << (8 * (i % 4));
     }
-    
+
     return serial;
-}
\ No newline at end of file
+}
+
+// CDC transport
+
+static void usb_cdc_write(const char *data, size_t len) {
+    if (!usb_connected || !tud_cdc_connected()) {
+        return;
+    }
+
+    usb_lock();
+    uint64_t deadline = time_us_64() + USB_CDC_WRITE_TIMEOUT_US;
+
+    while (len > 0) {
+        uint32_t space = tud_cdc_write_available();
+        if (space > 0) {
+            uint32_t n = tud_cdc_write(data, len < space ? (uint32_t)len : space);
+            data += n;
+            len -= n;
+        } else {
+            // FIFO full - push what we have and service the stack ourselves,
+            // since the task interrupt is locked out while we hold the mutex
+            tud_cdc_write_flush();
+            tud_task();
+            if (time_us_64() > deadline || !tud_cdc_connected()) {
+                break;
+            }
+        }
+    }
+
+    tud_cdc_write_flush();
+    usb_unlock();
+}
+
+static void usb_stdio_out_chars(const char *buf, int len) {
+    usb_cdc_write(buf, (size_t)len);
+}
+
+static void usb_stdio_out_flush(void) {
+    if (!usb_connected) {
+        return;
+    }
+    usb_lock();
+    tud_cdc_write_flush();
+    usb_unlock();
+}
+
+// TinyUSB device callbacks (USB task context)
+
+void tud_mount_cb(void) {
+    usb_connected = true;
+    usb_mount_pending = true;
+    usb_suspended = false;
+    power_set_usb_suspended(false);
+}
+
+void tud_umount_cb(void) {
+    usb_connected = false;
+    usb_msc_discard_overlay();
+    update_uf2_reset();
+    power_signal_event(POWER_EVENT_USB);
+}
+
+void tud_suspend_cb(bool remote_wakeup_en) {
+    usb_suspended = true;
+    power_set_usb_suspended(true);
+}
+
+void tud_resume_cb(void) {
+    usb_suspended = false;
+    power_set_usb_suspended(false);
+}
+
+void tud_cdc_rx_cb(uint8_t itf) {
+    power_signal_event(POWER_EVENT_USB);
+}
+
+#if CASHSTICK_USB_HID
+// HID transport - commands arrive as 64-byte output reports, replies go
+// back as a stream of 64-byte input reports (zero padded)
+
+static void usb_hid_send_next_report(void) {
+    if (hid_tx_head == hid_tx_tail || !tud_hid_ready()) {
+        return;
+    }
+
+    uint8_t report[USB_HID_REPORT_SIZE] = {0};
+    size_t n = 0;
+    while (n < sizeof(report) && hid_tx_tail != hid_tx_head) {
+        report[n++] = hid_tx[hid_tx_tail];
+        hid_tx_tail = (hid_tx_tail + 1) % USB_HID_TX_SIZE;
+    }
+    tud_hid_report(0, report, sizeof(report));
+}
+
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                           const uint8_t *buffer, uint16_t bufsize) {
+    for (uint16_t i = 0; i < bufsize && hid_rx_len < sizeof(hid_rx); i++) {
+        if (buffer[i] == 0) {
+            // Padding ends the report; keep it as a line terminator
+            hid_rx[hid_rx_len++] = '\n';
+            break;
+        }
+        hid_rx[hid_rx_len++] = buffer[i];
+    }
+    power_signal_event(POWER_EVENT_USB);
+}
+
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               uint8_t *buffer, uint16_t reqlen) {
+    return 0;
+}
+
+void tud_hid_report_complete_cb(uint8_t instance, const uint8_t *report, uint16_t len) {
+    usb_hid_send_next_report();
+}
+#endif
@@ -0,0 +1,449 @@
+#include "cashstick.h"
+#include "msc_overlay.h"
+#include "uf2_stream.h"
+#include "tusb.h"
+
+// Virtual FAT12 volume served over USB mass storage. Nothing here touches
+// flash: file contents are rendered into RAM by usb_create_virtual_filesystem()
+// in thread context, and the MSC callbacks (which run from the USB task
+// interrupt) only copy out of those buffers.
+//
+// Hosts write to every volume they mount (recycle bin and index folders,
+// access dates), and a read-only medium makes some of them retry or mount
+// slowly. Those writes go to a small RAM overlay instead (msc_overlay.h)
+// that reads check first; it is dropped on eject, unmount, or when the
+// volume is rendered again, so the next mount sees the generated volume.
+// In update mode, sectors holding UF2 blocks go to the firmware update
+// instead (see firmware_update.c); the blocks identify themselves, so the
+// file's place on the volume does not matter.
+
+// Volume geometry: 8 MB, 4 KB clusters, one cluster per file
+#define MSC_BLOCK_SIZE          512
+#define MSC_BLOCK_COUNT         16384
+#define MSC_SECTORS_PER_CLUSTER 8
+#define MSC_RESERVED_SECTORS    1
+#define MSC_FAT_SECTORS         6       // (2046 clusters + 2) * 1.5 bytes
+#define MSC_ROOT_ENTRIES        64
+#define MSC_ROOT_SECTORS        (MSC_ROOT_ENTRIES * 32 / MSC_BLOCK_SIZE)
+#define MSC_FAT_LBA             MSC_RESERVED_SECTORS
+#define MSC_ROOT_LBA            (MSC_FAT_LBA + MSC_FAT_SECTORS)
+#define MSC_DATA_LBA            (MSC_ROOT_LBA + MSC_ROOT_SECTORS)
+
+// Fixed timestamp for every entry: 2025-09-03 12:00:00
+#define MSC_FAT_DATE    ((uint16_t)(((2025 - 1980) << 9) | (9 << 5) | 3))
+#define MSC_FAT_TIME    ((uint16_t)(12 << 11))
+
+typedef struct {
+    const char name[11];    // 8.3, space padded
+    char *data;
+    size_t length;          // 0 = file not present
+} msc_file_t;
+
+static char readme_data[768];
+static char address_data[192];
+static char info_data[384];
+static char private_data[256];
+
+static msc_file_t msc_files[] = {
+    { "README  TXT", readme_data,  0 },
+    { "ADDRESS TXT", address_data, 0 },
+    { "INFO    TXT", info_data,    0 },
+    { "PRIVATE TXT", private_data, 0 },
+};
+
+enum {
+    MSC_FILE_README = 0,
+    MSC_FILE_ADDRESS,
+    MSC_FILE_INFO,
+    MSC_FILE_PRIVATE
+};
+
+static volatile bool media_changed = false;
+static bool ejected = false;
+static bool reveal_rendered = false;    // PRIVATE.TXT holds reveal_public_key's key
+static uint8_t reveal_public_key[33];
+
+// Sized at least one so the arrays are legal with the overlay compiled out
+#define MSC_OVERLAY_SLOTS (CASHSTICK_MSC_OVERLAY_SECTORS > 0 ? CASHSTICK_MSC_OVERLAY_SECTORS : 1)
+
+static uint8_t overlay_sectors[MSC_OVERLAY_SLOTS][MSC_BLOCK_SIZE];
+static uint32_t overlay_lba[MSC_OVERLAY_SLOTS];
+static uint32_t overlay_last_use[MSC_OVERLAY_SLOTS];
+
+// Boot sector, FAT and root directory are evicted last
+static msc_overlay_t overlay = {
+    .sectors = overlay_sectors,
+    .lba = overlay_lba,
+    .last_use = overlay_last_use,
+    .capacity = CASHSTICK_MSC_OVERLAY_SECTORS,
+    .pin_below = MSC_DATA_LBA,
+};
+
+static void msc_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void msc_put_u32(uint8_t *p, uint32_t v) {
+    msc_put_u16(p, (uint16_t)v);
+    msc_put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+// Rendering (thread context)
+
+void usb_create_virtual_filesystem(void) {
+    char addresses[ADDRESS_FORMAT_COUNT][ADDRESS_P2TR_LEN];
+    bool has_address = false;
+    for (int f = 0; f < ADDRESS_FORMAT_COUNT; f++) {
+        if (!wallet_get_address((address_format_t)f, addresses[f], sizeof(addresses[f]))) {
+            addresses[f][0] = '\0';
+        } else {
+            has_address = true;
+        }
+    }
+
+    usb_lock();
+
+    msc_files[MSC_FILE_README].length = (size_t)snprintf(readme_data, sizeof(readme_data),
+        "CashStick Bitcoin Bearer Device\r\n"
+        "===============================\r\n"
+        "\r\n"
+        "ADDRESS.TXT  Bitcoin addresses held by this stick (one key, each format)\r\n"
+        "INFO.TXT     Device serial number and security status\r\n"
+        "\r\n"
+        "Green LED: sealed - only the address is available.\r\n"
+        "Red LED:   seal broken - PRIVATE.TXT holds the key to sweep funds.\r\n"
+        "Blue LED:  new device - press TEST to generate a wallet.\r\n");
+
+    if (has_address) {
+        size_t len = 0;
+        for (int f = 0; f < ADDRESS_FORMAT_COUNT; f++) {
+            if (addresses[f][0] != '\0' && len < sizeof(address_data)) {
+                len += (size_t)snprintf(address_data + len, sizeof(address_data) - len, "%-7s %s\r\n",
+                                        address_format_name((address_format_t)f), addresses[f]);
+            }
+        }
+        msc_files[MSC_FILE_ADDRESS].length = len < sizeof(address_data) ? len : sizeof(address_data) - 1;
+    } else {
+        msc_files[MSC_FILE_ADDRESS].length = 0;
+    }
+
+    msc_files[MSC_FILE_INFO].length = (size_t)snprintf(info_data, sizeof(info_data),
+        "Serial:   %08lx\r\n"
+        "Firmware: 1.0.0\r\n"
+        "Updates:  %s\r\n"
+        "SE050:    %s\r\n"
+        "Wallet:   %s\r\n"
+        "Keys:     %s\r\n",
+        (unsigned long)get_device_serial(),
+        CASHSTICK_DEV_SIGNING_KEY ? "DEVELOPMENT KEY - anyone can sign" : "vendor signed",
+        CASHSTICK_DEV_SCP03_KEYS ? "TEST KEYS - anyone can open the channel" : "provisioned keys",
+        has_address ? "initialized" : "not initialized",
+        wallet_are_keys_revealed() ? "REVEALED" : "sealed");
+
+    // Host writes were made against the old FAT and directory
+    msc_overlay_discard(&overlay);
+    media_changed = true;
+    usb_unlock();
+}
+
+void usb_create_key_reveal_files(const bitcoin_keys_t *keys) {
+    if (!keys || !keys->keys_revealed) {
+        return;
+    }
+
+    // Every failed tamper check - each STATUS poll of a broken stick -
+    // lands here. Rendering the same key again would discard the host's
+    // overlay writes and force a remount, so only a new reveal does.
+    if (reveal_rendered && memcmp(reveal_public_key, keys->public_key, sizeof(reveal_public_key)) == 0) {
+        return;
+    }
+    memcpy(reveal_public_key, keys->public_key, sizeof(reveal_public_key));
+    reveal_rendered = true;
+
+    printf("USB: Creating key reveal files for owner\n");
+
+    usb_lock();
+    size_t len = (size_t)snprintf(private_data, sizeof(private_data), "Private key (hex): ");
+    for (int i = 0; i < 32 && len + 2 < sizeof(private_data); i++) {
+        len += (size_t)snprintf(private_data + len, sizeof(private_data) - len, "%02x", keys->private_key[i]);
+    }
+    const char *address = address_table_get(&keys->addresses, ADDRESS_FORMAT_DEFAULT);
+    len += (size_t)snprintf(private_data + len, sizeof(private_data) - len,
+        "\r\nAddress: %s\r\n"
+        "Import this key into any Bitcoin wallet and sweep the funds.\r\n",
+        address ? address : "");
+    msc_files[MSC_FILE_PRIVATE].length = len < sizeof(private_data) ? len : sizeof(private_data) - 1;
+    usb_unlock();
+
+    // Refresh the rest of the volume (status now reads REVEALED)
+    usb_create_virtual_filesystem();
+}
+
+void usb_msc_get_overlay_stats(usb_msc_overlay_stats_t *stats) {
+    usb_lock();
+    stats->capacity = overlay.capacity;
+    stats->used = overlay.used;
+    stats->writes = overlay.stats.writes;
+    stats->read_hits = overlay.stats.read_hits;
+    stats->evictions = overlay.stats.evictions;
+    stats->pinned_evictions = overlay.stats.pinned_evictions;
+    stats->discards = overlay.stats.discards;
+    usb_unlock();
+}
+
+// Host is gone (USB task context); the next mount starts clean
+void usb_msc_discard_overlay(void) {
+    msc_overlay_discard(&overlay);
+}
+
+// Sector generators (USB task context)
+
+static void msc_read_boot_sector(uint8_t *sector) {
+    static const uint8_t jump[3] = {0xEB, 0x3C, 0x90};
+    memcpy(sector, jump, sizeof(jump));
+    memcpy(sector + 3, "MSWIN4.1", 8);
+    msc_put_u16(sector + 11, MSC_BLOCK_SIZE);
+    sector[13] = MSC_SECTORS_PER_CLUSTER;
+    msc_put_u16(sector + 14, MSC_RESERVED_SECTORS);
+    sector[16] = 1;                                 // Number of FATs
+    msc_put_u16(sector + 17, MSC_ROOT_ENTRIES);
+    msc_put_u16(sector + 19, MSC_BLOCK_COUNT);
+    sector[21] = 0xF8;                              // Fixed media
+    msc_put_u16(sector + 22, MSC_FAT_SECTORS);
+    msc_put_u16(sector + 24, 1);                    // Sectors per track
+    msc_put_u16(sector + 26, 1);                    // Heads
+    sector[36] = 0x80;                              // Drive number
+    sector[38] = 0x29;                              // Extended boot signature
+    msc_put_u32(sector + 39, get_device_serial());  // Volume serial
+    memcpy(sector + 43, "CASHSTICK  ", 11);
+    memcpy(sector + 54, "FAT12   ", 8);
+    sector[510] = 0x55;
+    sector[511] = 0xAA;
+}
+
+static uint16_t msc_fat_entry(uint32_t entry) {
+    if (entry == 0) {
+        return 0xFF8;       // Media descriptor
+    }
+    if (entry == 1) {
+        return 0xFFF;
+    }
+    // Files occupy clusters 2..N+1, each a single-cluster chain
+    return (entry < 2 + count_of(msc_files)) ? 0xFFF : 0x000;
+}
+
+static void msc_read_fat_sector(uint32_t fat_sector, uint8_t *sector) {
+    // FAT12 packs two 12-bit entries into every three bytes
+    for (uint32_t i = 0; i < MSC_BLOCK_SIZE; i++) {
+        uint32_t byte_index = fat_sector * MSC_BLOCK_SIZE + i;
+        uint32_t pair = byte_index / 3;
+        uint16_t even = msc_fat_entry(pair * 2);
+        uint16_t odd = msc_fat_entry(pair * 2 + 1);
+
+        switch (byte_index % 3) {
+            case 0:
+                sector[i] = (uint8_t)even;
+                break;
+            case 1:
+                sector[i] = (uint8_t)(((even >> 8) & 0x0F) | ((odd & 0x0F) << 4));
+                break;
+            default:
+                sector[i] = (uint8_t)(odd >> 4);
+                break;
+        }
+    }
+}
+
+static void msc_read_root_sector(uint32_t root_sector, uint8_t *sector) {
+    if (root_sector != 0) {
+        return;  // All entries fit in the first sector
+    }
+
+    // Volume label entry
+    memcpy(sector, "CASHSTICK  ", 11);
+    sector[11] = 0x08;
+
+    uint8_t *entry = sector + 32;
+    for (uint32_t i = 0; i < count_of(msc_files); i++) {
+        if (msc_files[i].length == 0) {
+            continue;
+        }
+        memcpy(entry, msc_files[i].name, 11);
+        entry[11] = 0x01;                               // Read-only
+        msc_put_u16(entry + 14, MSC_FAT_TIME);          // Created
+        msc_put_u16(entry + 16, MSC_FAT_DATE);
+        msc_put_u16(entry + 18, MSC_FAT_DATE);          // Accessed
+        msc_put_u16(entry + 22, MSC_FAT_TIME);          // Modified
+        msc_put_u16(entry + 24, MSC_FAT_DATE);
+        msc_put_u16(entry + 26, (uint16_t)(2 + i));     // First cluster
+        msc_put_u32(entry + 28, (uint32_t)msc_files[i].length);
+        entry += 32;
+    }
+}
+
+static void msc_read_data_sector(uint32_t data_sector, uint8_t *sector) {
+    uint32_t file_index = data_sector / MSC_SECTORS_PER_CLUSTER;
+    uint32_t offset = (data_sector % MSC_SECTORS_PER_CLUSTER) * MSC_BLOCK_SIZE;
+
+    if (file_index >= count_of(msc_files) || offset >= msc_files[file_index].length) {
+        return;
+    }
+
+    size_t len = msc_files[file_index].length - offset;
+    if (len > MSC_BLOCK_SIZE) {
+        len = MSC_BLOCK_SIZE;
+    }
+    memcpy(sector, msc_files[file_index].data + offset, len);
+}
+
+static void msc_read_sector(uint32_t lba, uint8_t *sector) {
+    if (msc_overlay_read(&overlay, lba, sector)) {
+        return;
+    }
+
+    memset(sector, 0, MSC_BLOCK_SIZE);
+
+    if (lba == 0) {
+        msc_read_boot_sector(sector);
+    } else if (lba < MSC_ROOT_LBA) {
+        msc_read_fat_sector(lba - MSC_FAT_LBA, sector);
+    } else if (lba < MSC_DATA_LBA) {
+        msc_read_root_sector(lba - MSC_ROOT_LBA, sector);
+    } else {
+        msc_read_data_sector(lba - MSC_DATA_LBA, sector);
+    }
+}
+
+// TinyUSB MSC callbacks
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4]) {
+    (void)lun;
+    memcpy(vendor_id, "CashStk ", 8);
+    memcpy(product_id, "Bearer Device   ", 16);
+    memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun) {
+    if (ejected) {
+        tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3A, 0x00);  // Medium not present
+        return false;
+    }
+
+    // Report a media change once so the host drops its cached directory
+    if (media_changed) {
+        media_changed = false;
+        tud_msc_set_sense(lun, SCSI_SENSE_UNIT_ATTENTION, 0x28, 0x00);
+        return false;
+    }
+
+    return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size) {
+    (void)lun;
+    *block_count = MSC_BLOCK_COUNT;
+    *block_size = MSC_BLOCK_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject) {
+    (void)lun;
+    (void)power_condition;
+
+    if (load_eject) {
+        ejected = !start;
+        if (ejected) {
+            msc_overlay_discard(&overlay);
+            update_uf2_reset();
+        }
+    }
+    return true;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize) {
+    (void)lun;
+    uint8_t sector[MSC_BLOCK_SIZE];
+    uint8_t *out = (uint8_t *)buffer;
+    uint32_t done = 0;
+
+    while (done < bufsize) {
+        if (lba >= MSC_BLOCK_COUNT) {
+            return -1;
+        }
+
+        msc_read_sector(lba, sector);
+
+        uint32_t chunk = MSC_BLOCK_SIZE - offset;
+        if (chunk > bufsize - done) {
+            chunk = bufsize - done;
+        }
+        memcpy(out + done, sector + offset, chunk);
+
+        done += chunk;
+        offset = 0;
+        lba++;
+    }
+
+    return (int32_t)done;
+}
+
+bool tud_msc_is_writable_cb(uint8_t lun) {
+    (void)lun;
+    return CASHSTICK_MSC_OVERLAY_SECTORS > 0 || usb_is_mass_storage_mode();
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize) {
+    (void)lun;
+    uint8_t sector[MSC_BLOCK_SIZE];
+    uint32_t done = 0;
+
+    while (done < bufsize) {
+        if (lba >= MSC_BLOCK_COUNT) {
+            return -1;
+        }
+
+        uint32_t chunk = MSC_BLOCK_SIZE - offset;
+        if (chunk > bufsize - done) {
+            chunk = bufsize - done;
+        }
+
+        if (chunk == MSC_BLOCK_SIZE && usb_is_mass_storage_mode() && uf2_is_block(buffer + done)) {
+            if (!update_uf2_block(buffer + done)) {
+                return -1;
+            }
+        } else if (CASHSTICK_MSC_OVERLAY_SECTORS == 0) {
+            return -1;  // Volume is read-only
+        } else if (chunk == MSC_BLOCK_SIZE) {
+            msc_overlay_write(&overlay, lba, buffer + done);
+        } else {
+            // Part of a sector: patch what the host would read back
+            uint8_t *current = msc_overlay_find(&overlay, lba);
+            if (!current) {
+                msc_read_sector(lba, sector);
+                current = sector;
+            }
+            memcpy(current + offset, buffer + done, chunk);
+            msc_overlay_write(&overlay, lba, current);
+        }
+
+        done += chunk;
+        offset = 0;
+        lba++;
+    }
+
+    return (int32_t)done;
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, const uint8_t scsi_cmd[16], void *buffer, uint16_t bufsize) {
+    (void)buffer;
+    (void)bufsize;
+
+    switch (scsi_cmd[0]) {
+        case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+            return 0;   // Nothing to lock, always allow
+
+        default:
+            tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+            return -1;
+    }
+}
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""Profile-guided SRAM placement list, and before/after cycle reports.
+
+    hot_functions.py select --map FIRMWARE.elf.map BENCH.LOG [--budget BYTES] [-o HEADER]
+    hot_functions.py compare BEFORE.LOG AFTER.LOG
+
+BENCH.LOG is the stdio capture of a CASHSTICK_BENCHMARKS build. Profile that
+build with CASHSTICK_RAM_FUNCTIONS off, so every sample lands in flash.
+
+select spreads the PROFILE buckets over the functions in the linker map
+(the SDK builds with -ffunction-sections, so each function has its own
+.text.<name> input section). It ranks the functions by samples per byte
+and fills the SRAM budget greedily from the top. Only functions written
+as RAM_FUNC(name) in src/ can move. Hot functions without the marker are
+listed in the report so they can be marked. The result is written as
+include/hot_functions.h.
+
+compare lines up the "BENCH: cycles" results of two runs.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+PROFILE_HEADER = re.compile(r"PROFILE: samples (\d+) flash (\d+) ram (\d+) other (\d+) bucket (\d+)")
+PROFILE_BUCKET = re.compile(r"PROFILE: ([0-9a-fA-F]{8}) (\d+)\s*$")
+CYCLES_LINE = re.compile(r"BENCH: cycles (\S+)\s+cold\s+(\d+)\s+warm\s+(\d+)")
+TEXT_SECTION = re.compile(r"^ \.text\.(\S+)?\s*(?:0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+))?")
+ADDR_SIZE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+\S")
+RAM_FUNC = re.compile(r"RAM_FUNC\((\w+)\)")
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def read_profile(path):
+    bucket_size = 64
+    buckets = []
+    ram = total = 0
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = PROFILE_HEADER.search(line)
+            if m:
+                total, ram, bucket_size = int(m.group(1)), int(m.group(3)), int(m.group(5))
+                buckets = []    # Keep the last profile in the log
+                continue
+            m = PROFILE_BUCKET.search(line)
+            if m:
+                buckets.append((int(m.group(1), 16), int(m.group(2))))
+    return buckets, bucket_size, total, ram
+
+
+def read_functions(map_path):
+    """(name, start, size) of every .text.<name> input section."""
+    functions = []
+    pending = None
+    in_map = False
+    with open(map_path) as f:
+        for line in f:
+            if line.startswith("Linker script and memory map"):
+                in_map = True
+                continue
+            if not in_map:
+                continue
+            if pending is not None:
+                m = ADDR_SIZE.match(line)
+                if m and int(m.group(2), 16) > 0:
+                    functions.append((pending, int(m.group(1), 16), int(m.group(2), 16)))
+                pending = None
+                continue
+            m = TEXT_SECTION.match(line)
+            if not m or not m.group(1):
+                continue
+            if m.group(2) is None:
+                pending = m.group(1)    # Long name, address on the next line
+            elif int(m.group(3), 16) > 0:
+                functions.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16)))
+    return sorted(functions, key=lambda fn: fn[1])
+
+
+def read_candidates(src_dir):
+    names = set()
+    for root, _, files in os.walk(src_dir):
+        for name in files:
+            if name.endswith(".c"):
+                with open(os.path.join(root, name)) as f:
+                    names.update(RAM_FUNC.findall(f.read()))
+    return names
+
+
+def attribute(buckets, bucket_size, functions):
+    """Spread each bucket's samples over the functions it overlaps."""
+    samples = {}
+    starts = [fn[1] for fn in functions]
+    for addr, count in buckets:
+        end = addr + bucket_size
+        # Functions are sorted by start: walk back to the first one that
+        # could reach into the bucket
+        i = max(0, _bisect(starts, addr) - 1)
+        overlaps = []
+        while i < len(functions) and functions[i][1] < end:
+            name, start, size = functions[i]
+            overlap = min(end, start + size) - max(addr, start)
+            if overlap > 0:
+                overlaps.append((name, overlap))
+            i += 1
+        covered = sum(o for _, o in overlaps)
+        for name, overlap in overlaps:
+            samples[name] = samples.get(name, 0.0) + count * overlap / covered
+    return samples
+
+
+def _bisect(values, x):
+    lo, hi = 0, len(values)
+    while lo < hi:
+        mid = (lo + hi) // 2
+        if values[mid] <= x:
+            lo = mid + 1
+        else:
+            hi = mid
+    return lo
+
+
+def write_header(path, selected, log_name, total):
+    with open(path, "w") as f:
+        f.write("#ifndef HOT_FUNCTIONS_H\n#define HOT_FUNCTIONS_H\n\n")
+        f.write("// Functions copied to SRAM when built with CASHSTICK_RAM_FUNCTIONS (see\n")
+        f.write("// ram_functions.h). Generated by tools/hot_functions.py select from\n")
+        f.write("// %s (%d samples); regenerate rather than edit.\n\n" % (log_name, total))
+        for name, share, size in selected:
+            f.write("#define CASHSTICK_HOT_%s 1    // %4.1f%% of samples, %d bytes\n" % (name, share, size))
+        f.write("\n#endif // HOT_FUNCTIONS_H\n")
+
+
+def cmd_select(args):
+    buckets, bucket_size, total, ram = read_profile(args.log)
+    if not buckets:
+        print("hot_functions: no PROFILE lines in %s" % args.log, file=sys.stderr)
+        return 2
+    functions = read_functions(args.map)
+    candidates = read_candidates(os.path.join(REPO, "src"))
+    samples = attribute(buckets, bucket_size, functions)
+    sizes = {name: size for name, _, size in functions}
+
+    if total and ram * 20 > total:
+        print("hot_functions: %d%% of samples already in SRAM - profile a build without "
+              "CASHSTICK_RAM_FUNCTIONS" % (100 * ram // total), file=sys.stderr)
+
+    flash_samples = sum(samples.values()) or 1.0
+    ranked = sorted(samples, key=lambda n: samples[n] / sizes[n], reverse=True)
+
+    selected = []
+    used = 0
+    print("%8s %6s %7s  %-32s %s" % ("samples", "share", "bytes", "function", ""))
+    for name in sorted(samples, key=lambda n: samples[n], reverse=True)[:args.top]:
+        share = 100.0 * samples[name] / flash_samples
+        note = "" if name in candidates else "not RAM_FUNC"
+        print("%8.0f %5.1f%% %7d  %-32s %s" % (samples[name], share, sizes[name], name, note))
+
+    for name in ranked:
+        share = 100.0 * samples[name] / flash_samples
+        if name not in candidates or share < args.min_share:
+            continue
+        if used + sizes[name] > args.budget:
+            continue
+        selected.append((name, share, sizes[name]))
+        used += sizes[name]
+
+    covered = sum(share for _, share, _ in selected)
+    print("selected %d functions, %d bytes of SRAM, %.1f%% of flash samples"
+          % (len(selected), used, covered))
+    write_header(args.output, selected, os.path.basename(args.log), total)
+    return 0
+
+
+def read_cycles(path):
+    cycles = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = CYCLES_LINE.search(line)
+            if m:
+                cycles[m.group(1)] = (int(m.group(2)), int(m.group(3)))
+    return cycles
+
+
+def cmd_compare(args):
+    before = read_cycles(args.before)
+    after = read_cycles(args.after)
+    if not before or not after:
+        print("hot_functions: no 'BENCH: cycles' lines to compare", file=sys.stderr)
+        return 2
+
+    def delta(a, b):
+        return "%+6.1f%%" % (100.0 * (b - a) / a) if a else "   n/a"
+
+    print("%-20s %12s %12s %8s %12s %12s %8s"
+          % ("kernel", "cold before", "cold after", "", "warm before", "warm after", ""))
+    for name in before:
+        if name not in after:
+            continue
+        (cold_a, warm_a), (cold_b, warm_b) = before[name], after[name]
+        print("%-20s %12d %12d %8s %12d %12d %8s" % (name, cold_a, cold_b, delta(cold_a, cold_b),
+                                                    warm_a, warm_b, delta(warm_a, warm_b)))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    select = sub.add_parser("select", help="generate hot_functions.h from a profile")
+    select.add_argument("log")
+    select.add_argument("--map", required=True, help="linker map of the profiled build")
+    select.add_argument("--budget", type=lambda v: int(v, 0), default=16384,
+                        help="SRAM bytes to spend on code (default 16384)")
+    select.add_argument("--min-share", type=float, default=0.5,
+                        help="ignore functions under this percentage of samples")
+    select.add_argument("--top", type=int, default=20, help="functions to list in the report")
+    select.add_argument("-o", "--output", default=os.path.join(REPO, "include", "hot_functions.h"))
+    select.set_defaults(run=cmd_select)
+
+    compare = sub.add_parser("compare", help="before/after cycle counts of two benchmark runs")
+    compare.add_argument("before")
+    compare.add_argument("after")
+    compare.set_defaults(run=cmd_compare)
+
+    args = parser.parse_args()
+    return args.run(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""RAM/flash budget report from a GNU ld map file.
+
+    memory_budget.py FIRMWARE.elf.map [--budget REGION=BYTES]... [--top N]
+
+Prints the usage of every memory region in the map (FLASH, RAM and the
+two SCRATCH banks holding the core stacks on the RP2040) and the largest
+objects in RAM. Exits non-zero if a region is over its budget; a region
+without a budget is checked against its size in the linker script.
+
+Flash usage counts both what runs from flash and the load images of
+initialised RAM sections (.data and friends) stored there. RAM usage is
+the static part only: .heap is reported on its own line.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+HEX = r"0x([0-9a-fA-F]+)"
+MEMORY_LINE = re.compile(r"^(\S+)\s+" + HEX + r"\s+" + HEX)
+SECTION_LINE = re.compile(r"^(\S+)?\s+" + HEX + r"\s+" + HEX + r"(?:\s+load address " + HEX + r")?\s*$")
+INPUT_LINE = re.compile(r"^ (\S+)?\s+" + HEX + r"\s+" + HEX + r"\s+(\S.*)$")
+
+
+class Region:
+    def __init__(self, name, origin, length):
+        self.name = name
+        self.origin = origin
+        self.length = length
+        self.used_end = origin
+        self.static = 0
+        self.sections = []
+
+    def contains(self, addr):
+        return self.origin <= addr < self.origin + self.length
+
+
+def parse_map(path):
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    regions = []
+    sections = []   # (name, vma, size, lma)
+    objects = []    # (name, vma, size, file)
+
+    i = 0
+    while i < len(lines) and lines[i].strip() != "Memory Configuration":
+        i += 1
+    for line in lines[i + 1:]:
+        if line.startswith("Linker script and memory map"):
+            break
+        m = MEMORY_LINE.match(line)
+        if m and m.group(1) != "*default*":
+            regions.append(Region(m.group(1), int(m.group(2), 16), int(m.group(3), 16)))
+
+    in_map = False
+    pending_section = None
+    pending_input = None
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+
+        # Output sections start in column 0; a long name is wrapped onto
+        # a line of its own with the address and size on the next one
+        if line and not line[0].isspace():
+            pending_input = None
+            if line.startswith(".") and len(line.split()) == 1:
+                pending_section = line
+                continue
+            m = SECTION_LINE.match(line)
+            if m and m.group(1):
+                sections.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16),
+                                 int(m.group(4), 16) if m.group(4) else None))
+            pending_section = None
+            continue
+
+        if pending_section is not None:
+            m = SECTION_LINE.match(line)
+            if m and not m.group(1):
+                sections.append((pending_section, int(m.group(2), 16), int(m.group(3), 16),
+                                 int(m.group(4), 16) if m.group(4) else None))
+            pending_section = None
+            continue
+
+        # Input sections: " .bss.name  0xADDR  0xSIZE  file", possibly wrapped
+        stripped = line.split()
+        if line.startswith(" ") and not line.startswith("  ") and len(stripped) == 1:
+            pending_input = stripped[0]
+            continue
+        m = INPUT_LINE.match(line)
+        if m:
+            name = m.group(1) or pending_input
+            if name and name != "*fill*":
+                objects.append((name, int(m.group(2), 16), int(m.group(3), 16), m.group(4).strip()))
+        pending_input = None
+
+    return regions, sections, objects
+
+
+def object_name(section):
+    for prefix in (".bss.", ".data.", ".sbss.", ".sdata.", ".time_critical.", ".uninitialized_data."):
+        if section.startswith(prefix):
+            return section[len(prefix):]
+    return section
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map")
+    parser.add_argument("--budget", action="append", default=[], metavar="REGION=BYTES")
+    parser.add_argument("--top", type=int, default=10, help="largest RAM objects to list")
+    args = parser.parse_args()
+
+    budgets = {}
+    for spec in args.budget:
+        name, _, value = spec.partition("=")
+        budgets[name] = int(value, 0)
+
+    regions, sections, objects = parse_map(args.map)
+    if not regions or not sections:
+        print("memory_budget: no memory map in %s" % args.map, file=sys.stderr)
+        return 2
+
+    heap = 0
+    for name, vma, size, lma in sections:
+        if size == 0:
+            continue
+        for region in regions:
+            if region.contains(vma):
+                region.used_end = max(region.used_end, vma + size)
+                if name == ".heap":
+                    heap += size
+                else:
+                    region.static += size
+                    region.sections.append((name, size))
+            if lma is not None and lma != vma and region.contains(lma):
+                region.used_end = max(region.used_end, lma + size)
+
+    print("Memory budget (%s)" % os.path.basename(args.map))
+    print("  %-10s %10s %10s %10s %7s" % ("region", "used", "size", "budget", "of"))
+
+    failed = []
+    for region in regions:
+        # Flash is measured as image extent, everything else as static use
+        used = region.used_end - region.origin if region.name == "FLASH" else region.static
+        budget = budgets.get(region.name, region.length)
+        print("  %-10s %10d %10d %10d %6.1f%%" % (region.name, used, region.length, budget,
+                                                  100.0 * used / budget if budget else 0.0))
+        if region.name != "FLASH" and region.sections and len(region.sections) <= 4:
+            print("  %-10s %s" % ("", ", ".join("%s %d" % s for s in region.sections)))
+        if used > budget:
+            failed.append((region.name, used - budget))
+    print("  %-10s %10d" % ("heap", heap))
+
+    ram = [r for r in regions if r.name == "RAM"]
+    if ram and args.top > 0:
+        largest = sorted((o for o in objects if ram[0].contains(o[1]) and o[2] > 0),
+                         key=lambda o: o[2], reverse=True)[:args.top]
+        print("  Largest RAM objects:")
+        for name, _, size, path in largest:
+            print("  %10d  %-32s %s" % (size, object_name(name), os.path.basename(path)))
+
+    for name, excess in failed:
+        print("memory_budget: %s over budget by %d bytes" % (name, excess), file=sys.stderr)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())